@@ -24,6 +24,7 @@
 #include <stopwidget.h>
 #include <checkcombobox.h>
 #include <vehicletypemodel.h>
+#include <vehicleiconatlas.h>
 
 // KDE includes
 #include <KLocale>
@@ -71,6 +72,8 @@ GraphicalTimetableLine::GraphicalTimetableLine(QObject *parent, const QVariantLi
     setBackgroundHints(DefaultBackground);
     m_svg.setImagePath( KGlobal::dirs()->findResource("data", "plasma_applet_graphicaltimetableline/vehicles.svg") );
     m_svg.setContainsMultipleImages( true );
+    m_vehicleIconSvgId = VehicleIconAtlas::self()->registerSvg( m_svg.imagePath() );
+    connect( &m_svg, SIGNAL(repaintNeeded()), this, SLOT(svgChanged()) );
 
     setAspectRatioMode(Plasma::IgnoreAspectRatio);
     setHasConfigurationInterface(true);
@@ -218,6 +221,7 @@ void GraphicalTimetableLine::configAccepted()
 
     qDeleteAll( m_departures );
     m_departures.clear();
+    m_departureIndex.clear();
 
     if ( m_stopSettings.stops().isEmpty() ) {
         setConfigurationRequired( true, i18n("Please select a stop name") );
@@ -261,6 +265,7 @@ void GraphicalTimetableLine::configAccepted()
 
     emit configNeedsSaving();
     configChanged();
+    update(); // The timetable may have been enabled/disabled
 
     m_stopWidget = 0;
     m_vehicleTypeModel = 0;
@@ -364,6 +369,14 @@ void GraphicalTimetableLine::zoomOut()
     update();
 }
 
+void GraphicalTimetableLine::svgChanged()
+{
+    // The cached SVG backgrounds need to be rendered again, eg. after the theme has changed
+    m_backgroundPixmap = QPixmap();
+    m_timetablePixmap = QPixmap();
+    update();
+}
+
 QDateTime GraphicalTimetableLine::endTime() const
 {
     return QDateTime::currentDateTime().addSecs( 60 * m_timelineLength );
@@ -420,6 +433,13 @@ void GraphicalTimetableLine::dataUpdated( const QString& sourceName,
         }
     }
 
+    // Forget departures that are too old to be added again
+    const QDateTime oldestTime = QDateTime::currentDateTime().addSecs( -60 );
+    QMap< QDateTime, QList<DepartureData> >::Iterator it = m_departureIndex.begin();
+    while ( it != m_departureIndex.end() && it.key() < oldestTime ) {
+        it = m_departureIndex.erase( it );
+    }
+
     QUrl url;
     QDateTime updated;
     url = data["requestUrl"].toUrl();
@@ -443,16 +463,11 @@ void GraphicalTimetableLine::dataUpdated( const QString& sourceName,
         DepartureData departureData( dateTime, departureHash["TransportLine"].toString(),
                                      departureHash["Target"].toString(), vehicleType );
 
-        bool departureIsOld = false;
-        foreach ( Departure *departure, m_departures ) {
-            if ( departure->containsDeparture(departureData) ) {
-                departureIsOld = true;
-                break;
-            }
-        }
-        if ( departureIsOld ) {
+        QList<DepartureData> &departuresAtTime = m_departureIndex[ dateTime ];
+        if ( departuresAtTime.contains(departureData) ) {
             continue; // Departure was already added in a previous dataUpdated call
         }
+        departuresAtTime << departureData;
 
         Departure *departure = new Departure( m_departureView, departureData );
         departure->setPos( m_timelineEnd );
@@ -487,7 +502,47 @@ void GraphicalTimetableLine::dataUpdated( const QString& sourceName,
     kDebug() << m_departures.count() << "departures after adding new ones";
     updateItemPositions( m_animate );
     m_animate = true;
-    update();
+    updateTimeDependentRegions();
+}
+
+QList<QRectF> GraphicalTimetableLine::timeMarkerRects() const
+{
+    QList<QRectF> rects;
+    QFontMetrics fm( font() );
+    QDateTime time( QDate::currentDate(), QTime(QTime::currentTime().hour() + 1, 0) );
+    QPointF pos = positionFromTime( time );
+    while ( !pos.isNull() ) {
+        QString text = KGlobal::locale()->formatTime(time.time());
+        int textWidth = fm.width( text );
+        rects << QRectF( pos.x() - textWidth / 2.0, pos.y() - fm.height() / 2.0,
+                         textWidth, fm.height() );
+
+        time = time.addSecs( 60 * 60 );
+        pos = positionFromTime( time );
+    }
+    return rects;
+}
+
+QRect GraphicalTimetableLine::timetableRect( const QRect &contentsRect ) const
+{
+    return QRect( contentsRect.left() + 5,
+                  contentsRect.top() + m_title->boundingRect().height() + 10,
+                  contentsRect.width() * 0.4, contentsRect.height() * 0.4 );
+}
+
+void GraphicalTimetableLine::updateTimeDependentRegions()
+{
+    // Update old and new time marker positions, including space for the halo
+    const QRect rect = contentsRect().toRect();
+    const QList<QRectF> markerRects = timeMarkerRects();
+    foreach ( const QRectF &markerRect, m_timeMarkerRects + markerRects ) {
+        update( markerRect.adjusted(-markerRect.height(), -markerRect.height(),
+                                    markerRect.height(), markerRect.height()) );
+    }
+
+    if ( m_showTimetable ) {
+        update( timetableRect(rect) );
+    }
 }
 
 void GraphicalTimetableLine::updateTitle()
@@ -870,44 +925,28 @@ void GraphicalTimetableLine::paintVehicle( QPainter* painter, VehicleType vehicl
     bool drawTransportLine = m_drawTransportLine && !transportLine.isEmpty()
             && PublicTransport::Global::generalVehicleType(vehicle) == LocalPublicTransport;
 
-    QString vehicleKey;
-    switch ( vehicle ) {
-        case Tram: vehicleKey = "tram"; break;
-        case Bus: vehicleKey = "bus"; break;
-        case TrolleyBus: vehicleKey = "trolleybus"; break;
-        case Subway: vehicleKey = "subway"; break;
-        case Metro: vehicleKey = "metro"; break;
-        case InterurbanTrain: vehicleKey = "interurbantrain"; break;
-        case RegionalTrain: vehicleKey = "regionaltrain"; break;
-        case RegionalExpressTrain: vehicleKey = "regionalexpresstrain"; break;
-        case InterregionalTrain: vehicleKey = "interregionaltrain"; break;
-        case IntercityTrain: vehicleKey = "intercitytrain"; break;
-        case HighSpeedTrain: vehicleKey = "highspeedtrain"; break;
-        case Feet: vehicleKey = "feet"; break;
-        case Ship: vehicleKey = "ship"; break;
-        case Plane: vehicleKey = "plane"; break;
-        default:
-            kDebug() << "Unknown vehicle type" << vehicle;
-            return; // TODO: draw a simple circle or something.. or an unknown vehicle type icon
-    }
+    // Draw the vehicle type icon with a shadow, rendered by the icon atlas shared by all applets
+    VehicleIconAtlas::IconFlags iconFlags = VehicleIconAtlas::ShadowedIcon;
     if ( drawTransportLine ) {
-        vehicleKey.append( "_empty" );
+        iconFlags |= VehicleIconAtlas::EmptyIcon;
     }
-    if ( !m_svg.hasElement(vehicleKey) ) {
-        kDebug() << "SVG element" << vehicleKey << "not found";
-        return;
+    // Departure items get resized in animations, use icons from a strip of sizes in
+    // VEHICLE_ICON_SIZE_STEP steps to not render new icons for each animation frame
+    const int iconSize = qMax( VEHICLE_ICON_SIZE_STEP,
+            qRound(rect.width() / VEHICLE_ICON_SIZE_STEP) * VEHICLE_ICON_SIZE_STEP );
+    const QPixmap icon = VehicleIconAtlas::self()->icon( m_vehicleIconSvgId, vehicle,
+            QSize(iconSize, iconSize), iconFlags );
+    if ( icon.isNull() ) {
+        if ( VehicleIconAtlas::elementId(vehicle).isEmpty() ) {
+            kDebug() << "Unknown vehicle type" << vehicle;
+        }
+        return; // TODO: draw a simple circle or something.. or an unknown vehicle type icon
     }
-
-    int shadowWidth = 4;
-    m_svg.resize( rect.width() - 2 * shadowWidth, rect.height() - 2 * shadowWidth );
-
-    QPixmap pixmap( (int)rect.width(), (int)rect.height() );
-    pixmap.fill( Qt::transparent );
-    QPainter p( &pixmap );
-    m_svg.paint( &p, shadowWidth, shadowWidth, vehicleKey );
+    painter->drawPixmap( rect, icon, icon.rect() );
 
     // Draw transport line string (only for local public transport)
     if ( drawTransportLine ) {
+        const int shadowWidth = VehicleIconAtlas::SHADOW_WIDTH;
         QString text = transportLine;
         text.remove( ' ' );
 
@@ -918,18 +957,13 @@ void GraphicalTimetableLine::paintVehicle( QPainter* painter, VehicleType vehicl
         } else {
             f.setPixelSize( rect.width() * 0.55 );
         }
-        p.setFont( f );
-        p.setPen( Qt::white );
-
-        QRect textRect( shadowWidth, shadowWidth,
-                        rect.width() - 2 * shadowWidth, rect.height() - 2 * shadowWidth );
-        p.drawText( textRect, text, QTextOption(Qt::AlignCenter) );
+        painter->save();
+        painter->setFont( f );
+        painter->setPen( Qt::white );
+        painter->drawText( rect.adjusted(shadowWidth, shadowWidth, -shadowWidth, -shadowWidth),
+                           text, QTextOption(Qt::AlignCenter) );
+        painter->restore();
     }
-
-    QImage shadow = pixmap.toImage();
-    Plasma::PaintUtils::shadowBlur( shadow, shadowWidth - 1, Qt::black );
-    painter->drawImage( rect.topLeft() + QPoint(1, 2), shadow );
-    painter->drawPixmap( rect.topLeft(), pixmap );
 }
 
 void GraphicalTimetableLine::resizeEvent(QGraphicsSceneResizeEvent* event)
@@ -961,28 +995,29 @@ void GraphicalTimetableLine::paintInterface( QPainter *p,
         kDebug() << "Background SVG element not found";
         return;
     }
-    m_svg.resize( (int)rect.width(), (int)rect.height() );
-    m_svg.paint( p, rect, "background" );
+    if ( m_backgroundPixmap.size() != rect.size() ) {
+        // Render the background only when the size changed,
+        // most paints only update a small region of it
+        m_backgroundPixmap = QPixmap( rect.size() );
+        m_backgroundPixmap.fill( Qt::transparent );
+        QPainter backgroundPainter( &m_backgroundPixmap );
+        m_svg.resize( rect.size() );
+        m_svg.paint( &backgroundPainter, m_backgroundPixmap.rect(), "background" );
+    }
+    p->drawPixmap( rect.topLeft(), m_backgroundPixmap );
 
     // Draw text markers (every full hour)
     QFont timeMarkerFont = font();
     timeMarkerFont.setBold( true );
     p->setFont( timeMarkerFont );
     p->setPen( Qt::darkGray );
-    QFontMetrics fm( font() );
     QDateTime time( QDate::currentDate(), QTime(QTime::currentTime().hour() + 1, 0) );
-    QPointF pos = positionFromTime( time );
-    while ( !pos.isNull() ) {
-        QString text = KGlobal::locale()->formatTime(time.time());
-        int textWidth = fm.width( text );
-        QRectF textRect( pos.x() - textWidth / 2.0, pos.y() - fm.height() / 2.0,
-                         textWidth, fm.height() );
-
+    m_timeMarkerRects = timeMarkerRects();
+    foreach ( const QRectF &textRect, m_timeMarkerRects ) {
         Plasma::PaintUtils::drawHalo( p, textRect );
-        p->drawText( textRect, text, QTextOption(Qt::AlignCenter) );
-
+        p->drawText( textRect, KGlobal::locale()->formatTime(time.time()),
+                     QTextOption(Qt::AlignCenter) );
         time = time.addSecs( 60 * 60 );
-        pos = positionFromTime( time );
     }
 
     if ( m_showTimetable ) {
@@ -996,10 +1031,9 @@ void GraphicalTimetableLine::paintInterface( QPainter *p,
         p->setPen( Plasma::Theme::defaultTheme()->color(Plasma::Theme::ViewTextColor) );
 #endif
 
-        fm = QFontMetrics( timetableFont );
+        QFontMetrics fm( timetableFont );
         qreal padding = 8;
-        QRect timetableRect( rect.left() + 5, rect.top() + m_title->boundingRect().height() + 10,
-                             rect.width() * 0.4, rect.height() * 0.4 );
+        const QRect timetableRect = this->timetableRect( rect );
         QRect timetableContentsRect = timetableRect.adjusted( padding, padding, -padding, -padding );
         int maxLines = qFloor( timetableRect.height() / fm.lineSpacing() ) - 1;
         QList<DepartureData> departureDataList;
@@ -1008,8 +1042,14 @@ void GraphicalTimetableLine::paintInterface( QPainter *p,
         }
 
         // Draw timetable background
-        m_svg.resize( (int)timetableRect.width(), (int)timetableRect.height() );
-        m_svg.paint( p, timetableRect, "timetable" );
+        if ( m_timetablePixmap.size() != timetableRect.size() ) {
+            m_timetablePixmap = QPixmap( timetableRect.size() );
+            m_timetablePixmap.fill( Qt::transparent );
+            QPainter timetablePainter( &m_timetablePixmap );
+            m_svg.resize( timetableRect.size() );
+            m_svg.paint( &timetablePainter, m_timetablePixmap.rect(), "timetable" );
+        }
+        p->drawPixmap( timetableRect.topLeft(), m_timetablePixmap );
 
         // Calculate column widths
         int maxTransportLineWidth = 0;
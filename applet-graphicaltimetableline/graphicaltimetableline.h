@@ -33,6 +33,7 @@
 #define MIN_DISTANCE_BETWEEN_DEPARTURES 50
 #define MIN_TIMELINE_LENGTH 5 // in minutes
 #define MAX_TIMELINE_LENGTH 3 * 60 // in minutes
+#define VEHICLE_ICON_SIZE_STEP 4 // Vehicle icons get rendered in multiples of this size (pixels)
 
 class QPropertyAnimation;
 class QCheckBox;
@@ -191,6 +192,20 @@ public:
     QDateTime endTime() const;
     void createTooltip( Departure *departure = 0 );
 
+    /** @brief Get the rectangles of the time markers (every full hour). */
+    QList<QRectF> timeMarkerRects() const;
+
+    /** @brief Get the rectangle of the mini timetable in @p contentsRect. */
+    QRect timetableRect( const QRect &contentsRect ) const;
+
+    /**
+     * @brief Repaint only the regions that change when the time advances.
+     *
+     * These are the old and new positions of the time markers and the mini timetable.
+     * Departure items repaint themselves when they get moved.
+     **/
+    void updateTimeDependentRegions();
+
     QPointF newDeparturePosition() const { return m_timelineEnd; };
 
 protected:
@@ -208,6 +223,9 @@ public slots:
     void zoomIn();
     void zoomOut();
 
+    /** @brief The SVG was changed, clears the cached SVG backgrounds and repaints. */
+    void svgChanged();
+
 private:
     // Configuration widgets
     StopWidget *m_stopWidget;
@@ -230,11 +248,20 @@ private:
     QGraphicsWidget *m_departureView;
     QList<Departure*> m_departures;
 
+    // Data of all added departures by departure time, to quickly find already added departures
+    QMap< QDateTime, QList<DepartureData> > m_departureIndex;
+
+    // Cached SVG backgrounds and the last painted time marker rectangles
+    QPixmap m_backgroundPixmap;
+    QPixmap m_timetablePixmap;
+    QList<QRectF> m_timeMarkerRects;
+
     // Data source info
     QDateTime m_lastSourceUpdate;
     QString m_sourceName;
 
     Plasma::Svg m_svg;
+    int m_vehicleIconSvgId; // The ID of m_svg in VehicleIconAtlas
     QPointF m_timelineStart;
     QPointF m_timelineEnd;
     bool m_animate;
@@ -2171,11 +2171,19 @@ void DepartureModel::fireAlarm( const QDateTime& dateTime, DepartureItem* item )
 
 RouteItemFlags PublicTransportModel::routeItemFlags( const QString& stopName ) const
 {
+    // Do not add stop names to the string table here, eg. texts of route stop tooltips,
+    // strings that are not in the table cannot be the highlighted or home stop
+    return routeItemFlags( StringTable::self()->findFoldedHandle(stopName) );
+}
+
+RouteItemFlags PublicTransportModel::routeItemFlags( int stopHandle ) const
+{
+    // Equal folded handles mean that the stop names are equal, ignoring case
     RouteItemFlags flags = RouteItemDefault;
-    if ( m_info.highlightedStop.compare(stopName, Qt::CaseInsensitive) == 0 ) {
+    if ( m_info.highlightedStopHandle == stopHandle ) {
         flags |= RouteItemHighlighted;
     }
-    if ( m_info.homeStop.compare(stopName, Qt::CaseInsensitive) == 0 ) {
+    if ( m_info.homeStopHandle == stopHandle ) {
         flags |= RouteItemHomeStop;
     }
     return flags;
@@ -2184,6 +2192,7 @@ RouteItemFlags PublicTransportModel::routeItemFlags( const QString& stopName ) c
 void PublicTransportModel::setHighlightedStop( const QString& stopName )
 {
     m_info.highlightedStop = stopName;
+    m_info.highlightedStopHandle = StringTable::self()->foldedHandle( stopName );
 
     if ( !m_items.isEmpty() ) {
         emit dataChanged( m_items.first()->index(), m_items.last()->index() );
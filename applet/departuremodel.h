@@ -29,6 +29,7 @@
 
 // libpublictransporthelper includes
 #include <departureinfo.h> // Member variable
+#include <stringtable.h> // For stop name handles
 
 // Qt includes
 #include <QAbstractItemModel> // Base class
@@ -42,6 +43,8 @@ struct Info {
         sizeFactor = 1.0f;
         alarmMinsBeforeDeparture = 5;
         currentStopSettingsIndex = -1;
+        homeStopHandle = 0;
+        highlightedStopHandle = 0;
     };
 
     AlarmSettingsList alarm;
@@ -51,6 +54,8 @@ struct Info {
     float sizeFactor;
     QString homeStop;
     QString highlightedStop;
+    int homeStopHandle; // StringTable::foldedHandle() of homeStop
+    int highlightedStopHandle; // StringTable::foldedHandle() of highlightedStop
 };
 
 /**
@@ -629,6 +634,7 @@ public:
 
     void setHomeStop( const QString &homeStop ) {
         m_info.homeStop = homeStop;
+        m_info.homeStopHandle = StringTable::self()->foldedHandle( homeStop );
     };
 
     /**
@@ -648,6 +654,17 @@ public:
      **/
     RouteItemFlags routeItemFlags( const QString &stopName ) const;
 
+    /**
+     * @brief Gets the flags for route stop item with the given @p stopHandle.
+     *
+     * This is faster than routeItemFlags(const QString&), because no stop names need to be
+     * compared.
+     *
+     * @param stopHandle The StringTable::foldedHandle() of the stop name which is associated
+     *   with the route stop item to get flags for, eg. from DepartureInfo::routeStopHandles().
+     **/
+    RouteItemFlags routeItemFlags( int stopHandle ) const;
+
     /**
      * @brief Notifies the model about changes in the given @p item.
      *
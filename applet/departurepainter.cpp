@@ -27,6 +27,7 @@
 // libpublictransporthelper includes
 #include <departureinfo.h>
 #include <global.h>
+#include <vehicleiconatlas.h>
 
 // KDE+Plasma includes
 #include <Plasma/Theme>
@@ -40,7 +41,8 @@
 #include <qmath.h>
 
 DeparturePainter::DeparturePainter( QObject *parent )
-        : QObject(parent), m_pixmapCache(new KPixmapCache("DeparturePainter")), m_svg(0)
+        : QObject(parent), m_pixmapCache(new KPixmapCache("DeparturePainter")), m_svg(0),
+          m_vehicleIconSvgId(-1)
 {
 }
 
@@ -51,38 +53,21 @@ DeparturePainter::~DeparturePainter()
 
 QString DeparturePainter::iconKey( VehicleType vehicle, DeparturePainter::VehicleIconFlags flags )
 {
-    QString vehicleKey;
-    switch ( vehicle ) {
-        case Tram: vehicleKey = "tram"; break;
-        case Bus: vehicleKey = "bus"; break;
-        case TrolleyBus: vehicleKey = "trolleybus"; break;
-        case Subway: vehicleKey = "subway"; break;
-        case Metro: vehicleKey = "metro"; break;
-        case InterurbanTrain: vehicleKey = "interurbantrain"; break;
-        case RegionalTrain: vehicleKey = "regionaltrain"; break;
-        case RegionalExpressTrain: vehicleKey = "regionalexpresstrain"; break;
-        case InterregionalTrain: vehicleKey = "interregionaltrain"; break;
-        case IntercityTrain: vehicleKey = "intercitytrain"; break;
-        case HighSpeedTrain: vehicleKey = "highspeedtrain"; break;
-        case Feet: vehicleKey = "feet"; break;
-        case Ship: vehicleKey = "ship"; break;
-        case Plane: vehicleKey = "plane"; break;
-        default:
-            kDebug() << "Unknown vehicle type" << vehicle;
-            return QString();
+    // The values of VehicleIconFlags match those of VehicleIconAtlas::IconFlags
+    const QString vehicleKey =
+            VehicleIconAtlas::elementId( vehicle, VehicleIconAtlas::IconFlags(int(flags)) );
+    if ( vehicleKey.isEmpty() ) {
+        kDebug() << "Unknown vehicle type" << vehicle;
     }
-
-    // Use monochrome (mostly white) icons
-    if ( flags.testFlag(MonochromeIcon) ) {
-        vehicleKey.append( "_white" );
-    }
-    if ( flags.testFlag(EmptyIcon) ) {
-        vehicleKey.append( "_empty" );
-    }
-
     return vehicleKey;
 }
 
+void DeparturePainter::setSvg( Plasma::Svg *svg )
+{
+    m_svg = svg;
+    m_vehicleIconSvgId = VehicleIconAtlas::self()->registerSvg( svg->imagePath() );
+}
+
 DeparturePainter::VehicleIconFlags DeparturePainter::iconFlagsFromIconDrawFlags(
         DeparturePainter::VehicleIconDrawFlags flags )
 {
@@ -108,25 +93,32 @@ void DeparturePainter::paintVehicle( QPainter* painter, VehicleType vehicle,
         iconDrawFlags &= ~DrawTransportLine;
     }
     const VehicleIconFlags iconFlags = iconFlagsFromIconDrawFlags( iconDrawFlags );
-    const QString vehicleKey = iconKey( vehicle, iconFlags );
-    const QString vehicleCacheKey = vehicleKey + QString("%1%2%3%4")
-            .arg( static_cast<int>(iconDrawFlags) ).arg( drawTransportLine ? transportLine : "" )
-            .arg( int(rect.width()) ).arg( int(rect.height()) );
     const int shadowWidth = qBound( 2, int(rect.width() / 20), 4 );
 
+    // Get the vehicle type icon from the icon atlas shared by all applets
+    const QPixmap icon = VehicleIconAtlas::self()->icon( m_vehicleIconSvgId, vehicle,
+            QSize(int(rect.width()) - shadowWidth, int(rect.height()) - shadowWidth),
+            VehicleIconAtlas::IconFlags(int(iconFlags)) );
+
     QPixmap vehiclePixmap;
-    if ( !m_pixmapCache->find(vehicleCacheKey, vehiclePixmap) ) {
+    if ( !drawTransportLine ) {
+        // Only copy the icon, it gets modified below
         vehiclePixmap = QPixmap( int(rect.width()), int(rect.height()) );
         vehiclePixmap.fill( Qt::transparent );
         QPainter p( &vehiclePixmap );
-        p.setRenderHint( QPainter::Antialiasing );
-
-        // Resize vehicle type icon SVG and draw it
-        m_svg->resize( rect.width() - shadowWidth, rect.height() - shadowWidth );
-        m_svg->paint( &p, shadowWidth / 2, shadowWidth / 2, vehicleKey );
-
-        // Draw transport line string (only for local public transport)
-        if ( drawTransportLine ) {
+        p.drawPixmap( shadowWidth / 2, shadowWidth / 2, icon );
+    } else {
+        const QString vehicleCacheKey = iconKey( vehicle, iconFlags ) + QString("%1%2%3%4")
+                .arg( static_cast<int>(iconDrawFlags) ).arg( transportLine )
+                .arg( int(rect.width()) ).arg( int(rect.height()) );
+        if ( !m_pixmapCache->find(vehicleCacheKey, vehiclePixmap) ) {
+            vehiclePixmap = QPixmap( int(rect.width()), int(rect.height()) );
+            vehiclePixmap.fill( Qt::transparent );
+            QPainter p( &vehiclePixmap );
+            p.setRenderHint( QPainter::Antialiasing );
+            p.drawPixmap( shadowWidth / 2, shadowWidth / 2, icon );
+
+            // Draw transport line string (only for local public transport)
             QString text;
             if ( transportLine.length() > 8 ) {
                 // The transport line string is too long to be drawn inside a vehicle icon
@@ -179,11 +171,11 @@ void DeparturePainter::paintVehicle( QPainter* painter, VehicleType vehicle,
                 p.setPen( Qt::white );
                 p.drawText( rect, text, QTextOption(Qt::AlignCenter) );
             }
-        }
-        p.end();
+            p.end();
 
-        // Insert rendered vehicle icon into the pixmap cache
-        m_pixmapCache->insert( vehicleCacheKey, vehiclePixmap );
+            // Insert rendered vehicle icon into the pixmap cache
+            m_pixmapCache->insert( vehicleCacheKey, vehiclePixmap );
+        }
     }
 
     // Make a part 70% transparent, dependent on minsToDeparture
@@ -87,7 +87,8 @@ public:
      **/
     static const int MAX_MINUTES_UNTIL_DEPARTURE = 60;
 
-    void setSvg( Plasma::Svg *svg ) { m_svg = svg; };
+    /** @brief Sets the SVG containing vehicle type elements, registered in VehicleIconAtlas. */
+    void setSvg( Plasma::Svg *svg );
     Plasma::Svg *svg() const { return m_svg; };
 
     static QString iconKey( VehicleType vehicle, VehicleIconFlags flags = ColoredIcon );
@@ -126,8 +127,9 @@ public:
     QPixmap createPopupIcon( PopupIcon *popupIcon, DepartureModel *model, const QSize &size );
 
 private:
-    KPixmapCache *m_pixmapCache;
+    KPixmapCache *m_pixmapCache; // Caches icons with transport lines and time graphics
     Plasma::Svg *m_svg;
+    int m_vehicleIconSvgId; // The ID of m_svg in VehicleIconAtlas
 };
 Q_DECLARE_OPERATORS_FOR_FLAGS( DeparturePainter::VehicleIconFlags )
 Q_DECLARE_OPERATORS_FOR_FLAGS( DeparturePainter::VehicleIconDrawFlags )
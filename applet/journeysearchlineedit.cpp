@@ -27,6 +27,8 @@
 #include <QAbstractTextDocumentLayout>
 #include <QPainter>
 #include <KDebug>
+#include <KGlobal>
+#include <KLocale>
 
 JourneySearchHighlighter::JourneySearchHighlighter( QTextDocument* parent )
         : QSyntaxHighlighter( parent )
@@ -38,14 +40,65 @@ JourneySearchHighlighter::JourneySearchHighlighter( QTextDocument* parent )
     m_formatValue.setForeground( Qt::blue );
     m_formatError.setFontItalic( true );
     m_formatError.setForeground( Qt::red );
+
+    updateExpressions();
+}
+
+void JourneySearchHighlighter::updateExpressions()
+{
+    // Build the expressions only once for each language, not for each highlighted text
+    const QString language = KGlobal::locale()->language();
+    if ( language == m_language ) {
+        return;
+    }
+    m_language = language;
+
+    m_expressionToFrom = keywordExpression( QStringList() << JourneySearchParser::toKeywords()
+                                            << JourneySearchParser::fromKeywords() );
+    m_expressionArrivalDeparture = keywordExpression( QStringList()
+            << JourneySearchParser::arrivalKeywords()
+            << JourneySearchParser::departureKeywords() );
+    m_expressionTomorrow = keywordExpression( JourneySearchParser::timeKeywordsTomorrow() );
+
+    // Date/time keys and values
+    // ("[time]" or "[date]" or "[time], [date]" or "[date], [time]")
+    m_expressionsDateTime = combinationExpressions( JourneySearchParser::timeKeywordsAt(),
+            QStringList() << "\\d{2}:\\d{2}(, \\d{2}\\.\\d{2}\\.(\\d{2,4})?)?"
+                << "\\d{2}:\\d{2}(, \\d{2}-\\d{2}(-\\d{2,4})?)?"
+                << "\\d{2}:\\d{2}(, (\\d{2,4}-)?\\d{2}-\\d{2})?"
+                << "\\d{2}\\.\\d{2}\\.(\\d{2,4})?(, \\d{2}:\\d{2})?"
+                << "\\d{2}-\\d{2}(-\\d{2,4})?(, \\d{2}:\\d{2})?"
+                << "(\\d{2,4}-)?\\d{2}-\\d{2}(, \\d{2}:\\d{2})?" );
+
+    // Relative time keys and values
+    m_expressionsRelativeTime = combinationExpressions( JourneySearchParser::timeKeywordsIn(),
+            QStringList() << JourneySearchParser::relativeTimeString("\\d{1,}") );
+}
+
+QRegExp JourneySearchHighlighter::keywordExpression( const QStringList &keywords )
+{
+    return QRegExp( QString("\\b(%1)\\b").arg(keywords.join("|")), Qt::CaseInsensitive );
+}
+
+QList< QRegExp > JourneySearchHighlighter::combinationExpressions(
+        const QStringList &keywords, const QStringList &keywordValues )
+{
+    QList< QRegExp > expressions;
+    foreach( const QString &keyword, keywords ) {
+        foreach( const QString &value, keywordValues ) {
+            QString str = QString( "(%1) (%2)" ).arg( keyword ).arg( value );
+            expressions << keywordExpression( QStringList() << str );
+        }
+    }
+    return expressions;
 }
 
 int JourneySearchHighlighter::highlightKeywords( const QString& text,
-        const QStringList& keywords, const QTextCharFormat& format,
+        const QRegExp& matchExpression, const QTextCharFormat& format,
         int maxAllowedOccurances, int needsToStartAt )
 {
     QTextCharFormat curFormat = format, curKeywordFormat = m_formatKeyword;
-    QRegExp expression( QString( "\\b(%1)\\b" ).arg( keywords.join( "|" ) ), Qt::CaseInsensitive );
+    QRegExp expression = matchExpression;
     int index = text.indexOf( expression );
     int count = 0;
     while ( index >= 0 ) {
@@ -73,44 +126,32 @@ int JourneySearchHighlighter::highlightKeywords( const QString& text,
 }
 
 int JourneySearchHighlighter::highlightCombinations( const QString& text,
-        const QStringList& keywords, const QStringList& keywordValues,
+        const QList<QRegExp>& expressions,
         const QTextCharFormat& format, int maxAllowedOccurances, int needsToStartAt )
 {
     int count = 0;
-    foreach( const QString &keyword, keywords ) {
-        foreach( const QString &value, keywordValues ) {
-            QString str = QString( "(%1) (%2)" ).arg( keyword ).arg( value );
-            count += highlightKeywords( text, QStringList() << str, format,
-                                        maxAllowedOccurances, needsToStartAt );
-        }
+    foreach( const QRegExp &expression, expressions ) {
+        count += highlightKeywords( text, expression, format,
+                                    maxAllowedOccurances, needsToStartAt );
     }
     return count;
 }
 
 void JourneySearchHighlighter::highlightBlock( const QString& text )
 {
+    // Keywords are localized, update the expressions if the language has changed
+    updateExpressions();
+
     // Highlight keywords
-    highlightKeywords( text, QStringList() << JourneySearchParser::toKeywords()
-                    << JourneySearchParser::fromKeywords(), m_formatKeyword, 1, 0 );
-    highlightKeywords( text, QStringList() << JourneySearchParser::arrivalKeywords()
-                    << JourneySearchParser::departureKeywords(), m_formatKeyword, 1 );
-    highlightKeywords( text, JourneySearchParser::timeKeywordsTomorrow(), m_formatKeyword, 1 );
+    highlightKeywords( text, m_expressionToFrom, m_formatKeyword, 1, 0 );
+    highlightKeywords( text, m_expressionArrivalDeparture, m_formatKeyword, 1 );
+    highlightKeywords( text, m_expressionTomorrow, m_formatKeyword, 1 );
 
     // Highlight date/time keys and values
-    // ("[time]" or "[date]" or "[time], [date]" or "[date], [time]")
-    int matched = highlightCombinations( text, JourneySearchParser::timeKeywordsAt(),
-            QStringList() << "\\d{2}:\\d{2}(, \\d{2}\\.\\d{2}\\.(\\d{2,4})?)?"
-                << "\\d{2}:\\d{2}(, \\d{2}-\\d{2}(-\\d{2,4})?)?"
-                << "\\d{2}:\\d{2}(, (\\d{2,4}-)?\\d{2}-\\d{2})?"
-                << "\\d{2}\\.\\d{2}\\.(\\d{2,4})?(, \\d{2}:\\d{2})?"
-                << "\\d{2}-\\d{2}(-\\d{2,4})?(, \\d{2}:\\d{2})?"
-                << "(\\d{2,4}-)?\\d{2}-\\d{2}(, \\d{2}:\\d{2})?",
-            m_formatValue, 1 );
+    int matched = highlightCombinations( text, m_expressionsDateTime, m_formatValue, 1 );
 
     // Highlight relative time keys and values
-    highlightCombinations( text, JourneySearchParser::timeKeywordsIn(),
-                        QStringList() << JourneySearchParser::relativeTimeString( "\\d{1,}" ),
-                        m_formatValue, matched == 0 ? 1 : 0 );
+    highlightCombinations( text, m_expressionsRelativeTime, m_formatValue, matched == 0 ? 1 : 0 );
 
     // Highlight stop name if it is inside double quotes
     QRegExp expression = QRegExp( "\\s?\"[^\"]*\"\\s?" );
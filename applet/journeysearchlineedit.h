@@ -25,6 +25,7 @@
 
 // Qt includes
 #include <QSyntaxHighlighter> // Base class
+#include <QRegExp>
 
 class QTextDocument;
 
@@ -51,19 +52,41 @@ public:
     QTextCharFormat &formatError() { return m_formatError; };
 
 protected:
-    /** @return The number of matched keywords. */
-    int highlightKeywords( const QString &text, const QStringList &keywords,
+    /**
+     * @brief Highlight matches of @p matchExpression, see keywordExpression().
+     *
+     * @return The number of matched keywords.
+     **/
+    int highlightKeywords( const QString &text, const QRegExp &matchExpression,
             const QTextCharFormat &format, int maxAllowedOccurances = -1, int needsToStartAt = -1 );
 
-    /** @return The number of matched keyword value combinations. */
-    int highlightCombinations( const QString &text, const QStringList &keywords,
-            const QStringList &keywordValues, const QTextCharFormat &format,
-            int maxAllowedOccurances = -1, int needsToStartAt = -1 );
+    /**
+     * @brief Highlight matches of each of @p expressions, see combinationExpressions().
+     *
+     * @return The number of matched keyword value combinations.
+     **/
+    int highlightCombinations( const QString &text, const QList<QRegExp> &expressions,
+            const QTextCharFormat &format, int maxAllowedOccurances = -1, int needsToStartAt = -1 );
 
     virtual void highlightBlock( const QString& text );
 
+    /** @brief Get an expression matching any of @p keywords as whole word. */
+    static QRegExp keywordExpression( const QStringList &keywords );
+
+    /** @brief Get expressions matching each of @p keywords followed by a value. */
+    static QList<QRegExp> combinationExpressions( const QStringList &keywords,
+                                                  const QStringList &keywordValues );
+
+    /** @brief Build the expressions for the localized keywords, if the language has changed. */
+    void updateExpressions();
+
 private:
     QTextCharFormat m_formatStopName, m_formatKeyword, m_formatValue, m_formatError;
+
+    // Expressions for keywords and keyword value combinations, see updateExpressions()
+    QRegExp m_expressionToFrom, m_expressionArrivalDeparture, m_expressionTomorrow;
+    QList<QRegExp> m_expressionsDateTime, m_expressionsRelativeTime;
+    QString m_language; // The language for which the expressions were built
 };
 
 /**
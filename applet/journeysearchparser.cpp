@@ -20,6 +20,7 @@
 #include "journeysearchparser.h"
 
 #include <QStringList>
+#include <QHash>
 #include <QTime>
 
 #include <KGlobal>
@@ -28,57 +29,200 @@
 #include <KLineEdit>
 #include <KDebug>
 
-const QStringList JourneySearchParser::arrivalKeywords()
-{
-    return i18nc( "@info/plain A comma separated list of keywords for the journey search to "
-                "indicate that given times are meant as arrivals. The order is used for "
+/**
+ * @brief Localized journey search keywords.
+ *
+ * The keyword lists are read from the translations only once and again when the language
+ * changes. All keywords are also stored in one hash from the lower case keyword to the matching
+ * keywords, to find the keywords of a word with a single lookup.
+ **/
+class JourneySearchKeywords {
+public:
+    /** @brief Read the keywords from the translations, if not already done for the language. */
+    void update()
+    {
+        const QString language = KGlobal::locale()->language();
+        if ( language == m_language ) {
+            return;
+        }
+        m_language = language;
+
+        arrival = i18nc( "@info/plain A comma separated list of keywords for the journey "
+                "search to indicate that given times are meant as arrivals. The order is used for "
                 "autocompletion.\nNote: Keywords should be unique for each meaning.",
                 "arriving,arrive,arrival,arr" ).split( ',', QString::SkipEmptyParts );
+        departure = i18nc( "@info/plain A comma separated list of keywords for the journey "
+                "search to indicate that given times are meant as departures (default). The order "
+                "is used for autocompletion.\nNote: Keywords should be unique for each meaning.",
+                "departing,depart,departure,dep" ).split( ',', QString::SkipEmptyParts );
+        from = i18nc( "@info/plain A comma separated list of keywords for the journey search, "
+                "indicating that a journey FROM the given stop should be searched. This keyword "
+                "needs to be placed at the beginning of the field.", "from" )
+                .split( ',', QString::SkipEmptyParts );
+        to = i18nc( "@info/plain A comma separated list of keywords for the journey search, "
+                "indicating that a journey TO the given stop should be searched. This keyword "
+                "needs to be placed at the beginning of the field.", "to" )
+                .split( ',', QString::SkipEmptyParts );
+        timeAt = i18nc( "@info/plain A comma separated list of keywords for the journey search "
+                "field, indicating that a date/time string follows.\nNote: Keywords should be "
+                "unique for each meaning.", "at" ).split( ',', QString::SkipEmptyParts );
+        timeIn = i18nc( "@info/plain A comma separated list of keywords for the journey search "
+                "field, indicating that a relative time string follows.\nNote: Keywords should "
+                "be unique for each meaning.", "in" ).split( ',', QString::SkipEmptyParts );
+        tomorrow = i18nc( "@info/plain A comma separated list of keywords for the journey search "
+                "field, as replacement for tomorrows date.\nNote: Keywords should be unique for "
+                "each meaning.", "tomorrow" ).split( ',', QString::SkipEmptyParts );
+
+        keywords.clear();
+        insertKeywords( to, JourneySearchParser::KeywordTo );
+        insertKeywords( from, JourneySearchParser::KeywordFrom );
+        insertKeywords( timeAt, JourneySearchParser::KeywordTimeAt );
+        insertKeywords( timeIn, JourneySearchParser::KeywordTimeIn );
+        insertKeywords( tomorrow, JourneySearchParser::KeywordTomorrow );
+        insertKeywords( departure, JourneySearchParser::KeywordDeparture );
+        insertKeywords( arrival, JourneySearchParser::KeywordArrival );
+    };
+
+    QStringList arrival, departure, from, to, timeAt, timeIn, tomorrow;
+    QHash< QString, JourneySearchParser::Keywords > keywords; // Lower case keyword -> keywords
+
+private:
+    void insertKeywords( const QStringList &words, JourneySearchParser::Keyword keyword )
+    {
+        foreach ( const QString &word, words ) {
+            keywords[ word.toLower() ] |= keyword;
+        }
+    };
+
+    QString m_language; // The language for which the keywords were read
+};
+K_GLOBAL_STATIC( JourneySearchKeywords, globalJourneySearchKeywords )
+
+/** @brief The last tokenized search line with it's tokens, see JourneySearchParser::tokens(). */
+struct JourneySearchTokenCache {
+    QString searchLine;
+    QList< JourneySearchParser::Token > tokens;
+    QString language; // The language of the keywords of the tokens
+};
+K_GLOBAL_STATIC( JourneySearchTokenCache, globalJourneySearchTokenCache )
+
+/** @brief Get the localized keywords, read them from the translations if needed. */
+static const JourneySearchKeywords *journeySearchKeywords()
+{
+    globalJourneySearchKeywords->update();
+    return globalJourneySearchKeywords;
+}
+
+const QStringList JourneySearchParser::arrivalKeywords()
+{
+    return journeySearchKeywords()->arrival;
 }
 
 const QStringList JourneySearchParser::departureKeywords()
 {
-    return i18nc( "@info/plain A comma separated list of keywords for the journey search to "
-                "indicate that given times are meant as departures (default). The order is used "
-                "for autocompletion.\nNote: Keywords should be unique for each meaning.",
-                "departing,depart,departure,dep" ).split( ',', QString::SkipEmptyParts );
+    return journeySearchKeywords()->departure;
 }
 
 const QStringList JourneySearchParser::fromKeywords()
 {
-    return i18nc( "@info/plain A comma separated list of keywords for the journey search, "
-                "indicating that a journey FROM the given stop should be searched. This keyword "
-                "needs to be placed at the beginning of the field.", "from" )
-            .split( ',', QString::SkipEmptyParts );
+    return journeySearchKeywords()->from;
 }
 
 const QStringList JourneySearchParser::toKeywords()
 {
-    return i18nc( "@info/plain A comma separated list of keywords for the journey search, "
-                "indicating that a journey TO the given stop should be searched. This keyword needs "
-                "to be placed at the beginning of the field.", "to" )
-            .split( ',', QString::SkipEmptyParts );
+    return journeySearchKeywords()->to;
 }
 
 const QStringList JourneySearchParser::timeKeywordsAt()
 {
-    return i18nc( "@info/plain A comma separated list of keywords for the journey search field, "
-                "indicating that a date/time string follows.\nNote: Keywords should be "
-                "unique for each meaning.", "at" ).split( ',', QString::SkipEmptyParts );
+    return journeySearchKeywords()->timeAt;
 }
 
 const QStringList JourneySearchParser::timeKeywordsIn()
 {
-    return i18nc( "@info/plain A comma separated list of keywords for the journey search field, "
-                "indicating that a relative time string follows.\nNote: Keywords should "
-                "be unique for each meaning.", "in" ).split( ',', QString::SkipEmptyParts );
+    return journeySearchKeywords()->timeIn;
 }
 
 const QStringList JourneySearchParser::timeKeywordsTomorrow()
 {
-    return i18nc( "@info/plain A comma separated list of keywords for the journey search field, as "
-                "replacement for tomorrows date.\nNote: Keywords should be unique for "
-                "each meaning.", "tomorrow" ).split( ',', QString::SkipEmptyParts );
+    return journeySearchKeywords()->tomorrow;
+}
+
+JourneySearchParser::Keywords JourneySearchParser::keywordsForWord( const QString &word )
+{
+    return journeySearchKeywords()->keywords.value( word.toLower(), NoKeyword );
+}
+
+QList< JourneySearchParser::Token > JourneySearchParser::tokens( const QString &searchLine )
+{
+    JourneySearchTokenCache *cache = globalJourneySearchTokenCache;
+    const QString language = KGlobal::locale()->language();
+    if ( language != cache->language ) {
+        // The keywords of the cached tokens are for another language, tokenize everything again
+        cache->searchLine.clear();
+        cache->tokens.clear();
+        cache->language = language;
+    }
+
+    const QString &oldSearchLine = cache->searchLine;
+    if ( searchLine == oldSearchLine ) {
+        return cache->tokens;
+    }
+
+    // Find the edited span, ie. the length of the unchanged prefix and suffix
+    const int minLength = qMin( searchLine.length(), oldSearchLine.length() );
+    int prefixLength = 0;
+    while ( prefixLength < minLength &&
+            searchLine[prefixLength] == oldSearchLine[prefixLength] )
+    {
+        ++prefixLength;
+    }
+    int suffixLength = 0;
+    while ( suffixLength < minLength - prefixLength &&
+            searchLine[searchLine.length() - 1 - suffixLength] ==
+            oldSearchLine[oldSearchLine.length() - 1 - suffixLength] )
+    {
+        ++suffixLength;
+    }
+
+    // Reuse tokens that are followed by a space inside the unchanged prefix
+    // and tokens that are preceded by a space inside the unchanged suffix
+    const int lengthDifference = searchLine.length() - oldSearchLine.length();
+    const int oldSuffixStart = oldSearchLine.length() - suffixLength;
+    QList< Token > newTokens, suffixTokens;
+    foreach ( const Token &token, cache->tokens ) {
+        if ( token.position + token.text.length() < prefixLength ) {
+            newTokens << token;
+        } else if ( token.position > oldSuffixStart ) {
+            suffixTokens << Token( token.text, token.position + lengthDifference,
+                                   token.keywords );
+        }
+    }
+
+    // Tokenize the edited span
+    int position = newTokens.isEmpty() ? 0
+            : newTokens.last().position + newTokens.last().text.length();
+    const int end = suffixTokens.isEmpty() ? searchLine.length()
+            : suffixTokens.first().position;
+    while ( position < end ) {
+        if ( searchLine[position] == ' ' ) {
+            ++position;
+            continue;
+        }
+
+        int wordEnd = searchLine.indexOf( ' ', position );
+        if ( wordEnd == -1 || wordEnd > end ) {
+            wordEnd = end;
+        }
+        const QString word = searchLine.mid( position, wordEnd - position );
+        newTokens << Token( word, position, keywordsForWord(word) );
+        position = wordEnd;
+    }
+
+    newTokens << suffixTokens;
+    cache->searchLine = searchLine;
+    cache->tokens = newTokens;
+    return newTokens;
 }
 
 const QString JourneySearchParser::relativeTimeString( const QVariant &value )
@@ -118,13 +262,14 @@ void JourneySearchParser::doCorrections( KLineEdit *lineEdit, QString *searchLin
     QString lastWordBeforeCursor;
     if ( posEnd == cursorPos && pos != -1 && !( lastWordBeforeCursor = searchLine->mid(
                     pos, posEnd - pos ).trimmed() ).isEmpty() ) {
-        if ( timeKeywordsAt().contains( lastWordBeforeCursor, Qt::CaseInsensitive ) ) {
+        const Keywords keywords = keywordsForWord( lastWordBeforeCursor );
+        if ( keywords.testFlag(KeywordTimeAt) ) {
             // Automatically add the current time after 'at'
             QString formattedTime = KGlobal::locale()->formatTime( QTime::currentTime() );
             searchLine->insert( posEnd, ' ' + formattedTime );
             selStart = posEnd + 1; // +1 for the added space
             selLength = formattedTime.length();
-        } else if ( timeKeywordsIn().contains( lastWordBeforeCursor, Qt::CaseInsensitive ) ) {
+        } else if ( keywords.testFlag(KeywordTimeIn) ) {
             // Automatically add '5 minutes' after 'in'
             searchLine->insert( posEnd, ' ' + relativeTimeString(5) );
             selStart = posEnd + 1; // +1 for the added space
@@ -208,22 +353,23 @@ bool JourneySearchParser::parseJourneySearch( KLineEdit* lineEdit,
     }
 
     // Get word list
-    QStringList words = searchLine.split( ' ', QString::SkipEmptyParts );
-    if ( words.isEmpty() ) {
+    QList< Token > wordTokens = tokens( searchLine );
+    if ( wordTokens.isEmpty() ) {
         return false;
     }
 
     // Combine words between double quotes to one word
     // to allow stop names containing keywords.
-    JourneySearchParser::combineDoubleQuotedWords( &words );
+    JourneySearchParser::combineDoubleQuotedTokens( &wordTokens );
+    const QStringList words = tokenTexts( wordTokens );
 
     // First search for keywords at the beginning of the string ('to' or 'from')
-    QString firstWord = words.first();
-    if ( toKeywords().contains( firstWord, Qt::CaseInsensitive ) ) {
+    const QString firstWord = words.first();
+    if ( wordTokens.first().keywords.testFlag(KeywordTo) ) {
         searchLine = searchLine.mid( firstWord.length() + 1 );
         cursorPos -= firstWord.length() + 1;
         ++removedWordsFromLeft;
-    } else if ( fromKeywords().contains( firstWord, Qt::CaseInsensitive ) ) {
+    } else if ( wordTokens.first().keywords.testFlag(KeywordFrom) ) {
         searchLine = searchLine.mid( firstWord.length() + 1 );
         *stopIsTarget = false; // the given stop is the origin
         cursorPos -= firstWord.length() + 1;
@@ -243,8 +389,8 @@ bool JourneySearchParser::parseJourneySearch( KLineEdit* lineEdit,
 
     // Now search for keywords inside the string from back
     for ( int i = words.count() - 1; i >= removedWordsFromLeft; --i ) {
-        QString word = words[ i ];
-        if ( timeKeywordsAt().contains( word, Qt::CaseInsensitive ) ) {
+        const Keywords keywords = wordTokens[ i ].keywords;
+        if ( keywords.testFlag(KeywordTimeAt) ) {
             // An 'at' keyword was found at position i
             QString sDeparture;
             JourneySearchParser::splitWordList( words, i, stop, &sDeparture, removedWordsFromLeft );
@@ -252,13 +398,12 @@ bool JourneySearchParser::parseJourneySearch( KLineEdit* lineEdit,
             // Search for keywords before 'at'
             QDate date;
             JourneySearchParser::searchForJourneySearchKeywords( *stop,
-                    timeKeywordsTomorrow(), departureKeywords(), arrivalKeywords(),
                     &date, stop, timeIsDeparture, len );
 
             // Parse date and/or time from the string after 'at'
             JourneySearchParser::parseDateAndTime( sDeparture, departure, &date );
             return true;
-        } else if ( timeKeywordsIn().contains( word, Qt::CaseInsensitive ) ) {
+        } else if ( keywords.testFlag(KeywordTimeIn) ) {
             // An 'in' keyword was found at position i
             QString sDeparture;
             JourneySearchParser::splitWordList( words, i, stop, &sDeparture, removedWordsFromLeft );
@@ -272,7 +417,6 @@ bool JourneySearchParser::parseJourneySearch( KLineEdit* lineEdit,
                 // Search for keywords before 'in'
                 QDate date = QDate::currentDate();
                 JourneySearchParser::searchForJourneySearchKeywords( *stop,
-                        timeKeywordsTomorrow(), departureKeywords(), arrivalKeywords(),
                         &date, stop, timeIsDeparture, len );
                 *departure = QDateTime( date, QTime::currentTime().addSecs( minutes * 60 ) );
                 return true;
@@ -284,8 +428,7 @@ bool JourneySearchParser::parseJourneySearch( KLineEdit* lineEdit,
 
     // Search for keywords at the end of the string
     QDate date = QDate::currentDate();
-    JourneySearchParser::searchForJourneySearchKeywords( *stop, timeKeywordsTomorrow(),
-            departureKeywords(), arrivalKeywords(),
+    JourneySearchParser::searchForJourneySearchKeywords( *stop,
             &date, stop, timeIsDeparture, len );
     *departure = QDateTime( date, QTime::currentTime() );
     return false;
@@ -297,29 +440,29 @@ QHash< JourneySearchParser::Keyword, QVariant > JourneySearchParser::keywordValu
     QHash< Keyword, QVariant > ret;
 
     // Get word list
-    QStringList words = searchLine.split( ' ', QString::SkipEmptyParts );
-    if ( words.isEmpty() ) {
+    QList< Token > wordTokens = tokens( searchLine );
+    if ( wordTokens.isEmpty() ) {
         return ret;
     }
 
     // Combine words between double quotes to one word
     // to allow stop names containing keywords.
-    JourneySearchParser::combineDoubleQuotedWords( &words );
+    JourneySearchParser::combineDoubleQuotedTokens( &wordTokens );
+    const QStringList words = tokenTexts( wordTokens );
 
     // First search for keywords at the beginning of the string ('to' or 'from')
     int removedWordsFromLeft = 0;
-    QString firstWord = words.first();
-    if ( toKeywords().contains( firstWord, Qt::CaseInsensitive ) ) {
+    if ( wordTokens.first().keywords.testFlag(KeywordTo) ) {
         ret.insert( KeywordTo, true );
         ++removedWordsFromLeft;
-    } else if ( fromKeywords().contains( firstWord, Qt::CaseInsensitive ) ) {
+    } else if ( wordTokens.first().keywords.testFlag(KeywordFrom) ) {
         ret.insert( KeywordFrom, true );
         ++removedWordsFromLeft;
     }
 
     for ( int i = words.count() - 1; i >= removedWordsFromLeft; --i ) {
-        QString word = words[ i ];
-        if ( timeKeywordsAt().contains( word, Qt::CaseInsensitive ) ) {
+        const Keywords keywords = wordTokens[ i ].keywords;
+        if ( keywords.testFlag(KeywordTimeAt) ) {
             // An 'at' keyword was found at position i
             QString sDeparture, stop;
             QDate date;
@@ -330,7 +473,7 @@ QHash< JourneySearchParser::Keyword, QVariant > JourneySearchParser::keywordValu
             JourneySearchParser::parseDateAndTime( sDeparture, &departure, &date );
             ret.insert( KeywordTimeAt, departure );
             break;
-        } else if ( timeKeywordsIn().contains( word, Qt::CaseInsensitive ) ) {
+        } else if ( keywords.testFlag(KeywordTimeIn) ) {
             // An 'in' keyword was found at position i
             QString sDeparture, stop;
             JourneySearchParser::splitWordList( words, i, &stop, &sDeparture, removedWordsFromLeft );
@@ -422,9 +565,7 @@ void JourneySearchParser::setJourneySearchWordCompletion( KLineEdit* lineEdit,
 }
 
 bool JourneySearchParser::searchForJourneySearchKeywords( const QString& journeySearch,
-        const QStringList& timeKeywordsTomorrow, const QStringList& departureKeywords,
-        const QStringList& arrivalKeywords, QDate* date, QString* stop,
-        bool* timeIsDeparture, int* len )
+        QDate* date, QString* stop, bool* timeIsDeparture, int* len )
 {
     if ( stop->startsWith( '\"' ) && stop->endsWith( '\"' ) ) {
         if ( len ) {
@@ -450,8 +591,8 @@ bool JourneySearchParser::searchForJourneySearchKeywords( const QString& journey
             continue;
         }
         QString lastWordInStop = wordsStop.last();
-        if ( !lastWordInStop.isEmpty() && timeKeywordsTomorrow.contains(
-                    lastWordInStop, Qt::CaseInsensitive ) ) {
+        if ( !lastWordInStop.isEmpty() &&
+             keywordsForWord(lastWordInStop).testFlag(KeywordTomorrow) ) {
             *stop = stop->left( stop->length() - lastWordInStop.length() ).trimmed();
             *date = QDate::currentDate().addDays( 1 );
 
@@ -461,12 +602,13 @@ bool JourneySearchParser::searchForJourneySearchKeywords( const QString& journey
 
         // Search for departure / arrival keywords
         if ( !lastWordInStop.isEmpty() ) {
-            if ( departureKeywords.contains( lastWordInStop, Qt::CaseInsensitive ) ) {
+            const Keywords keywords = keywordsForWord( lastWordInStop );
+            if ( keywords.testFlag(KeywordDeparture) ) {
                 // If a departure keyword is found, use given time as departure time
                 *stop = stop->left( stop->length() - lastWordInStop.length() ).trimmed();
                 *timeIsDeparture = true;
                 found = continueSearch = true;
-            } else if ( arrivalKeywords.contains( lastWordInStop, Qt::CaseInsensitive ) ) {
+            } else if ( keywords.testFlag(KeywordArrival) ) {
                 // If an arrival keyword is found, use given time as arrival time
                 *stop = stop->left( stop->length() - lastWordInStop.length() ).trimmed();
                 *timeIsDeparture = false;
@@ -486,11 +628,47 @@ bool JourneySearchParser::searchForJourneySearchKeywords( const QString& journey
 
 QStringList JourneySearchParser::notDoubleQuotedWords( const QString& searchLine )
 {
-    QStringList words = searchLine.split( ' ', QString::SkipEmptyParts );
+    QStringList words = tokenTexts( tokens(searchLine) );
     combineDoubleQuotedWords( &words, false );
     return words;
 }
 
+QStringList JourneySearchParser::tokenTexts( const QList<Token> &tokens )
+{
+    QStringList texts;
+    foreach ( const Token &token, tokens ) {
+        texts << token.text;
+    }
+    return texts;
+}
+
+void JourneySearchParser::combineDoubleQuotedTokens( QList<Token> *tokens )
+{
+    int quotedStart = -1, quotedEnd = -1;
+    for ( int i = 0; i < tokens->count(); ++i ) {
+        if ( tokens->at(i).text.startsWith('\"') ) {
+            quotedStart = i;
+        }
+        if ( tokens->at(i).text.endsWith('\"') ) {
+            quotedEnd = i;
+            break;
+        }
+    }
+    if ( quotedStart != -1 ) {
+        if ( quotedEnd == -1 ) {
+            quotedEnd = tokens->count() - 1;
+        }
+
+        // Combine tokens, the combined token is no keyword
+        const int position = tokens->at( quotedStart ).position;
+        QString combinedWord;
+        for ( int i = quotedEnd; i >= quotedStart; --i ) {
+            combinedWord = tokens->takeAt( i ).text + ' ' + combinedWord;
+        }
+        tokens->insert( quotedStart, Token(combinedWord.trimmed(), position) );
+    }
+}
+
 void JourneySearchParser::combineDoubleQuotedWords( QStringList* words, bool reinsertQuotedWords )
 {
     int quotedStart = -1, quotedEnd = -1;
@@ -20,10 +20,12 @@
 #ifndef JOURNEYSEARCHPARSER_HEADER
 #define JOURNEYSEARCHPARSER_HEADER
 
+#include <QString>
+#include <QList>
+
 template<class Key, class T >
 class QHash;
 class QVariant;
-class QString;
 class QStringList;
 class QDate;
 class QTime;
@@ -41,18 +43,42 @@ public:
     /**
      * @brief Keywords to be used in a journey search line.
      *
-     * @todo Add all keywords.
+     * The same word can be used for multiple keywords in a translation, therefore these
+     * values can be combined to Keywords flags, see Token.
      **/
     enum Keyword {
-        KeywordTo, /**< The "to" keyword indicates that journey to the given
+        NoKeyword       = 0x00, /**< The word is no keyword. */
+        KeywordTo       = 0x01, /**< The "to" keyword indicates that journey to the given
                 * stop should be searched. */
-        KeywordFrom, /**< The "from" keyword indicates that journey from the
+        KeywordFrom     = 0x02, /**< The "from" keyword indicates that journey from the
                 * given stop should be searched. */
-        KeywordTimeAt, /**< The "at" keyword is followed by a time and or date
+        KeywordTimeAt   = 0x04, /**< The "at" keyword is followed by a time and or date
                 * string, indicating when the journeys should depart/arrive. */
-        KeywordTimeIn /**< The "in" keyword is followed by a relative time
+        KeywordTimeIn   = 0x08, /**< The "in" keyword is followed by a relative time
                 * string (ie. "in 5 minutes"), indicating when the journeys
                 * should depart/arrive relative to the current time. */
+        KeywordTomorrow = 0x10, /**< The "tomorrow" keyword can be used instead of
+                * the date of tomorrow. */
+        KeywordDeparture = 0x20, /**< The "departure" keyword indicates that the given
+                * time is the departure time (default). */
+        KeywordArrival  = 0x40 /**< The "arrival" keyword indicates that the given
+                * time is the arrival time. */
+    };
+    Q_DECLARE_FLAGS( Keywords, Keyword )
+
+    /**
+     * @brief A word of a journey search line, words are separated by spaces.
+     *
+     * Double quoted words are not combined here, see notDoubleQuotedWords().
+     **/
+    struct Token {
+        Token( const QString &text = QString(), int position = -1,
+               Keywords keywords = NoKeyword )
+                : text(text), position(position), keywords(keywords) {};
+
+        QString text; /**< The text of the word. */
+        int position; /**< The position of the word in the search line. */
+        Keywords keywords; /**< The keywords matching the word, if any. */
     };
 
     static bool parseJourneySearch( KLineEdit *lineEdit, const QString &search,
@@ -61,6 +87,24 @@ public:
             bool correctString = true );
     static QHash<Keyword, QVariant> keywordValues( const QString &searchLine );
 
+    /**
+     * @brief Get the words in @p searchLine with the keywords they match.
+     *
+     * The tokens of the last tokenized search line get cached. If @p searchLine is an edited
+     * version of it, only the edited span gets tokenized again, tokens before and after
+     * it get reused. This makes it cheap to call this for each keystroke and multiple times
+     * for the same search line.
+     **/
+    static QList<Token> tokens( const QString &searchLine );
+
+    /**
+     * @brief Get the keywords matching @p word.
+     *
+     * All localized keywords get stored in one hash from the lower case keyword to the
+     * matching Keywords, it is built on first use.
+     **/
+    static Keywords keywordsForWord( const QString &word );
+
     /**
      * @brief Searches for the stop name in the given @p lineEdit.
      *
@@ -117,12 +161,20 @@ private:
                             const QString &match );
 
     static bool searchForJourneySearchKeywords( const QString &journeySearch,
-            const QStringList &timeKeywordsTomorrow, const QStringList &departureKeywords,
-            const QStringList &arrivalKeywords, QDate *date, QString *stop,
-            bool *timeIsDeparture, int *len );
+            QDate *date, QString *stop, bool *timeIsDeparture, int *len );
 
     static void combineDoubleQuotedWords( QStringList *words, bool reinsertQuotedWords = true );
 
+    /**
+     * @brief Combine tokens between double quotes to one token without keywords.
+     *
+     * Like combineDoubleQuotedWords() but for tokens, see tokens().
+     **/
+    static void combineDoubleQuotedTokens( QList<Token> *tokens );
+
+    /** @brief Get the texts of @p tokens. */
+    static QStringList tokenTexts( const QList<Token> &tokens );
+
     /**
      * @brief Get the strings on the left and right of the word at @p splitWordPos in @p wordList.
      *
@@ -136,5 +188,6 @@ private:
     static bool parseTime( const QString &sTime, QTime *time );
     static bool parseDate( const QString &sDate, QDate *date );
 };
+Q_DECLARE_OPERATORS_FOR_FLAGS( JourneySearchParser::Keywords )
 
 #endif // Multiple inclusion guard
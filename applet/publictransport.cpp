@@ -1366,10 +1366,11 @@ void PublicTransportApplet::showColumnTarget()
 void PublicTransportApplet::toggleExpanded()
 {
     Q_D( PublicTransportApplet );
+    // The item of the clicked row may have been reused for another row after scrolling
     if ( d->journeyTimetable && d->isStateActive("journeyView") ) {
-        d->journeyTimetable->item( d->clickedItemIndex.row() )->toggleExpanded();
+        d->journeyTimetable->toggleRowExpanded( d->clickedItemIndex.row() );
     } else {
-        d->timetable->item( d->clickedItemIndex.row() )->toggleExpanded();
+        d->timetable->toggleRowExpanded( d->clickedItemIndex.row() );
     }
 }
 
@@ -1385,8 +1386,8 @@ QAction* PublicTransportApplet::updatedAction( const QString& actionName )
 
     if ( actionName == QLatin1String("toggleExpanded") ) {
         if ( (d->journeyTimetable && d->isStateActive("journeyView"))
-            ? d->journeyTimetable->item(d->clickedItemIndex.row())->isExpanded()
-            : d->timetable->item(d->clickedItemIndex.row())->isExpanded() )
+            ? d->journeyTimetable->isRowExpanded(d->clickedItemIndex.row())
+            : d->timetable->isRowExpanded(d->clickedItemIndex.row()) )
         {
             a->setText( i18nc("@action", "Hide Additional &Information") );
             a->setIcon( KIcon("arrow-up") );
@@ -337,7 +337,8 @@ void RouteGraphicsItem::updateData( DepartureItem *item )
             QFont *font;
 
             const bool manuallyHighlighted =
-                    model->routeItemFlags(stopName).testFlag(RouteItemHighlighted);
+                    model->routeItemFlags(info->routeStopHandles()[index])
+                    .testFlag(RouteItemHighlighted);
             if ( index == 0 || index == info->routeStops().count() - 1 // first and last item
                  || manuallyHighlighted )
             {
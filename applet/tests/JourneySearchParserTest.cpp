@@ -0,0 +1,131 @@
+/*
+ *   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "JourneySearchParserTest.h"
+
+#include "../journeysearchparser.h"
+
+#include <qtest_kde.h>
+
+QStringList JourneySearchParserTest::tokenStrings( const QString &searchLine )
+{
+    QStringList strings;
+    foreach ( const JourneySearchParser::Token &token, JourneySearchParser::tokens(searchLine) ) {
+        strings << QString( "%1@%2#%3" ).arg( token.text ).arg( token.position )
+                   .arg( int(token.keywords) );
+    }
+    return strings;
+}
+
+QStringList JourneySearchParserTest::splitTokenStrings( const QString &searchLine )
+{
+    QStringList strings;
+    int position = 0;
+    foreach ( const QString &word, searchLine.split(' ') ) {
+        if ( !word.isEmpty() ) {
+            strings << QString( "%1@%2#%3" ).arg( word ).arg( position )
+                       .arg( int(JourneySearchParser::keywordsForWord(word)) );
+        }
+        position += word.length() + 1;
+    }
+    return strings;
+}
+
+void JourneySearchParserTest::tokensTest_data()
+{
+    QTest::addColumn< QStringList >( "searchLines" );
+
+    QTest::newRow( "Insert inside quotes" ) << (QStringList()
+            << "to \"Hauptbahnhof\" at 12:00"
+            << "to \"Haupt bahnhof\" at 12:00"
+            << "to \"Haupt  bahnhof\" at 12:00"
+            << "to \"Hauptbahnhof Süd\" at 12:00"
+            << "to \"Hauptbahnhof Süd at\" at 12:00"
+            << "to \" at Hauptbahnhof Süd at\" at 12:00");
+    QTest::newRow( "Delete inside quotes" ) << (QStringList()
+            << "from \"Bahnhof Nord West\" tomorrow"
+            << "from \"Bahnhof NordWest\" tomorrow"
+            << "from \"BahnhofNordWest\" tomorrow"
+            << "from \"Bahnhof\" tomorrow"
+            << "from \"\" tomorrow"
+            << "from \" tomorrow"
+            << "from tomorrow");
+    QTest::newRow( "Replace inside quotes" ) << (QStringList()
+            << "to \"Marktplatz\" arrival at 08:15"
+            << "to \"Rathaus\" arrival at 08:15"
+            << "to \"Rathaus in\" arrival at 08:15"
+            << "to \"Rat in haus\" arrival at 08:15"
+            << "to \"to from at in\" arrival at 08:15"
+            << "to \"toto\" arrival at 08:15");
+    QTest::newRow( "Edit quotes and keywords" ) << (QStringList()
+            << "\"Marktplatz\" in 5 minutes"
+            << "Marktplatz\" in 5 minutes"
+            << "Marktplatz in 5 minutes"
+            << "Marktplatz \"in 5\" minutes"
+            << "Marktplatz \"in 5 minutes"
+            << "Marktplatz \"in5 minutes"
+            << "  Marktplatz  \"in5   minutes  "
+            << ""
+            << "\"at\"");
+    QTest::newRow( "Repeated text" ) << (QStringList()
+            << "\"at at at\" at at"
+            << "\"at at\" at at"
+            << "\"at at at at\" at at"
+            << "\"at at at at\" at"
+            << "\"at at at at\" at at at");
+}
+
+void JourneySearchParserTest::tokensTest()
+{
+    QFETCH( QStringList, searchLines );
+
+    foreach ( const QString &searchLine, searchLines ) {
+        QCOMPARE( tokenStrings(searchLine), splitTokenStrings(searchLine) );
+
+        // Tokenizing the same line again uses the cache
+        QCOMPARE( tokenStrings(searchLine), splitTokenStrings(searchLine) );
+    }
+}
+
+void JourneySearchParserTest::tokensTypingTest()
+{
+    const QString searchLine = "to \"Hauptbahnhof Süd\" departure at 12:00 tomorrow";
+
+    // Type the search line
+    for ( int length = 0; length <= searchLine.length(); ++length ) {
+        const QString typed = searchLine.left( length );
+        QCOMPARE( tokenStrings(typed), splitTokenStrings(typed) );
+    }
+
+    // Type inside the quotes
+    QString edited = searchLine;
+    for ( int i = 0; i < 5; ++i ) {
+        edited.insert( 8 + i, i == 2 ? ' ' : 'x' );
+        QCOMPARE( tokenStrings(edited), splitTokenStrings(edited) );
+    }
+
+    // Delete characters in the middle, from inside the quotes to after them
+    while ( edited.length() > 5 ) {
+        edited.remove( 5, 1 );
+        QCOMPARE( tokenStrings(edited), splitTokenStrings(edited) );
+    }
+}
+
+QTEST_KDEMAIN( JourneySearchParserTest, NoGUI )
+#include "JourneySearchParserTest.moc"
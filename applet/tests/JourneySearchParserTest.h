@@ -0,0 +1,47 @@
+/*
+ *   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef JOURNEYSEARCHPARSERTEST_H
+#define JOURNEYSEARCHPARSERTEST_H
+
+#include <QtCore/QObject>
+#include <QStringList>
+
+class JourneySearchParserTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    // Test that incrementally tokenized search lines match a full split after each edit,
+    // with insertions, deletions and replacements inside and around double quoted text
+    void tokensTest_data();
+    void tokensTest();
+
+    // Test the same while typing and deleting a search line character by character
+    void tokensTypingTest();
+
+private:
+    /** @brief Tokens of @p searchLine from JourneySearchParser::tokens() as strings. */
+    static QStringList tokenStrings( const QString &searchLine );
+
+    /** @brief Tokens of @p searchLine split without the cache, formatted like tokenStrings(). */
+    static QStringList splitTokenStrings( const QString &searchLine );
+};
+
+#endif // JOURNEYSEARCHPARSERTEST_H
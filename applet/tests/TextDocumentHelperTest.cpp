@@ -0,0 +1,149 @@
+/*
+ *   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "TextDocumentHelperTest.h"
+
+#include "../textdocumenthelper.h"
+
+#include <QtTest/QTest>
+#include <QtTest/QtTestGui>
+#include <QTextDocument>
+#include <QTextOption>
+#include <QStyleOptionGraphicsItem>
+#include <QPixmapCache>
+#include <QPainter>
+
+void TextDocumentHelperTest::cachedTextDocumentTest()
+{
+    const QTextOption textOption( Qt::AlignLeft | Qt::AlignVCenter );
+    const QFont font( "Sans", 10 );
+    const QSizeF size( 200, 40 );
+    const QSharedPointer<QTextDocument> document =
+            TextDocumentHelper::cachedTextDocument( "<b>Tram 1</b> Hauptbahnhof", size,
+                                                    textOption, font );
+    QVERIFY( !document.isNull() );
+    QCOMPARE( document->toPlainText(), QString("Tram 1 Hauptbahnhof") );
+
+    // Equal values share the document
+    QCOMPARE( TextDocumentHelper::cachedTextDocument("<b>Tram 1</b> Hauptbahnhof", size,
+                                                     textOption, font).data(), document.data() );
+
+    // Changed texts, sizes, text options and fonts (eg. zoomed) use other documents
+    QVERIFY( TextDocumentHelper::cachedTextDocument("<b>Tram 2</b> Hauptbahnhof", size,
+                                                    textOption, font).data() != document.data() );
+    QVERIFY( TextDocumentHelper::cachedTextDocument("<b>Tram 1</b> Hauptbahnhof",
+                                                    QSizeF(300, 40), textOption,
+                                                    font).data() != document.data() );
+    QVERIFY( TextDocumentHelper::cachedTextDocument("<b>Tram 1</b> Hauptbahnhof", size,
+                                                    QTextOption(Qt::AlignRight),
+                                                    font).data() != document.data() );
+    QVERIFY( TextDocumentHelper::cachedTextDocument("<b>Tram 1</b> Hauptbahnhof", size,
+                                                    textOption,
+                                                    QFont("Sans", 12)).data() != document.data() );
+
+    // Texts containing '%' characters are not used as format strings for the key
+    const QSharedPointer<QTextDocument> percentDocument =
+            TextDocumentHelper::cachedTextDocument( "%1 %2", size, textOption, font );
+    QCOMPARE( percentDocument->toPlainText(), QString("%1 %2") );
+    QVERIFY( TextDocumentHelper::cachedTextDocument("%2 %1", size, textOption, font).data() !=
+             percentDocument.data() );
+}
+
+void TextDocumentHelperTest::pixmapCacheKeyTest()
+{
+    const QSharedPointer<QTextDocument> document = TextDocumentHelper::cachedTextDocument(
+            "Bus 42", QSizeF(200, 40), QTextOption(), QFont("Sans", 10) );
+    const QString key = TextDocumentHelper::pixmapCacheKey( document.data(), QSize(200, 40),
+                                                            Qt::black, Qt::LeftToRight );
+    QVERIFY( !key.isEmpty() );
+    QCOMPARE( TextDocumentHelper::pixmapCacheKey(document.data(), QSize(200, 40), Qt::black,
+                                                 Qt::LeftToRight), key );
+
+    // Changed sizes, colors and directions use other keys
+    QVERIFY( TextDocumentHelper::pixmapCacheKey(document.data(), QSize(200, 50), Qt::black,
+                                                Qt::LeftToRight) != key );
+    QVERIFY( TextDocumentHelper::pixmapCacheKey(document.data(), QSize(200, 40), Qt::white,
+                                                Qt::LeftToRight) != key );
+    QVERIFY( TextDocumentHelper::pixmapCacheKey(document.data(), QSize(200, 40), Qt::black,
+                                                Qt::RightToLeft) != key );
+
+    // Other documents (eg. for a changed font) use other keys
+    const QSharedPointer<QTextDocument> zoomedDocument = TextDocumentHelper::cachedTextDocument(
+            "Bus 42", QSizeF(200, 40), QTextOption(), QFont("Sans", 12) );
+    QVERIFY( TextDocumentHelper::pixmapCacheKey(zoomedDocument.data(), QSize(200, 40),
+                                                Qt::black, Qt::LeftToRight) != key );
+
+    // Documents that are not cached do not get cached pixmaps
+    QTextDocument *uncachedDocument = TextDocumentHelper::createTextDocument(
+            "Bus 42", QSizeF(200, 40), QTextOption(), QFont("Sans", 10) );
+    QVERIFY( TextDocumentHelper::pixmapCacheKey(uncachedDocument, QSize(200, 40), Qt::black,
+                                                Qt::LeftToRight).isEmpty() );
+    delete uncachedDocument;
+}
+
+void TextDocumentHelperTest::drawTextDocumentTest()
+{
+    QPixmapCache::clear();
+    const QRect textRect( 0, 0, 200, 40 );
+    const QSharedPointer<QTextDocument> document = TextDocumentHelper::cachedTextDocument(
+            "Tram 1 Hauptbahnhof", textRect.size(), QTextOption(), QFont("Sans", 10) );
+    QStyleOptionGraphicsItem option;
+    option.direction = Qt::LeftToRight;
+    QPixmap target( textRect.size() );
+    target.fill( Qt::transparent );
+    QPainter painter( &target );
+    painter.setPen( Qt::black );
+
+    // The drawn text and it's blurred shadow get cached
+    const QString key = TextDocumentHelper::pixmapCacheKey( document.data(), textRect.size(),
+                                                            Qt::black, Qt::LeftToRight );
+    TextDocumentHelper::drawTextDocument( &painter, &option, document.data(), textRect,
+                                          TextDocumentHelper::DrawShadows );
+    QPixmap pixmap, shadow;
+    QVERIFY( QPixmapCache::find(key, &pixmap) );
+    QVERIFY( QPixmapCache::find(key + "|Shadow", &shadow) );
+    QCOMPARE( pixmap.size(), textRect.size() );
+    QCOMPARE( shadow.size(), textRect.size() );
+
+    // Drawing again uses the cached pixmaps
+    TextDocumentHelper::drawTextDocument( &painter, &option, document.data(), textRect,
+                                          TextDocumentHelper::DrawShadows );
+    QPixmap cachedPixmap;
+    QVERIFY( QPixmapCache::find(key, &cachedPixmap) );
+    QCOMPARE( cachedPixmap.cacheKey(), pixmap.cacheKey() );
+
+    // An evicted shadow gets blurred again
+    QPixmapCache::remove( key + "|Shadow" );
+    TextDocumentHelper::drawTextDocument( &painter, &option, document.data(), textRect,
+                                          TextDocumentHelper::DrawShadows );
+    QVERIFY( QPixmapCache::find(key + "|Shadow", &shadow) );
+
+    // Another pen color draws the text again, without shadow no shadow gets cached
+    painter.setPen( Qt::white );
+    const QString whiteKey = TextDocumentHelper::pixmapCacheKey( document.data(),
+            textRect.size(), Qt::white, Qt::LeftToRight );
+    TextDocumentHelper::drawTextDocument( &painter, &option, document.data(), textRect,
+                                          TextDocumentHelper::DoNotDrawShadowOrHalos );
+    QVERIFY( QPixmapCache::find(whiteKey, &pixmap) );
+    QVERIFY( !QPixmapCache::find(whiteKey + "|Shadow", &shadow) );
+    painter.end();
+}
+
+QTEST_MAIN(TextDocumentHelperTest)
+#include "TextDocumentHelperTest.moc"
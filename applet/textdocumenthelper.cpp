@@ -0,0 +1,259 @@
+/*
+*   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU Library General Public License as
+*   published by the Free Software Foundation; either version 2 or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details
+*
+*   You should have received a copy of the GNU Library General Public
+*   License along with this program; if not, write to the
+*   Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+// Header
+#include "textdocumenthelper.h"
+
+// Plasma includes
+#include <Plasma/PaintUtils>
+
+// KDE includes
+#include <KGlobal>
+#include <KDebug>
+
+// Qt includes
+#include <QPainter>
+#include <QPixmapCache>
+#include <QStyle>
+#include <QStyleOptionGraphicsItem>
+#include <QTextLayout>
+#include <QTextDocument>
+#include <QTextBlock>
+#include <QCache>
+#include <qmath.h>
+
+// The name of the property of documents from cachedTextDocument() containing their cache key
+static const char *TEXT_DOCUMENT_CACHE_KEY_PROPERTY = "textDocumentCacheKey";
+
+// Laid out text documents shared by all items, see TextDocumentHelper::cachedTextDocument()
+typedef QCache< QString, QSharedPointer<QTextDocument> > TextDocumentCache;
+K_GLOBAL_STATIC_WITH_ARGS( TextDocumentCache, globalTextDocumentCache,
+                           (TextDocumentHelper::MAXIMUM_CACHED_TEXT_DOCUMENTS) )
+
+QTextDocument* TextDocumentHelper::createTextDocument(const QString& html, const QSizeF& size,
+    const QTextOption &textOption, const QFont &font  )
+{
+    QTextDocument *textDocument = new QTextDocument;
+    textDocument->setDefaultFont( font );
+    textDocument->setDocumentMargin( 0 );
+    textDocument->setDefaultTextOption( textOption );
+    textDocument->setPageSize( size );
+    if ( html.contains('<') || html.contains('&') || html.contains('\n') ) {
+        textDocument->setHtml( html );
+    } else {
+        // No markup, no need to parse HTML
+        textDocument->setPlainText( html );
+    }
+    textDocument->documentLayout();
+    return textDocument;
+}
+
+QSharedPointer<QTextDocument> TextDocumentHelper::cachedTextDocument( const QString &html,
+        const QSizeF &size, const QTextOption &textOption, const QFont &font )
+{
+    // The text gets appended last, it may contain '%' characters
+    const QString key = QString( "%1|%2x%3|%4|%5|%6|" ).arg( font.key() )
+            .arg( size.width() ).arg( size.height() ).arg( int(textOption.alignment()) )
+            .arg( int(textOption.wrapMode()) ).arg( int(textOption.textDirection()) ) + html;
+    const QSharedPointer<QTextDocument> *cachedDocument = globalTextDocumentCache->object( key );
+    if ( cachedDocument ) {
+        return *cachedDocument;
+    }
+
+    // Documents removed from the cache get deleted when no item uses them any longer
+    QSharedPointer<QTextDocument> document( createTextDocument(html, size, textOption, font) );
+    document->setProperty( TEXT_DOCUMENT_CACHE_KEY_PROPERTY, key );
+    globalTextDocumentCache->insert( key, new QSharedPointer<QTextDocument>(document) );
+    return document;
+}
+
+// Draw the text of @p document into a pixmap of the size of @p textRect, fading out long lines.
+// If @p haloRects is given, it gets filled with a rect for each drawn line in painter coordinates
+static QPixmap drawTextDocumentPixmap( QTextDocument *document, const QRect &textRect,
+                                       const QPen &pen, Qt::LayoutDirection direction,
+                                       QList<QRect> *haloRects = 0 )
+{
+    QList<QRect> fadeRects;
+    const int fadeWidth = 30;
+
+    QPixmap pixmap( textRect.size() );
+    pixmap.fill( Qt::transparent );
+    QPainter p( &pixmap );
+    p.setPen( pen );
+    p.setRenderHints( QPainter::Antialiasing | QPainter::SmoothPixmapTransform );
+
+    QFontMetrics fm( document->defaultFont() );
+    int maxLineCount = qMax( qFloor(textRect.height() / fm.lineSpacing()), 1 );
+    int blockCount = document->blockCount();
+    int lineCount = 0;
+    for ( int b = 0; b < blockCount; ++b ) {
+        lineCount += document->findBlockByNumber( b ).layout()->lineCount();
+    }
+    if ( lineCount > maxLineCount ) {
+        lineCount = maxLineCount;
+    }
+    int textHeight = lineCount * ( fm.lineSpacing() + 1 );
+
+    // Draw text and calculate halo/fade rects
+    for ( int b = 0; b < blockCount; ++b ) {
+        QTextLayout *textLayout = document->findBlockByNumber( b ).layout();
+        const int lines = textLayout->lineCount();
+        const QPointF position( 0, (textRect.height() - textHeight) / 2.0f );
+        for ( int l = 0; l < lines; ++l ) {
+            // Draw a text line
+            QTextLine textLine = textLayout->lineAt( l );
+            textLine.draw( &p, position );
+
+            if ( haloRects ) {
+                // Calculate halo rect
+                QSize textSize = textLine.naturalTextRect().size().toSize();
+                if ( textSize.width() > textRect.width() ) {
+                    textSize.setWidth( textRect.width() );
+                }
+                QRect haloRect = QStyle::visualRect( textLayout->textOption().textDirection(),
+                        textRect, QRect((textLine.position() + position).toPoint() +
+                        (document->defaultTextOption().alignment().testFlag(Qt::AlignRight)
+                        ? (textRect.topRight() - QPoint(textSize.width(), 0)) : textRect.topLeft()),
+                        textSize) );
+                if ( haloRect.top() <= textRect.bottom() ) {
+                    if ( haloRect.width() > textRect.width() ) {
+                        haloRect.setWidth( textRect.width() );
+                    }
+                    // Add a halo rect for each drawn text line
+                    *haloRects << haloRect;
+                }
+            }
+
+            // Add a fade out rect to the list if the line is too long
+            if ( textLine.naturalTextWidth() > textRect.width() - textLine.x() ) {
+                int x = int( qMin(textLine.naturalTextWidth(), (qreal)textRect.width()) )
+                        - fadeWidth + textLine.x() + position.x();
+                int y = int( textLine.position().y() + position.y() );
+                QRect fadeRect = QStyle::visualRect( textLayout->textOption().textDirection(),
+                        textRect, QRect(x, y, fadeWidth, int(textLine.height()) + 1) );
+                fadeRects << fadeRect;
+            }
+        }
+    }
+
+    // Reduce the alpha in each fade out rect using the alpha gradient
+    if ( !fadeRects.isEmpty() ) {
+        // (From the tasks plasmoid) Create the alpha gradient for the fade out effect
+        QLinearGradient alphaGradient( 0, 0, 1, 0 );
+        alphaGradient.setCoordinateMode( QGradient::ObjectBoundingMode );
+        if ( direction == Qt::LeftToRight ) {
+            alphaGradient.setColorAt( 0, Qt::black );
+            alphaGradient.setColorAt( 1, Qt::transparent );
+        } else {
+            alphaGradient.setColorAt( 0, Qt::transparent );
+            alphaGradient.setColorAt( 1, Qt::black );
+        }
+
+        p.setCompositionMode( QPainter::CompositionMode_DestinationIn );
+        foreach( const QRect &rect, fadeRects ) {
+            p.fillRect( rect, alphaGradient );
+        }
+    }
+    p.end();
+    return pixmap;
+}
+
+void TextDocumentHelper::drawTextDocument( QPainter *painter,
+        const QStyleOptionGraphicsItem* option, QTextDocument *document,
+        const QRect &textRect, Option options )
+{
+    if ( textRect.isEmpty() ) {
+        kDebug() << "Empty text rect given!";
+        return;
+    }
+
+    if ( options == DrawHalos ) {
+        // Halos get drawn for each text line, the pixmap does not get cached
+        QList<QRect> haloRects;
+        const QPixmap pixmap = drawTextDocumentPixmap( document, textRect, painter->pen(),
+                                                       option->direction, &haloRects );
+        foreach( const QRect &haloRect, haloRects ) {
+            Plasma::PaintUtils::drawHalo( painter, haloRect );
+        }
+        painter->drawPixmap( textRect.topLeft(), pixmap );
+        return;
+    }
+
+    // Draw the text and blur it's shadow only once for unchanged documents from the cache
+    const QString key = pixmapCacheKey( document, textRect.size(), painter->pen().color(),
+                                        option->direction );
+    QPixmap pixmap;
+    if ( key.isEmpty() || !QPixmapCache::find(key, &pixmap) ) {
+        pixmap = drawTextDocumentPixmap( document, textRect, painter->pen(), option->direction );
+        if ( !key.isEmpty() ) {
+            QPixmapCache::insert( key, pixmap );
+        }
+    }
+
+    if ( options == DrawShadows ) {
+        const QString shadowKey = key.isEmpty() ? QString() : key + "|Shadow";
+        QPixmap shadow;
+        if ( shadowKey.isEmpty() || !QPixmapCache::find(shadowKey, &shadow) ) {
+            QImage shadowImage = pixmap.toImage();
+            Plasma::PaintUtils::shadowBlur( shadowImage, 3, Qt::black );
+            shadow = QPixmap::fromImage( shadowImage );
+            if ( !shadowKey.isEmpty() ) {
+                QPixmapCache::insert( shadowKey, shadow );
+            }
+        }
+        painter->drawPixmap( textRect.topLeft() + QPoint(1, 2), shadow );
+    }
+
+    painter->drawPixmap( textRect.topLeft(), pixmap );
+}
+
+QString TextDocumentHelper::pixmapCacheKey( const QTextDocument *document, const QSize &size,
+        const QColor &color, Qt::LayoutDirection direction )
+{
+    const QString documentKey = document
+            ? document->property( TEXT_DOCUMENT_CACHE_KEY_PROPERTY ).toString() : QString();
+    if ( documentKey.isEmpty() ) {
+        return QString();
+    }
+
+    // The document key gets appended last, it contains the text
+    return QString( "TextDocument|%1x%2|%3|%4|" ).arg( size.width() ).arg( size.height() )
+            .arg( color.rgba() ).arg( int(direction) ) + documentKey;
+}
+
+qreal TextDocumentHelper::textDocumentWidth( QTextDocument* document )
+{
+    if ( !document ) {
+        return 0.0;
+    }
+
+    qreal maxWidth = 0.0;
+    int blockCount = document->blockCount();
+    for ( int b = 0; b < blockCount; ++b ) {
+        QTextLayout *textLayout = document->findBlockByNumber( b ).layout();
+        int lines = textLayout->lineCount();
+        for ( int l = 0; l < lines; ++l ) {
+            QTextLine textLine = textLayout->lineAt( l );
+            if ( textLine.naturalTextWidth() > maxWidth ) {
+                maxWidth = textLine.naturalTextWidth();
+            }
+        }
+    }
+    return maxWidth;
+}
@@ -0,0 +1,86 @@
+/*
+ *   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef TEXTDOCUMENTHELPER_H
+#define TEXTDOCUMENTHELPER_H
+
+// Qt includes
+#include <QSharedPointer> // Return value
+#include <QString>
+
+/** @file
+ * @brief This file contains the TextDocumentHelper class used to draw texts of timetable items.
+ * @author Friedrich Pülz <fpuelz@gmx.de> */
+
+class QStyleOptionGraphicsItem;
+class QPainter;
+class QTextOption;
+class QTextDocument;
+class QColor;
+class QFont;
+class QRect;
+class QSize;
+class QSizeF;
+
+class TextDocumentHelper {
+public:
+    enum Option {
+        DoNotDrawShadowOrHalos, DrawShadows, DrawHalos, DefaultOption = DrawShadows
+    };
+
+    /** @brief The maximal number of documents in the cache used by cachedTextDocument(). */
+    static const int MAXIMUM_CACHED_TEXT_DOCUMENTS = 500;
+
+    static QTextDocument *createTextDocument( const QString &html, const QSizeF &size,
+            const QTextOption &textOption, const QFont &font );
+
+    /**
+     * @brief Get a laid out document for @p html from a cache shared by all items.
+     *
+     * Documents get cached by text, size, text option and font (which contains the zoom
+     * factor). Items showing the same text in the same size share one document and unchanged
+     * texts do not need to be laid out again. The returned document must not be modified.
+     **/
+    static QSharedPointer<QTextDocument> cachedTextDocument( const QString &html,
+            const QSizeF &size, const QTextOption &textOption, const QFont &font );
+
+    /**
+     * @brief Draw @p document into @p textRect.
+     *
+     * For documents from cachedTextDocument() the drawn text and it's blurred shadow get
+     * stored in QPixmapCache, see pixmapCacheKey(). Halos get drawn for each text line.
+     **/
+    static void drawTextDocument( QPainter *painter, const QStyleOptionGraphicsItem* option,
+            QTextDocument *document, const QRect &textRect, Option options = DefaultOption );
+
+    /**
+     * @brief The key used to store the drawn @p document in QPixmapCache.
+     *
+     * The key contains the key of the document in the cache used by cachedTextDocument(),
+     * therefore changed texts, fonts or sizes use other pixmaps. The blurred shadow gets
+     * stored with the key and a "|Shadow" suffix.
+     * @return The key or an empty string, if @p document is not from cachedTextDocument().
+     **/
+    static QString pixmapCacheKey( const QTextDocument *document, const QSize &size,
+            const QColor &color, Qt::LayoutDirection direction );
+
+    static qreal textDocumentWidth( QTextDocument *document );
+};
+
+#endif // TEXTDOCUMENTHELPER_H
@@ -22,6 +22,9 @@
 #include "routegraphicsitem.h"
 #include "departuremodel.h"
 
+// libpublictransporthelper includes
+#include <vehicleiconatlas.h>
+
 // Plasma includes
 #include <Plasma/PaintUtils>
 #include <Plasma/Svg>
@@ -30,10 +33,10 @@
 #include <Plasma/DataEngineManager>
 
 // KDE includes
+#include <KGlobal>
 #include <KColorScheme>
 #include <KColorUtils>
 #include <KMenu>
-#include <KPixmapCache>
 
 // Qt includes
 #include <QGraphicsLinearLayout>
@@ -64,6 +67,7 @@ PublicTransportGraphicsItem::PublicTransportGraphicsItem(
     m_expanded = false;
     m_expandStep = 0.0;
     m_fadeOut = 1.0;
+    m_textLayoutsDirty = false;
 }
 
 PublicTransportGraphicsItem::~PublicTransportGraphicsItem()
@@ -144,6 +148,44 @@ void PublicTransportGraphicsItem::resizeAnimationFinished()
 void PublicTransportGraphicsItem::updateGeometry()
 {
     QGraphicsWidget::updateGeometry();
+
+    // Items are not managed by a layout, the parent positions them
+    m_parent->scheduleRowLayout();
+}
+
+void PublicTransportGraphicsItem::invalidateTextLayouts()
+{
+    m_textLayoutsDirty = true;
+    m_parent->scheduleTextLayout();
+}
+
+void PublicTransportGraphicsItem::updateTextLayoutsIfDirty()
+{
+    if ( m_textLayoutsDirty ) {
+        m_textLayoutsDirty = false;
+        updateTextLayouts();
+    }
+}
+
+void PublicTransportGraphicsItem::resetState( bool expanded )
+{
+    if ( m_resizeAnimation ) {
+        m_resizeAnimation->stop();
+        delete m_resizeAnimation;
+        m_resizeAnimation = 0;
+    }
+    delete m_pixmap;
+    m_pixmap = 0;
+
+    m_expanded = expanded;
+    m_expandStep = expanded ? 1.0 : 0.0;
+    m_fadeOut = 1.0;
+    QGraphicsWidget *route = routeItem();
+    if ( route ) {
+        route->setVisible( expanded );
+    }
+    setOpacity( 1.0 );
+    updateGeometry();
 }
 
 void TimetableListItem::paint( QPainter *painter, const QStyleOptionGraphicsItem *option,
@@ -206,6 +248,10 @@ void PublicTransportGraphicsItem::paint( QPainter* painter,
 {
     Q_UNUSED( widget );
     painter->setRenderHints( QPainter::Antialiasing | QPainter::SmoothPixmapTransform );
+    if ( m_item ) {
+        // Got painted before the outdated layouts of all items were updated
+        updateTextLayoutsIfDirty();
+    }
     if ( !m_item || !isValid() ) {
         if ( m_pixmap ) {
             // Draw captured pixmap, the item in the model is already deleted
@@ -265,6 +311,13 @@ qreal PublicTransportGraphicsItem::unexpandedHeight() const
                  (qreal)QFontMetrics(font()).lineSpacing() * m_parent->maxLineCount() + padding() );
 }
 
+qreal PublicTransportWidget::unexpandedItemHeight() const
+{
+    // Items use the font of this widget, see PublicTransportGraphicsItem::unexpandedHeight()
+    return qFloor( qMax(iconSize() * 1.1,
+            (qreal)QFontMetrics(font()).lineSpacing() * m_maxLineCount + 4.0 * m_zoomFactor) );
+}
+
 bool PublicTransportGraphicsItem::hasExtraIcon( Columns column ) const
 {
     if ( !m_item ) {
@@ -282,150 +335,10 @@ int PublicTransportGraphicsItem::extraIconSize() const
     return m_parent->iconSize() / 2;
 }
 
-QTextDocument* TextDocumentHelper::createTextDocument(const QString& html, const QSizeF& size,
-    const QTextOption &textOption, const QFont &font  )
-{
-    QTextDocument *textDocument = new QTextDocument;
-    textDocument->setDefaultFont( font );
-    textDocument->setDocumentMargin( 0 );
-    textDocument->setDefaultTextOption( textOption );
-    textDocument->setPageSize( size );
-    textDocument->setHtml( html );
-    textDocument->documentLayout();
-    return textDocument;
-}
-
-void TextDocumentHelper::drawTextDocument( QPainter *painter,
-        const QStyleOptionGraphicsItem* option, QTextDocument *document,
-        const QRect &textRect, Option options )
-{
-    if ( textRect.isEmpty() ) {
-        kDebug() << "Empty text rect given!";
-        return;
-    }
-
-    QList<QRect> haloRects, fadeRects;
-    const int fadeWidth = 30;
-
-    QPixmap pixmap( textRect.size() );
-    pixmap.fill( Qt::transparent );
-    QPainter p( &pixmap );
-    p.setPen( painter->pen() );
-    p.setRenderHints( QPainter::Antialiasing | QPainter::SmoothPixmapTransform );
-
-    QFontMetrics fm( document->defaultFont() );
-    int maxLineCount = qMax( qFloor(textRect.height() / fm.lineSpacing()), 1 );
-    int blockCount = document->blockCount();
-    int lineCount = 0;
-    for ( int b = 0; b < blockCount; ++b ) {
-        lineCount += document->findBlockByNumber( b ).layout()->lineCount();
-    }
-    if ( lineCount > maxLineCount ) {
-        lineCount = maxLineCount;
-    }
-    int textHeight = lineCount * ( fm.lineSpacing() + 1 );
-
-    // Draw text and calculate halo/fade rects
-    for ( int b = 0; b < blockCount; ++b ) {
-        QTextLayout *textLayout = document->findBlockByNumber( b ).layout();
-        const int lines = textLayout->lineCount();
-        const QPointF position( 0, (textRect.height() - textHeight) / 2.0f );
-        for ( int l = 0; l < lines; ++l ) {
-            // Draw a text line
-            QTextLine textLine = textLayout->lineAt( l );
-            textLine.draw( &p, position );
-
-            if ( options == DrawHalos ) {
-                // Calculate halo rect
-                QSize textSize = textLine.naturalTextRect().size().toSize();
-                if ( textSize.width() > textRect.width() ) {
-                    textSize.setWidth( textRect.width() );
-                }
-                QRect haloRect = QStyle::visualRect( textLayout->textOption().textDirection(),
-                        textRect, QRect((textLine.position() + position).toPoint() +
-                        (document->defaultTextOption().alignment().testFlag(Qt::AlignRight)
-                        ? (textRect.topRight() - QPoint(textSize.width(), 0)) : textRect.topLeft()),
-                        textSize) );
-                if ( haloRect.top() <= textRect.bottom() ) {
-                    if ( haloRect.width() > textRect.width() ) {
-                        haloRect.setWidth( textRect.width() );
-                    }
-                    // Add a halo rect for each drawn text line
-                    haloRects << haloRect;
-                }
-            }
-
-            // Add a fade out rect to the list if the line is too long
-            if ( textLine.naturalTextWidth() > textRect.width() - textLine.x() ) {
-                int x = int( qMin(textLine.naturalTextWidth(), (qreal)textRect.width()) )
-                        - fadeWidth + textLine.x() + position.x();
-                int y = int( textLine.position().y() + position.y() );
-                QRect fadeRect = QStyle::visualRect( textLayout->textOption().textDirection(),
-                        textRect, QRect(x, y, fadeWidth, int(textLine.height()) + 1) );
-                fadeRects << fadeRect;
-            }
-        }
-    }
-
-    // Reduce the alpha in each fade out rect using the alpha gradient
-    if ( !fadeRects.isEmpty() ) {
-        // (From the tasks plasmoid) Create the alpha gradient for the fade out effect
-        QLinearGradient alphaGradient( 0, 0, 1, 0 );
-        alphaGradient.setCoordinateMode( QGradient::ObjectBoundingMode );
-        if ( option->direction == Qt::LeftToRight ) {
-            alphaGradient.setColorAt( 0, Qt::black );
-            alphaGradient.setColorAt( 1, Qt::transparent );
-        } else {
-            alphaGradient.setColorAt( 0, Qt::transparent );
-            alphaGradient.setColorAt( 1, Qt::black );
-        }
-
-        p.setCompositionMode( QPainter::CompositionMode_DestinationIn );
-        foreach( const QRect &rect, fadeRects ) {
-            p.fillRect( rect, alphaGradient );
-        }
-    }
-    p.end();
-
-    // Draw halo/shadow
-    if ( options == DrawHalos ) {
-        foreach( const QRect &haloRect, haloRects ) {
-            Plasma::PaintUtils::drawHalo( painter, haloRect );
-        }
-    } else if ( options == DrawShadows ) {
-        QImage shadow = pixmap.toImage();
-        Plasma::PaintUtils::shadowBlur( shadow, 3, Qt::black );
-        painter->drawImage( textRect.topLeft() + QPoint(1, 2), shadow );
-    }
-
-    painter->drawPixmap( textRect.topLeft(), pixmap );
-}
-
-qreal TextDocumentHelper::textDocumentWidth( QTextDocument* document )
-{
-    if ( !document ) {
-        return 0.0;
-    }
-
-    qreal maxWidth = 0.0;
-    int blockCount = document->blockCount();
-    for ( int b = 0; b < blockCount; ++b ) {
-        QTextLayout *textLayout = document->findBlockByNumber( b ).layout();
-        int lines = textLayout->lineCount();
-        for ( int l = 0; l < lines; ++l ) {
-            QTextLine textLine = textLayout->lineAt( l );
-            if ( textLine.naturalTextWidth() > maxWidth ) {
-                maxWidth = textLine.naturalTextWidth();
-            }
-        }
-    }
-    return maxWidth;
-}
-
 void PublicTransportGraphicsItem::resizeEvent( QGraphicsSceneResizeEvent* event )
 {
     QGraphicsWidget::resizeEvent( event );
-    updateTextLayouts();
+    invalidateTextLayouts();
 }
 
 void DepartureGraphicsItem::resizeEvent( QGraphicsSceneResizeEvent* event )
@@ -548,13 +461,12 @@ DepartureGraphicsItem::DepartureGraphicsItem( PublicTransportWidget* publicTrans
         QGraphicsItem* parent,
         StopAction *copyStopToClipboardAction, StopAction *showInMapAction,
         StopAction *showDeparturesAction, StopAction *highlightStopAction,
-        StopAction *newFilterViaStopAction, KPixmapCache *pixmapCache )
+        StopAction *newFilterViaStopAction )
         : PublicTransportGraphicsItem( publicTransportWidget, parent, copyStopToClipboardAction,
                                        showInMapAction ),
-        m_infoTextDocument(0), m_timeTextDocument(0), m_routeItem(0), m_highlighted(false),
+        m_routeItem(0), m_highlighted(false),
         m_leavingAnimation(0), m_showDeparturesAction(showDeparturesAction),
-        m_highlightStopAction(highlightStopAction), m_newFilterViaStopAction(newFilterViaStopAction),
-        m_pixmapCache(pixmapCache)
+        m_highlightStopAction(highlightStopAction), m_newFilterViaStopAction(newFilterViaStopAction)
 {
     m_leavingStep = 0.0;
 }
@@ -564,9 +476,6 @@ DepartureGraphicsItem::~DepartureGraphicsItem()
     if ( m_leavingAnimation ) {
         m_leavingAnimation->stop();
     }
-
-    delete m_infoTextDocument;
-    delete m_timeTextDocument;
 }
 
 JourneyGraphicsItem::JourneyGraphicsItem( PublicTransportWidget* publicTransportWidget,
@@ -576,15 +485,13 @@ JourneyGraphicsItem::JourneyGraphicsItem( PublicTransportWidget* publicTransport
         : PublicTransportGraphicsItem( publicTransportWidget, parent, copyStopToClipboardAction,
                                        showInMapAction
         /*, toggleAlarmAction*/ ),
-        m_infoTextDocument(0), m_routeItem(0),
-        m_requestJourneyToStopAction(requestJourneyToStopAction),
+        m_routeItem(0), m_requestJourneyToStopAction(requestJourneyToStopAction),
         m_requestJourneyFromStopAction(requestJourneyFromStopAction)
 {
 }
 
 JourneyGraphicsItem::~JourneyGraphicsItem()
 {
-    delete m_infoTextDocument;
 }
 
 void DepartureGraphicsItem::setLeavingStep( qreal leavingStep )
@@ -607,37 +514,31 @@ void DepartureGraphicsItem::updateTextLayouts()
     textOption.setWrapMode( m_parent->maxLineCount() == 1
             ? QTextOption::NoWrap : QTextOption::WordWrap );
 
-    // Update text layouts
-    if ( !m_timeTextDocument || (m_timeTextDocument->pageSize() != _timeRect.size()) ) {
-        delete m_timeTextDocument;
-        textOption.setAlignment( Qt::AlignVCenter | Qt::AlignRight );
-        m_timeTextDocument = TextDocumentHelper::createTextDocument(
-                index().model()->index(index().row(), 2).data(FormattedTextRole).toString(),
-                _timeRect.size(), textOption, font() );
-    }
+    // Update text layouts, unchanged texts are found in the cache
+    textOption.setAlignment( Qt::AlignVCenter | Qt::AlignRight );
+    m_timeTextDocument = TextDocumentHelper::cachedTextDocument(
+            index().model()->index(index().row(), 2).data(FormattedTextRole).toString(),
+            _timeRect.size(), textOption, font() );
 
     const qreal timeWidth = timeColumnWidth();
     const QRectF _infoRect = infoRect( rect, timeWidth );
 
-    // Create layout for the main column showing information about the departure
-    if ( !m_infoTextDocument || (m_infoTextDocument->pageSize() != _infoRect.size()) ) {
-        delete m_infoTextDocument;
-        textOption.setAlignment( Qt::AlignVCenter | Qt::AlignLeft );
-        QString html;
-        const DepartureInfo *info = departureItem()->departureInfo();
-        TimetableWidget *timetableWidget = qobject_cast<TimetableWidget*>( m_parent );
-        if ( timetableWidget->isTargetHidden() ) {
-            html = i18nc("@info", "<emphasis strong='1'>%1</emphasis>", info->lineString());
-        } else if ( departureItem()->model()->info().departureArrivalListType == ArrivalList ) {
-            html = i18nc("@info", "<emphasis strong='1'>%1</emphasis> from %2",
-                         info->lineString(), info->targetShortened());
-        } else { // if ( departureItem()->model()->info().departureArrivalListType == DepartureList ) {
-            html = i18nc("@info", "<emphasis strong='1'>%1</emphasis> to %2",
-                         info->lineString(), info->targetShortened());
-        }
-        m_infoTextDocument = TextDocumentHelper::createTextDocument( html, _infoRect.size(),
-                                                                     textOption, font() );
+    // Get layout for the main column showing information about the departure
+    textOption.setAlignment( Qt::AlignVCenter | Qt::AlignLeft );
+    QString html;
+    const DepartureInfo *info = departureItem()->departureInfo();
+    TimetableWidget *timetableWidget = qobject_cast<TimetableWidget*>( m_parent );
+    if ( timetableWidget->isTargetHidden() ) {
+        html = i18nc("@info", "<emphasis strong='1'>%1</emphasis>", info->lineString());
+    } else if ( departureItem()->model()->info().departureArrivalListType == ArrivalList ) {
+        html = i18nc("@info", "<emphasis strong='1'>%1</emphasis> from %2",
+                     info->lineString(), info->targetShortened());
+    } else { // if ( departureItem()->model()->info().departureArrivalListType == DepartureList ) {
+        html = i18nc("@info", "<emphasis strong='1'>%1</emphasis> to %2",
+                     info->lineString(), info->targetShortened());
     }
+    m_infoTextDocument = TextDocumentHelper::cachedTextDocument( html, _infoRect.size(),
+                                                                 textOption, font() );
 }
 
 void JourneyGraphicsItem::updateTextLayouts()
@@ -651,50 +552,44 @@ void JourneyGraphicsItem::updateTextLayouts()
     textOption.setWrapMode( m_parent->maxLineCount() == 1
             ? QTextOption::NoWrap : QTextOption::ManualWrap );
 
-    // Create layout for the main column showing information about the departure
+    // Get layout for the main column showing information about the journey
     const QRectF _infoRect = infoRect( rect/*, departureTimeWidth, arrivalTimeWidth*/ );
-    if ( !m_infoTextDocument || (m_infoTextDocument->pageSize() != _infoRect.size()) ) {
-        delete m_infoTextDocument;
-        textOption.setAlignment( Qt::AlignVCenter | Qt::AlignLeft );
-        QString html;
-        const JourneyInfo *info = journeyItem()->journeyInfo();
-        if ( m_parent->maxLineCount() == 1 ) {
-            // Single line string
-            html = i18nc("@info", "<emphasis strong='1'>Duration:</emphasis> %1, "
-                         "<emphasis strong='1'>Changes:</emphasis> %2",
-                         KGlobal::locale()->formatDuration(info->duration()*60*1000),
-                         ((info->changes() == 0
-                         ? i18nc("@info No vehicle changes in a journey", "none")
-                         : QString::number(info->changes()))));
-        } else {
-            // Two (or more) line string
-            html = i18nc("@info", "<emphasis strong='1'>Duration:</emphasis> %1, "
-                         "<emphasis strong='1'>Changes:</emphasis> %2<nl />"
-                         "<emphasis strong='1'>Departing:</emphasis> %3, "
-                         "<emphasis strong='1'>Arriving:</emphasis> %4",
-                          KGlobal::locale()->formatDuration(info->duration()*60*1000),
-                         (info->changes() == 0
-                         ? i18nc("@info No vehicle changes in a journey", "none")
-                         : QString::number(info->changes())),
-                         KGlobal::locale()->formatDateTime(info->departure(), KLocale::FancyShortDate),
-                         KGlobal::locale()->formatDateTime(info->arrival(), KLocale::FancyShortDate));
-        }
-        m_infoTextDocument = TextDocumentHelper::createTextDocument( html, _infoRect.size(),
-                                                                     textOption, font() );
+    textOption.setAlignment( Qt::AlignVCenter | Qt::AlignLeft );
+    QString html;
+    const JourneyInfo *info = journeyItem()->journeyInfo();
+    if ( m_parent->maxLineCount() == 1 ) {
+        // Single line string
+        html = i18nc("@info", "<emphasis strong='1'>Duration:</emphasis> %1, "
+                     "<emphasis strong='1'>Changes:</emphasis> %2",
+                     KGlobal::locale()->formatDuration(info->duration()*60*1000),
+                     ((info->changes() == 0
+                     ? i18nc("@info No vehicle changes in a journey", "none")
+                     : QString::number(info->changes()))));
+    } else {
+        // Two (or more) line string
+        html = i18nc("@info", "<emphasis strong='1'>Duration:</emphasis> %1, "
+                     "<emphasis strong='1'>Changes:</emphasis> %2<nl />"
+                     "<emphasis strong='1'>Departing:</emphasis> %3, "
+                     "<emphasis strong='1'>Arriving:</emphasis> %4",
+                      KGlobal::locale()->formatDuration(info->duration()*60*1000),
+                     (info->changes() == 0
+                     ? i18nc("@info No vehicle changes in a journey", "none")
+                     : QString::number(info->changes())),
+                     KGlobal::locale()->formatDateTime(info->departure(), KLocale::FancyShortDate),
+                     KGlobal::locale()->formatDateTime(info->arrival(), KLocale::FancyShortDate));
     }
+    m_infoTextDocument = TextDocumentHelper::cachedTextDocument( html, _infoRect.size(),
+                                                                 textOption, font() );
 }
 
-void JourneyGraphicsItem::updateData( JourneyItem* item, bool updateLayouts )
+void JourneyGraphicsItem::updateData( JourneyItem* item )
 {
     m_item = item;
     setAcceptHoverEvents( true );
     updateGeometry();
 
-    if ( updateLayouts ) {
-        delete m_infoTextDocument;
-        m_infoTextDocument = 0;
-    }
-    updateTextLayouts();
+    // Texts get laid out for all updated items at once, the old layouts get used until then
+    invalidateTextLayouts();
 
     if ( !item->journeyInfo()->routeStopsShortened().isEmpty() ) {
         if ( m_routeItem ) {
@@ -718,18 +613,13 @@ void JourneyGraphicsItem::updateData( JourneyItem* item, bool updateLayouts )
     update();
 }
 
-void DepartureGraphicsItem::updateData( DepartureItem* item, bool updateLayouts )
+void DepartureGraphicsItem::updateData( DepartureItem* item )
 {
     m_item = item;
     updateGeometry();
 
-    if ( updateLayouts ) {
-        delete m_infoTextDocument;
-        delete m_timeTextDocument;
-        m_infoTextDocument = 0;
-        m_timeTextDocument = 0;
-    }
-    updateTextLayouts();
+    // Texts get laid out for all updated items at once, the old layouts get used until then
+    invalidateTextLayouts();
 
     if ( !item->departureInfo()->routeStopsShortened().isEmpty() ) {
         if ( m_routeItem ) {
@@ -757,7 +647,12 @@ void DepartureGraphicsItem::updateData( DepartureItem* item, bool updateLayouts
         m_routeItem = 0;
     }
 
-    if ( item->isLeavingSoon() && !m_leavingAnimation ) {
+    if ( !item->isLeavingSoon() && m_leavingAnimation ) {
+        // This item was reused for another departure
+        m_leavingAnimation->stop();
+        m_leavingAnimation = 0;
+        setLeavingStep( 0.0 );
+    } else if ( item->isLeavingSoon() && !m_leavingAnimation ) {
         m_leavingAnimation = new QPropertyAnimation( this, "leavingStep", this );
         m_leavingAnimation->setStartValue( 0.0 );
         m_leavingAnimation->setKeyValueAt( 0.5, 0.5 );
@@ -773,7 +668,7 @@ void DepartureGraphicsItem::updateData( DepartureItem* item, bool updateLayouts
 
 qreal DepartureGraphicsItem::timeColumnWidth() const
 {
-    qreal width = TextDocumentHelper::textDocumentWidth( m_timeTextDocument );
+    qreal width = TextDocumentHelper::textDocumentWidth( m_timeTextDocument.data() );
 
     QRectF rect = contentsRect();
     if ( qobject_cast<TimetableWidget*>(m_parent)->isTargetHidden() ) {
@@ -902,7 +797,6 @@ void JourneyGraphicsItem::paintItem( QPainter* painter, const QStyleOptionGraphi
     qreal x = shadowWidth;
     qreal y = shadowWidth;
     QSizeF iconSize( vehicleSize - 2 * shadowWidth, vehicleSize - 2 * shadowWidth );
-    m_parent->svg()->resize( iconSize );
 
     // Draw the vehicle type icons
     for ( int i = 0; i < vehicleTypes.count(); ++i ) {
@@ -917,34 +811,16 @@ void JourneyGraphicsItem::paintItem( QPainter* painter, const QStyleOptionGraphi
             y += vehicleOffsetY;
         }
 
-        QString vehicleKey;
-        switch ( vehicleType ) {
-            case Tram: vehicleKey = "tram"; break;
-            case Bus: vehicleKey = "bus"; break;
-            case TrolleyBus: vehicleKey = "trolleybus"; break;
-            case Subway: vehicleKey = "subway"; break;
-            case Metro: vehicleKey = "metro"; break;
-            case InterurbanTrain: vehicleKey = "interurbantrain"; break;
-            case RegionalTrain: vehicleKey = "regionaltrain"; break;
-            case RegionalExpressTrain: vehicleKey = "regionalexpresstrain"; break;
-            case InterregionalTrain: vehicleKey = "interregionaltrain"; break;
-            case IntercityTrain: vehicleKey = "intercitytrain"; break;
-            case HighSpeedTrain: vehicleKey = "highspeedtrain"; break;
-            case Feet: vehicleKey = "feet"; break;
-            case Ship: vehicleKey = "ship"; break;
-            case Plane: vehicleKey = "plane"; break;
-            default:
-                kDebug() << "Unknown vehicle type" << vehicleType;
-                painter->drawEllipse( QRectF(x, y, iconSize.width(), iconSize.height())
-                                    .adjusted(5, 5, -5, -5) );
-                painter->drawText( QRectF(x, y, iconSize.width(), iconSize.height()),
-                                "?", QTextOption(Qt::AlignCenter) );
-        }
-        if ( !m_parent->svg()->hasElement(vehicleKey) ) {
-            kDebug() << "SVG element" << vehicleKey << "not found";
+        if ( VehicleIconAtlas::elementId(vehicleType).isEmpty() ) {
+            kDebug() << "Unknown vehicle type" << vehicleType;
+            painter->drawEllipse( QRectF(x, y, iconSize.width(), iconSize.height())
+                                .adjusted(5, 5, -5, -5) );
+            painter->drawText( QRectF(x, y, iconSize.width(), iconSize.height()),
+                            "?", QTextOption(Qt::AlignCenter) );
         } else {
-            // Draw SVG vehicle element into pixmap
-            m_parent->svg()->paint( &p, x, y, vehicleKey );
+            // Draw the vehicle icon from the shared icon atlas into the pixmap
+            p.drawPixmap( QPointF(x, y), VehicleIconAtlas::self()->icon(
+                    m_parent->vehicleIconSvgId(), vehicleType, iconSize.toSize()) );
         }
 
         ++vehiclesInCurrentRow;
@@ -977,7 +853,7 @@ void JourneyGraphicsItem::paintItem( QPainter* painter, const QStyleOptionGraphi
     const bool drawShadowsOrHalos = m_parent->isOptionEnabled( PublicTransportWidget::DrawShadowsOrHalos );
     const bool drawHalos = drawShadowsOrHalos && qGray(_textColor.rgb()) < 192;
     painter->setPen( _textColor );
-    TextDocumentHelper::drawTextDocument( painter, option, m_infoTextDocument,
+    TextDocumentHelper::drawTextDocument( painter, option, m_infoTextDocument.data(),
             _infoRect.toRect(), drawShadowsOrHalos
             ? (drawHalos ? TextDocumentHelper::DrawHalos : TextDocumentHelper::DrawShadows)
             : TextDocumentHelper::DoNotDrawShadowOrHalos );
@@ -1138,75 +1014,22 @@ void DepartureGraphicsItem::paintItem( QPainter* painter, const QStyleOptionGrap
     const qreal timeWidth = timeColumnWidth();
     const QRectF _infoRect = infoRect( rect, timeWidth );
 
-    int shadowWidth = 4;
-    QSizeF iconSize( _vehicleRect.width() - 2 * shadowWidth, _vehicleRect.height() - 2 * shadowWidth );
-    QString vehicleKey;
-    switch ( departureItem()->departureInfo()->vehicleType() ) {
-        case Tram: vehicleKey = "tram"; break;
-        case Bus: vehicleKey = "bus"; break;
-        case TrolleyBus: vehicleKey = "trolleybus"; break;
-        case Subway: vehicleKey = "subway"; break;
-        case Metro: vehicleKey = "metro"; break;
-        case InterurbanTrain: vehicleKey = "interurbantrain"; break;
-        case RegionalTrain: vehicleKey = "regionaltrain"; break;
-        case RegionalExpressTrain: vehicleKey = "regionalexpresstrain"; break;
-        case InterregionalTrain: vehicleKey = "interregionaltrain"; break;
-        case IntercityTrain: vehicleKey = "intercitytrain"; break;
-        case HighSpeedTrain: vehicleKey = "highspeedtrain"; break;
-        case Feet: vehicleKey = "feet"; break;
-        case Ship: vehicleKey = "ship"; break;
-        case Plane: vehicleKey = "plane"; break;
-        default:
-            kDebug() << "Unknown vehicle type" << departureItem()->departureInfo()->vehicleType();
-            painter->setPen( _textColor );
-            painter->setBrush( _backgroundColor );
-            painter->drawEllipse( QRectF(shadowWidth, shadowWidth, iconSize.width(), iconSize.height())
-                                .adjusted(2, 2, -2, -2) );
-            painter->drawText( QRectF(shadowWidth, shadowWidth, iconSize.width(), iconSize.height()),
-                            "?", QTextOption(Qt::AlignCenter) );
-    }
-
-    const QString vehicleCacheKey
-            = vehicleKey + QString("%1%2").arg( iconSize.width() ).arg( iconSize.height() );
-    QPixmap vehiclePixmap;
-    if ( !m_pixmapCache || !m_pixmapCache->find(vehicleCacheKey, vehiclePixmap) ) {
-        if ( !m_parent->svg()->hasElement(vehicleKey) ) {
-            if ( !vehicleKey.isEmpty() ) {
-                kDebug() << "SVG element" << vehicleKey << "not found";
-            }
-        } else {
-            // Draw SVG vehicle element into pixmap
-            QPixmap pixmap( (int)_vehicleRect.width(), (int)_vehicleRect.height() );
-            pixmap.fill( Qt::transparent );
-            QPainter p( &pixmap );
-            m_parent->svg()->resize( iconSize );
-            m_parent->svg()->paint( &p, shadowWidth, shadowWidth, vehicleKey );
-
-            vehiclePixmap = QPixmap( pixmap.size() );
-            vehiclePixmap.fill( Qt::transparent );
-            QPainter p2( &vehiclePixmap );
-
-            // Create shadow for the SVG element and draw the SVG and it's shadow.
-            QImage shadow = pixmap.toImage();
-            Plasma::PaintUtils::shadowBlur( shadow, shadowWidth - 1, Qt::black );
-            p2.drawImage( QPoint(1, 2), shadow );
-            p2.drawPixmap( QPoint(0, 0), pixmap );
-
-            // Make startTransitionPixmap more transparent (for fading)
-            p2.setCompositionMode( QPainter::CompositionMode_DestinationIn );
-            QLinearGradient gradient( pixmap.width() / 4, 0, pixmap.width(), 0 );
-            gradient.setColorAt( 0.0, Qt::black );
-            gradient.setColorAt( 1.0, Qt::transparent );
-            p2.fillRect( vehiclePixmap.rect(), QBrush(gradient) );
-            p2.end();
-
-            if ( m_pixmapCache ) {
-                m_pixmapCache->insert( vehicleCacheKey, vehiclePixmap );
-            }
-        }
-    }
-    if ( !vehicleKey.isEmpty() ) {
+    // Draw the vehicle type icon, rendered by the icon atlas shared by all applets
+    const VehicleType vehicleType = departureItem()->departureInfo()->vehicleType();
+    const QPixmap vehiclePixmap = VehicleIconAtlas::self()->icon( m_parent->vehicleIconSvgId(),
+            vehicleType, QSize(int(_vehicleRect.width()), int(_vehicleRect.height())),
+            VehicleIconAtlas::ShadowedIcon | VehicleIconAtlas::FadedIcon );
+    if ( !vehiclePixmap.isNull() ) {
         painter->drawPixmap( _vehicleRect.topLeft(), vehiclePixmap );
+    } else if ( VehicleIconAtlas::elementId(vehicleType).isEmpty() ) {
+        kDebug() << "Unknown vehicle type" << vehicleType;
+        const int shadowWidth = VehicleIconAtlas::SHADOW_WIDTH;
+        const QRectF iconRect = _vehicleRect.adjusted( shadowWidth, shadowWidth,
+                                                       -shadowWidth, -shadowWidth );
+        painter->setPen( _textColor );
+        painter->setBrush( _backgroundColor );
+        painter->drawEllipse( iconRect.adjusted(2, 2, -2, -2) );
+        painter->drawText( iconRect, "?", QTextOption(Qt::AlignCenter) );
     }
 
     // Draw text
@@ -1224,20 +1047,20 @@ void DepartureGraphicsItem::paintItem( QPainter* painter, const QStyleOptionGrap
     }
 
     if ( m_highlighted != manuallyHighlighted ) {
+        // Cached documents are shared, get documents for the changed font
         QFont _font = font();
         _font.setItalic( manuallyHighlighted );
-        m_infoTextDocument->setDefaultFont( _font );
-        m_timeTextDocument->setDefaultFont( _font );
         setFont( _font );
         m_highlighted = manuallyHighlighted;
+        updateTextLayouts();
     }
 
     TextDocumentHelper::Option options = drawShadowsOrHalos
             ? (drawHalos ? TextDocumentHelper::DrawHalos : TextDocumentHelper::DrawShadows)
             : TextDocumentHelper::DoNotDrawShadowOrHalos;
-    TextDocumentHelper::drawTextDocument( painter, option, m_infoTextDocument,
+    TextDocumentHelper::drawTextDocument( painter, option, m_infoTextDocument.data(),
             _infoRect.toRect(), options );
-    TextDocumentHelper::drawTextDocument( painter, option, m_timeTextDocument,
+    TextDocumentHelper::drawTextDocument( painter, option, m_timeTextDocument.data(),
             _timeRect.toRect(), options );
 
     // Draw extra icon(s), eg. an alarm icon or an indicator for additional news for a journey
@@ -1518,7 +1341,9 @@ QSizeF PublicTransportWidget::sizeHint(Qt::SizeHint which, const QSizeF& constra
 
 PublicTransportWidget::PublicTransportWidget( Options options, QGraphicsItem* parent )
     : Plasma::ScrollWidget( parent ), m_options(options), m_model(0), m_prefixItem(0),
-      m_postfixItem(0), m_svg(0), m_copyStopToClipboardAction(0), m_showInMapAction(0)
+      m_postfixItem(0), m_rowArea(0), m_rowLayoutScheduled(false), m_textLayoutScheduled(false),
+      m_svg(0),
+      m_vehicleIconSvgId(-1), m_copyStopToClipboardAction(0), m_showInMapAction(0)
 {
     setHorizontalScrollBarPolicy( Qt::ScrollBarAlwaysOff );
     setupActions();
@@ -1530,11 +1355,31 @@ PublicTransportWidget::PublicTransportWidget( Options options, QGraphicsItem* pa
     setWidget( container );
     setFlag( ItemClipsChildrenToShape );
 
+    // Row items get positioned in layoutRows(), the height of the row area is the sum of all
+    // row heights, also of rows without an item
+    m_rowArea = new QGraphicsWidget( container );
+    m_rowArea->setMinimumHeight( 0.0 );
+    m_rowArea->setMaximumHeight( 0.0 );
+    l->addItem( m_rowArea );
+
+    // Update items when scrolling (the container gets moved) or when the size changes
+    connect( container, SIGNAL(yChanged()), this, SLOT(scheduleRowLayout()) );
+    connect( m_rowArea, SIGNAL(yChanged()), this, SLOT(scheduleRowLayout()) );
+    connect( m_rowArea, SIGNAL(widthChanged()), this, SLOT(scheduleRowLayout()) );
+    connect( this, SIGNAL(viewportGeometryChanged(QRectF)), this, SLOT(scheduleRowLayout()) );
+
     m_maxLineCount = 2;
     m_iconSize = 32;
     m_zoomFactor = 1.0;
 }
 
+void PublicTransportWidget::setSvg( Plasma::Svg *svg )
+{
+    m_svg = svg;
+    m_vehicleIconSvgId = VehicleIconAtlas::self()->registerSvg( svg->imagePath() );
+    update();
+}
+
 void PublicTransportWidget::setupActions()
 {
     m_copyStopToClipboardAction = new StopAction( StopAction::CopyStopNameToClipboard, this );
@@ -1624,17 +1469,12 @@ JourneyTimetableWidget::JourneyTimetableWidget( Options options, Flags flags,
 
 TimetableWidget::TimetableWidget( Options options, QGraphicsItem* parent )
     : PublicTransportWidget(options, parent), m_showDeparturesAction(0), m_highlightStopAction(0),
-      m_newFilterViaStopAction(0), m_pixmapCache(new KPixmapCache("PublicTransportVehicleIcons"))
+      m_newFilterViaStopAction(0)
 {
     m_targetHidden = false;
     setupActions();
 }
 
-TimetableWidget::~TimetableWidget()
-{
-    delete m_pixmapCache;
-}
-
 void TimetableWidget::setupActions()
 {
     PublicTransportWidget::setupActions();
@@ -1691,22 +1531,52 @@ void PublicTransportWidget::setModel( PublicTransportModel* model )
 
 PublicTransportGraphicsItem* PublicTransportWidget::item( const QModelIndex& index )
 {
-    foreach ( PublicTransportGraphicsItem *item, m_items ) {
-        if ( item->index() == index ) {
-            return item;
-        }
+    return index.isValid() ? item( index.row() ) : 0;
+}
+
+bool PublicTransportWidget::isRowExpanded( int row ) const
+{
+    if ( row < 0 || row >= m_items.count() ) {
+        return false;
+    }
+    return m_items[row] ? m_items[row]->isExpanded()
+                        : m_expandedItems.contains(m_model->item(row));
+}
+
+void PublicTransportWidget::setRowExpanded( int row, bool expanded )
+{
+    if ( row < 0 || row >= m_items.count() ) {
+        kDebug() << "Invalid row" << row;
+        return;
     }
 
-    return 0;
+    if ( m_items[row] ) {
+        // The item stores the expanded state in itemExpandedStateChanged()
+        m_items[row]->setExpanded( expanded );
+        return;
+    }
+
+    // Store the state for the item that gets created when the row gets visible,
+    // the height of the row is unknown until then
+    const ItemBase *modelItem = m_model->item( row );
+    if ( expanded ) {
+        m_expandedItems.insert( modelItem );
+    } else {
+        m_expandedItems.remove( modelItem );
+    }
+    m_rowHeights[row] = -1.0;
+    scheduleRowLayout();
 }
 
 void PublicTransportWidget::setZoomFactor( qreal zoomFactor )
 {
     m_zoomFactor = zoomFactor;
 
-    for ( int i = 0; i < m_items.count(); ++i ) {
-        // Notify children about changed settings
-        m_items[i]->updateSettings();
+    // Notify children about changed settings, reused items get notified in acquireItem()
+    foreach ( PublicTransportGraphicsItem *item, m_items ) {
+        if ( item ) {
+            item->updateSettings();
+        }
     }
     updateGeometry();
     updateItemGeometries();
@@ -1751,131 +1621,296 @@ void PublicTransportWidget::paint( QPainter* painter, const QStyleOptionGraphics
 
 void PublicTransportWidget::updateItemLayouts()
 {
+    // Unused items get updated in acquireItem()
     foreach ( PublicTransportGraphicsItem *item, m_items ) {
-        item->updateTextLayouts();
+        if ( item ) {
+            item->invalidateTextLayouts();
+        }
     }
 }
 
 void PublicTransportWidget::updateItemGeometries()
 {
     foreach ( PublicTransportGraphicsItem *item, m_items ) {
-        item->updateGeometry();
+        if ( item ) {
+            item->updateGeometry();
+        }
     }
+
+    // Estimated heights of rows without an item may have changed
+    scheduleRowLayout();
 }
 
 void PublicTransportWidget::modelReset()
 {
-    qDeleteAll( m_items );
+    // Keep items for reuse
+    for ( int row = 0; row < m_items.count(); ++row ) {
+        releaseItem( row );
+    }
+    const QList< QPair<int, PublicTransportGraphicsItem*> > removedItems = m_removedItems;
+    m_removedItems.clear();
+    for ( int i = 0; i < removedItems.count(); ++i ) {
+        delete removedItems[i].second;
+    }
+
     m_items.clear();
+    m_rowHeights.clear();
+    m_expandedItems.clear();
+    for ( int row = 0; row < m_model->rowCount(); ++row ) {
+        m_items << 0;
+        m_rowHeights << -1.0;
+    }
+    scheduleRowLayout();
 }
 
-void TimetableWidget::dataChanged( const QModelIndex& topLeft, const QModelIndex& bottomRight )
+void PublicTransportWidget::dataChanged( const QModelIndex& topLeft,
+                                         const QModelIndex& bottomRight )
 {
     if ( !topLeft.isValid() || !bottomRight.isValid() ) {
         return;
     }
-    for ( int row = topLeft.row(); row <= bottomRight.row() && row < m_model->rowCount(); ++row ) {
-        departureItem( row )->updateData( static_cast<DepartureItem*>(m_model->item(row)), true );
+
+    // Rows without an item get updated when they get visible, see acquireItem()
+    for ( int row = topLeft.row(); row <= bottomRight.row() && row < m_items.count(); ++row ) {
+        if ( m_items[row] ) {
+            updateItem( m_items[row], row );
+        }
     }
 }
 
-void JourneyTimetableWidget::dataChanged( const QModelIndex& topLeft, const QModelIndex& bottomRight )
+qreal PublicTransportWidget::rowHeight( int row ) const
 {
-    if ( !topLeft.isValid() || !bottomRight.isValid() ) {
-        return;
+    return m_items[row] ? m_items[row]->sizeHint(Qt::MinimumSize).height()
+            : (m_rowHeights[row] < 0.0 ? unexpandedItemHeight() : m_rowHeights[row]);
+}
+
+PublicTransportGraphicsItem *PublicTransportWidget::acquireItem( int row )
+{
+    PublicTransportGraphicsItem *item;
+    if ( m_itemPool.isEmpty() ) {
+        item = createItem();
+        connect( item, SIGNAL(expandedStateChanged(PublicTransportGraphicsItem*,bool)),
+                 this, SLOT(itemExpandedStateChanged(PublicTransportGraphicsItem*,bool)) );
+    } else {
+        item = m_itemPool.takeLast();
+        item->updateSettings();
     }
-    for ( int row = topLeft.row(); row <= bottomRight.row() && row < m_model->rowCount(); ++row ) {
-        journeyItem( row )->updateData( static_cast<JourneyItem*>(m_model->item(row)), true );
+
+    updateItem( item, row );
+    item->resetState( m_expandedItems.contains(m_model->item(row)) );
+    item->show();
+    m_items[row] = item;
+    return item;
+}
+
+void PublicTransportWidget::releaseItem( int row )
+{
+    PublicTransportGraphicsItem *item = m_items[row];
+    if ( !item ) {
+        return;
     }
+
+    // Remember the height of expanded rows, unexpanded rows use unexpandedItemHeight()
+    m_rowHeights[row] = item->isExpanded() ? item->sizeHint(Qt::MinimumSize).height() : -1.0;
+    m_items[row] = 0;
+    item->hide();
+    m_itemPool << item;
 }
 
-void PublicTransportWidget::layoutChanged()
+void PublicTransportWidget::scheduleRowLayout()
 {
+    if ( !m_rowLayoutScheduled ) {
+        m_rowLayoutScheduled = true;
+        QMetaObject::invokeMethod( this, "layoutRows", Qt::QueuedConnection );
+    }
+}
 
+void PublicTransportWidget::scheduleTextLayout()
+{
+    if ( !m_textLayoutScheduled ) {
+        m_textLayoutScheduled = true;
+        QMetaObject::invokeMethod( this, "layoutTexts", Qt::QueuedConnection );
+    }
 }
 
-void JourneyTimetableWidget::rowsInserted( const QModelIndex& parent, int first, int last )
+void PublicTransportWidget::layoutTexts()
 {
-    if ( parent.isValid() ) {
-        kDebug() << "Item with parent" << parent << "Inserted" << first << last;
-        return;
+    m_textLayoutScheduled = false;
+
+    // Items in the pool get updated when they get reused, see acquireItem()
+    foreach ( PublicTransportGraphicsItem *item, m_items ) {
+        if ( item ) {
+            item->updateTextLayoutsIfDirty();
+        }
     }
+}
 
-    QGraphicsLinearLayout *l = static_cast<QGraphicsLinearLayout*>( widget()->layout() );
-    const int prefixOffset = m_prefixItem ? 1 : 0;
+void PublicTransportWidget::layoutRows()
+{
+    m_rowLayoutScheduled = false;
 
-    if ( m_items.isEmpty() ) {
-        setPrefixItem( m_prefixItem );
-        setPostfixItem( m_postfixItem );
+    // Get the visible part of the row area, extended by OVERSCAN_ROWS rows above and below
+    const qreal overscan = OVERSCAN_ROWS * unexpandedItemHeight();
+    const qreal visibleTop = -widget()->pos().y() - m_rowArea->pos().y() - overscan;
+    const qreal visibleBottom = visibleTop + viewportGeometry().height() + 2 * overscan;
+    const qreal width = m_rowArea->size().width();
+
+    qreal y = 0.0;
+    for ( int row = 0; row <= m_items.count(); ++row ) {
+        // Items of removed rows stay in place until their animation is finished
+        for ( int i = 0; i < m_removedItems.count(); ++i ) {
+            if ( m_removedItems[i].first == row ) {
+                PublicTransportGraphicsItem *item = m_removedItems[i].second;
+                const qreal height = item->sizeHint( Qt::MinimumSize ).height();
+                item->setGeometry( 0.0, y, width, height );
+                y += height;
+            }
+        }
+        if ( row == m_items.count() ) {
+            break;
+        }
+
+        const qreal height = rowHeight( row );
+        if ( y + height < visibleTop || y > visibleBottom ) {
+            releaseItem( row );
+            y += height;
+        } else {
+            PublicTransportGraphicsItem *item = m_items[row] ? m_items[row] : acquireItem( row );
+            const qreal itemHeight = item->sizeHint( Qt::MinimumSize ).height();
+            item->setGeometry( 0.0, y, width, itemHeight );
+            y += itemHeight;
+        }
     }
 
-    for ( int row = first; row <= last; ++row ) {
-        JourneyGraphicsItem *item = new JourneyGraphicsItem( this, widget(),
-                m_copyStopToClipboardAction, m_showInMapAction,
-                m_requestJourneyToStopAction, m_requestJourneyFromStopAction );
-        item->updateData( static_cast<JourneyItem*>(m_model->item(row)) );
-        connect( item, SIGNAL(requestAlarmCreation(QDateTime,QString,VehicleType,QString,QGraphicsWidget*)),
-                 this, SIGNAL(requestAlarmCreation(QDateTime,QString,VehicleType,QString,QGraphicsWidget*)) );
-        connect( item, SIGNAL(requestAlarmDeletion(QDateTime,QString,VehicleType,QString,QGraphicsWidget*)),
-                 this, SIGNAL(requestAlarmDeletion(QDateTime,QString,VehicleType,QString,QGraphicsWidget*)) );
-        connect( item, SIGNAL(expandedStateChanged(PublicTransportGraphicsItem*,bool)),
-                 this, SIGNAL(expandedStateChanged(PublicTransportGraphicsItem*,bool)) );
-        m_items.insert( row, item );
+    if ( !qFuzzyCompare(m_rowArea->maximumHeight() + 1.0, y + 1.0) ) {
+        m_rowArea->setMinimumHeight( y );
+        m_rowArea->setMaximumHeight( y );
+    }
+}
 
-        // Fade new items in
-        Plasma::Animation *fadeAnimation = Plasma::Animator::create(
-                Plasma::Animator::FadeAnimation, item );
-        fadeAnimation->setTargetWidget( item );
-        fadeAnimation->setProperty( "startOpacity", 0.0 );
-        fadeAnimation->setProperty( "targetOpacity", 1.0 );
-        fadeAnimation->start( QAbstractAnimation::DeleteWhenStopped );
+void PublicTransportWidget::itemExpandedStateChanged( PublicTransportGraphicsItem *item,
+                                                      bool expanded )
+{
+    // Store the expanded state in case the item gets reused for another row
+    const ItemBase *modelItem = item->m_item.data();
+    if ( modelItem ) {
+        if ( expanded ) {
+            m_expandedItems.insert( modelItem );
+        } else {
+            m_expandedItems.remove( modelItem );
+        }
+    }
 
-        l->insertItem( row + prefixOffset, item );
+    emit expandedStateChanged( item, expanded );
+}
+
+void PublicTransportWidget::removedItemDestroyed( QObject *item )
+{
+    for ( int i = 0; i < m_removedItems.count(); ++i ) {
+        if ( static_cast<QObject*>(m_removedItems[i].second) == item ) {
+            m_removedItems.removeAt( i );
+            scheduleRowLayout();
+            return;
+        }
     }
 }
 
-void TimetableWidget::rowsInserted( const QModelIndex& parent, int first, int last )
+void PublicTransportWidget::layoutChanged()
+{
+
+}
+
+void PublicTransportWidget::rowsInserted( const QModelIndex& parent, int first, int last )
 {
     if ( parent.isValid() ) {
         kDebug() << "Item with parent" << parent << "Inserted" << first << last;
         return;
     }
 
-    QGraphicsLinearLayout *l = static_cast<QGraphicsLinearLayout*>( widget()->layout() );
-    const int prefixOffset = m_prefixItem ? 1 : 0;
+    if ( m_items.isEmpty() ) {
+        if ( m_prefixItem ) {
+            setPrefixItem( m_prefixItem );
+        }
+        if ( m_postfixItem ) {
+            setPostfixItem( m_postfixItem );
+        }
+    }
+
+    // Items of removed rows below the inserted rows move down with their rows
+    const int count = last - first + 1;
+    for ( int i = 0; i < m_removedItems.count(); ++i ) {
+        if ( m_removedItems[i].first > first ) {
+            m_removedItems[i].first += count;
+        }
+    }
     for ( int row = first; row <= last; ++row ) {
-        DepartureGraphicsItem *item = new DepartureGraphicsItem( this, widget(),
-                m_copyStopToClipboardAction, m_showInMapAction, m_showDeparturesAction,
-                m_highlightStopAction, m_newFilterViaStopAction, m_pixmapCache );
-        item->updateData( static_cast<DepartureItem*>(m_model->item(row)) );
-        connect( item, SIGNAL(expandedStateChanged(PublicTransportGraphicsItem*,bool)),
-                 this, SIGNAL(expandedStateChanged(PublicTransportGraphicsItem*,bool)) );
-        m_items.insert( row, item );
+        m_items.insert( row, 0 );
+        m_rowHeights.insert( row, -1.0 );
+    }
+
+    // Create items for the new rows if they are visible and fade them in
+    layoutRows();
+    for ( int row = first; row <= last; ++row ) {
+        PublicTransportGraphicsItem *item = m_items[row];
+        if ( !item ) {
+            continue;
+        }
 
-        // Fade new items in
         Plasma::Animation *fadeAnimation = Plasma::Animator::create(
                 Plasma::Animator::FadeAnimation, item );
         fadeAnimation->setTargetWidget( item );
         fadeAnimation->setProperty( "startOpacity", 0.0 );
         fadeAnimation->setProperty( "targetOpacity", 1.0 );
         fadeAnimation->start( QAbstractAnimation::DeleteWhenStopped );
-
-        l->insertItem( row + prefixOffset, item );
     }
 }
 
+PublicTransportGraphicsItem *JourneyTimetableWidget::createItem()
+{
+    JourneyGraphicsItem *item = new JourneyGraphicsItem( this, m_rowArea,
+            m_copyStopToClipboardAction, m_showInMapAction,
+            m_requestJourneyToStopAction, m_requestJourneyFromStopAction );
+    connect( item, SIGNAL(requestAlarmCreation(QDateTime,QString,VehicleType,QString,QGraphicsWidget*)),
+             this, SIGNAL(requestAlarmCreation(QDateTime,QString,VehicleType,QString,QGraphicsWidget*)) );
+    connect( item, SIGNAL(requestAlarmDeletion(QDateTime,QString,VehicleType,QString,QGraphicsWidget*)),
+             this, SIGNAL(requestAlarmDeletion(QDateTime,QString,VehicleType,QString,QGraphicsWidget*)) );
+    return item;
+}
+
+void JourneyTimetableWidget::updateItem( PublicTransportGraphicsItem *item, int row )
+{
+    static_cast<JourneyGraphicsItem*>( item )->updateData(
+            static_cast<JourneyItem*>(m_model->item(row)) );
+}
+
+PublicTransportGraphicsItem *TimetableWidget::createItem()
+{
+    return new DepartureGraphicsItem( this, m_rowArea,
+            m_copyStopToClipboardAction, m_showInMapAction, m_showDeparturesAction,
+            m_highlightStopAction, m_newFilterViaStopAction );
+}
+
+void TimetableWidget::updateItem( PublicTransportGraphicsItem *item, int row )
+{
+    static_cast<DepartureGraphicsItem*>( item )->updateData(
+            static_cast<DepartureItem*>(m_model->item(row)) );
+}
+
 void PublicTransportWidget::itemsAboutToBeRemoved( const QList< ItemBase* >& items )
 {
     // Capture pixmaps for departures that will get removed
     // to be able to animate it's disappearance
     foreach ( const ItemBase *item, items ) {
+        m_expandedItems.remove( item );
         if ( item->row() >= m_items.count() ) {
             kDebug() << "Index out of bounds!";
             continue;
         }
 
         PublicTransportGraphicsItem *timetableItem = m_items[ item->row() ];
-        timetableItem->capturePixmap();
+        if ( timetableItem ) {
+            timetableItem->capturePixmap();
+        }
     }
 }
 
@@ -1891,11 +1926,26 @@ void PublicTransportWidget::rowsRemoved( const QModelIndex& parent, int first, i
         last = m_items.count() - 1;
     }
 
-    if ( first == 0 && last == m_items.count() - 1 ) {
-        // All items get removed, the shrink animations wouldn't be smooth
-        for ( int row = last; row >= first; --row ) {
-            PublicTransportGraphicsItem *item = m_items.takeAt( row );
+    // Items of other removed rows move up with their rows
+    for ( int i = 0; i < m_removedItems.count(); ++i ) {
+        int &row = m_removedItems[i].first;
+        row = row > last ? row - (last - first + 1) : qMin( row, first );
+    }
 
+    // Rows without an item are not visible and get removed without animation
+    const bool allRemoved = first == 0 && last == m_items.count() - 1;
+    for ( int row = last; row >= first; --row ) {
+        m_rowHeights.removeAt( row );
+        PublicTransportGraphicsItem *item = m_items.takeAt( row );
+        if ( !item ) {
+            continue;
+        }
+
+        // Keep the item in place until it gets deleted after the animation
+        m_removedItems << qMakePair( first, item );
+        connect( item, SIGNAL(destroyed(QObject*)), this, SLOT(removedItemDestroyed(QObject*)) );
+        if ( allRemoved ) {
+            // All items get removed, the shrink animations wouldn't be smooth
             // Fade old items out
             Plasma::Animation *fadeAnimation = Plasma::Animator::create(
                     Plasma::Animator::FadeAnimation, item );
@@ -1904,12 +1954,8 @@ void PublicTransportWidget::rowsRemoved( const QModelIndex& parent, int first, i
             fadeAnimation->setProperty( "targetOpacity", 0.0 );
             connect( fadeAnimation, SIGNAL(finished()), item, SLOT(deleteLater()) );
             fadeAnimation->start( QAbstractAnimation::DeleteWhenStopped );
-        }
-    } else {
-        // Only some items get removed, most probably they're currently departing
-        for ( int row = last; row >= first; --row ) {
-            PublicTransportGraphicsItem *item = m_items.takeAt( row );
-
+        } else {
+            // Only some items get removed, most probably they're currently departing
             // Shrink departing items
             QPropertyAnimation *shrinkAnimation = new QPropertyAnimation( item, "fadeOut" );
             shrinkAnimation->setEasingCurve( QEasingCurve(QEasingCurve::InOutQuart) );
@@ -1920,6 +1966,7 @@ void PublicTransportWidget::rowsRemoved( const QModelIndex& parent, int first, i
             shrinkAnimation->start( QAbstractAnimation::DeleteWhenStopped );
         }
     }
+    scheduleRowLayout();
 }
 
 QRectF JourneyGraphicsItem::vehicleRect(const QRectF& rect) const
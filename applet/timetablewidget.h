@@ -23,6 +23,7 @@
 // Own includes
 #include "stopaction.h" // for StopAction::Type
 #include "departuremodel.h"
+#include "textdocumenthelper.h"
 
 // Plasma includes
 #include <Plasma/ScrollWidget> // Base class
@@ -30,12 +31,13 @@
 // Qt includes
 #include <QGraphicsWidget> // Base class
 #include <QPointer> // Member variable
+#include <QSet> // Member variable
+#include <QSharedPointer> // Member variable
 
 /** @file
  * @brief This file contains the TimetableWidget / JourneyTimetableWidget and it's item classes.
  * @author Friedrich Pülz <fpuelz@gmx.de> */
 
-class KPixmapCache;
 namespace Plasma
 {
     class Svg;
@@ -46,6 +48,7 @@ class QWidget;
 class QStyleOptionGraphicsItem;
 class QPainter;
 class QTextOption;
+class QTextDocument;
 
 class RouteGraphicsItem;
 class JourneyRouteGraphicsItem;
@@ -312,33 +315,40 @@ protected:
     virtual void updateGeometry();
     virtual void updateTextLayouts() = 0;
     virtual QGraphicsWidget *routeItem() const = 0;
+
+    /**
+     * @brief Mark the text layouts of this item as outdated.
+     *
+     * The layouts of all outdated items get updated at once by PublicTransportWidget,
+     * when control returns to the event loop or when the item gets painted before.
+     **/
+    void invalidateTextLayouts();
+
+    /** @brief Call updateTextLayouts(), if invalidateTextLayouts() was called before. */
+    void updateTextLayoutsIfDirty();
+
     virtual void drawFadeOutLeftAndRight( QPainter *painter, const QRect &rect, int fadeWidth = 40 );
     virtual void drawAlarmBackground( QPainter *painter, const QRect &rect );
 
+    /**
+     * @brief Resets animation states, used when this item gets reused for another row.
+     *
+     * @param expanded Whether or not the item should be expanded, without animation.
+     **/
+    void resetState( bool expanded );
+
     QPointer<TopLevelItem> m_item;
     PublicTransportWidget *m_parent;
     bool m_expanded;
     qreal m_expandStep;
     qreal m_fadeOut;
+    bool m_textLayoutsDirty;
     QPropertyAnimation *m_resizeAnimation;
     QPixmap *m_pixmap;
     StopAction *m_copyStopToClipboardAction;
     StopAction *m_showInMapAction;
 };
 
-class TextDocumentHelper {
-public:
-    enum Option {
-        DoNotDrawShadowOrHalos, DrawShadows, DrawHalos, DefaultOption = DrawShadows
-    };
-
-    static QTextDocument *createTextDocument( const QString &html, const QSizeF &size,
-            const QTextOption &textOption, const QFont &font );
-    static void drawTextDocument( QPainter *painter, const QStyleOptionGraphicsItem* option,
-            QTextDocument *document, const QRect &textRect, Option options = DefaultOption );
-    static qreal textDocumentWidth( QTextDocument *document );
-};
-
 /**
  * @brief A QGraphicsWidget representing a departure/arrival with public transport.
  *
@@ -357,17 +367,17 @@ public:
                                     StopAction *showInMapAction = 0,
                                     StopAction *showDeparturesAction = 0,
                                     StopAction *highlightStopAction = 0,
-                                    StopAction *newFilterViaStopAction = 0,
-                                    KPixmapCache *pixmapCache = 0 );
+                                    StopAction *newFilterViaStopAction = 0 );
     virtual ~DepartureGraphicsItem();
 
     /**
      * @brief Updates this graphics item to visualize the given @p item.
      *
+     * Text layouts get updated in the next PublicTransportWidget::layoutTexts(), using cached
+     * documents for unchanged texts.
      * @param item The item with the new data.
-     * @param update Whether or not to update the layouts of the QTextDocuments. Default is false.
      **/
-    void updateData( DepartureItem* item, bool update = false );
+    void updateData( DepartureItem* item );
 
     /** @brief Notifies this item about changed settings in the parent PublicTransportWidget. */
     virtual void updateSettings();
@@ -376,7 +386,8 @@ public:
     inline DepartureItem *departureItem() const { return qobject_cast<DepartureItem*>(m_item); };
 
     /** @brief Whether or not this item is valid, ie. it has data for painting. */
-    virtual bool isValid() const { return m_infoTextDocument && m_timeTextDocument; };
+    virtual bool isValid() const {
+        return !m_infoTextDocument.isNull() && !m_timeTextDocument.isNull(); };
 
     /** @brief The size of the expand area. */
     virtual qreal expandAreaHeight() const;
@@ -470,8 +481,8 @@ protected:
     virtual QGraphicsWidget *routeItem() const;
 
 private:
-    QTextDocument *m_infoTextDocument;
-    QTextDocument *m_timeTextDocument;
+    QSharedPointer<QTextDocument> m_infoTextDocument; // Shared, see cachedTextDocument()
+    QSharedPointer<QTextDocument> m_timeTextDocument;
     RouteGraphicsItem *m_routeItem; // Pointer to the route item or 0 if no route data is available
     bool m_highlighted;
 
@@ -481,8 +492,6 @@ private:
     StopAction *m_showDeparturesAction;
     StopAction *m_highlightStopAction;
     StopAction *m_newFilterViaStopAction;
-
-    KPixmapCache *m_pixmapCache;
 };
 
 /**
@@ -507,10 +516,11 @@ public:
     /**
      * @brief Updates this graphics item to visualize the given @p item.
      *
+     * Text layouts get updated in the next PublicTransportWidget::layoutTexts(), using cached
+     * documents for unchanged texts.
      * @param item The item with the new data.
-     * @param update Whether or not to update the layout of the QTextDocument. Default is false.
      **/
-    void updateData( JourneyItem* item, bool update = false );
+    void updateData( JourneyItem* item );
 
     /** @brief Notifies this item about changed settings in the parent PublicTransportWidget. */
     virtual void updateSettings();
@@ -519,7 +529,7 @@ public:
     inline JourneyItem *journeyItem() const { return qobject_cast<JourneyItem*>(m_item); };
 
     /** @brief Whether or not this item is valid, ie. it has data for painting. */
-    virtual bool isValid() const { return m_infoTextDocument; };
+    virtual bool isValid() const { return !m_infoTextDocument.isNull(); };
 
     /** @brief The size of the expand area. */
     virtual qreal expandAreaHeight() const;
@@ -595,7 +605,7 @@ protected:
     virtual QGraphicsWidget *routeItem() const;
 
 private:
-    QTextDocument *m_infoTextDocument;
+    QSharedPointer<QTextDocument> m_infoTextDocument; // Shared, see cachedTextDocument()
     JourneyRouteGraphicsItem *m_routeItem; // Pointer to the route item or 0 if no route data is available
     StopAction *m_requestJourneyToStopAction;
     StopAction *m_requestJourneyFromStopAction;
@@ -603,6 +613,11 @@ private:
 
 /**
  * @brief Base class for TimetableWidget and JourneyTimetableWidget.
+ *
+ * Graphics items only get created for visible rows and OVERSCAN_ROWS rows above and below.
+ * Items of rows that get scrolled out of view are hidden and reused for other rows. The heights
+ * of rows without an item are estimated using unexpandedItemHeight(), for expanded rows the
+ * last known height gets used.
  **/
 class PublicTransportWidget : public Plasma::ScrollWidget
 {
@@ -620,6 +635,9 @@ public:
     };
     Q_DECLARE_FLAGS( Options, Option )
 
+    /** @brief Number of rows above and below the visible rows for which items get created. */
+    static const int OVERSCAN_ROWS = 3;
+
     PublicTransportWidget( Options options = DefaultOptions, QGraphicsItem* parent = 0 );
 
     /** @brief Gets the model containing the data for this widget. */
@@ -628,15 +646,36 @@ public:
     /** @brief Sets the model containing the data for this widget to @p model. */
     void setModel( PublicTransportModel *model );
 
-    /** @brief Gets the item at the given @p row. */
-    PublicTransportGraphicsItem *item( int row ) { return m_items[row]; };
+    /** @brief Gets the item at the given @p row or 0, if there is no item for @p row currently. */
+    PublicTransportGraphicsItem *item( int row ) { return m_items.value(row); };
 
-    /** @brief Gets the item with the given @p index. */
+    /** @brief Gets the item with the given @p index or 0, see item(int). */
     PublicTransportGraphicsItem *item( const QModelIndex &index );
 
-    void setSvg( Plasma::Svg *svg ) { m_svg = svg; };
+    /** @brief Whether or not @p row is expanded, also for rows without an item. */
+    bool isRowExpanded( int row ) const;
+
+    /**
+     * @brief Expand or collapse @p row, also if there is no item for @p row currently.
+     *
+     * The expanded state gets stored for the model item of @p row, an item that gets created
+     * or reused for the row later is expanded without animation, see acquireItem().
+     **/
+    void setRowExpanded( int row, bool expanded = true );
+
+    /** @brief Toggle the expanded state of @p row, see setRowExpanded(). */
+    void toggleRowExpanded( int row ) { setRowExpanded(row, !isRowExpanded(row)); };
+
+    /** @brief The height of unexpanded items, also used for rows without an item. */
+    qreal unexpandedItemHeight() const;
+
+    /** @brief Sets the SVG containing vehicle type elements, registered in VehicleIconAtlas. */
+    void setSvg( Plasma::Svg *svg );
     Plasma::Svg *svg() const { return m_svg; };
 
+    /** @brief The ID of svg() in VehicleIconAtlas, see VehicleIconAtlas::registerSvg(). */
+    int vehicleIconSvgId() const { return m_vehicleIconSvgId; };
+
     void setIconSize( qreal iconSize ) { m_iconSize = iconSize; updateItemLayouts(); };
     qreal iconSize() const { return m_maxLineCount == 1 ? m_iconSize * m_zoomFactor * 0.75
             : m_iconSize * m_zoomFactor; };
@@ -692,10 +731,26 @@ signals:
 
 protected slots:
     void itemsAboutToBeRemoved( const QList<ItemBase*> &journeys );
+    virtual void rowsInserted( const QModelIndex &parent, int first, int last );
     virtual void rowsRemoved( const QModelIndex &parent, int first, int last );
     virtual void modelReset();
     virtual void layoutChanged();
-    virtual void dataChanged( const QModelIndex &topLeft, const QModelIndex &bottomRight ) = 0;
+    virtual void dataChanged( const QModelIndex &topLeft, const QModelIndex &bottomRight );
+
+    /** @brief Position items of visible rows, create/reuse items for rows getting visible. */
+    void layoutRows();
+
+    /** @brief Call layoutRows() when control returns to the event loop. */
+    void scheduleRowLayout();
+
+    /** @brief Update outdated text layouts of all items with a row at once. */
+    void layoutTexts();
+
+    /** @brief Call layoutTexts() when control returns to the event loop. */
+    void scheduleTextLayout();
+
+    void itemExpandedStateChanged( PublicTransportGraphicsItem *item, bool expanded );
+    void removedItemDestroyed( QObject *item );
 
 protected:
     virtual QSizeF sizeHint( Qt::SizeHint which, const QSizeF& constraint ) const;
@@ -707,12 +762,36 @@ protected:
     void setPrefixItem( TimetableListItem *prefixItem );
     void setPostfixItem( TimetableListItem *postfixItem );
 
+    /** @brief Create a new item for rows, a child of m_rowArea. */
+    virtual PublicTransportGraphicsItem *createItem() = 0;
+
+    /** @brief Update @p item to show the data of @p row in the model. */
+    virtual void updateItem( PublicTransportGraphicsItem *item, int row ) = 0;
+
+    /** @brief Get an item for @p row from the pool of unused items or create a new one. */
+    PublicTransportGraphicsItem *acquireItem( int row );
+
+    /** @brief Hide the item of @p row (if any) and put it into the pool of unused items. */
+    void releaseItem( int row );
+
+    /** @brief The height of @p row, estimated if there is no item for @p row. */
+    qreal rowHeight( int row ) const;
+
     Options m_options;
     PublicTransportModel *m_model;
     TimetableListItem *m_prefixItem;
     TimetableListItem *m_postfixItem;
-    QList<PublicTransportGraphicsItem*> m_items;
+    QGraphicsWidget *m_rowArea; // Contains row items, between the prefix and the postfix item
+    QList<PublicTransportGraphicsItem*> m_items; // Items by row, 0 for rows without an item
+    QList<qreal> m_rowHeights; // Known heights of rows without an item, -1 for unexpanded rows
+    QList<PublicTransportGraphicsItem*> m_itemPool; // Hidden items, ready to be reused
+    // Items of removed rows while they get animated, with the row they get shown above
+    QList< QPair<int, PublicTransportGraphicsItem*> > m_removedItems;
+    QSet<const ItemBase*> m_expandedItems; // Model items of expanded rows
+    bool m_rowLayoutScheduled;
+    bool m_textLayoutScheduled;
     Plasma::Svg *m_svg;
+    int m_vehicleIconSvgId;
     qreal m_iconSize;
     qreal m_zoomFactor;
     int m_maxLineCount;
@@ -733,7 +812,6 @@ class TimetableWidget : public PublicTransportWidget
 
 public:
     TimetableWidget( Options options = DefaultOptions, QGraphicsItem* parent = 0 );
-    virtual ~TimetableWidget();
 
     void setTargetHidden( bool targetHidden ) { m_targetHidden = targetHidden; updateItemLayouts(); };
     bool isTargetHidden() const { return m_targetHidden; };
@@ -753,20 +831,17 @@ public:
         return qobject_cast<DepartureModel*>(m_model);
     };
 
-protected slots:
-    virtual void rowsInserted( const QModelIndex &parent, int first, int last );
-    virtual void dataChanged( const QModelIndex &topLeft, const QModelIndex &bottomRight );
-
 protected:
     virtual void contextMenuEvent( QGraphicsSceneContextMenuEvent *event );
     virtual void setupActions();
+    virtual PublicTransportGraphicsItem *createItem();
+    virtual void updateItem( PublicTransportGraphicsItem *item, int row );
 
 private:
     bool m_targetHidden;
     StopAction *m_showDeparturesAction;
     StopAction *m_highlightStopAction;
     StopAction *m_newFilterViaStopAction;
-    KPixmapCache *m_pixmapCache;
 };
 
 /**
@@ -809,12 +884,10 @@ public:
 
     virtual QList< QAction* > contextMenuActions();
 
-protected slots:
-    virtual void rowsInserted( const QModelIndex &parent, int first, int last );
-    virtual void dataChanged( const QModelIndex &topLeft, const QModelIndex &bottomRight );
-
 protected:
     virtual void setupActions();
+    virtual PublicTransportGraphicsItem *createItem();
+    virtual void updateItem( PublicTransportGraphicsItem *item, int row );
 
 private:
     Flags m_flags;
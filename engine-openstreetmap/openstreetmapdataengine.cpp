@@ -93,6 +93,12 @@ bool OpenStreetMapEngine::updateSourceEvent( const QString& source ) {
     QString osmUrl;
     OsmReader::ResultFlags resultFlags = OsmReader::AllResults;
 
+    // Special source to import a local .osm file into the tile cache
+    // "importOsm publictransportstops /home/user/bremen.osm"
+    if ( source.startsWith(QLatin1String("importOsm "), Qt::CaseInsensitive) ) {
+        return importOsmFile( source );
+    }
+
     // Special source to get the coordinates of something
     // "getCoords publictransportstops Pappelstraße"
     if ( source.startsWith(QLatin1String("getCoords "), Qt::CaseInsensitive) ) {
@@ -183,11 +189,37 @@ bool OpenStreetMapEngine::updateSourceEvent( const QString& source ) {
             sFilter = source.mid( pos2 + 1 ).trimmed();
         }
 
-        // Build url
-        osmUrl = QString( "%1%2[%3][bbox=%4,%5,%6,%7]" )
-                .arg( baseUrl(), element, sFilter )
-                .arg( longitude - mapBoxSize/2 ).arg( latitude - mapBoxSize/2 )
-                .arg( longitude + mapBoxSize/2 ).arg( latitude + mapBoxSize/2 );
+        QRectF box( QPointF(longitude - mapBoxSize/2, latitude - mapBoxSize/2),
+                    QPointF(longitude + mapBoxSize/2, latitude + mapBoxSize/2) );
+        if ( element == QLatin1String("node") ) {
+            // Use cached nodes and only download tiles that are not cached
+            const QString filterKey = OsmTileCache::filterKey( element, sFilter, resultFlags );
+            const Plasma::DataEngine::Data cachedElements = m_tileCache.elements( filterKey, box );
+            if ( !cachedElements.isEmpty() ) {
+                setData( source, cachedElements );
+            }
+
+            const QRect missingTiles =
+                    m_tileCache.missingTiles( filterKey, OsmTileCache::tilesForBox(box) );
+            if ( missingTiles.isNull() ) {
+                kDebug() << "All tiles are cached for" << source;
+                setData( source, "finished", true );
+                return true;
+            }
+
+            // Download the whole area of the missing tiles to be able to cache them
+            const QRectF missingBox = OsmTileCache::boxForTiles( missingTiles );
+            osmUrl = QString( "%1%2[%3][bbox=%4,%5,%6,%7]" )
+                    .arg( baseUrl(), element, sFilter )
+                    .arg( missingBox.left() ).arg( missingBox.top() )
+                    .arg( missingBox.right() ).arg( missingBox.bottom() );
+            m_tileRequests.insert( source, TileRequest(filterKey, osmUrl, missingTiles, box) );
+        } else {
+            // Build url
+            osmUrl = QString( "%1%2[%3][bbox=%4,%5,%6,%7]" )
+                    .arg( baseUrl(), element, sFilter )
+                    .arg( box.left() ).arg( box.top() ).arg( box.right() ).arg( box.bottom() );
+        }
         kDebug() << "URL:" << osmUrl;
     }
 
@@ -202,10 +234,10 @@ bool OpenStreetMapEngine::updateSourceEvent( const QString& source ) {
 
     // Store source name and reader associated with the job
     QPointer<OsmReader> osmReader = new OsmReader( source, osmUrl, resultFlags );
-    connect( osmReader, SIGNAL(chunkRead(QPointer<OsmReader>,Plasma::DataEngine::Data)),
-             this, SLOT(osmChunkRead(QPointer<OsmReader>,Plasma::DataEngine::Data)) );
-    connect( osmReader, SIGNAL(finishedReading(QPointer<OsmReader>,Plasma::DataEngine::Data)),
-             this, SLOT(osmFinishedReading(QPointer<OsmReader>,Plasma::DataEngine::Data)) );
+    connect( osmReader, SIGNAL(chunkRead(QPointer<OsmReader>,OsmElementList)),
+             this, SLOT(osmChunkRead(QPointer<OsmReader>,OsmElementList)) );
+    connect( osmReader, SIGNAL(finishedReading(QPointer<OsmReader>,OsmElementList)),
+             this, SLOT(osmFinishedReading(QPointer<OsmReader>,OsmElementList)) );
     m_jobInfos.insert( job, JobInfo(source, osmReader) );
     return true;
 }
@@ -231,22 +263,65 @@ void OpenStreetMapEngine::finished( KJob* job ) {
 }
 
 void OpenStreetMapEngine::osmChunkRead( QPointer<OsmReader> osmReader,
-                                        const Plasma::DataEngine::Data &data ) {
-    // Update data
-    if ( !data.isEmpty() ) {
-        setData( osmReader->associatedSourceName(), data );
+                                        const OsmElementList &elements ) {
+    const QString sourceName = osmReader->associatedSourceName();
+    if ( elements.isEmpty() ) {
+        return;
+    }
+
+    const Plasma::DataEngine::Data data = OsmReader::toData( elements );
+    QHash< QString, TileRequest >::Iterator it = m_tileRequests.find( sourceName );
+    if ( it != m_tileRequests.end() && it->url == osmReader->sourceUrl() ) {
+        // Collect elements of the downloaded tiles, only use elements inside the source's box
+        for ( Plasma::DataEngine::Data::ConstIterator element = data.constBegin();
+              element != data.constEnd(); ++element )
+        {
+            it->elements.insert( element.key(), element.value() );
+        }
+        const Plasma::DataEngine::Data dataInBox = OsmTileCache::elementsInBox( data, it->box );
+        if ( !dataInBox.isEmpty() ) {
+            setData( sourceName, dataInBox );
+        }
+    } else {
+        // Update data
+        setData( sourceName, data );
     }
 }
 
 void OpenStreetMapEngine::osmFinishedReading( QPointer<OsmReader> osmReader,
-                                              const Plasma::DataEngine::Data& data ) {
+                                              const OsmElementList &elements ) {
+    const QString sourceName = osmReader->associatedSourceName();
+    const Plasma::DataEngine::Data data = OsmReader::toData( elements );
+    const bool hasFallbackUrl =
+            osmReader->sourceUrl().contains(QLatin1String("public_transport=*")) ||
+            osmReader->sourceUrl().contains(QLatin1String("railway=tram_stop"));
+    const bool hasResults = osmReader->readElementCount() > 0;
+    Plasma::DataEngine::Data newData = data;
+    if ( m_tileRequests.contains(sourceName) ) {
+        const TileRequest request = m_tileRequests.take( sourceName );
+        if ( request.url == osmReader->sourceUrl() ) {
+            Plasma::DataEngine::Data allElements = request.elements;
+            for ( Plasma::DataEngine::Data::ConstIterator it = data.constBegin();
+                  it != data.constEnd(); ++it )
+            {
+                allElements.insert( it.key(), it.value() );
+            }
+
+            // Do not cache empty results, if another URL gets tried
+            if ( hasResults || !hasFallbackUrl ) {
+                m_tileCache.insertElements( request.filterKey, request.tiles, allElements );
+            }
+            newData = OsmTileCache::elementsInBox( data, request.box );
+        }
+    }
+
     // Update data
     bool finished = true;
-    if ( !data.isEmpty() ) {
-        setData( osmReader->associatedSourceName(), data );
-    } else if ( osmReader->sourceUrl().contains(QLatin1String("public_transport=*"))
-        || osmReader->sourceUrl().contains(QLatin1String("railway=tram_stop")) )
-    {
+    if ( hasResults ) {
+        if ( !newData.isEmpty() ) {
+            setData( sourceName, newData );
+        }
+    } else if ( hasFallbackUrl ) {
         QString newUrl = osmReader->sourceUrl().replace(
                     QLatin1String("railway=tram_stop"),
                     QLatin1String("highway=bus_stop") )
@@ -263,10 +338,10 @@ void OpenStreetMapEngine::osmFinishedReading( QPointer<OsmReader> osmReader,
 
         // Store source name and reader associated with the job
         QPointer<OsmReader> newOsmReader = new OsmReader( osmReader->associatedSourceName(), newUrl );
-        connect( newOsmReader, SIGNAL(chunkRead(QPointer<OsmReader>,Plasma::DataEngine::Data)),
-                 this, SLOT(osmChunkRead(QPointer<OsmReader>,Plasma::DataEngine::Data)) );
-        connect( newOsmReader, SIGNAL(finishedReading(QPointer<OsmReader>,Plasma::DataEngine::Data)),
-                 this, SLOT(osmFinishedReading(QPointer<OsmReader>,Plasma::DataEngine::Data)) );
+        connect( newOsmReader, SIGNAL(chunkRead(QPointer<OsmReader>,OsmElementList)),
+                 this, SLOT(osmChunkRead(QPointer<OsmReader>,OsmElementList)) );
+        connect( newOsmReader, SIGNAL(finishedReading(QPointer<OsmReader>,OsmElementList)),
+                 this, SLOT(osmFinishedReading(QPointer<OsmReader>,OsmElementList)) );
         m_jobInfos.insert( job, JobInfo(osmReader->associatedSourceName(), newOsmReader) );
 
         finished = false;
@@ -294,6 +369,55 @@ void OpenStreetMapEngine::osmFinishedReading( QPointer<OsmReader> osmReader,
     osmReader->deleteLater();
 }
 
+bool OpenStreetMapEngine::importOsmFile( const QString &source ) {
+    // "importOsm ([element] [filter]|[short-filter]) [fileName]"
+    const int pos = source.indexOf( ' ' );
+    const int pos2 = source.indexOf( ' ', pos + 1 );
+    if ( pos2 == -1 ) {
+        kDebug() << "No file name given";
+        return false;
+    }
+
+    QString element, sFilter, fileName;
+    OsmReader::ResultFlags resultFlags = OsmReader::AllResults;
+    const QString maybeElement = source.mid( pos + 1, pos2 - pos - 1 ).toLower();
+    if ( m_shortFilter.contains(maybeElement) ) {
+        // Replace 'short filters', like "hospital" -> "amenity=hospital" (with element="node")
+        Filter filter = m_shortFilter[ maybeElement ];
+        element = elementToString( filter.element );
+        sFilter = filter.filter;
+        fileName = source.mid( pos2 + 1 ).trimmed();
+
+        if ( maybeElement == QLatin1String("publictransportstops") ) {
+            resultFlags |= OsmReader::OnlyResultsWithNameAttribute;
+        }
+    } else {
+        // A custom filter
+        const int pos3 = source.indexOf( ' ', pos2 + 1 );
+        if ( pos3 == -1 ) {
+            kDebug() << "No file name given";
+            return false;
+        }
+        element = maybeElement;
+        sFilter = source.mid( pos2 + 1, pos3 - pos2 - 1 );
+        fileName = source.mid( pos3 + 1 ).trimmed();
+    }
+
+    QString errorText;
+    int count = -1;
+    if ( element != QLatin1String("node") ) {
+        errorText = i18nc("@info/plain", "Only nodes can be imported");
+    } else {
+        count = m_tileCache.importFile( fileName, element, sFilter, resultFlags, &errorText );
+    }
+
+    setData( source, "importedElements", qMax(0, count) );
+    setData( source, "error", count == -1 );
+    setData( source, "errorText", errorText );
+    setData( source, "finished", true );
+    return true;
+}
+
 QString OpenStreetMapEngine::elementToString( OpenStreetMapEngine::Element element ) const {
     switch ( element ) {
     case Node:         return "node";
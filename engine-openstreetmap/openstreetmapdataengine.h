@@ -23,6 +23,7 @@
 #include <Plasma/DataEngine>
 
 #include "osmreader.h"
+#include "osmtilecache.h"
 
 class KJob;
 namespace KIO {
@@ -41,6 +42,12 @@ class QBuffer;
  *         "53.069,8.8 publictransportstops"
  *         "53.069,8.8 node amenity=theatre" (custom search)
  *
+ * Nodes get cached in tiles on disk (see OsmTileCache), only tiles that are not cached yet or
+ * that have expired get downloaded. Local .osm extracts can be imported for offline use with
+ * the source "importOsm ([element] [filter]|[short-filter]) [fileName]", eg.
+ * "importOsm publictransportstops /home/user/bremen.osm". It contains the number of imported
+ * elements in "importedElements" and "error"/"errorText" if the file could not be imported.
+ *
  * TODO: Could use libweb from Project Silk, the base class for REST apis?
  **/
 class OpenStreetMapEngine : public Plasma::DataEngine {
@@ -71,12 +78,12 @@ public slots:
     /**
      * @brief Reading an XML document has finished (reached the end of the document).
      *
-     * @Note @p data only contains the last chunk of data.
+     * @Note @p elements only contains the last chunk of elements.
      **/
-    void osmFinishedReading( QPointer<OsmReader> osmReader, const Plasma::DataEngine::Data &data );
+    void osmFinishedReading( QPointer<OsmReader> osmReader, const OsmElementList &elements );
 
     /** @brief A new chunk of the XML document has been read. */
-    void osmChunkRead( QPointer<OsmReader> osmReader, const Plasma::DataEngine::Data &data );
+    void osmChunkRead( QPointer<OsmReader> osmReader, const OsmElementList &elements );
 
 private:
     enum Element {
@@ -107,10 +114,33 @@ private:
         };
     };
 
+    /** @brief Data stored for sources getting answered from the tile cache. */
+    struct TileRequest {
+        QString filterKey;
+        QString url; // The URL used to download the missing tiles
+        QRect tiles; // The downloaded tiles, stored in the cache when finished
+        QRectF box; // The bounding box of the source
+        Plasma::DataEngine::Data elements; // All elements read for the downloaded tiles
+
+        TileRequest() {};
+        TileRequest( const QString &filterKey, const QString &url, const QRect &tiles,
+                     const QRectF &box ) {
+            this->filterKey = filterKey;
+            this->url = url;
+            this->tiles = tiles;
+            this->box = box;
+        };
+    };
+
     QString elementToString( Element element ) const;
 
+    /** @brief Import a local .osm file for the "importOsm" source. */
+    bool importOsmFile( const QString &source );
+
     QHash< KJob*, JobInfo > m_jobInfos;
     QHash< QString, Filter > m_shortFilter;
+    QHash< QString, TileRequest > m_tileRequests; // Tile requests by source name
+    OsmTileCache m_tileCache;
 };
 
 #endif // Multiple include guard
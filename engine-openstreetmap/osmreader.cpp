@@ -19,9 +19,44 @@
 
 #include "osmreader.h"
 
+QVariantHash OsmElement::toHash() const {
+    QVariantHash hash;
+    switch ( type ) {
+    case Node:
+        hash.insert( "longitude", longitude );
+        hash.insert( "latitude", latitude );
+        hash.insert( "type", "node" );
+        break;
+    case Way:
+        hash.insert( "type", "way" );
+        break;
+    case Relation:
+        hash.insert( "type", "relation" );
+        break;
+    }
+
+    foreach ( const Tag &tag, tags ) {
+        hash.insert( tag.first, tag.second );
+    }
+    if ( !nodes.isEmpty() ) {
+        hash.insert( "nodes", nodes ); // IDs of associated nodes
+    }
+    if ( !ways.isEmpty() ) {
+        hash.insert( "ways", ways ); // IDs of associated ways
+    }
+    return hash;
+}
+
+Plasma::DataEngine::Data OsmReader::toData( const OsmElementList &elements ) {
+    Plasma::DataEngine::Data data;
+    foreach ( const OsmElement &element, elements ) {
+        data.insert( element.id, element.toHash() );
+    }
+    return data;
+}
 
 void OsmReader::read() {
-    m_data.clear();
+    m_elements.clear();
 
     while ( !atEnd() || waitOnRecoverableError() ) {
         readNext();
@@ -35,15 +70,12 @@ void OsmReader::read() {
     }
 
     kDebug() << "Read complete:" << (hasError() ? "No error." : errorString() );
-    emit finishedReading( this, m_data );
+    emit finishedReading( this, m_elements );
 }
 
 bool OsmReader::waitOnRecoverableError() {
-    if ( error() == PrematureEndOfDocumentError ) {
-        if ( !m_data.isEmpty() ) {
-            emit chunkRead( this, m_data );
-        }
-        m_data.clear(); // Clear old data
+    if ( error() == PrematureEndOfDocumentError && m_waitForMoreData ) {
+        emitChunk();
         m_loop.exec(); // Wait for more data
         return true;
     } else {
@@ -51,6 +83,21 @@ bool OsmReader::waitOnRecoverableError() {
     }
 }
 
+void OsmReader::emitChunk() {
+    if ( !m_elements.isEmpty() ) {
+        emit chunkRead( this, m_elements );
+    }
+    m_elements.clear(); // Clear old data
+}
+
+void OsmReader::addElement( const OsmElement &element ) {
+    m_elements << element;
+    ++m_readElementCount;
+    if ( m_maximumChunkSize > 0 && m_elements.count() >= m_maximumChunkSize ) {
+        emitChunk();
+    }
+}
+
 void OsmReader::readUnknownElement() {
     Q_ASSERT( isStartElement() );
 
@@ -83,6 +130,8 @@ void OsmReader::readOsm() {
                 readWay();
             } else if ( name().compare(QLatin1String("relation"), Qt::CaseInsensitive) == 0 ) {
                 readRelation();
+            } else if ( name().compare(QLatin1String("bounds"), Qt::CaseInsensitive) == 0 ) {
+                readBounds();
             } else {
                 readUnknownElement();
             }
@@ -92,22 +141,39 @@ void OsmReader::readOsm() {
     kDebug() << "Finished reading the <osm> tag";
 }
 
-bool OsmReader::isResultValid( const QVariantHash& data ) const {
-    return !m_resultFlags.testFlag(OnlyResultsWithNameAttribute)
-        || data.contains("name");
+void OsmReader::readBounds() {
+    const QXmlStreamAttributes attributes = this->attributes();
+    const double west = attributes.value( QLatin1String("minlon") ).toString().toDouble();
+    const double south = attributes.value( QLatin1String("minlat") ).toString().toDouble();
+    const double east = attributes.value( QLatin1String("maxlon") ).toString().toDouble();
+    const double north = attributes.value( QLatin1String("maxlat") ).toString().toDouble();
+    if ( west < east && south < north ) {
+        m_bounds = QRectF( QPointF(west, south), QPointF(east, north) );
+    }
+    readUnknownElement();
+}
+
+bool OsmReader::isResultValid() const {
+    if ( !m_resultFlags.testFlag(OnlyResultsWithNameAttribute) ) {
+        return true;
+    }
+
+    foreach ( const OsmElement::Tag &tag, m_tags ) {
+        if ( tag.first == QLatin1String("name") ) {
+            return true;
+        }
+    }
+    return false;
 }
 
 void OsmReader::readNode() {
-    QString id = attributes().value( QLatin1String("id") ).toString();
-    double longitude = attributes().value( QLatin1String("lon") ).toString().toDouble();
-    double latitude = attributes().value( QLatin1String("lat") ).toString().toDouble();
+    const QXmlStreamAttributes attributes = this->attributes();
+    const QString id = attributes.value( QLatin1String("id") ).toString();
+    const double longitude = attributes.value( QLatin1String("lon") ).toString().toDouble();
+    const double latitude = attributes.value( QLatin1String("lat") ).toString().toDouble();
     // Could read more information from attributes (user, uid, timestamp, version, changeset)
 
-    QVariantHash nodeData;
-    nodeData.insert( "longitude", longitude );
-    nodeData.insert( "latitude", latitude );
-    nodeData.insert( "type", "node" );
-
+    m_tags.resize( 0 );
     while ( !atEnd() || waitOnRecoverableError() ) {
         readNext();
 
@@ -117,25 +183,29 @@ void OsmReader::readNode() {
 
         if ( isStartElement() ) {
             if ( name().compare(QLatin1String("tag"), Qt::CaseInsensitive) == 0 ) {
-                readTag( &nodeData );
+                readTag();
             } else {
                 readUnknownElement();
             }
         }
     }
 
-    if ( isResultValid(nodeData) ) {
-        m_data.insert( id, nodeData );
+    // Only create elements that are not filtered out
+    if ( isResultValid() ) {
+        OsmElement node( OsmElement::Node, id );
+        node.longitude = longitude;
+        node.latitude = latitude;
+        node.tags = m_tags;
+        addElement( node );
     }
 }
 
 void OsmReader::readWay() {
-    QString id = attributes().value( QLatin1String("id") ).toString();
+    const QString id = attributes().value( QLatin1String("id") ).toString();
     // Could read more information from attributes (user, uid, timestamp, version, changeset)
-    QVariantHash nodeData;
     QStringList nodes;
-    nodeData.insert( "type", "way" );
 
+    m_tags.resize( 0 );
     while ( !atEnd() || waitOnRecoverableError() ) {
         readNext();
 
@@ -144,7 +214,7 @@ void OsmReader::readWay() {
 
         if ( isStartElement() ) {
             if ( name().compare(QLatin1String("tag"), Qt::CaseInsensitive) == 0 ) {
-                readTag( &nodeData );
+                readTag();
             } else if ( name().compare(QLatin1String("nd"), Qt::CaseInsensitive) == 0 ) {
                 QString node = attributes().value( QLatin1String("ref") ).toString();
                 if ( !node.isEmpty() ) {
@@ -156,21 +226,20 @@ void OsmReader::readWay() {
         }
     }
 
-    if ( isResultValid(nodeData) ) {
-        if ( !nodes.isEmpty() ) {
-            nodeData.insert( "nodes", nodes ); // IDs of associated nodes
-        }
-        m_data.insert( id, nodeData );
+    if ( isResultValid() ) {
+        OsmElement way( OsmElement::Way, id );
+        way.tags = m_tags;
+        way.nodes = nodes;
+        addElement( way );
     }
 }
 
 void OsmReader::readRelation() {
-    QString id = attributes().value( QLatin1String("id") ).toString();
+    const QString id = attributes().value( QLatin1String("id") ).toString();
     // Could read more information from attributes (user, uid, timestamp, version, changeset)
-    QVariantHash nodeData;
     QStringList nodes, ways;
-    nodeData.insert( "type", "relation" );
 
+    m_tags.resize( 0 );
     while ( !atEnd() || waitOnRecoverableError() ) {
         readNext();
 
@@ -180,17 +249,17 @@ void OsmReader::readRelation() {
 
         if ( isStartElement() ) {
             if ( name().compare(QLatin1String("tag"), Qt::CaseInsensitive) == 0 ) {
-                readTag( &nodeData );
+                readTag();
             } else if ( name().compare(QLatin1String("member"), Qt::CaseInsensitive) == 0 ) {
                 QString nodeOrWay = attributes().value( QLatin1String("ref") ).toString();
                 if ( !nodeOrWay.isEmpty() ) {
-                    QString type = attributes().value( QLatin1String("type") ).toString();
+                    QStringRef type = attributes().value( QLatin1String("type") );
                     if ( type == QLatin1String("node") ) {
                         nodes << nodeOrWay;
                     } else if ( type == QLatin1String("way") ) {
                         ways << nodeOrWay;
                     } else {
-                        kDebug() << "Unknown member type" << type
+                        kDebug() << "Unknown member type" << type.toString()
                                  << "of relation" << id;
                     }
                 }
@@ -200,23 +269,33 @@ void OsmReader::readRelation() {
         }
     }
 
-    if ( isResultValid(nodeData) ) {
-        if ( !nodes.isEmpty() ) {
-            nodeData.insert( "nodes", nodes ); // IDs of associated nodes
-        }
-        if ( !ways.isEmpty() ) {
-            nodeData.insert( "ways", ways ); // IDs of associated ways
-        }
-        m_data.insert( id, nodeData );
+    if ( isResultValid() ) {
+        OsmElement relation( OsmElement::Relation, id );
+        relation.tags = m_tags;
+        relation.nodes = nodes;
+        relation.ways = ways;
+        addElement( relation );
     }
 }
 
-void OsmReader::readTag( QVariantHash *nodeData ) {
-    if ( !attributes().hasAttribute("k") || !attributes().hasAttribute("v") ) {
+void OsmReader::readTag() {
+    const QXmlStreamAttributes attributes = this->attributes();
+    if ( !attributes.hasAttribute("k") || !attributes.hasAttribute("v") ) {
         kDebug() << "Key or value attribute not found for <tag>";
     }
 
     // Simply use the keys from OpenStreetMap. Maybe it's better to translate
     // them ("addr:street" => "street", then maybe combined with "addr:housenumber").
-    nodeData->insert( attributes().value("k").toString(), attributes().value("v").toString() );
+    m_tags << OsmElement::Tag( internedKey(attributes.value("k")),
+                               attributes.value("v").toString() );
+}
+
+QString OsmReader::internedKey( const QStringRef &key ) {
+    // Look the key up without copying it
+    const QString rawKey = QString::fromRawData( key.unicode(), key.size() );
+    QSet< QString >::ConstIterator it = m_tagKeys.constFind( rawKey );
+    if ( it != m_tagKeys.constEnd() ) {
+        return *it;
+    }
+    return *m_tagKeys.insert( key.toString() );
 }
@@ -24,9 +24,49 @@
 
 #include <QXmlStreamReader>
 #include <QEventLoop>
+#include <QPair>
+#include <QRectF>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
 
 class ServiceProvider;
 
+/**
+ * @brief An element read from an OpenStreetMap XML document, ie. a node, way or relation.
+ *
+ * Tag keys of elements read by the same OsmReader share their data, ie. each distinct key is
+ * only stored once. Use toHash() to get the data in the format used for Plasma data.
+ **/
+struct OsmElement {
+    enum Type {
+        Node, Way, Relation
+    };
+
+    /** @brief A tag of an element, the key and the value. */
+    typedef QPair< QString, QString > Tag;
+
+    Type type;
+    QString id;
+    double longitude; // Only used for nodes
+    double latitude; // Only used for nodes
+    QVector< Tag > tags;
+    QStringList nodes; // IDs of associated nodes, used for ways and relations
+    QStringList ways; // IDs of associated ways, used for relations
+
+    OsmElement( Type type = Node, const QString &id = QString() )
+            : type(type), id(id), longitude(0.0), latitude(0.0) {};
+
+    /**
+     * @brief Get the data of this element as hash.
+     *
+     * Contains the keys "type" ("node", "way" or "relation"), "longitude"/"latitude" for nodes,
+     * "nodes"/"ways" if there are associated nodes/ways and all tags.
+     **/
+    QVariantHash toHash() const;
+};
+typedef QList< OsmElement > OsmElementList;
+
 class OsmReader : public QObject, public QXmlStreamReader {
     Q_OBJECT;
 
@@ -44,12 +84,52 @@ public:
         m_associatedSourceName = associatedSourceName;
         m_sourceUrl = sourceUrl;
         m_resultFlags = resultFlags;
+        m_waitForMoreData = true;
+        m_maximumChunkSize = DEFAULT_CHUNK_SIZE;
+        m_readElementCount = 0;
+        m_tags.reserve( 16 );
     };
 
+    /** @brief The default maximal number of elements in a chunk, see setMaximumChunkSize(). */
+    static const int DEFAULT_CHUNK_SIZE = 64;
+
     void read();
-    Plasma::DataEngine::Data data() const { return m_data; };
+
+    /** @brief The elements of the current chunk, ie. that were not emitted in chunkRead() yet. */
+    OsmElementList elements() const { return m_elements; };
+
+    /** @brief The number of elements read so far, without elements that were filtered out. */
+    int readElementCount() const { return m_readElementCount; };
+
+    /**
+     * @brief The area covered by the document, read from it's <bounds> element.
+     *
+     * Longitudes are x coordinates, latitudes are y coordinates. This is a null rectangle,
+     * if the document has no <bounds> element (or it was not read yet).
+     **/
+    QRectF bounds() const { return m_bounds; };
+
+    /** @brief Convert @p elements to Plasma data, with element IDs as keys. */
+    static Plasma::DataEngine::Data toData( const OsmElementList &elements );
 
     void resumeReading() { m_loop.quit(); };
+
+    /**
+     * @brief Set whether or not to wait for more data, if the data ends before the document.
+     *
+     * Set this to false, if all data has been added, eg. when reading a local file.
+     * Otherwise read() waits for more data, until resumeReading() gets called.
+     **/
+    void setWaitForMoreData( bool waitForMoreData ) { m_waitForMoreData = waitForMoreData; };
+
+    /**
+     * @brief Set the maximal number of elements emitted at once in chunkRead().
+     *
+     * Chunks also get emitted before waiting for more data. Use 0 to only emit chunks
+     * before waiting for more data, eg. to get all elements of a local file using elements().
+     **/
+    void setMaximumChunkSize( int maximumChunkSize ) { m_maximumChunkSize = maximumChunkSize; };
+
     QString associatedSourceName() const { return m_associatedSourceName; };
     QString sourceUrl() const { return m_sourceUrl; };
 
@@ -57,30 +137,52 @@ signals:
     /**
      * @brief Reading an XML document has finished (reached the end of the document).
      *
-     * @Note @p lastDataChunk only contains the last chunk of data.
+     * @Note @p lastChunk only contains the last chunk of elements.
      **/
-    void finishedReading( QPointer<OsmReader> reader, const Plasma::DataEngine::Data &lastDataChunk );
+    void finishedReading( QPointer<OsmReader> reader, const OsmElementList &lastChunk );
 
-    /** @brief A new chunk of the XML document has been read. */
-    void chunkRead( QPointer<OsmReader> reader, const Plasma::DataEngine::Data &dataChunk );
+    /**
+     * @brief A new chunk of the XML document has been read.
+     *
+     * Gets emitted when more data is needed to continue reading or when the chunk contains
+     * the maximal number of elements, see setMaximumChunkSize().
+     **/
+    void chunkRead( QPointer<OsmReader> reader, const OsmElementList &chunk );
 
 private:
-    bool isResultValid( const QVariantHash &data ) const;
+    /** @brief Whether or not an element with the tags in m_tags should be added. */
+    bool isResultValid() const;
+
+    /** @brief Add @p element to the current chunk, emits chunkRead() if the chunk is full. */
+    void addElement( const OsmElement &element );
+
+    /** @brief Emit chunkRead() for the current chunk, if it is not empty. */
+    void emitChunk();
+
+    /** @brief Get a shared copy of @p key, see m_tagKeys. */
+    QString internedKey( const QStringRef &key );
 
     void readUnknownElement();
     void readOsm();
+    void readBounds();
     void readNode();
     void readWay();
     void readRelation();
-    void readTag( QHash< QString, QVariant > *nodeData );
+    void readTag();
 
     bool waitOnRecoverableError();
 
-    Plasma::DataEngine::Data m_data;
+    OsmElementList m_elements; // Elements of the current chunk
+    QVector< OsmElement::Tag > m_tags; // Tags of the element being read, reused for all elements
+    QSet< QString > m_tagKeys; // Each tag key read, elements share the key strings stored here
+    int m_maximumChunkSize;
+    int m_readElementCount;
+    QRectF m_bounds;
     QEventLoop m_loop;
     QString m_associatedSourceName;
     ResultFlags m_resultFlags;
     QString m_sourceUrl;
+    bool m_waitForMoreData;
 };
 Q_DECLARE_OPERATORS_FOR_FLAGS( OsmReader::ResultFlags )
 
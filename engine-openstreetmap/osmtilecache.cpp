@@ -0,0 +1,345 @@
+/*
+*   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU Library General Public License as
+*   published by the Free Software Foundation; either version 2 or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details
+*
+*   You should have received a copy of the GNU Library General Public
+*   License along with this program; if not, write to the
+*   Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "osmtilecache.h"
+
+#include <KStandardDirs>
+#include <KSaveFile>
+#include <KDebug>
+#include <KLocale>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QSet>
+#include <qmath.h>
+
+const double OsmTileCache::TILE_SIZE = 0.05;
+
+// Tile files start with this magic number and a version number
+static const quint32 TILE_MAGIC = 0x4f534d54; // "OSMT"
+static const quint32 TILE_VERSION = 1;
+
+// Imports of bigger extracts only store tiles containing elements
+static const int MAXIMUM_IMPORTED_EMPTY_TILES = 4096;
+
+OsmTileCache::OsmTileCache( const QString &directory )
+        : m_directory(directory), m_tiles(MAXIMUM_CACHED_TILES) {
+    if ( m_directory.isEmpty() ) {
+        m_directory = KGlobal::dirs()->saveLocation( "data", "plasma_engine_openstreetmap/tiles/" );
+    } else if ( !m_directory.endsWith('/') ) {
+        m_directory += '/';
+    }
+}
+
+QString OsmTileCache::filterKey( const QString &element, const QString &filter,
+                                 OsmReader::ResultFlags resultFlags ) {
+    QString key = QString( "%1[%2]" ).arg( element, filter );
+    if ( resultFlags.testFlag(OsmReader::OnlyResultsWithNameAttribute) ) {
+        key += "[name]";
+    }
+    return key;
+}
+
+static QPoint tileForCoordinates( double longitude, double latitude ) {
+    return QPoint( qFloor(longitude / OsmTileCache::TILE_SIZE),
+                   qFloor(latitude / OsmTileCache::TILE_SIZE) );
+}
+
+QRect OsmTileCache::tilesForBox( const QRectF &box ) {
+    return QRect( tileForCoordinates(box.left(), box.top()),
+                  tileForCoordinates(box.right(), box.bottom()) );
+}
+
+QRectF OsmTileCache::boxForTiles( const QRect &tiles ) {
+    return QRectF( QPointF(tiles.left() * TILE_SIZE, tiles.top() * TILE_SIZE),
+                   QPointF((tiles.right() + 1) * TILE_SIZE, (tiles.bottom() + 1) * TILE_SIZE) );
+}
+
+Plasma::DataEngine::Data OsmTileCache::elementsInBox( const Plasma::DataEngine::Data &elements,
+                                                      const QRectF &box ) {
+    Plasma::DataEngine::Data result;
+    for ( Plasma::DataEngine::Data::ConstIterator it = elements.constBegin();
+          it != elements.constEnd(); ++it )
+    {
+        const QVariantHash element = it.value().toHash();
+        if ( element.contains("longitude") && element.contains("latitude") &&
+             box.contains(element["longitude"].toDouble(), element["latitude"].toDouble()) )
+        {
+            result.insert( it.key(), it.value() );
+        }
+    }
+    return result;
+}
+
+bool OsmTileCache::matchesFilter( const QVariantHash &element, const QString &filter ) {
+    // Predicates are separated by "][", keys and values can contain alternatives separated by '|'
+    foreach ( const QString &predicate, filter.split(QLatin1String("][")) ) {
+        const int pos = predicate.indexOf( '=' );
+        const QStringList keys = predicate.left( pos ).split( '|' );
+        const QStringList values = pos == -1 ? QStringList() << "*"
+                                             : predicate.mid( pos + 1 ).split( '|' );
+        bool matches = false;
+        foreach ( const QString &key, keys ) {
+            if ( element.contains(key) && (values.contains("*") ||
+                                           values.contains(element[key].toString())) )
+            {
+                matches = true;
+                break;
+            }
+        }
+        if ( !matches ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QString OsmTileCache::tileFileName( const QString &filterKey, const QPoint &tile ) const {
+    // Use one directory for each filter
+    const QString filterDirectory =
+            QCryptographicHash::hash( filterKey.toUtf8(), QCryptographicHash::Md5 ).toHex();
+    return QString( "%1%2/%3_%4.tile" )
+            .arg( m_directory, filterDirectory ).arg( tile.x() ).arg( tile.y() );
+}
+
+OsmTileCache::Tile *OsmTileCache::tile( const QString &filterKey, const QPoint &tile ) {
+    const QString fileName = tileFileName( filterKey, tile );
+    Tile *cachedTile = m_tiles.object( fileName );
+    if ( !cachedTile ) {
+        cachedTile = readTile( fileName );
+        if ( cachedTile ) {
+            m_tiles.insert( fileName, cachedTile );
+        }
+    }
+    return cachedTile;
+}
+
+QRect OsmTileCache::missingTiles( const QString &filterKey, const QRect &tiles ) {
+    const uint now = QDateTime::currentDateTime().toTime_t();
+    QRect missing;
+    for ( int x = tiles.left(); x <= tiles.right(); ++x ) {
+        for ( int y = tiles.top(); y <= tiles.bottom(); ++y ) {
+            const Tile *cachedTile = tile( filterKey, QPoint(x, y) );
+            if ( !cachedTile || (cachedTile->expires != 0 && cachedTile->expires < now) ) {
+                missing = missing.united( QRect(x, y, 1, 1) );
+            }
+        }
+    }
+    return missing;
+}
+
+Plasma::DataEngine::Data OsmTileCache::elements( const QString &filterKey, const QRectF &box ) {
+    // Also use data of expired tiles, until the tiles get downloaded again
+    Plasma::DataEngine::Data result;
+    const QRect tiles = tilesForBox( box );
+    for ( int x = tiles.left(); x <= tiles.right(); ++x ) {
+        for ( int y = tiles.top(); y <= tiles.bottom(); ++y ) {
+            const Tile *cachedTile = tile( filterKey, QPoint(x, y) );
+            if ( cachedTile ) {
+                const Plasma::DataEngine::Data tileElements =
+                        elementsInBox( cachedTile->elements, box );
+                for ( Plasma::DataEngine::Data::ConstIterator it = tileElements.constBegin();
+                      it != tileElements.constEnd(); ++it )
+                {
+                    result.insert( it.key(), it.value() );
+                }
+            }
+        }
+    }
+    return result;
+}
+
+QRect OsmTileCache::tilesInsideBox( const QRectF &box ) {
+    // Tolerate rounding errors for boxes on tile borders
+    const double epsilon = 1e-9;
+    const QPoint topLeft( qCeil(box.left() / TILE_SIZE - epsilon),
+                          qCeil(box.top() / TILE_SIZE - epsilon) );
+    const QPoint bottomRight( qFloor(box.right() / TILE_SIZE + epsilon) - 1,
+                              qFloor(box.bottom() / TILE_SIZE + epsilon) - 1 );
+    return bottomRight.x() < topLeft.x() || bottomRight.y() < topLeft.y()
+            ? QRect() : QRect( topLeft, bottomRight );
+}
+
+void OsmTileCache::insertElements( const QString &filterKey, const QRect &tiles,
+                                   const Plasma::DataEngine::Data &elements, bool expires ) {
+    if ( expires ) {
+        writeTiles( filterKey, tiles, QRect(), elements,
+                    QDateTime::currentDateTime().toTime_t() + MAXIMUM_TILE_AGE );
+    } else {
+        writeTiles( filterKey, tiles, tiles, elements, 0 );
+    }
+}
+
+void OsmTileCache::writeTiles( const QString &filterKey, const QRect &tiles,
+                               const QRect &completeTiles,
+                               const Plasma::DataEngine::Data &elements, uint expireTime ) {
+    // Create the tiles, tiles in completeTiles never expire. Tiles that are already expired
+    // when written do not replace cached tiles that are still valid
+    const uint now = QDateTime::currentDateTime().toTime_t();
+    const bool storeEmptyTiles = tiles.width() * tiles.height() <= MAXIMUM_IMPORTED_EMPTY_TILES;
+    QHash< QString, Tile > newTiles;
+    QSet< QString > skippedTiles;
+    for ( int x = tiles.left(); x <= tiles.right(); ++x ) {
+        for ( int y = tiles.top(); y <= tiles.bottom(); ++y ) {
+            const QPoint point( x, y );
+            if ( completeTiles.contains(point) ) {
+                if ( storeEmptyTiles ) {
+                    newTiles[ tileFileName(filterKey, point) ].expires = 0;
+                }
+                continue;
+            }
+
+            const Tile *cachedTile = expireTime < now ? tile( filterKey, point ) : 0;
+            if ( cachedTile && (cachedTile->expires == 0 || cachedTile->expires >= now) ) {
+                skippedTiles.insert( tileFileName(filterKey, point) );
+            } else {
+                newTiles[ tileFileName(filterKey, point) ].expires = expireTime;
+            }
+        }
+    }
+
+    // Distribute the elements to the tiles containing their coordinates
+    for ( Plasma::DataEngine::Data::ConstIterator it = elements.constBegin();
+          it != elements.constEnd(); ++it )
+    {
+        const QVariantHash element = it.value().toHash();
+        if ( !element.contains("longitude") || !element.contains("latitude") ) {
+            continue;
+        }
+
+        const QPoint point = tileForCoordinates( element["longitude"].toDouble(),
+                                                 element["latitude"].toDouble() );
+        const QString fileName = tileFileName( filterKey, point );
+        if ( tiles.contains(point) && !skippedTiles.contains(fileName) ) {
+            Tile &newTile = newTiles[ fileName ];
+            newTile.expires = completeTiles.contains( point ) ? 0 : expireTime;
+            newTile.elements.insert( it.key(), it.value() );
+        }
+    }
+
+    for ( QHash< QString, Tile >::ConstIterator it = newTiles.constBegin();
+          it != newTiles.constEnd(); ++it )
+    {
+        if ( !writeTile(it.key(), it.value()) ) {
+            kDebug() << "Could not write tile" << it.key();
+        }
+        m_tiles.insert( it.key(), new Tile(it.value()) );
+    }
+}
+
+int OsmTileCache::importFile( const QString &fileName, const QString &element,
+                              const QString &filter, OsmReader::ResultFlags resultFlags,
+                              QString *errorText ) {
+    QFile file( fileName );
+    if ( !file.open(QIODevice::ReadOnly) ) {
+        if ( errorText ) {
+            *errorText = i18nc("@info/plain", "Cannot open file %1: %2",
+                               fileName, file.errorString());
+        }
+        return -1;
+    }
+
+    // Read the whole file, without waiting for more data at the end of the file
+    OsmReader reader( QString(), fileName, resultFlags );
+    reader.setWaitForMoreData( false );
+    reader.setMaximumChunkSize( 0 );
+    reader.addData( file.readAll() );
+    reader.read();
+    if ( reader.hasError() ) {
+        if ( errorText ) {
+            *errorText = i18nc("@info/plain", "Cannot read file %1: %2",
+                               fileName, reader.errorString());
+        }
+        return -1;
+    }
+
+    // Find matching elements and the area covered by the extract
+    Plasma::DataEngine::Data matchingElements;
+    double west = 180.0, east = -180.0, south = 90.0, north = -90.0;
+    foreach ( const OsmElement &osmElement, reader.elements() ) {
+        if ( osmElement.type != OsmElement::Node ) {
+            continue;
+        }
+
+        west = qMin( west, osmElement.longitude );
+        east = qMax( east, osmElement.longitude );
+        south = qMin( south, osmElement.latitude );
+        north = qMax( north, osmElement.latitude );
+
+        const QVariantHash elementData = osmElement.toHash();
+        if ( element == QLatin1String("node") && matchesFilter(elementData, filter) ) {
+            matchingElements.insert( osmElement.id, elementData );
+        }
+    }
+
+    // Only tiles completely inside the <bounds> of the extract are complete and do not expire.
+    // Tiles at the border of the extract may miss elements outside of it. They get stored as
+    // already expired, ie. they get downloaded when online and their elements get used until
+    // then. Without <bounds> all tiles are treated as border tiles
+    const QRectF nodeBox( QPointF(west, south), QPointF(east, north) );
+    const QRectF bounds = reader.bounds();
+    if ( !bounds.isNull() || (west <= east && south <= north) ) {
+        const QRectF box = bounds.isNull() ? nodeBox : bounds;
+        writeTiles( filterKey(element, filter, resultFlags), tilesForBox(box),
+                    bounds.isNull() ? QRect() : tilesInsideBox(bounds), matchingElements, 1 );
+    }
+    return matchingElements.count();
+}
+
+OsmTileCache::Tile *OsmTileCache::readTile( const QString &fileName ) const {
+    QFile file( fileName );
+    if ( !file.open(QIODevice::ReadOnly) ) {
+        return 0;
+    }
+
+    QDataStream stream( &file );
+    stream.setVersion( QDataStream::Qt_4_6 );
+    quint32 magic, version;
+    stream >> magic >> version;
+    if ( magic != TILE_MAGIC || version != TILE_VERSION ) {
+        kDebug() << "Invalid tile file" << fileName;
+        return 0;
+    }
+
+    Tile *tile = new Tile;
+    quint32 expires;
+    stream >> expires >> tile->elements;
+    tile->expires = expires;
+    if ( stream.status() != QDataStream::Ok ) {
+        kDebug() << "Corrupted tile file" << fileName;
+        delete tile;
+        return 0;
+    }
+    return tile;
+}
+
+bool OsmTileCache::writeTile( const QString &fileName, const Tile &tile ) const {
+    QDir().mkpath( fileName.left(fileName.lastIndexOf('/')) );
+    KSaveFile file( fileName );
+    if ( !file.open(QIODevice::WriteOnly) ) {
+        return false;
+    }
+
+    QDataStream stream( &file );
+    stream.setVersion( QDataStream::Qt_4_6 );
+    stream << TILE_MAGIC << TILE_VERSION << quint32(tile.expires) << tile.elements;
+    return stream.status() == QDataStream::Ok && file.finalize();
+}
@@ -0,0 +1,170 @@
+/*
+*   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU Library General Public License as
+*   published by the Free Software Foundation; either version 2 or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details
+*
+*   You should have received a copy of the GNU Library General Public
+*   License along with this program; if not, write to the
+*   Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef OSMTILECACHE_HEADER
+#define OSMTILECACHE_HEADER
+
+#include "osmreader.h"
+
+#include <QCache>
+#include <QRect>
+#include <QRectF>
+
+/**
+ * @brief A tiled on-disk cache for OpenStreetMap elements.
+ *
+ * The map gets divided into tiles of TILE_SIZE x TILE_SIZE degrees. Elements read by OsmReader
+ * get stored for each filter (see filterKey()) in the tiles containing their coordinates, one
+ * file per filter and tile. Tiles get also stored if they contain no elements, to know that
+ * there is nothing to download for them.
+ *
+ * For a requested bounding box the elements of all cached tiles can be read with elements(),
+ * missingTiles() returns the tiles that still need to be downloaded. Downloaded tiles expire
+ * after MAXIMUM_TILE_AGE seconds.
+ *
+ * Local .osm extracts can be imported using importFile(), imported tiles completely inside the
+ * bounds of the extract do not expire.
+ *
+ * Only elements with coordinates (nodes) can be stored in tiles.
+ **/
+class OsmTileCache {
+public:
+    /** @brief The width and height of a tile in degrees. */
+    static const double TILE_SIZE;
+
+    /** @brief Seconds after which downloaded tiles need to be downloaded again. */
+    static const int MAXIMUM_TILE_AGE = 7 * 24 * 60 * 60;
+
+    /** @brief The maximal number of tiles kept in memory. */
+    static const int MAXIMUM_CACHED_TILES = 256;
+
+    /**
+     * @brief Create a tile cache storing tiles in @p directory.
+     *
+     * @param directory The directory where to store tile files. If this is empty, a directory
+     *   in the local data directory of KDE gets used.
+     **/
+    explicit OsmTileCache( const QString &directory = QString() );
+
+    /** @brief Get a key for tiles containing @p element's matching @p filter. */
+    static QString filterKey( const QString &element, const QString &filter,
+                              OsmReader::ResultFlags resultFlags = OsmReader::AllResults );
+
+    /**
+     * @brief Get the tiles covering @p box.
+     *
+     * @param box The bounding box, longitudes are x coordinates, latitudes are y coordinates.
+     * @return A rectangle of tile coordinates, including the right/bottom tiles.
+     **/
+    static QRect tilesForBox( const QRectF &box );
+
+    /**
+     * @brief Get the tiles that are completely inside @p box.
+     *
+     * @return A rectangle of tile coordinates, which is empty if no tile is completely
+     *   inside @p box.
+     **/
+    static QRect tilesInsideBox( const QRectF &box );
+
+    /** @brief Get the bounding box covered by @p tiles, see tilesForBox(). */
+    static QRectF boxForTiles( const QRect &tiles );
+
+    /** @brief Get all elements of @p elements with coordinates inside @p box. */
+    static Plasma::DataEngine::Data elementsInBox( const Plasma::DataEngine::Data &elements,
+                                                   const QRectF &box );
+
+    /**
+     * @brief Whether or not @p element matches @p filter.
+     *
+     * @param element Data of an element as read by OsmReader.
+     * @param filter A filter in XAPI syntax, eg. "amenity=theatre", "public_transport=*" or
+     *   "highway=bus_stop|platform". Multiple predicates can be combined, eg. "a=b][c=d".
+     **/
+    static bool matchesFilter( const QVariantHash &element, const QString &filter );
+
+    /**
+     * @brief Get the bounding rectangle of tiles in @p tiles that are not cached for
+     *   @p filterKey or that have expired.
+     *
+     * @return A null rectangle, if all tiles are cached.
+     **/
+    QRect missingTiles( const QString &filterKey, const QRect &tiles );
+
+    /** @brief Get elements for @p filterKey inside @p box from cached tiles. */
+    Plasma::DataEngine::Data elements( const QString &filterKey, const QRectF &box );
+
+    /**
+     * @brief Store @p elements for @p filterKey in @p tiles.
+     *
+     * All tiles in @p tiles get written, also if they do not contain any element. Only for
+     * big areas of tiles that do not expire (imported extracts) empty tiles get skipped.
+     * Elements without coordinates get ignored.
+     *
+     * @param expires Whether or not the tiles expire after MAXIMUM_TILE_AGE seconds.
+     **/
+    void insertElements( const QString &filterKey, const QRect &tiles,
+                         const Plasma::DataEngine::Data &elements, bool expires = true );
+
+    /**
+     * @brief Read a local .osm extract and store elements matching the filter.
+     *
+     * The tiles covered by the <bounds> of the extract get stored. Tiles that are completely
+     * inside the bounds do not expire. Tiles at the border of the extract only contain the
+     * elements inside the extract, they get stored as already expired. Their elements get used
+     * until they get downloaded. If the extract has no <bounds> element, the tiles covered
+     * by it's nodes get stored as border tiles.
+     *
+     * @param fileName The name of the .osm file to import.
+     * @param element The type of the elements to import, eg. "node".
+     * @param filter The filter for the elements to import, see matchesFilter().
+     * @param resultFlags Flags to filter results, see OsmReader::ResultFlags.
+     * @param errorText Gets set to a string explaining an error, if this returns -1.
+     *
+     * @return The number of imported elements or -1 if the file could not be read.
+     **/
+    int importFile( const QString &fileName, const QString &element, const QString &filter,
+                    OsmReader::ResultFlags resultFlags = OsmReader::AllResults,
+                    QString *errorText = 0 );
+
+private:
+    /** @brief A cached tile. */
+    struct Tile {
+        Plasma::DataEngine::Data elements;
+        uint expires; // Time at which the tile expires in seconds since the epoch, 0 for never
+    };
+
+    /**
+     * @brief Store @p elements for @p filterKey in @p tiles.
+     *
+     * Tiles in @p completeTiles never expire, other tiles expire at @p expireTime.
+     * For big areas of complete tiles empty tiles do not get stored.
+     **/
+    void writeTiles( const QString &filterKey, const QRect &tiles, const QRect &completeTiles,
+                     const Plasma::DataEngine::Data &elements, uint expireTime );
+
+    QString tileFileName( const QString &filterKey, const QPoint &tile ) const;
+    Tile *tile( const QString &filterKey, const QPoint &tile );
+    Tile *readTile( const QString &fileName ) const;
+    bool writeTile( const QString &fileName, const Tile &tile ) const;
+
+    QString m_directory;
+    QCache< QString, Tile > m_tiles; // Tiles in memory by tile file name
+};
+
+#endif // OSMTILECACHE_HEADER
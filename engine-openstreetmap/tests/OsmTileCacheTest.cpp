@@ -0,0 +1,174 @@
+/*
+ *   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "OsmTileCacheTest.h"
+
+#include "osmtilecache.h"
+
+#include <KTempDir>
+#include <KGlobal>
+#include <QtTest/QTest>
+#include <QFile>
+#include <QTextStream>
+
+// Tiles used by the test extract, the bounds cover the tiles x=160..162, y=1060..1061.
+// Only the tiles x=160..161, y=1060 are completely inside the bounds
+static const QString STOPS_FILTER = "highway=bus_stop";
+
+void OsmTileCacheTest::init()
+{
+    // Initialize for i18n
+    KGlobal::locale();
+    m_directory = new KTempDir();
+}
+
+void OsmTileCacheTest::cleanup()
+{
+    delete m_directory;
+    m_directory = 0;
+}
+
+QString OsmTileCacheTest::writeExtract( bool withBounds ) const
+{
+    const QString fileName = m_directory->name() + "extract.osm";
+    QFile file( fileName );
+    if ( !file.open(QIODevice::WriteOnly) ) {
+        return QString();
+    }
+
+    QTextStream stream( &file );
+    stream << "<?xml version='1.0' encoding='UTF-8'?>\n<osm version=\"0.6\">\n";
+    if ( withBounds ) {
+        stream << "<bounds minlat=\"53.0\" minlon=\"8.0\" maxlat=\"53.08\" maxlon=\"8.12\"/>\n";
+    }
+    // A stop in a complete tile, a stop in a border tile and a node not matching the filter
+    stream << "<node id=\"1\" lat=\"53.01\" lon=\"8.01\">"
+              "<tag k=\"highway\" v=\"bus_stop\"/><tag k=\"name\" v=\"Inner\"/></node>\n"
+              "<node id=\"2\" lat=\"53.02\" lon=\"8.11\">"
+              "<tag k=\"highway\" v=\"bus_stop\"/><tag k=\"name\" v=\"Border\"/></node>\n"
+              "<node id=\"3\" lat=\"53.07\" lon=\"8.02\">"
+              "<tag k=\"amenity\" v=\"bench\"/></node>\n"
+              "</osm>\n";
+    return fileName;
+}
+
+void OsmTileCacheTest::tileCoordinatesTest()
+{
+    const QRectF box( QPointF(8.0, 53.0), QPointF(8.12, 53.08) );
+    QCOMPARE( OsmTileCache::tilesForBox(box), QRect(QPoint(160, 1060), QPoint(162, 1061)) );
+    QCOMPARE( OsmTileCache::tilesInsideBox(box), QRect(QPoint(160, 1060), QPoint(161, 1060)) );
+
+    // Tiles on the borders of the box are completely inside, despite of rounding errors
+    const QRectF tilesBox = OsmTileCache::boxForTiles( QRect(QPoint(160, 1060), QPoint(161, 1061)) );
+    QCOMPARE( OsmTileCache::tilesInsideBox(tilesBox), QRect(QPoint(160, 1060), QPoint(161, 1061)) );
+
+    // No tile is completely inside a small box
+    QVERIFY( OsmTileCache::tilesInsideBox(QRectF(8.01, 53.01, 0.01, 0.01)).isNull() );
+}
+
+void OsmTileCacheTest::insertElementsTest()
+{
+    const QString filterKey = OsmTileCache::filterKey( "node", STOPS_FILTER );
+    const QRect tiles( QPoint(160, 1060), QPoint(161, 1060) );
+    OsmTileCache cache( m_directory->name() );
+    QCOMPARE( cache.missingTiles(filterKey, tiles), tiles );
+
+    QVariantHash stop;
+    stop[ "longitude" ] = 8.01;
+    stop[ "latitude" ] = 53.01;
+    stop[ "name" ] = "Inner";
+    Plasma::DataEngine::Data elements;
+    elements.insert( "1", stop );
+    cache.insertElements( filterKey, tiles, elements );
+
+    // Downloaded tiles are not missing, also if they are empty
+    QVERIFY( cache.missingTiles(filterKey, tiles).isNull() );
+    QCOMPARE( cache.missingTiles(filterKey, QRect(160, 1060, 3, 1)), QRect(162, 1060, 1, 1) );
+    const QRectF box = OsmTileCache::boxForTiles( tiles );
+    QCOMPARE( cache.elements(filterKey, box).keys(), QStringList() << "1" );
+    QVERIFY( cache.elements(OsmTileCache::filterKey("node", "amenity=bench"), box).isEmpty() );
+
+    // Tiles get read from disk by a new cache
+    OsmTileCache cache2( m_directory->name() );
+    QVERIFY( cache2.missingTiles(filterKey, tiles).isNull() );
+    QCOMPARE( cache2.elements(filterKey, box)["1"].toHash()["name"].toString(),
+              QString("Inner") );
+}
+
+void OsmTileCacheTest::importFileTest()
+{
+    const QString filterKey = OsmTileCache::filterKey( "node", STOPS_FILTER );
+    OsmTileCache cache( m_directory->name() );
+
+    // Download a border tile before the import
+    QVariantHash downloadedStop;
+    downloadedStop[ "longitude" ] = 8.11;
+    downloadedStop[ "latitude" ] = 53.06;
+    Plasma::DataEngine::Data downloadedElements;
+    downloadedElements.insert( "4", downloadedStop );
+    cache.insertElements( filterKey, QRect(162, 1061, 1, 1), downloadedElements );
+
+    const QString fileName = writeExtract( true );
+    QVERIFY( !fileName.isEmpty() );
+    QString errorText;
+    QCOMPARE( cache.importFile(fileName, "node", STOPS_FILTER, OsmReader::AllResults,
+                               &errorText), 2 );
+    QVERIFY( errorText.isEmpty() );
+
+    // Tiles completely inside the bounds are complete and never expire
+    const QRect completeTiles( QPoint(160, 1060), QPoint(161, 1060) );
+    QVERIFY( cache.missingTiles(filterKey, completeTiles).isNull() );
+
+    // Border tiles are expired and need to be downloaded, but their elements get used
+    QCOMPARE( cache.missingTiles(filterKey, QRect(162, 1060, 1, 1)), QRect(162, 1060, 1, 1) );
+    QCOMPARE( cache.missingTiles(filterKey, QRect(160, 1061, 1, 1)), QRect(160, 1061, 1, 1) );
+    const QRectF box = OsmTileCache::boxForTiles( QRect(QPoint(160, 1060), QPoint(162, 1060)) );
+    QStringList ids = cache.elements( filterKey, box ).keys();
+    qSort( ids );
+    QCOMPARE( ids, QStringList() << "1" << "2" );
+
+    // The downloaded border tile did not get replaced by the expired border tile
+    QVERIFY( cache.missingTiles(filterKey, QRect(162, 1061, 1, 1)).isNull() );
+    QCOMPARE( cache.elements(filterKey, OsmTileCache::boxForTiles(QRect(162, 1061, 1, 1))).keys(),
+              QStringList() << "4" );
+
+    // Import errors
+    QCOMPARE( cache.importFile(m_directory->name() + "missing.osm", "node", STOPS_FILTER,
+                               OsmReader::AllResults, &errorText), -1 );
+    QVERIFY( !errorText.isEmpty() );
+}
+
+void OsmTileCacheTest::importFileWithoutBoundsTest()
+{
+    const QString filterKey = OsmTileCache::filterKey( "node", STOPS_FILTER );
+    OsmTileCache cache( m_directory->name() );
+    const QString fileName = writeExtract( false );
+    QVERIFY( !fileName.isEmpty() );
+    QCOMPARE( cache.importFile(fileName, "node", STOPS_FILTER), 2 );
+
+    // Without bounds it is unknown which tiles the extract covers completely
+    const QRect tiles( QPoint(160, 1060), QPoint(162, 1061) );
+    QCOMPARE( cache.missingTiles(filterKey, tiles), tiles );
+    QStringList ids = cache.elements( filterKey, OsmTileCache::boxForTiles(tiles) ).keys();
+    qSort( ids );
+    QCOMPARE( ids, QStringList() << "1" << "2" );
+}
+
+QTEST_MAIN(OsmTileCacheTest)
+#include "OsmTileCacheTest.moc"
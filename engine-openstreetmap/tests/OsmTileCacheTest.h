@@ -0,0 +1,56 @@
+/*
+ *   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef OSMTILECACHETEST_H
+#define OSMTILECACHETEST_H
+
+#include <QObject>
+
+class KTempDir;
+
+/** @brief Tests the tiled on-disk cache of the OpenStreetMap engine. */
+class OsmTileCacheTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    // Test OsmTileCache::tilesForBox(), OsmTileCache::tilesInsideBox()
+    // and OsmTileCache::boxForTiles()
+    void tileCoordinatesTest();
+
+    // Test storing downloaded elements, reading them back (also from disk) and missing tiles
+    void insertElementsTest();
+
+    // Test importing an extract with <bounds>, border tiles get stored as expired
+    void importFileTest();
+
+    // Test importing an extract without <bounds>, all tiles get stored as expired
+    void importFileWithoutBoundsTest();
+
+private:
+    /** @brief Write an .osm extract with some stops to a file in m_directory. */
+    QString writeExtract( bool withBounds ) const;
+
+    KTempDir *m_directory;
+};
+
+#endif // OSMTILECACHETEST_H
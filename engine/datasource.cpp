@@ -145,6 +145,12 @@ void TimetableDataSource::setTimetableItems( const QVariantList &items )
     m_data[ timetableItemKey() ] = items;
 }
 
+QVariantList TimetableDataSource::takeTimetableItems()
+{
+    // Remove the QVariant from the data hash, so that the list is no longer shared
+    return m_data.take( timetableItemKey() ).toList();
+}
+
 UpdateFlags TimetableDataSource::updateFlags() const
 {
     UpdateFlags flags = NoUpdateFlags;
@@ -267,6 +267,16 @@ public:
      **/
     void setTimetableItems( const QVariantList &items );
 
+    /**
+     * @brief Take the list of timetable items out of this data source.
+     *
+     * The items get removed from the data source, the returned list is not shared with the
+     * data source and can be modified without copying it. Use setTimetableItems() to store the
+     * modified list again.
+     * @see timetableItems()
+     **/
+    QVariantList takeTimetableItems();
+
     /**
      * @brief Get all additional data of this data source.
      * Additional data gets stored by a hash value for the associated timetable item.
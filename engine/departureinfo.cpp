@@ -26,36 +26,89 @@
 // KDE includes
 #include <KDebug>
 
-PublicTransportInfo::PublicTransportInfo(QObject* parent): QObject(parent)
+int PublicTransportInfoData::slotIndex( Enums::TimetableInformation info )
 {
+    switch ( info ) {
+    case Enums::DepartureDateTime:
+        return 0;
+    case Enums::TypeOfVehicle:
+        return 1;
+    case Enums::TransportLine:
+        return 2;
+    case Enums::Target:
+        return 3;
+    case Enums::TargetShortened:
+        return 4;
+    case Enums::Platform:
+        return 5;
+    case Enums::Delay:
+        return 6;
+    case Enums::Operator:
+        return 7;
+    case Enums::RouteStops:
+        return 8;
+    case Enums::RouteStopsShortened:
+        return 9;
+    case Enums::RouteTimes:
+        return 10;
+    case Enums::RouteExactStops:
+        return 11;
+    case Enums::ArrivalDateTime:
+        return 12;
+    case Enums::Duration:
+        return 13;
+    case Enums::StopName:
+        return 14;
+    case Enums::StopID:
+        return 15;
+    default:
+        return -1;
+    }
+}
+
+Enums::TimetableInformation PublicTransportInfoData::slotInformation( int index )
+{
+    static const Enums::TimetableInformation informations[ SLOT_COUNT ] = {
+            Enums::DepartureDateTime, Enums::TypeOfVehicle, Enums::TransportLine, Enums::Target,
+            Enums::TargetShortened, Enums::Platform, Enums::Delay, Enums::Operator,
+            Enums::RouteStops, Enums::RouteStopsShortened, Enums::RouteTimes,
+            Enums::RouteExactStops, Enums::ArrivalDateTime, Enums::Duration,
+            Enums::StopName, Enums::StopID };
+    return informations[ index ];
 }
 
-PublicTransportInfo::~PublicTransportInfo()
+PublicTransportInfo::PublicTransportInfo() : d(new PublicTransportInfoData)
 {
 }
 
 PublicTransportInfo::PublicTransportInfo( const QHash< Enums::TimetableInformation, QVariant >& data,
-                                          Corrections corrections, QObject *parent )
-    : QObject(parent), m_data(data)
+                                          Corrections corrections, const QDateTime &now )
+    : d(new PublicTransportInfoData)
 {
-    m_isValid = false;
+    for ( TimetableData::ConstIterator it = data.constBegin(); it != data.constEnd(); ++it ) {
+        insert( it.key(), it.value() );
+    }
 
     // Insert -1 as Delay if none is given (-1 means "no delay information available")
     if ( !contains(Enums::Delay) ) {
         insert( Enums::Delay, -1 );
     }
 
+    // Only read the current date and time once and only if needed
+    const QDateTime current = corrections == NoCorrection ? QDateTime() : currentDateTime( now );
+    const QTime minimumTime = current.time().addSecs( -5 * 60 );
+
     if ( corrections.testFlag(DeduceMissingValues) ) {
         // Guess date value if none is given,
         // this could produce wrong dates (better give DepartureDate in scripts)
         if ( !contains(Enums::DepartureDate) && contains(Enums::DepartureTime) ) {
             QTime departureTime = value( Enums::DepartureTime ).toTime();
-            if ( departureTime < QTime::currentTime().addSecs(-5 * 60) ) {
+            if ( departureTime < minimumTime ) {
                 kDebug() << "Guessed DepartureDate as tomorrow";
-                insert( Enums::DepartureDate, QDate::currentDate().addDays(1) );
+                insert( Enums::DepartureDate, current.date().addDays(1) );
             } else {
                 kDebug() << "Guessed DepartureDate as today";
-                insert( Enums::DepartureDate, QDate::currentDate() );
+                insert( Enums::DepartureDate, current.date() );
             }
         }
     }
@@ -68,12 +121,12 @@ PublicTransportInfo::PublicTransportInfo( const QHash< Enums::TimetableInformati
                 QDate date;
                 if ( contains(Enums::DepartureDate) ) {
                     date = value( Enums::DepartureDate ).toDate();
-                } else if ( time < QTime::currentTime().addSecs(-5 * 60) ) {
+                } else if ( time < minimumTime ) {
                     kDebug() << "Guessed DepartureDate as tomorrow";
-                    date = QDate::currentDate().addDays( 1 );
+                    date = current.date().addDays( 1 );
                 } else {
                     kDebug() << "Guessed DepartureDate as today";
-                    date = QDate::currentDate();
+                    date = current.date();
                 }
                 insert( Enums::DepartureDateTime, QDateTime(date, time) );
                 remove( Enums::DepartureDate );
@@ -108,9 +161,77 @@ PublicTransportInfo::PublicTransportInfo( const QHash< Enums::TimetableInformati
     }
 }
 
-JourneyInfo::JourneyInfo( const TimetableData &data, Corrections corrections, QObject *parent )
-        : PublicTransportInfo( data, corrections, parent )
+bool PublicTransportInfo::contains( Enums::TimetableInformation info ) const
 {
+    const int index = PublicTransportInfoData::slotIndex( info );
+    return index == -1 ? d->otherValues.contains(info) : (d->slotMask & (1u << index)) != 0;
+}
+
+QVariant PublicTransportInfo::value( Enums::TimetableInformation info ) const
+{
+    const int index = PublicTransportInfoData::slotIndex( info );
+    return index == -1 ? d->otherValues.value(info) : d->slotValues[index];
+}
+
+void PublicTransportInfo::insert( Enums::TimetableInformation info, const QVariant &data )
+{
+    const int index = PublicTransportInfoData::slotIndex( info );
+    if ( index == -1 ) {
+        d->otherValues.insert( info, data );
+    } else {
+        d->slotValues[ index ] = data;
+        d->slotMask |= 1u << index;
+    }
+}
+
+void PublicTransportInfo::remove( Enums::TimetableInformation info )
+{
+    const int index = PublicTransportInfoData::slotIndex( info );
+    if ( index == -1 ) {
+        d->otherValues.remove( info );
+    } else if ( d->slotMask & (1u << index) ) {
+        d->slotValues[ index ] = QVariant();
+        d->slotMask &= ~(1u << index);
+    }
+}
+
+TimetableData PublicTransportInfo::data() const
+{
+    TimetableData data = d->otherValues;
+    for ( int index = 0; index < PublicTransportInfoData::SLOT_COUNT; ++index ) {
+        if ( d->slotMask & (1u << index) ) {
+            data.insert( PublicTransportInfoData::slotInformation(index), d->slotValues[index] );
+        }
+    }
+    return data;
+}
+
+QVariantHash PublicTransportInfo::toVariantHash() const
+{
+    QVariantHash hash;
+    for ( int index = 0; index < PublicTransportInfoData::SLOT_COUNT; ++index ) {
+        if ( (d->slotMask & (1u << index)) && d->slotValues[index].isValid() ) {
+            hash.insert( Global::timetableInformationToString(
+                         PublicTransportInfoData::slotInformation(index)), d->slotValues[index] );
+        }
+    }
+    for ( TimetableData::ConstIterator it = d->otherValues.constBegin();
+          it != d->otherValues.constEnd(); ++it )
+    {
+        if ( it.value().isValid() ) {
+            hash.insert( Global::timetableInformationToString(it.key()), it.value() );
+        }
+    }
+    return hash;
+}
+
+JourneyInfo::JourneyInfo( const TimetableData &data, Corrections corrections,
+                          const QDateTime &now )
+        : PublicTransportInfo( data, corrections, now )
+{
+    const QDateTime current = corrections == NoCorrection ? QDateTime() : currentDateTime( now );
+    const QTime minimumTime = current.time().addSecs( -5 * 60 );
+
     if ( corrections.testFlag(DeduceMissingValues) ) {
         // Guess arrival date value if none is given,
         // this could produce wrong dates (better give ArrivalDate eg. in scripts)
@@ -118,10 +239,10 @@ JourneyInfo::JourneyInfo( const TimetableData &data, Corrections corrections, QO
              !contains(Enums::ArrivalDate) && contains(Enums::ArrivalTime) )
         {
             QTime arrivalTime = value(Enums::ArrivalTime).toTime();
-            if ( arrivalTime < QTime::currentTime().addSecs(-5 * 60) ) {
-                insert( Enums::ArrivalDate, QDate::currentDate().addDays(1) );
+            if ( arrivalTime < minimumTime ) {
+                insert( Enums::ArrivalDate, current.date().addDays(1) );
             } else {
-                insert( Enums::ArrivalDate, QDate::currentDate() );
+                insert( Enums::ArrivalDate, current.date() );
             }
         }
 
@@ -245,12 +366,12 @@ JourneyInfo::JourneyInfo( const TimetableData &data, Corrections corrections, QO
                 QDate date;
                 if ( contains(Enums::ArrivalDate) ) {
                     date = value( Enums::ArrivalDate ).toDate();
-                } else if ( time < QTime::currentTime().addSecs(-5 * 60) ) {
+                } else if ( time < minimumTime ) {
                     kDebug() << "Guessed ArrivalDate as tomorrow";
-                    date = QDate::currentDate().addDays( 1 );
+                    date = current.date().addDays( 1 );
                 } else {
                     kDebug() << "Guessed ArrivalDate as today";
-                    date = QDate::currentDate();
+                    date = current.date();
                 }
                 insert( Enums::ArrivalDateTime, QDateTime(date, time) );
                 remove( Enums::ArrivalDate );
@@ -261,25 +382,22 @@ JourneyInfo::JourneyInfo( const TimetableData &data, Corrections corrections, QO
         }
     }
 
-    m_isValid = contains(Enums::DepartureDateTime) && contains(Enums::ArrivalDateTime) &&
-                contains(Enums::StartStopName) && contains(Enums::TargetStopName);
-}
-
-StopInfo::StopInfo( QObject *parent ) : PublicTransportInfo(parent)
-{
-    m_isValid = false;
+    d->isValid = contains(Enums::DepartureDateTime) && contains(Enums::ArrivalDateTime) &&
+                 contains(Enums::StartStopName) && contains(Enums::TargetStopName);
 }
 
-StopInfo::StopInfo( const QHash< Enums::TimetableInformation, QVariant >& data, QObject *parent )
-    : PublicTransportInfo(parent)
+StopInfo::StopInfo( const QHash< Enums::TimetableInformation, QVariant >& data )
+    : PublicTransportInfo()
 {
-    m_data.unite( data );
-    m_isValid = contains( Enums::StopName );
+    for ( TimetableData::ConstIterator it = data.constBegin(); it != data.constEnd(); ++it ) {
+        insert( it.key(), it.value() );
+    }
+    d->isValid = contains( Enums::StopName );
 }
 
 StopInfo::StopInfo( const QString &name, const QString& id, int weight,
                     qreal longitude, qreal latitude, const QString &city,
-                    const QString &countryCode, QObject *parent ) : PublicTransportInfo(parent)
+                    const QString &countryCode ) : PublicTransportInfo()
 {
     insert( Enums::StopName, name );
     if ( !id.isNull() ) {
@@ -301,16 +419,12 @@ StopInfo::StopInfo( const QString &name, const QString& id, int weight,
         insert( Enums::StopWeight, weight );
     }
 
-    m_isValid = !name.isEmpty();
-}
-
-DepartureInfo::DepartureInfo( QObject *parent ) : PublicTransportInfo(parent)
-{
-    m_isValid = false;
+    d->isValid = !name.isEmpty();
 }
 
-DepartureInfo::DepartureInfo( const TimetableData &data, Corrections corrections, QObject *parent )
-        : PublicTransportInfo( data, corrections, parent )
+DepartureInfo::DepartureInfo( const TimetableData &data, Corrections corrections,
+                              const QDateTime &now )
+        : PublicTransportInfo( data, corrections, now )
 {
     if ( (contains(Enums::RouteStops) || contains(Enums::RouteTimes)) &&
          value(Enums::RouteTimes).toList().count() != value(Enums::RouteStops).toStringList().count() )
@@ -338,8 +452,8 @@ DepartureInfo::DepartureInfo( const TimetableData &data, Corrections corrections
         }
     }
 
-    m_isValid = contains( Enums::TransportLine ) && contains( Enums::Target ) &&
-                contains( Enums::DepartureDateTime );
+    d->isValid = contains( Enums::TransportLine ) && contains( Enums::Target ) &&
+                 contains( Enums::DepartureDateTime );
 }
 
 QStringList JourneyInfo::vehicleIconNames() const
@@ -31,7 +31,9 @@
 #include <QVariant>
 #include <QTime>
 #include <QStringList>
-#include <QPointer>
+#include <QDateTime>
+#include <QSharedData>
+#include <QVector>
 
 /**
  * @brief LineService-Flags.
@@ -40,12 +42,49 @@
 Q_DECLARE_FLAGS( LineServices, Enums::LineService )
 
 /**
- * @brief This is the abstract base class of all other timetable information classes.
+ * @brief Shared data of PublicTransportInfo objects.
+ *
+ * Values for the most common TimetableInformations are stored in fixed slots, which do not
+ * need to be allocated for each value like hash nodes. Other values are stored in a hash.
+ * @internal
+ **/
+class PublicTransportInfoData : public QSharedData {
+public:
+    /** @brief The number of fixed value slots. */
+    static const int SLOT_COUNT = 16;
+
+    PublicTransportInfoData() : slotMask(0), isValid(false) {};
+
+    /**
+     * @brief Get the index of the fixed slot for @p info.
+     * @return The slot index or -1, if values for @p info are stored in otherValues.
+     **/
+    static int slotIndex( Enums::TimetableInformation info );
+
+    /** @brief The TimetableInformation stored in the fixed slot with @p index. */
+    static Enums::TimetableInformation slotInformation( int index );
+
+    QVariant slotValues[ SLOT_COUNT ];
+    quint32 slotMask; // Bit i is set if slotValues[i] contains a value
+    TimetableData otherValues;
+    LineServices lineServices;
+    bool isValid;
+};
+
+/**
+ * @brief This is the base class of all other timetable information classes.
+ *
+ * Timetable information objects are implicitly shared values. Copies share their data until
+ * one of them gets modified, copies between the derived classes and this class are cheap.
+ *
+ * The constructors taking TimetableData can correct the given values, eg. guess missing dates.
+ * Pass the current date and time as @p now, when creating many objects at once.
  *
  * @see JourneyInfo
  * @see DepartureInfo
+ * @see StopInfo
  **/
-class PublicTransportInfo : public QObject {
+class PublicTransportInfo {
 public:
     /** @brief Options for stop names, eg. use a shortened form or not. */
     enum StopNameOptions {
@@ -53,8 +92,8 @@ public:
         UseShortenedStopNames /**< Use a shortened form of the stop names. */
     };
 
-    /** @brief Constructs a new PublicTransportInfo object. */
-    PublicTransportInfo( QObject *parent = 0 );
+    /** @brief Constructs a new invalid PublicTransportInfo object. */
+    PublicTransportInfo();
 
     enum Correction {
         NoCorrection                    = 0x0000,
@@ -73,22 +112,29 @@ public:
      *   with @p data.
      *
      * @param data A hash that contains values for TimetableInformations.
+     * @param corrections The corrections to apply to the values in @p data.
+     * @param now The current date and time, used to guess missing dates. If this is invalid,
+     *   the current date and time gets read, if needed for @p corrections.
      **/
     explicit PublicTransportInfo( const TimetableData &data,
                                   Corrections corrections = CorrectEverything,
-                                  QObject *parent = 0 );
+                                  const QDateTime &now = QDateTime() );
 
-    virtual ~PublicTransportInfo();
-
-    bool contains( Enums::TimetableInformation info ) const { return m_data.contains(info); };
-    QVariant value( Enums::TimetableInformation info ) const { return m_data[info]; };
-    void insert( Enums::TimetableInformation info, const QVariant &data ) {
-        m_data.insert( info, data );
-    };
-    void remove( Enums::TimetableInformation info ) { m_data.remove(info); };
+    bool contains( Enums::TimetableInformation info ) const;
+    QVariant value( Enums::TimetableInformation info ) const;
+    void insert( Enums::TimetableInformation info, const QVariant &data );
+    void remove( Enums::TimetableInformation info );
 
     /** @brief Returns the TimetableData object for this item. */
-    TimetableData data() const { return m_data; };
+    TimetableData data() const;
+
+    /**
+     * @brief Get all valid values with TimetableInformation names as keys.
+     *
+     * This is the format used for timetable items in data sources.
+     * @see Global::timetableInformationToString()
+     **/
+    QVariantHash toVariantHash() const;
 
     /**
      * @brief Wheather or not this PublicTransportInfo object is valid.
@@ -96,11 +142,23 @@ public:
      * @return true if the PublicTransportInfo object is valid.
      * @return false if the PublicTransportInfo object is invalid.
      **/
-    virtual bool isValid() const { return m_isValid; };
+    bool isValid() const { return d->isValid; };
+
+    /**
+     * @brief Whether or not this object shares its data with @p other.
+     *
+     * This is true for unmodified copies of the same object and can be used to check for
+     * identity without comparing values.
+     **/
+    bool isSharedWith( const PublicTransportInfo &other ) const { return d == other.d; };
 
 protected:
-    bool m_isValid;
-    TimetableData m_data;
+    /** @brief Get the current date and time, if @p now is invalid. */
+    static QDateTime currentDateTime( const QDateTime &now ) {
+        return now.isValid() ? now : QDateTime::currentDateTime();
+    };
+
+    QSharedDataPointer< PublicTransportInfoData > d;
 };
 
 /**
@@ -111,6 +169,12 @@ protected:
  */
 class JourneyInfo : public PublicTransportInfo {
 public:
+    /** @brief Constructs an invalid JourneyInfo object. */
+    JourneyInfo() : PublicTransportInfo() {};
+
+    /** @brief Constructs a JourneyInfo object sharing the data of @p info. */
+    explicit JourneyInfo( const PublicTransportInfo &info ) : PublicTransportInfo(info) {};
+
     /**
      * @brief Contructs a new JourneyInfo object based on the information given with @p data.
      *
@@ -120,7 +184,7 @@ public:
      *   If only DepartureTime gets used, the date is guessed. The same is true for ArrivalDateTime.
      **/
     explicit JourneyInfo( const TimetableData &data, Corrections corrections = CorrectEverything,
-                          QObject *parent = 0 );
+                          const QDateTime &now = QDateTime() );
 
     QStringList vehicleIconNames() const;
     QStringList vehicleNames( bool plural = false ) const;
@@ -135,7 +199,10 @@ public:
 class DepartureInfo : public PublicTransportInfo {
 public:
     /** @brief Constructs an invalid DepartureInfo object. */
-    DepartureInfo( QObject *parent = 0 );
+    DepartureInfo() : PublicTransportInfo() {};
+
+    /** @brief Constructs a DepartureInfo object sharing the data of @p info. */
+    explicit DepartureInfo( const PublicTransportInfo &info ) : PublicTransportInfo(info) {};
 
     /**
      * @brief Contructs a new DepartureInfo object based on the information given with @p data.
@@ -146,16 +213,13 @@ public:
      *   gets used, the date is guessed.
      **/
     explicit DepartureInfo( const TimetableData &data, Corrections corrections = CorrectEverything,
-                            QObject *parent = 0 );
+                            const QDateTime &now = QDateTime() );
 
     /** @brief Wheather or not the departing / arriving vehicle is a night line. */
-    bool isNightLine() const { return m_lineServices.testFlag( Enums::NightLine ); };
+    bool isNightLine() const { return d->lineServices.testFlag( Enums::NightLine ); };
 
     /** @brief Wheather or not the departing / arriving vehicle is an express line. */
-    bool isExpressLine() const { return m_lineServices.testFlag( Enums::ExpressLine ); };
-
-private:
-    LineServices m_lineServices;
+    bool isExpressLine() const { return d->lineServices.testFlag( Enums::ExpressLine ); };
 };
 
 /**
@@ -167,14 +231,17 @@ private:
 class StopInfo : public PublicTransportInfo {
 public:
     /** @brief Constructs an invalid StopInfo object. */
-    StopInfo( QObject *parent = 0 );
+    StopInfo() : PublicTransportInfo() {};
+
+    /** @brief Constructs a StopInfo object sharing the data of @p info. */
+    explicit StopInfo( const PublicTransportInfo &info ) : PublicTransportInfo(info) {};
 
     /**
      * @brief Contructs a new StopInfo object based on the information given with @p data.
      *
      * @param data A hash that contains values for at least the required TimetableInformations
      *   (StopName). */
-    StopInfo( const QHash<Enums::TimetableInformation, QVariant> &data, QObject *parent = 0 );
+    explicit StopInfo( const QHash<Enums::TimetableInformation, QVariant> &data );
 
     /**
      * @brief Constructs a new StopInfo object.
@@ -188,19 +255,19 @@ public:
      */
     StopInfo( const QString &name, const QString &id = QString(), int weight = -1,
               qreal longitude = 0.0, qreal latitude = 0.0, const QString &city = QString(),
-              const QString &countryCode = QString(), QObject *parent = 0 );
+              const QString &countryCode = QString() );
 };
 
+Q_DECLARE_TYPEINFO( PublicTransportInfo, Q_MOVABLE_TYPE );
+Q_DECLARE_TYPEINFO( JourneyInfo, Q_MOVABLE_TYPE );
+Q_DECLARE_TYPEINFO( DepartureInfo, Q_MOVABLE_TYPE );
+Q_DECLARE_TYPEINFO( StopInfo, Q_MOVABLE_TYPE );
+
 typedef DepartureInfo ArrivalInfo;
-typedef QSharedPointer< PublicTransportInfo > PublicTransportInfoPtr;
-typedef QSharedPointer< DepartureInfo > DepartureInfoPtr;
-typedef QSharedPointer< ArrivalInfo > ArrivalInfoPtr;
-typedef QSharedPointer< JourneyInfo > JourneyInfoPtr;
-typedef QSharedPointer< StopInfo > StopInfoPtr;
-typedef QList< PublicTransportInfoPtr > PublicTransportInfoList;
-typedef QList< DepartureInfoPtr > DepartureInfoList;
-typedef QList< ArrivalInfoPtr > ArrivalInfoList;
-typedef QList< JourneyInfoPtr > JourneyInfoList;
-typedef QList< StopInfoPtr > StopInfoList;
+typedef QVector< PublicTransportInfo > PublicTransportInfoList;
+typedef QVector< DepartureInfo > DepartureInfoList;
+typedef QVector< ArrivalInfo > ArrivalInfoList;
+typedef QVector< JourneyInfo > JourneyInfoList;
+typedef QVector< StopInfo > StopInfoList;
 
 #endif // DEPARTUREINFO_HEADER
@@ -267,6 +267,19 @@ QString namePlural = vehicleData["namePlural"].toString();
 KIcon icon = KIcon( vehicleData["iconName"].toString() );
 @endcode
 
+<br />
+@section usage_diagnostics_sec Receiving Diagnostic Information
+The data source @em "Diagnostics" contains statistics about internal caches of the engine.
+It gets refreshed each time it gets requested or updated. Currently it contains these keys:
+<br />
+<table>
+<tr><td><i>regExpCache</i></td> <td>QVariantHash</td> <td>Statistics about the cache of compiled
+regular expressions used by script helper functions, see ScriptApi::RegExpCache. Contains the
+number of cache <i>hits</i> and <i>misses</i>, the <i>hitRate</i> (0.0 - 1.0), the current
+<i>size</i> and the <i>maxSize</i> of the cache. Only available if the engine was built with
+support for scripted providers.</td></tr>
+</table>
+
 <br />
 @section usage_departures_sec Receiving Departures or Arrivals
 To get a list of departures/arrivals you need to construct the name of the data source. For
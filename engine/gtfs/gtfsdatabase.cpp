@@ -24,12 +24,65 @@
 #include <KStandardDirs>
 
 #include <QDate>
+#include <QMap>
+#include <QStringList>
 #include <QColor>
 #include <QUrl>
 #include <QVariant>
 #include <QSqlDatabase>
 #include <QSqlError>
 #include <QSqlQuery>
+#include <QThread>
+#include <QThreadStorage>
+#include <QMutex>
+#include <QHash>
+#include <QVector>
+
+const char *GtfsDatabase::ROUTE_SEPARATOR = "||";
+
+/** @brief Tracks read-only connections of threads, see GtfsDatabase::readOnlyDatabase(). */
+struct ReadOnlyConnections {
+    QMutex mutex;
+    QHash< QString, int > generations; // Incremented in closeDatabase() for each provider
+    QHash< QString, int > connectionGenerations; // The generation each connection was opened in
+};
+K_GLOBAL_STATIC( ReadOnlyConnections, readOnlyConnections )
+
+/** @brief Prepared queries of all connections of one thread, see GtfsDatabase::preparedQuery(). */
+class PreparedQueries {
+public:
+    ~PreparedQueries() {
+        foreach ( const QVector<QSqlQuery*> &queries, queries ) {
+            qDeleteAll( queries );
+        }
+    };
+
+    QHash< QString, QVector<QSqlQuery*> > queries; // Indexed by GtfsDatabase::Statement
+};
+static QThreadStorage< PreparedQueries* > preparedQueries;
+
+/** @brief Dates at which a service is available, see GtfsDatabase::updateServiceDays(). */
+struct ServiceDates {
+    QString weekdays; // Beginning with sunday, empty if not in "calendar"
+    QDate startDate;
+    QDate endDate;
+    QMap< QDate, bool > exceptions; // True if the service is added at a date, false if removed
+};
+
+/** @brief Delete all prepared queries of the connection @p connectionName in this thread. */
+static void clearPreparedQueries( const QString &connectionName )
+{
+    if ( preparedQueries.hasLocalData() ) {
+        qDeleteAll( preparedQueries.localData()->queries.take(connectionName) );
+    }
+}
+
+/** @brief Get the name of the read-only connection of the current thread for @p providerName. */
+static QString readOnlyConnectionName( const QString &providerName )
+{
+    return QString("%1_readonly_%2").arg( providerName )
+            .arg( quintptr(QThread::currentThreadId()) );
+}
 
 QString GtfsDatabase::databasePath( const QString &providerName )
 {
@@ -54,11 +107,206 @@ bool GtfsDatabase::initDatabase( const QString &providerName, QString *errorText
             *errorText = "Error opening the database connection " + db.lastError().text();
             return false;
         }
+
+        // Use write-ahead logging, readers do not block writers and a writer does not block
+        // readers, ie. read-only connections can be used while importing a GTFS feed
+        QSqlQuery query( db );
+        if ( !query.exec("PRAGMA journal_mode=WAL") ) {
+            kDebug() << "Could not enable write-ahead logging" << query.lastError();
+        }
+
+        // Databases imported by older versions have no 'service_days' table, which is needed
+        // for departure/arrival queries, create it from the imported calendar data
+        const QStringList tables = db.tables();
+        if ( tables.contains("calendar") && !tables.contains("service_days") ) {
+            kDebug() << "Create missing 'service_days' table for" << providerName;
+            if ( !createDatabaseTables(errorText, db) || !updateServiceDays(errorText, db) ) {
+                return false;
+            }
+        }
     }
 
     return true;
 }
 
+void GtfsDatabase::closeDatabase( const QString &providerName )
+{
+    database( providerName ).close();
+
+    // Let read-only connections get reopened when they get used the next time,
+    // eg. after the database file was deleted
+    QMutexLocker locker( &readOnlyConnections->mutex );
+    ++readOnlyConnections->generations[ providerName ];
+}
+
+QSqlDatabase GtfsDatabase::readOnlyDatabase( const QString &providerName, QString *errorText )
+{
+    const QString connectionName = readOnlyConnectionName( providerName );
+
+    // Check if the connection of this thread was opened before the database was closed last
+    readOnlyConnections->mutex.lock();
+    const int generation = readOnlyConnections->generations.value( providerName );
+    const bool outdated =
+            readOnlyConnections->connectionGenerations.value( connectionName, -1 ) != generation;
+    readOnlyConnections->connectionGenerations[ connectionName ] = generation;
+    readOnlyConnections->mutex.unlock();
+
+    QSqlDatabase db = QSqlDatabase::database( connectionName, false );
+    if ( db.isValid() && db.isOpen() && !outdated ) {
+        return db;
+    }
+
+    if ( !db.isValid() ) {
+        db = QSqlDatabase::addDatabase( "QSQLITE", connectionName );
+        if ( !db.isValid() ) {
+            kDebug() << "Error adding a QSQLITE database" << db.lastError();
+            if ( errorText ) {
+                *errorText = "Error adding a QSQLITE database " + db.lastError().text();
+            }
+            return db;
+        }
+    } else {
+        clearPreparedQueries( connectionName );
+        db.close();
+    }
+
+    db.setDatabaseName( databasePath(providerName) );
+    db.setConnectOptions( "QSQLITE_OPEN_READONLY;QSQLITE_BUSY_TIMEOUT=5000" );
+    if ( !db.open() ) {
+        kDebug() << "Error opening a read-only database connection" << db.lastError();
+        if ( errorText ) {
+            *errorText = "Error opening a read-only database connection " +
+                         db.lastError().text();
+        }
+    }
+    return db;
+}
+
+void GtfsDatabase::closeReadOnlyDatabase( const QString &providerName )
+{
+    const QString connectionName = readOnlyConnectionName( providerName );
+    clearPreparedQueries( connectionName );
+    QSqlDatabase::database( connectionName, false ).close();
+}
+
+QString GtfsDatabase::statementSql( Statement statement )
+{
+    switch ( statement ) {
+    case StopIdStatement:
+        // Only select stops, no stations (with one or more sub stops) by requiring
+        // 'location_type=0', location_type 1 is for stations.
+        // It's fast, because there is an index for 'stop_name' in the database.
+        return "SELECT stops.stop_id FROM stops "
+               "WHERE stop_name=:stopName AND (location_type IS NULL OR location_type=0)";
+
+    case DeparturesStatement:
+    case ArrivalsStatement:
+    case FrequencyDeparturesStatement:
+    case FrequencyArrivalsStatement: {
+        // Query the needed departure info from the database.
+        // It's fast, because all JOINs are done using INTEGER PRIMARY KEYs and
+        // because 'stop_id' and 'departure_time' are part of a compound index in the database.
+        // Sorting by 'arrival_time' may be a bit slower because is has no index in the database,
+        // but if arrival_time values do not differ too much from the deaprture_time values, they
+        // are also already sorted.
+        // The tables 'calendar' and 'calendar_dates' are implemented using the 'service_days'
+        // table, which contains a character for each day at which a service may be available.
+        // Testing the character for the julian day :day is a single lookup by primary key.
+        // Trips in the 'frequencies' table are only templates, their stop times are relative to
+        // the first departure of the trip. The frequency statements get the template trips with
+        // all their frequency periods, GtfsQueryJob enumerates the trip instances of the periods.
+        const bool arrivals = statement == ArrivalsStatement ||
+                              statement == FrequencyArrivalsStatement;
+        const bool frequencies = statement == FrequencyDeparturesStatement ||
+                                 statement == FrequencyArrivalsStatement;
+        QString sql =
+            "SELECT times.departure_time, times.arrival_time, times.stop_headsign, "
+                   "routes.route_type, routes.route_short_name, routes.route_long_name, "
+                   "trips.trip_headsign, routes.agency_id, stops.stop_id, trips.trip_id, "
+                   "routes.route_id, times.stop_sequence, "
+                   "( SELECT group_concat(route_stop.stop_name, '%2') AS route_stops "
+                     "FROM stop_times AS route_times INNER JOIN stops AS route_stop USING (stop_id) "
+                     "WHERE route_times.trip_id=times.trip_id AND route_times.stop_sequence %1= times.stop_sequence "
+                     "ORDER BY departure_time ) AS route_stops, "
+                   "( SELECT group_concat(route_times.departure_time, '%2') AS route_times "
+                     "FROM stop_times AS route_times "
+                     "WHERE route_times.trip_id=times.trip_id AND route_times.stop_sequence %1= times.stop_sequence "
+                     "ORDER BY departure_time ) AS route_times ";
+//                    "( SELECT min(price) FROM tmp_fares WHERE origin_id=stops.zone_id AND price>0 ) AS min_price, "
+//                    "( SELECT max(price) FROM tmp_fares WHERE origin_id=stops.zone_id ) AS max_price, "
+//                    "( SELECT currency_type FROM tmp_fares WHERE origin_id=stops.zone_id LIMIT 1 ) AS currency_type "
+        if ( frequencies ) {
+            // Additional columns, these need to be the last ones, see GtfsQueryJob
+            sql += ", frequencies.start_time, frequencies.end_time, frequencies.headway_secs, "
+                   "( SELECT first_times.departure_time FROM stop_times AS first_times "
+                     "WHERE first_times.trip_id=times.trip_id "
+                     "ORDER BY first_times.stop_sequence LIMIT 1 ) AS first_departure_time ";
+        }
+        sql += "FROM stops INNER JOIN stop_times AS times USING (stop_id) "
+                          "INNER JOIN trips USING (trip_id) "
+                          "INNER JOIN routes USING (route_id) "
+                          "LEFT JOIN service_days USING (service_id) ";
+        if ( frequencies ) {
+            sql += "INNER JOIN frequencies ON (frequencies.trip_id=times.trip_id) ";
+        }
+        sql += "WHERE stop_id=:stopId "
+                     "AND (service_days.days IS NULL " // No matching record in calendar/calendar_dates => always available
+                          "OR substr(service_days.days, " // The service is available at :day, days before first_day...
+                                    "max(:day - service_days.first_day, -1) + 1, 1)='1') "; // ...give position 0, ie. an empty string
+        if ( !frequencies ) {
+            sql += "AND departure_time>:time "
+                   "AND NOT EXISTS (SELECT 1 FROM frequencies WHERE frequencies.trip_id=times.trip_id) " // Template trips are not scheduled
+                   "ORDER BY departure_time "
+                   "LIMIT :count";
+        }
+        return sql.arg( arrivals ? '<' : '>' ) // For arrivals route_stops/route_times need stops before the home stop
+                  .arg( QLatin1String(ROUTE_SEPARATOR) );
+    }
+
+    case StopSuggestionsStatement:
+        return "SELECT * FROM stops WHERE stop_name LIKE :pattern LIMIT :limit";
+
+    case StopsByGeoPositionStatement:
+        return "SELECT * FROM stops "
+               "WHERE stop_lon BETWEEN :minLongitude AND :maxLongitude "
+               "AND stop_lat BETWEEN :minLatitude AND :maxLatitude LIMIT :limit";
+
+    default:
+        kWarning() << "Unknown statement" << statement;
+        return QString();
+    }
+}
+
+QSqlQuery *GtfsDatabase::preparedQuery( Statement statement, const QSqlDatabase &database,
+                                        QString *errorText )
+{
+    if ( !preparedQueries.hasLocalData() ) {
+        preparedQueries.setLocalData( new PreparedQueries );
+    }
+
+    // Get the prepared queries for the connection, create a new vector for new connections
+    QVector< QSqlQuery* > &queries =
+            preparedQueries.localData()->queries[ database.connectionName() ];
+    if ( queries.isEmpty() ) {
+        queries.fill( 0, StatementCount );
+    }
+
+    QSqlQuery *&query = queries[ statement ];
+    if ( !query ) {
+        query = new QSqlQuery( database );
+        query->setForwardOnly( true ); // Don't cache records
+        if ( !query->prepare(statementSql(statement)) ) {
+            kDebug() << "Error preparing statement" << statement << query->lastError();
+            if ( errorText ) {
+                *errorText = "Error preparing statement: " + query->lastError().text();
+            }
+            delete query;
+            query = 0;
+        }
+    }
+    return query;
+}
+
 bool GtfsDatabase::createDatabaseTables( QString *errorText, QSqlDatabase database )
 {
     QSqlQuery query( database );
@@ -136,6 +384,14 @@ bool GtfsDatabase::createDatabaseTables( QString *errorText, QSqlDatabase databa
         *errorText = "Error creating index for 'stop_name' in 'stops' table: " + query.lastError().text();
         return false;
     }
+    // Create an index to quickly find stops by name, used for StopIdStatement,
+    // the index above cannot be used for that because 'stop_id' is it's first column
+    query.prepare( "CREATE INDEX IF NOT EXISTS stops_stop_name ON stops(stop_name);" );
+    if( !query.exec() ) {
+        kDebug() << "Error creating index for 'stop_name' in 'stops' table:" << query.lastError() << query.lastQuery();
+        *errorText = "Error creating index for 'stop_name' in 'stops' table: " + query.lastError().text();
+        return false;
+    }
 
 // Not used
 //     // Create table for "shapes.txt"
@@ -225,6 +481,19 @@ bool GtfsDatabase::createDatabaseTables( QString *errorText, QSqlDatabase databa
         return false;
     }
 
+    // Create table with the dates at which services are available, combines "calendar" and
+    // "calendar_dates", filled by updateServiceDays()
+    query.prepare( "CREATE TABLE IF NOT EXISTS service_days ("
+                   "service_id INTEGER UNIQUE PRIMARY KEY NOT NULL, " // Uniquely identifies a set of dates when service is available, from "calendar" or "calendar_dates"
+                   "first_day INTEGER NOT NULL, " // The julian day of the first character in 'days'
+                   "days TEXT NOT NULL" // One character for each day beginning at 'first_day', '1' if the service is available at that day, '0' otherwise
+                   ")" );
+    if( !query.exec() ) {
+        kDebug() << "Error creating 'service_days' table:" << query.lastError();
+        *errorText = "Error creating 'service_days' table: " + query.lastError().text();
+        return false;
+    }
+
     // Create table for "fare_attributes.txt"
     query.prepare( "CREATE TABLE IF NOT EXISTS fare_attributes ("
                    "fare_id INTEGER UNIQUE PRIMARY KEY NOT NULL, " // (required) Uniquely identifies a fare class
@@ -261,10 +530,11 @@ bool GtfsDatabase::createDatabaseTables( QString *errorText, QSqlDatabase databa
 
     // Create table for "frequencies.txt"
     query.prepare( "CREATE TABLE IF NOT EXISTS frequencies ("
-                   "trip_id INTEGER PRIMARY KEY NOT NULL, " // (required) Identifies a trip on which the specified frequency of service applies
+                   "trip_id INTEGER NOT NULL, " // (required) Identifies a trip on which the specified frequency of service applies, a trip can have multiple frequency periods
                    "start_time INTEGER NOT NULL, " // (required) Specifies the time at which service begins with the specified frequency, HH:MM:SS or H:MM:SS, can be > 23:59:59 for times on the next day, eg. for trips that span with multiple dates
                    "end_time INTEGER NOT NULL, " // (required) Indicates the time at which service changes to a different frequency (or ceases) at the first stop in the trip, HH:MM:SS or H:MM:SS, can be > 23:59:59 for times on the next day, eg. for trips that span with multiple dates
                    "headway_secs INTEGER NOT NULL, " // (required) Indicates the time between departures from the same stop (headway) for this trip type, during the time interval specified by start_time and end_time, in seconds
+                   "PRIMARY KEY(trip_id, start_time), "
                    "FOREIGN KEY(trip_id) REFERENCES trips(trip_id)"
                    ")" );
     if( !query.exec() ) {
@@ -291,6 +561,113 @@ bool GtfsDatabase::createDatabaseTables( QString *errorText, QSqlDatabase databa
     return true;
 }
 
+bool GtfsDatabase::updateServiceDays( QString *errorText, QSqlDatabase database )
+{
+    QHash< uint, ServiceDates > services;
+
+    QSqlQuery query( database );
+    query.setForwardOnly( true );
+    if ( !query.exec("SELECT service_id, weekdays, start_date, end_date FROM calendar") ) {
+        kDebug() << "Error reading the 'calendar' table:" << query.lastError();
+        *errorText = "Error reading the 'calendar' table: " + query.lastError().text();
+        return false;
+    }
+    while ( query.next() ) {
+        ServiceDates &service = services[ query.value(0).toUInt() ];
+        service.weekdays = query.value( 1 ).toString();
+        service.startDate = QDate::fromString( query.value(2).toString(), "yyyyMMdd" );
+        service.endDate = QDate::fromString( query.value(3).toString(), "yyyyMMdd" );
+    }
+
+    if ( !query.exec("SELECT service_id, date, exception_type FROM calendar_dates") ) {
+        kDebug() << "Error reading the 'calendar_dates' table:" << query.lastError();
+        *errorText = "Error reading the 'calendar_dates' table: " + query.lastError().text();
+        return false;
+    }
+    while ( query.next() ) {
+        const QDate date = QDate::fromString( query.value(1).toString(), "yyyyMMdd" );
+        if ( date.isValid() ) {
+            services[ query.value(0).toUInt() ].exceptions.insert( date,
+                                                                  query.value(2).toInt() == 1 );
+        }
+    }
+    query.finish();
+
+    if ( !database.transaction() ) {
+        kDebug() << "Could not begin a transaction" << database.lastError();
+    }
+    if ( !query.exec("DELETE FROM service_days") ||
+         !query.prepare("INSERT INTO service_days (service_id, first_day, days) "
+                        "VALUES (:serviceId, :firstDay, :days)") )
+    {
+        kDebug() << "Error clearing the 'service_days' table:" << query.lastError();
+        *errorText = "Error clearing the 'service_days' table: " + query.lastError().text();
+        database.rollback();
+        return false;
+    }
+
+    for ( QHash<uint, ServiceDates>::ConstIterator it = services.constBegin();
+          it != services.constEnd(); ++it )
+    {
+        // Get the range of dates in which the service may be available
+        const ServiceDates &service = *it;
+        const bool hasCalendar = service.weekdays.length() == 7 && service.startDate.isValid() &&
+                                 service.endDate.isValid() && service.startDate <= service.endDate;
+        QDate firstDate = hasCalendar ? service.startDate : QDate();
+        QDate lastDate = hasCalendar ? service.endDate : QDate();
+        if ( !service.exceptions.isEmpty() ) {
+            const QDate firstException = service.exceptions.constBegin().key();
+            const QDate lastException = (service.exceptions.constEnd() - 1).key();
+            if ( !firstDate.isValid() || firstException < firstDate ) {
+                firstDate = firstException;
+            }
+            if ( !lastDate.isValid() || lastException > lastDate ) {
+                lastDate = lastException;
+            }
+        }
+
+        // Set one character for each day in the range, for the weekdays from "calendar" first
+        // and then apply the exceptions from "calendar_dates"
+        QString days;
+        if ( firstDate.isValid() ) {
+            days.fill( '0', firstDate.daysTo(lastDate) + 1 );
+            if ( hasCalendar ) {
+                for ( QDate date = service.startDate; date <= service.endDate;
+                      date = date.addDays(1) )
+                {
+                    // QDate::dayOfWeek() returns 7 for sunday, weekdays begin with sunday
+                    if ( service.weekdays[date.dayOfWeek() % 7] == '1' ) {
+                        days[ firstDate.daysTo(date) ] = '1';
+                    }
+                }
+            }
+            for ( QMap<QDate, bool>::ConstIterator exception = service.exceptions.constBegin();
+                  exception != service.exceptions.constEnd(); ++exception )
+            {
+                days[ firstDate.daysTo(exception.key()) ] = exception.value() ? '1' : '0';
+            }
+        }
+
+        query.bindValue( ":serviceId", it.key() );
+        query.bindValue( ":firstDay", firstDate.isValid() ? firstDate.toJulianDay() : 0 );
+        query.bindValue( ":days", days );
+        if ( !query.exec() ) {
+            kDebug() << "Error filling the 'service_days' table:" << query.lastError();
+            *errorText = "Error filling the 'service_days' table: " + query.lastError().text();
+            database.rollback();
+            return false;
+        }
+    }
+
+    if ( !database.commit() ) {
+        kDebug() << "Could not commit the 'service_days' table" << database.lastError();
+        *errorText = "Could not commit the 'service_days' table: " +
+                     database.lastError().text();
+        return false;
+    }
+    return true;
+}
+
 QVariant GtfsDatabase::convertFieldValue( const QByteArray &fieldValue,
                                                         FieldType type )
 {
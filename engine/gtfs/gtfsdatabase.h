@@ -29,12 +29,19 @@
 
 class QString;
 class QVariant;
+class QSqlQuery;
 
 /**
  * @brief Provides static methods to handle a GTFS database.
  *
  * @warning Before using any other method, @ref initDatabase must be called to open a connection
  *   to the correct database for a specific provider.
+ *
+ * The database uses write-ahead logging (WAL), which allows read-only connections of other
+ * threads (see readOnlyDatabase()) to read while a GTFS feed gets imported.
+ *
+ * Statements used to request timetable data get prepared once for each connection using
+ * preparedQuery(), values get bound to their named placeholders before execution.
  **/
 class GtfsDatabase {
 public:
@@ -59,6 +66,39 @@ public:
         Url /**< The source value is converted to a QUrl before storing it in the database. */
     };
 
+    /**
+     * @brief Statements used to request timetable data from the database.
+     *
+     * The placeholders that need to be bound are listed for each statement.
+     * @see statementSql()
+     * @see preparedQuery()
+     **/
+    enum Statement {
+        StopIdStatement = 0, /**< Get the ID of a stop (not a station) with a given name,
+                * binds :stopName. */
+        DeparturesStatement, /**< Get scheduled departures from a stop, binds :stopId, :day
+                * (the julian day of the date), :time (in seconds since midnight) and :count.
+                * Template trips from the 'frequencies' table are not included. */
+        ArrivalsStatement, /**< Get arrivals at a stop, binds the same values as
+                * DeparturesStatement. */
+        FrequencyDeparturesStatement, /**< Get template trips from the 'frequencies' table
+                * departing from a stop, with one record for each frequency period. The records
+                * have the columns of DeparturesStatement followed by start_time, end_time,
+                * headway_secs and first_departure_time (of the template trip).
+                * Binds :stopId and :day. */
+        FrequencyArrivalsStatement, /**< Get template trips from the 'frequencies' table
+                * arriving at a stop, like FrequencyDeparturesStatement. */
+        StopSuggestionsStatement, /**< Get stops with a name matching a pattern,
+                * binds :pattern (for LIKE) and :limit. */
+        StopsByGeoPositionStatement, /**< Get stops in a rectangular area, binds :minLongitude,
+                * :maxLongitude, :minLatitude, :maxLatitude and :limit. */
+
+        StatementCount /**< The number of statements, not a valid statement. */
+    };
+
+    /** @brief Separates values of route stops/times in results of departure/arrival queries. */
+    static const char *ROUTE_SEPARATOR;
+
     static inline QSqlDatabase database( const QString &providerName ) {
         return QSqlDatabase::database(providerName);
     };
@@ -73,10 +113,54 @@ public:
      **/
     static bool initDatabase( const QString &providerName, QString *errorText );
 
-    /** @brief Close an initialized database. */
-    static inline void closeDatabase( const QString &providerName ) {
-        database( providerName ).close();
-    };
+    /**
+     * @brief Close an initialized database.
+     *
+     * Read-only connections created with readOnlyDatabase() get reopened the next time they
+     * are requested.
+     **/
+    static void closeDatabase( const QString &providerName );
+
+    /**
+     * @brief Get a read-only connection to the database of @p providerName for the current thread.
+     *
+     * QSqlDatabase connections can only be used in the thread where they were created. This
+     * function creates one read-only connection for each provider and thread, which gets reused
+     * by subsequent calls in the same thread, eg. by GtfsQueryJob in threads of ThreadWeaver.
+     *
+     * @param providerName The name of the provider for which a GTFS database should be opened.
+     * @param errorText Gets set to a string explaining an error, if the returned connection is
+     *   not open.
+     **/
+    static QSqlDatabase readOnlyDatabase( const QString &providerName, QString *errorText = 0 );
+
+    /**
+     * @brief Close the read-only connection of the current thread for @p providerName.
+     *
+     * Prepared queries of the connection get deleted. The connection gets reopened the next time
+     * readOnlyDatabase() gets called, eg. after an error indicating that the database file was
+     * deleted.
+     **/
+    static void closeReadOnlyDatabase( const QString &providerName );
+
+    /** @brief Get the SQL for @p statement, with named placeholders for all values. */
+    static QString statementSql( Statement statement );
+
+    /**
+     * @brief Get a query for @p statement, prepared for @p database.
+     *
+     * Queries are prepared once for each connection and get reused by later calls in the same
+     * thread, so that SQLite does not need to parse and plan the statements again. Bind values
+     * using QSqlQuery::bindValue() and call QSqlQuery::finish() after reading the results.
+     *
+     * @param statement The statement to get a prepared query for.
+     * @param database An open connection to a GTFS database, created in the current thread.
+     * @param errorText Gets set to a string explaining an error, if this returns 0.
+     * @return A pointer to the prepared query, owned by the cache of the current thread.
+     *   If the statement could not be prepared 0 gets returned.
+     **/
+    static QSqlQuery *preparedQuery( Statement statement, const QSqlDatabase &database,
+                                     QString *errorText = 0 );
 
     /**
      * @brief Create all needed tables in the database, if they did not already exist.
@@ -88,6 +172,21 @@ public:
      **/
     static bool createDatabaseTables( QString *errorText, QSqlDatabase database = QSqlDatabase() );
 
+    /**
+     * @brief Fill the 'service_days' table from the 'calendar' and 'calendar_dates' tables.
+     *
+     * For each service the dates at which it is available get stored as a string with one
+     * character for each day, '1' if the service is available at that day, '0' otherwise.
+     * Exceptions from 'calendar_dates' are already applied, so that departure/arrival queries
+     * only need to test a single character. This needs to be called after importing a GTFS feed.
+     *
+     * @param errorText Gets set to a string explaining an error, if this returns false.
+     * @param database The database to use.
+     *
+     * @returns True, if the table could be filled successfully. False, otherwise.
+     **/
+    static bool updateServiceDays( QString *errorText, QSqlDatabase database = QSqlDatabase() );
+
     /**
      * @brief Get the full path to the SQLite database file for the given @p providerName.
      *
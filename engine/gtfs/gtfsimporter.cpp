@@ -19,6 +19,7 @@
 
 #include "gtfsimporter.h"
 #include "gtfsdatabase.h"
+#include "gtfstimetablesnapshot.h"
 
 #include <KZip>
 #include <KStandardDirs>
@@ -193,6 +194,9 @@ void GtfsImporter::run()
         totalFileSize += fileInfo.size();
     }
 
+    // The timetable snapshot gets outdated, it gets written again after the import
+    GtfsTimetableSnapshot::remove( providerName );
+
     QString errorText;
     if ( !GtfsDatabase::createDatabaseTables(&errorText, database) ) {
         setError( FatalError, "Error initializing tables in the database: " + errorText );
@@ -264,6 +268,25 @@ void GtfsImporter::run()
         m_mutex.unlock();
     }
 
+    // Combine "calendar" and "calendar_dates" into the dates at which each service is available
+    emit logMessage( i18nc("@info/plain GTFS feed import logbook entry",
+                         "Compute service days from calendar data") );
+    if ( !GtfsDatabase::updateServiceDays(&errorText, database) ) {
+        setError( FatalError, "Error computing service days: " + errorText );
+        return;
+    }
+
+    // Compile the imported timetable into a snapshot for fast lookups, the database can still
+    // be used without it
+    emit logMessage( i18nc("@info/plain GTFS feed import logbook entry",
+                         "Write timetable snapshot") );
+    if ( !GtfsTimetableSnapshot::write(GtfsTimetableSnapshot::snapshotPath(providerName),
+                                       database, &errorText) )
+    {
+        kWarning() << errorText;
+        emit logMessage( errorText );
+    }
+
     m_mutex.lock();
     m_state = errors ? FinishedWithErrors : FinishedSuccessfully;
     kDebug() << "Importer finished" << m_providerName;
@@ -78,6 +78,8 @@ class QSqlRecord;
  * The fields "monday", "tuesday", ..., "sunday" in @em calendar.txt are combines into one field
  * "weekdays", which gets stored as a string of 7 characters, each '0' or '1'. The values get
  * concatenated beginning with sunday.
+ * After all files are imported, the data of @em calendar.txt and @em calendar_dates.txt gets
+ * combined into the table "service_days", see GtfsDatabase::updateServiceDays().
  * The biggest file is most probably stop_times.txt, the importer will spent the most time on
  * importing it into the database.
  * The @em shapes.txt file currently is not imported.
@@ -0,0 +1,400 @@
+/*
+ *   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// Header
+#include "gtfsqueryjob.h"
+
+// Own includes
+#include "gtfsdatabase.h"
+#include "gtfstimetablesnapshot.h"
+#include "serviceprovidergtfs.h"
+#include "request.h"
+
+// KDE includes
+#include <KDebug>
+
+// Qt includes
+#include <QSqlQuery>
+#include <QStringList>
+#include <QMultiMap>
+
+/**
+ * @brief Enumerates instances of a template trip from the 'frequencies' table.
+ *
+ * The instances of one frequency period start at start_time and then every headway_secs seconds
+ * before end_time. Records for the instances get created from the record of the template trip
+ * (see GtfsDatabase::FrequencyDeparturesStatement) by shifting all times, no instances get
+ * stored in the database.
+ **/
+class FrequencyTripInstances {
+public:
+    /** @brief Create an enumerator for instances departing after @p time from @p record. */
+    FrequencyTripInstances( const QSqlRecord &record, int time )
+            : m_record(record)
+    {
+        m_next = record.value( "start_time" ).toInt();
+        m_end = record.value( "end_time" ).toInt();
+        m_headway = qMax( 1, record.value("headway_secs").toInt() );
+        m_firstDeparture = record.value( "first_departure_time" ).toInt();
+        m_offset = record.value( "departure_time" ).toInt() - m_firstDeparture;
+
+        // Use the same columns as in records for scheduled departures
+        m_record.remove( m_record.indexOf("start_time") );
+        m_record.remove( m_record.indexOf("end_time") );
+        m_record.remove( m_record.indexOf("headway_secs") );
+        m_record.remove( m_record.indexOf("first_departure_time") );
+
+        // Skip instances departing before or at the requested time
+        if ( m_next + m_offset <= time ) {
+            m_next += ((time - m_offset - m_next) / m_headway + 1) * m_headway;
+        }
+    };
+
+    /** @brief Whether or not there are more instances in the frequency period. */
+    bool hasNext() const { return m_next < m_end; };
+
+    /** @brief The departure time at the stop of the next instance, in seconds since midnight. */
+    int nextDepartureTime() const { return m_next + m_offset; };
+
+    /** @brief Create a record for the next instance and go to the following instance. */
+    QSqlRecord takeNext() {
+        const int shift = m_next - m_firstDeparture;
+        QSqlRecord record = m_record;
+        record.setValue( "departure_time", record.value("departure_time").toInt() + shift );
+        record.setValue( "arrival_time", record.value("arrival_time").toInt() + shift );
+
+        QStringList routeTimes = record.value( "route_times" ).toString()
+                .split( QLatin1String(GtfsDatabase::ROUTE_SEPARATOR) );
+        for ( int i = 0; i < routeTimes.count(); ++i ) {
+            routeTimes[i] = QString::number( routeTimes[i].toInt() + shift );
+        }
+        record.setValue( "route_times",
+                         routeTimes.join(QLatin1String(GtfsDatabase::ROUTE_SEPARATOR)) );
+
+        m_next += m_headway;
+        return record;
+    };
+
+private:
+    QSqlRecord m_record; // The template record without frequency columns
+    int m_next; // Start time of the next instance at the first stop of the trip
+    int m_end;
+    int m_headway;
+    int m_firstDeparture; // Departure time of the template trip at it's first stop
+    int m_offset; // Seconds from the first departure of the trip to the departure at the stop
+};
+
+GtfsQueryJob::GtfsQueryJob( const QString &providerId, const AbstractRequest *request,
+                            QObject *parent )
+        : ThreadWeaver::Job(parent), m_providerId(providerId), m_request(request->clone()),
+          m_aborted(0), m_success(false)
+{
+}
+
+GtfsQueryJob::~GtfsQueryJob()
+{
+    delete m_request;
+}
+
+void GtfsQueryJob::requestAbort()
+{
+    m_aborted.fetchAndStoreOrdered( 1 );
+}
+
+bool GtfsQueryJob::isAborted() const
+{
+    return m_aborted != 0;
+}
+
+bool GtfsQueryJob::success() const
+{
+    return m_success;
+}
+
+void GtfsQueryJob::run()
+{
+    if ( isAborted() ) {
+        // Aborted before the job was started
+        return;
+    }
+
+    // Get a read-only connection to the database for this thread
+    m_database = GtfsDatabase::readOnlyDatabase( m_providerId, &m_errorString );
+    if ( !m_database.isOpen() ) {
+        m_lastError = m_database.lastError();
+        return;
+    }
+
+    // StopsByGeoPositionRequest is a derivate of StopSuggestionRequest and ArrivalRequest is a
+    // derivate of DepartureRequest, therefore these tests need to be done first
+    bool success = false;
+    if ( const StopsByGeoPositionRequest *stopsByGeoPositionRequest =
+         dynamic_cast<const StopsByGeoPositionRequest*>(m_request) )
+    {
+        success = queryStopsByGeoPosition( stopsByGeoPositionRequest );
+    } else if ( const StopSuggestionRequest *stopSuggestionRequest =
+                dynamic_cast<const StopSuggestionRequest*>(m_request) )
+    {
+        success = queryStopSuggestions( stopSuggestionRequest );
+    } else if ( const DepartureRequest *departureRequest =
+                dynamic_cast<const DepartureRequest*>(m_request) )
+    {
+        success = queryDeparturesOrArrivals( departureRequest );
+    } else {
+        kWarning() << "Request type not supported by GTFS providers" << m_request->sourceName();
+        m_errorString = "Request type not supported";
+    }
+
+    if ( !success && m_lastError.isValid() ) {
+        // Reopen the connection the next time it gets used, the database file may have been
+        // deleted or replaced
+        GtfsDatabase::closeReadOnlyDatabase( m_providerId );
+    }
+    m_database = QSqlDatabase();
+    m_success = success && !isAborted();
+}
+
+bool GtfsQueryJob::execute( QSqlQuery *query )
+{
+    if ( !query->exec() ) {
+        m_lastError = query->lastError();
+        m_errorString = m_lastError.text();
+        kDebug() << query->lastError();
+        kDebug() << query->lastQuery() << query->boundValues();
+        return false;
+    }
+    return true;
+}
+
+QSqlQuery *GtfsQueryJob::preparedQuery( GtfsDatabase::Statement statement )
+{
+    QSqlQuery *query = GtfsDatabase::preparedQuery( statement, m_database, &m_errorString );
+    if ( !query ) {
+        m_lastError = m_database.lastError();
+    }
+    return query;
+}
+
+QList< QSqlRecord > GtfsQueryJob::readRecords( QSqlQuery *query )
+{
+    QList< QSqlRecord > records;
+    while ( !isAborted() && query->next() ) {
+        records << query->record();
+    }
+
+    // Reset the prepared query to be reused
+    query->finish();
+    return records;
+}
+
+bool GtfsQueryJob::queryScheduledDepartures( const DepartureRequest *request, uint *stopId,
+                                             QList<QSqlRecord> *records )
+{
+    // TODO If it is known that [stop] contains a stop ID testing for it's ID in stop_times is not necessary!
+    // Try to get the ID for the given stop (fails, if it already is a stop ID).
+    QSqlQuery *query = preparedQuery( GtfsDatabase::StopIdStatement );
+    if ( !query ) {
+        return false;
+    }
+    query->bindValue( ":stopName", request->stop() );
+    if ( !execute(query) ) {
+        return false;
+    }
+
+    if ( query->next() ) {
+        *stopId = query->value( 0 ).toUInt();
+        query->finish();
+    } else {
+        query->finish();
+        bool ok;
+        *stopId = request->stop().toUInt( &ok );
+        if ( !ok ) {
+            kDebug() << "No stop with the given name or id found (needs the exact name):"
+                     << request->stop();
+            m_errorString = "No stop with the given name or id found (needs the exact name): "
+                            + request->stop();
+            return false;
+        }
+    }
+    if ( isAborted() ) {
+        return false;
+    }
+
+// This creates a temporary table to calculate min/max fares for departures.
+// These values should be added into the db while importing, doing it here takes too long
+//     const QString createJoinedFareTable = "CREATE TEMPORARY TABLE IF NOT EXISTS tmp_fares AS "
+//             "SELECT * FROM fare_rules JOIN fare_attributes USING (fare_id);";
+//     if ( !query.prepare(createJoinedFareTable) || !query.exec() ) {
+//         kDebug() << "Error while creating a temporary table fore min/max fare calculation:"
+//                  << query.lastError();
+//         kDebug() << query.executedQuery();
+//         return;
+//     }
+
+    // Query the needed departure info from the database
+    query = preparedQuery( request->parseMode() == ParseForArrivals
+                           ? GtfsDatabase::ArrivalsStatement : GtfsDatabase::DeparturesStatement );
+    if ( !query ) {
+        return false;
+    }
+    const QTime time = request->dateTime().time();
+    query->bindValue( ":stopId", *stopId );
+    query->bindValue( ":day", request->dateTime().date().toJulianDay() );
+    query->bindValue( ":time", time.hour() * 60 * 60 + time.minute() * 60 + time.second() );
+    query->bindValue( ":count", request->count() );
+    if ( !execute(query) ) {
+        kDebug() << "Error while querying for departures";
+        return false;
+    }
+    *records = readRecords( query );
+    return true;
+}
+
+bool GtfsQueryJob::queryDeparturesOrArrivals( const DepartureRequest *request )
+{
+    const bool arrivals = request->parseMode() == ParseForArrivals;
+    const QTime time = request->dateTime().time();
+    const int seconds = time.hour() * 60 * 60 + time.minute() * 60 + time.second();
+    const int day = request->dateTime().date().toJulianDay();
+
+    // Get scheduled departures from the timetable snapshot, if there is one,
+    // otherwise query them from the database
+    uint stopId;
+    QList< QSqlRecord > scheduled;
+    const QSharedPointer< GtfsTimetableSnapshot > snapshot =
+            GtfsTimetableSnapshot::snapshot( m_providerId );
+    if ( snapshot ) {
+        int stopIndex = snapshot->stopIndexByName( request->stop() );
+        if ( stopIndex < 0 ) {
+            bool ok;
+            const uint id = request->stop().toUInt( &ok );
+            stopIndex = ok ? snapshot->stopIndex( id ) : -1;
+        }
+        if ( stopIndex < 0 ) {
+            kDebug() << "No stop with the given name or id found (needs the exact name):"
+                     << request->stop();
+            m_errorString = "No stop with the given name or id found (needs the exact name): "
+                            + request->stop();
+            return false;
+        }
+        stopId = snapshot->stopId( stopIndex );
+        scheduled = snapshot->departures( stopIndex, day, seconds, request->count(), arrivals );
+        if ( !snapshot->hasFrequencies() ) {
+            m_records = scheduled;
+            return true;
+        }
+    } else if ( !queryScheduledDepartures(request, &stopId, &scheduled) ) {
+        return false;
+    }
+    if ( isAborted() ) {
+        return false;
+    }
+
+    // Query template trips from the 'frequencies' table, one record for each frequency period
+    QSqlQuery *query = preparedQuery( arrivals ? GtfsDatabase::FrequencyArrivalsStatement
+                                               : GtfsDatabase::FrequencyDeparturesStatement );
+    if ( !query ) {
+        return false;
+    }
+    query->bindValue( ":stopId", stopId );
+    query->bindValue( ":day", day );
+    if ( !execute(query) ) {
+        kDebug() << "Error while querying for frequency based departures";
+        return false;
+    }
+    QList< FrequencyTripInstances > frequencyTrips;
+    foreach ( const QSqlRecord &record, readRecords(query) ) {
+        const FrequencyTripInstances trip( record, seconds );
+        if ( trip.hasNext() ) {
+            frequencyTrips << trip;
+        }
+    }
+    if ( frequencyTrips.isEmpty() ) {
+        m_records = scheduled;
+        return true;
+    }
+
+    // Merge scheduled departures and instances of frequency based trips sorted by departure
+    // time, instances only get created until the requested number of departures is reached
+    QMultiMap< int, int > nextInstances; // Departure times of next instances => frequency trip
+    for ( int i = 0; i < frequencyTrips.count(); ++i ) {
+        nextInstances.insert( frequencyTrips[i].nextDepartureTime(), i );
+    }
+    int scheduledIndex = 0;
+    while ( m_records.count() < request->count() && !isAborted() ) {
+        const bool hasScheduled = scheduledIndex < scheduled.count();
+        if ( !nextInstances.isEmpty() && (!hasScheduled || nextInstances.constBegin().key() <
+                scheduled[scheduledIndex].value("departure_time").toInt()) )
+        {
+            QMultiMap< int, int >::Iterator it = nextInstances.begin();
+            const int index = it.value();
+            nextInstances.erase( it );
+
+            FrequencyTripInstances &trip = frequencyTrips[ index ];
+            m_records << trip.takeNext();
+            if ( trip.hasNext() ) {
+                nextInstances.insert( trip.nextDepartureTime(), index );
+            }
+        } else if ( hasScheduled ) {
+            m_records << scheduled[ scheduledIndex++ ];
+        } else {
+            break;
+        }
+    }
+    return true;
+}
+
+bool GtfsQueryJob::queryStopSuggestions( const StopSuggestionRequest *request )
+{
+    QSqlQuery *query = preparedQuery( GtfsDatabase::StopSuggestionsStatement );
+    if ( !query ) {
+        return false;
+    }
+    query->bindValue( ":pattern", '%' + request->stop() + '%' );
+    query->bindValue( ":limit", ServiceProviderGtfs::STOP_SUGGESTION_LIMIT );
+    if ( !execute(query) ) {
+        return false;
+    }
+
+    m_records = readRecords( query );
+    return true;
+}
+
+bool GtfsQueryJob::queryStopsByGeoPosition( const StopsByGeoPositionRequest *request )
+{
+    // Calculate degree from meters = 360/40,070,000
+    const qreal distance = request->distance() * 0.000009 / 2;
+    kDebug() << "Get stops near:" << request->distance() << "meters ==" << distance;
+
+    QSqlQuery *query = preparedQuery( GtfsDatabase::StopsByGeoPositionStatement );
+    if ( !query ) {
+        return false;
+    }
+    query->bindValue( ":minLongitude", request->longitude() - distance );
+    query->bindValue( ":maxLongitude", request->longitude() + distance );
+    query->bindValue( ":minLatitude", request->latitude() - distance );
+    query->bindValue( ":maxLatitude", request->latitude() + distance );
+    query->bindValue( ":limit", ServiceProviderGtfs::STOP_SUGGESTION_LIMIT );
+    if ( !execute(query) ) {
+        return false;
+    }
+
+    m_records = readRecords( query );
+    return true;
+}
@@ -0,0 +1,135 @@
+/*
+ *   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/** @file
+* @brief This file contains a job to query a GTFS database in a separate thread.
+* @author Friedrich Pülz <fpuelz@gmx.de> */
+
+#ifndef GTFSQUERYJOB_HEADER
+#define GTFSQUERYJOB_HEADER
+
+// Own includes
+#include "gtfsdatabase.h"
+
+// KDE includes
+#include <ThreadWeaver/Job> // Base class
+
+// Qt includes
+#include <QSqlRecord>
+#include <QSqlError>
+#include <QAtomicInt>
+
+class AbstractRequest;
+class DepartureRequest;
+class StopSuggestionRequest;
+class StopsByGeoPositionRequest;
+class QSqlQuery;
+
+/**
+ * @brief Runs the database queries for a request to a GTFS provider in a ThreadWeaver thread.
+ *
+ * The job uses a read-only connection to the GTFS database of the provider for the thread it
+ * runs in, see GtfsDatabase::readOnlyDatabase(), and queries prepared once for that connection,
+ * see GtfsDatabase::preparedQuery(). All records of the query result get read into
+ * records(), they get converted to timetable items by ServiceProviderGtfs in the main thread
+ * after the job is done.
+ *
+ * If there is a timetable snapshot for the provider (see GtfsTimetableSnapshot), scheduled
+ * departures/arrivals get read from the snapshot without querying the database.
+ *
+ * Template trips from the 'frequencies' table are not stored as single trips in the database.
+ * For departure/arrival requests the job enumerates instances of these trips in the requested
+ * time window and merges them with the scheduled departures/arrivals, until the requested number
+ * of records is reached.
+ *
+ * Use requestAbort() to abort the job, eg. when the data source of the request was removed.
+ * Records get no longer read after the job was aborted, but the currently executed SQL statement
+ * gets finished.
+ **/
+class GtfsQueryJob : public ThreadWeaver::Job {
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Create a new job to query the database of @p providerId for @p request.
+     *
+     * @param providerId The ID of the GTFS provider to query the database for.
+     * @param request The request to query data for, either a DepartureRequest, ArrivalRequest,
+     *   StopSuggestionRequest or StopsByGeoPositionRequest. The job uses a copy of @p request.
+     **/
+    GtfsQueryJob( const QString &providerId, const AbstractRequest *request, QObject *parent = 0 );
+
+    /** @brief Destructor. */
+    virtual ~GtfsQueryJob();
+
+    /** @brief Abort the job, no more records get read. */
+    virtual void requestAbort();
+
+    /** @brief Whether or not requestAbort() was called. */
+    bool isAborted() const;
+
+    /** @brief Overwritten from ThreadWeaver::Job to return whether or not the job was successful. */
+    virtual bool success() const;
+
+    /** @brief The request for which the database gets queried. */
+    const AbstractRequest *request() const { return m_request; };
+
+    /**
+     * @brief The records of the query result.
+     * @note This should only be used after the job is done.
+     **/
+    QList< QSqlRecord > records() const { return m_records; };
+
+    /** @brief The last error reported by the database, if any. */
+    QSqlError lastError() const { return m_lastError; };
+
+    /** @brief A string describing the error, if success() returns false. */
+    QString errorString() const { return m_errorString; };
+
+protected:
+    /** @brief Perform the job. */
+    virtual void run();
+
+private:
+    bool queryDeparturesOrArrivals( const DepartureRequest *request );
+    bool queryScheduledDepartures( const DepartureRequest *request, uint *stopId,
+                                   QList<QSqlRecord> *records );
+    bool queryStopSuggestions( const StopSuggestionRequest *request );
+    bool queryStopsByGeoPosition( const StopsByGeoPositionRequest *request );
+
+    /** @brief Get a prepared query for @p statement, store errors on failure. */
+    QSqlQuery *preparedQuery( GtfsDatabase::Statement statement );
+
+    /** @brief Execute the prepared @p query with bound values, store errors on failure. */
+    bool execute( QSqlQuery *query );
+
+    /** @brief Read all records from @p query, until the job gets aborted. */
+    QList< QSqlRecord > readRecords( QSqlQuery *query );
+
+    const QString m_providerId;
+    QSqlDatabase m_database; // The read-only connection used while running
+    AbstractRequest *m_request;
+    QList< QSqlRecord > m_records;
+    QSqlError m_lastError;
+    QString m_errorString;
+    QAtomicInt m_aborted;
+    bool m_success;
+};
+
+#endif // Multiple inclusion guard
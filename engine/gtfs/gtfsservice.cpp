@@ -22,6 +22,7 @@
 #include "serviceprovider.h"
 #include "serviceproviderdata.h"
 #include "serviceproviderglobal.h"
+#include "gtfstimetablesnapshot.h"
 
 // KDE includes
 #include <KTemporaryFile>
@@ -229,7 +230,8 @@ void DeleteGtfsDatabaseJob::work()
     // because the already opened database connection gets used instead
     GtfsDatabase::closeDatabase( m_serviceProviderId );
 
-    // Delete the database file
+    // Delete the timetable snapshot and the database file
+    GtfsTimetableSnapshot::remove( m_serviceProviderId );
     const QString databasePath = GtfsDatabase::databasePath( m_serviceProviderId );
     if ( !QFile::remove(databasePath) ) {
         kDebug() << "Failed to delete GTFS database";
@@ -0,0 +1,784 @@
+/*
+ *   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// Header
+#include "gtfstimetablesnapshot.h"
+
+// Own includes
+#include "gtfsdatabase.h"
+
+// KDE includes
+#include <KDebug>
+#include <KGlobal>
+#include <KStandardDirs>
+#include <KSaveFile>
+#include <KRandom>
+
+// Qt includes
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QSqlField>
+#include <QStringList>
+#include <QMutex>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+
+// zlib includes
+#include <zlib.h>
+
+const quint32 GtfsTimetableSnapshot::VERSION = 2;
+
+/*
+ * The snapshot file starts with a SnapshotHeader, followed by the sections. Each section is an
+ * array of one of the entry types below, the header contains the offset and the number of
+ * entries of each section. All values are stored in the byte order of the writing machine.
+ * Strings are stored UTF-8 encoded and null terminated in StringSection, other sections
+ * reference them by their offset in that section.
+ */
+namespace {
+
+const quint32 SNAPSHOT_MAGIC = 0x53545450; // "PTTS"
+const quint32 SNAPSHOT_BYTE_ORDER = 0x01020304;
+const quint32 NO_INDEX = 0xffffffff;
+
+enum SnapshotFlag {
+    HasFrequenciesFlag = 0x1 /**< The 'frequencies' table is not empty. */
+};
+
+enum Section {
+    StopSection = 0, /**< StopEntry for each stop, sorted by stop ID. */
+    StopNameSection, /**< Stop indices (quint32) of stops, that are no stations, sorted by name. */
+    RouteSection, /**< RouteEntry for each route. */
+    PatternSection, /**< PatternEntry for each sequence of stops used by trips. */
+    PatternStopSection, /**< Stop indices (quint32) of all patterns. */
+    TripSection, /**< TripEntry for each trip, that is not in the 'frequencies' table. */
+    StopTimeSection, /**< StopTimeEntry for each stop of all trips. */
+    DepartureSection, /**< DepartureEntry for each stop time, grouped by stop, sorted by time. */
+    ServiceSection, /**< ServiceEntry for each service in the 'service_days' table. */
+    ServiceDaySection, /**< Bits (quint8) for the days of all services. */
+    StringSection, /**< Null terminated UTF-8 strings (char). */
+
+    SectionCount
+};
+
+struct SectionEntry {
+    quint32 offset;
+    quint32 count;
+};
+
+struct SnapshotHeader {
+    quint32 magic;
+    quint32 version;
+    quint32 byteOrder;
+    quint32 flags;
+    quint32 checksum; // CRC-32 of all data after the header
+    quint32 importId; // Random number, that is different for each written snapshot
+    quint32 fileSize;
+    SectionEntry sections[ SectionCount ];
+};
+
+struct StopEntry {
+    quint32 stopId;
+    quint32 name;
+    quint32 firstDeparture; // Index in DepartureSection
+    quint32 departureCount;
+};
+
+struct RouteEntry {
+    quint32 routeId;
+    quint32 agencyId; // NO_INDEX if NULL
+    qint32 routeType;
+    quint32 shortName;
+    quint32 longName;
+};
+
+struct PatternEntry {
+    quint32 firstStop; // Index in PatternStopSection
+    quint32 stopCount;
+};
+
+struct TripEntry {
+    quint32 tripId;
+    quint32 route;
+    quint32 service; // NO_INDEX if the service is always available
+    quint32 pattern;
+    quint32 headsign;
+    quint32 firstStopTime; // Index in StopTimeSection, one stop time for each stop of the pattern
+};
+
+struct StopTimeEntry {
+    qint32 arrivalTime;
+    qint32 departureTime;
+    quint32 headsign;
+    quint32 sequence;
+};
+
+struct DepartureEntry {
+    qint32 time;
+    quint32 trip;
+    quint32 position; // Position of the stop in the pattern of the trip
+};
+
+struct ServiceEntry {
+    quint32 serviceId;
+    qint32 firstDay; // Julian day of the first bit
+    quint32 dayCount;
+    quint32 days; // Byte offset in ServiceDaySection
+};
+
+const int SECTION_ENTRY_SIZES[ SectionCount ] = { sizeof(StopEntry), sizeof(quint32),
+        sizeof(RouteEntry), sizeof(PatternEntry), sizeof(quint32), sizeof(TripEntry),
+        sizeof(StopTimeEntry), sizeof(DepartureEntry), sizeof(ServiceEntry), sizeof(quint8),
+        sizeof(char) };
+
+/** @brief Collects strings for StringSection, each distinct string gets stored once. */
+class StringTable {
+public:
+    StringTable() : m_data(1, '\0') {}; // Offset 0 is the empty string
+
+    quint32 add( const QString &string ) {
+        if ( string.isEmpty() ) {
+            return 0;
+        }
+        const QByteArray utf8 = string.toUtf8();
+        QHash< QByteArray, quint32 >::ConstIterator it = m_offsets.constFind( utf8 );
+        if ( it != m_offsets.constEnd() ) {
+            return *it;
+        }
+        const quint32 offset = m_data.size();
+        m_data.append( utf8 ).append( '\0' );
+        m_offsets.insert( utf8, offset );
+        return offset;
+    };
+
+    QByteArray data() const { return m_data; };
+
+private:
+    QByteArray m_data;
+    QHash< QByteArray, quint32 > m_offsets;
+};
+
+/** @brief Compares stop indices by the names of the stops, used while writing. */
+struct StopNameLessThan {
+    StopNameLessThan( const QList<QByteArray> &names ) : names(names) {};
+    bool operator()( quint32 stop1, quint32 stop2 ) const {
+        return qstrcmp( names[stop1], names[stop2] ) < 0;
+    };
+    const QList< QByteArray > &names;
+};
+
+bool departureLessThan( const DepartureEntry &departure1, const DepartureEntry &departure2 )
+{
+    return departure1.time < departure2.time;
+}
+
+template< typename T >
+QByteArray sectionData( const QVector<T> &entries )
+{
+    return QByteArray( reinterpret_cast<const char*>(entries.constData()),
+                       entries.count() * sizeof(T) );
+}
+
+/** @brief Opened snapshots shared by all threads, see GtfsTimetableSnapshot::snapshot(). */
+struct SnapshotCache {
+    QMutex mutex;
+    QHash< QString, QSharedPointer<GtfsTimetableSnapshot> > snapshots;
+    QHash< QString, quint64 > keys; // Import ID and checksum of the opened snapshot files
+};
+
+/**
+ * @brief Read the import ID and the checksum from the header of the snapshot file @p fileName.
+ *
+ * Both values change each time a snapshot gets written, unlike the modification time of the
+ * file, which only has a resolution of one second.
+ * @return A key for the snapshot file or 0, if the header cannot be read.
+ **/
+quint64 snapshotKey( const QString &fileName )
+{
+    QFile file( fileName );
+    SnapshotHeader header;
+    if ( !file.open(QIODevice::ReadOnly) ||
+         file.read(reinterpret_cast<char*>(&header), sizeof(SnapshotHeader)) !=
+            qint64(sizeof(SnapshotHeader)) )
+    {
+        return 0;
+    }
+    return (quint64(header.importId) << 32) | header.checksum;
+}
+
+} // namespace
+
+K_GLOBAL_STATIC( SnapshotCache, snapshotCache )
+
+GtfsTimetableSnapshot::GtfsTimetableSnapshot() : m_data(0)
+{
+}
+
+GtfsTimetableSnapshot::~GtfsTimetableSnapshot()
+{
+    // Closing the file also unmaps it
+    m_file.close();
+}
+
+QString GtfsTimetableSnapshot::snapshotPath( const QString &providerName )
+{
+    const QString dir =
+            KGlobal::dirs()->saveLocation( "data", "plasma_engine_publictransport/gtfs/" );
+    return dir + providerName + ".timetable";
+}
+
+QSharedPointer< GtfsTimetableSnapshot > GtfsTimetableSnapshot::snapshot(
+        const QString &providerName )
+{
+    const QString fileName = snapshotPath( providerName );
+    QMutexLocker locker( &snapshotCache->mutex );
+    if ( !QFile::exists(fileName) ) {
+        snapshotCache->snapshots.remove( providerName );
+        snapshotCache->keys.remove( providerName );
+        return QSharedPointer< GtfsTimetableSnapshot >();
+    }
+
+    // Also invalid snapshot files get remembered, to not validate them again for each call
+    const quint64 key = snapshotKey( fileName );
+    if ( snapshotCache->keys.contains(providerName) &&
+         snapshotCache->keys[providerName] == key )
+    {
+        return snapshotCache->snapshots.value( providerName );
+    }
+
+    QSharedPointer< GtfsTimetableSnapshot > snapshot( new GtfsTimetableSnapshot );
+    QString errorText;
+    if ( !snapshot->open(fileName, &errorText) ) {
+        kWarning() << "Cannot use timetable snapshot for" << providerName << errorText;
+        snapshot.clear();
+    }
+    snapshotCache->snapshots.insert( providerName, snapshot );
+    snapshotCache->keys.insert( providerName, key );
+    return snapshot;
+}
+
+void GtfsTimetableSnapshot::remove( const QString &providerName )
+{
+    QMutexLocker locker( &snapshotCache->mutex );
+    snapshotCache->snapshots.remove( providerName );
+    snapshotCache->keys.remove( providerName );
+    QFile::remove( snapshotPath(providerName) );
+}
+
+bool GtfsTimetableSnapshot::write( const QString &fileName, const QSqlDatabase &database,
+                                   QString *errorText )
+{
+    // Simple benchmark, prints the time it took until the Block got destructed
+    KDebug::Block writeBlock( "Write GTFS timetable snapshot" );
+
+    QSqlQuery query( database );
+    query.setForwardOnly( true );
+    StringTable strings;
+
+    // Read stops, sorted by ID for binary search
+    if ( !query.exec("SELECT stop_id, stop_name, location_type FROM stops ORDER BY stop_id") ) {
+        *errorText = "Error reading stops: " + query.lastError().text();
+        return false;
+    }
+    QList< QPair<uint, int> > stopIds; // Stop ID => row
+    QList< QByteArray > stopNames;
+    QList< bool > stations;
+    while ( query.next() ) {
+        stopIds << qMakePair( query.value(0).toUInt(), stopIds.count() );
+        stopNames << query.value( 1 ).toString().toUtf8();
+        stations << (query.value(2).toInt() == 1);
+    }
+    qSort( stopIds ); // The database may sort signed values differently
+    QVector< StopEntry > stops( stopIds.count() );
+    QHash< uint, quint32 > stopIndices;
+    QVector< quint32 > stopsByName;
+    QList< QByteArray > sortedStopNames;
+    for ( int i = 0; i < stopIds.count(); ++i ) {
+        const int row = stopIds[i].second;
+        StopEntry &stop = stops[ i ];
+        stop.stopId = stopIds[i].first;
+        stop.name = strings.add( QString::fromUtf8(stopNames[row]) );
+        stop.firstDeparture = stop.departureCount = 0;
+        stopIndices.insert( stop.stopId, i );
+        sortedStopNames << stopNames[row];
+        if ( !stations[row] ) {
+            stopsByName << i;
+        }
+    }
+    // Sort by the UTF-8 bytes, like the BINARY collation of SQLite
+    qSort( stopsByName.begin(), stopsByName.end(), StopNameLessThan(sortedStopNames) );
+
+    // Read routes
+    if ( !query.exec("SELECT route_id, agency_id, route_type, route_short_name, route_long_name "
+                     "FROM routes") )
+    {
+        *errorText = "Error reading routes: " + query.lastError().text();
+        return false;
+    }
+    QVector< RouteEntry > routes;
+    QHash< uint, quint32 > routeIndices;
+    while ( query.next() ) {
+        RouteEntry route;
+        route.routeId = query.value( 0 ).toUInt();
+        route.agencyId = query.value( 1 ).isNull() ? NO_INDEX : query.value( 1 ).toUInt();
+        route.routeType = query.value( 2 ).toInt();
+        route.shortName = strings.add( query.value(3).toString() );
+        route.longName = strings.add( query.value(4).toString() );
+        routeIndices.insert( route.routeId, routes.count() );
+        routes << route;
+    }
+
+    // Read service days and convert the '0'/'1' strings into bits
+    if ( !query.exec("SELECT service_id, first_day, days FROM service_days") ) {
+        *errorText = "Error reading service days: " + query.lastError().text();
+        return false;
+    }
+    QVector< ServiceEntry > services;
+    QHash< uint, quint32 > serviceIndices;
+    QByteArray serviceDays;
+    while ( query.next() ) {
+        const QString days = query.value( 2 ).toString();
+        ServiceEntry service;
+        service.serviceId = query.value( 0 ).toUInt();
+        service.firstDay = query.value( 1 ).toInt();
+        service.dayCount = days.length();
+        service.days = serviceDays.size();
+        serviceDays.append( QByteArray((days.length() + 7) / 8, '\0') );
+        char *bits = serviceDays.data() + service.days;
+        for ( int day = 0; day < days.length(); ++day ) {
+            if ( days[day] == '1' ) {
+                bits[ day / 8 ] |= 1 << (day % 8);
+            }
+        }
+        serviceIndices.insert( service.serviceId, services.count() );
+        services << service;
+    }
+
+    // Trips from the 'frequencies' table are only templates, they do not get stored
+    if ( !query.exec("SELECT DISTINCT trip_id FROM frequencies") ) {
+        *errorText = "Error reading frequencies: " + query.lastError().text();
+        return false;
+    }
+    QSet< uint > frequencyTrips;
+    while ( query.next() ) {
+        frequencyTrips.insert( query.value(0).toUInt() );
+    }
+
+    // Read trips
+    if ( !query.exec("SELECT trip_id, route_id, service_id, trip_headsign FROM trips") ) {
+        *errorText = "Error reading trips: " + query.lastError().text();
+        return false;
+    }
+    QHash< uint, TripEntry > tripsById;
+    while ( query.next() ) {
+        TripEntry trip;
+        trip.tripId = query.value( 0 ).toUInt();
+        if ( frequencyTrips.contains(trip.tripId) ) {
+            continue;
+        }
+        trip.route = routeIndices.value( query.value(1).toUInt(), NO_INDEX );
+        trip.service = serviceIndices.value( query.value(2).toUInt(), NO_INDEX );
+        trip.headsign = strings.add( query.value(3).toString() );
+        trip.pattern = NO_INDEX;
+        trip.firstStopTime = 0;
+        if ( trip.route != NO_INDEX ) {
+            tripsById.insert( trip.tripId, trip );
+        }
+    }
+
+    // Read stop times of all trips, ordered like the 'stop_times_trip' index.
+    // Trips with the same sequence of stops share a pattern.
+    if ( !query.exec("SELECT trip_id, stop_id, arrival_time, departure_time, stop_headsign, "
+                     "stop_sequence FROM stop_times ORDER BY trip_id, stop_sequence") )
+    {
+        *errorText = "Error reading stop times: " + query.lastError().text();
+        return false;
+    }
+    QVector< TripEntry > trips;
+    QVector< StopTimeEntry > stopTimes;
+    QVector< PatternEntry > patterns;
+    QVector< quint32 > patternStops;
+    QHash< QByteArray, quint32 > patternIndices; // Stop indices of a pattern => pattern
+    QVector< QVector<DepartureEntry> > stopDepartures( stops.count() );
+    QVector< quint32 > currentStops;
+    TripEntry currentTrip;
+    bool hasNext = query.next();
+    while ( hasNext ) {
+        const uint tripId = query.value( 0 ).toUInt();
+        const bool storeTrip = tripsById.contains( tripId );
+        if ( storeTrip ) {
+            currentTrip = tripsById[ tripId ];
+            currentTrip.firstStopTime = stopTimes.count();
+            currentStops.clear();
+        }
+
+        // Read all stop times of the current trip
+        do {
+            const quint32 stop = stopIndices.value( query.value(1).toUInt(), NO_INDEX );
+            if ( storeTrip && stop != NO_INDEX ) {
+                StopTimeEntry stopTime;
+                stopTime.arrivalTime = query.value( 2 ).toInt();
+                stopTime.departureTime = query.value( 3 ).toInt();
+                stopTime.headsign = strings.add( query.value(4).toString() );
+                stopTime.sequence = query.value( 5 ).toUInt();
+                stopTimes << stopTime;
+                currentStops << stop;
+            }
+            hasNext = query.next();
+        } while ( hasNext && query.value(0).toUInt() == tripId );
+
+        if ( !storeTrip || currentStops.isEmpty() ) {
+            continue;
+        }
+
+        // Find the pattern of the trip or add a new one
+        const QByteArray patternKey( reinterpret_cast<const char*>(currentStops.constData()),
+                                     currentStops.count() * sizeof(quint32) );
+        QHash< QByteArray, quint32 >::ConstIterator it = patternIndices.constFind( patternKey );
+        if ( it == patternIndices.constEnd() ) {
+            PatternEntry pattern;
+            pattern.firstStop = patternStops.count();
+            pattern.stopCount = currentStops.count();
+            patternStops += currentStops;
+            it = patternIndices.insert( patternKey, patterns.count() );
+            patterns << pattern;
+        }
+        currentTrip.pattern = *it;
+
+        // Add departures of the trip to the stops
+        const quint32 tripIndex = trips.count();
+        for ( int position = 0; position < currentStops.count(); ++position ) {
+            DepartureEntry departure;
+            departure.time = stopTimes[ currentTrip.firstStopTime + position ].departureTime;
+            departure.trip = tripIndex;
+            departure.position = position;
+            stopDepartures[ currentStops[position] ] << departure;
+        }
+        trips << currentTrip;
+    }
+    query.finish();
+
+    // Sort departures of each stop by time
+    QVector< DepartureEntry > departures;
+    departures.reserve( stopTimes.count() );
+    for ( int i = 0; i < stops.count(); ++i ) {
+        qStableSort( stopDepartures[i].begin(), stopDepartures[i].end(), departureLessThan );
+        stops[i].firstDeparture = departures.count();
+        stops[i].departureCount = stopDepartures[i].count();
+        departures += stopDepartures[i];
+        stopDepartures[i].clear();
+    }
+
+    // Collect section data, each section is aligned to 4 bytes
+    QList< QByteArray > sectionDatas;
+    sectionDatas << sectionData( stops ) << sectionData( stopsByName ) << sectionData( routes )
+                 << sectionData( patterns ) << sectionData( patternStops ) << sectionData( trips )
+                 << sectionData( stopTimes ) << sectionData( departures )
+                 << sectionData( services ) << serviceDays << strings.data();
+    Q_ASSERT( sectionDatas.count() == SectionCount );
+
+    SnapshotHeader header;
+    memset( &header, 0, sizeof(SnapshotHeader) );
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = VERSION;
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.flags = frequencyTrips.isEmpty() ? 0 : HasFrequenciesFlag;
+    header.importId = KRandom::random();
+    QByteArray data;
+    for ( int section = 0; section < SectionCount; ++section ) {
+        header.sections[section].offset = sizeof(SnapshotHeader) + data.size();
+        header.sections[section].count =
+                sectionDatas[section].size() / SECTION_ENTRY_SIZES[section];
+        data.append( sectionDatas[section] );
+        if ( data.size() % 4 != 0 ) {
+            data.append( QByteArray(4 - data.size() % 4, '\0') );
+        }
+    }
+    header.fileSize = sizeof(SnapshotHeader) + data.size();
+    header.checksum = crc32( 0, reinterpret_cast<const Bytef*>(data.constData()), data.size() );
+
+    // Write the snapshot to a temporary file, which replaces an existing snapshot in finalize()
+    KSaveFile file( fileName );
+    if ( !file.open() ||
+         file.write(reinterpret_cast<const char*>(&header), sizeof(SnapshotHeader)) !=
+            qint64(sizeof(SnapshotHeader)) ||
+         file.write(data) != data.size() || !file.finalize() )
+    {
+        *errorText = "Error writing the timetable snapshot: " + file.errorString();
+        file.abort();
+        return false;
+    }
+
+    kDebug() << "Wrote timetable snapshot with" << stops.count() << "stops," << trips.count()
+             << "trips and" << patterns.count() << "patterns," << header.fileSize << "bytes";
+    return true;
+}
+
+bool GtfsTimetableSnapshot::open( const QString &fileName, QString *errorText )
+{
+    m_file.close();
+    m_data = 0;
+    m_file.setFileName( fileName );
+    if ( !m_file.open(QIODevice::ReadOnly) ) {
+        if ( errorText ) {
+            *errorText = "Cannot open file " + fileName + ": " + m_file.errorString();
+        }
+        return false;
+    }
+
+    const qint64 size = m_file.size();
+    const uchar *data = size >= qint64(sizeof(SnapshotHeader)) ? m_file.map(0, size) : 0;
+    if ( !data ) {
+        if ( errorText ) {
+            *errorText = "Cannot map file " + fileName;
+        }
+        m_file.close();
+        return false;
+    }
+
+    // Validate the header
+    QString error;
+    const SnapshotHeader *header = reinterpret_cast< const SnapshotHeader* >( data );
+    if ( header->magic != SNAPSHOT_MAGIC ) {
+        error = "Not a timetable snapshot file";
+    } else if ( header->version != VERSION ) {
+        error = QString("Unsupported version %1, expected %2").arg(header->version).arg(VERSION);
+    } else if ( header->byteOrder != SNAPSHOT_BYTE_ORDER ) {
+        error = "The snapshot was written on a machine with another byte order";
+    } else if ( header->fileSize != size ) {
+        error = "Wrong file size, the snapshot may be truncated";
+    } else {
+        for ( int section = 0; section < SectionCount; ++section ) {
+            const SectionEntry &entry = header->sections[ section ];
+            if ( entry.offset < sizeof(SnapshotHeader) || entry.offset % 4 != 0 ||
+                 entry.offset + qint64(entry.count) * SECTION_ENTRY_SIZES[section] > size )
+            {
+                error = QString("Invalid section %1").arg( section );
+                break;
+            }
+        }
+    }
+
+    // Validate the checksum of the data
+    if ( error.isEmpty() &&
+         crc32(0, data + sizeof(SnapshotHeader), size - sizeof(SnapshotHeader)) !=
+         header->checksum )
+    {
+        error = "Wrong checksum, the snapshot is corrupted";
+    }
+
+    if ( !error.isEmpty() ) {
+        if ( errorText ) {
+            *errorText = error;
+        }
+        m_file.close();
+        return false;
+    }
+
+    m_data = data;
+    return true;
+}
+
+template< typename T >
+const T *GtfsTimetableSnapshot::section( int section ) const
+{
+    const SnapshotHeader *header = reinterpret_cast< const SnapshotHeader* >( m_data );
+    return reinterpret_cast< const T* >( m_data + header->sections[section].offset );
+}
+
+int GtfsTimetableSnapshot::sectionCount( int section ) const
+{
+    return reinterpret_cast< const SnapshotHeader* >( m_data )->sections[section].count;
+}
+
+QString GtfsTimetableSnapshot::string( quint32 offset ) const
+{
+    return QString::fromUtf8( section<char>(StringSection) + offset );
+}
+
+bool GtfsTimetableSnapshot::hasFrequencies() const
+{
+    return m_data &&
+           (reinterpret_cast<const SnapshotHeader*>(m_data)->flags & HasFrequenciesFlag);
+}
+
+int GtfsTimetableSnapshot::stopCount() const
+{
+    return m_data ? sectionCount( StopSection ) : 0;
+}
+
+int GtfsTimetableSnapshot::tripCount() const
+{
+    return m_data ? sectionCount( TripSection ) : 0;
+}
+
+int GtfsTimetableSnapshot::stopIndex( uint stopId ) const
+{
+    if ( !m_data ) {
+        return -1;
+    }
+
+    // Binary search in the stops, which are sorted by ID
+    const StopEntry *stops = section< StopEntry >( StopSection );
+    int low = 0;
+    int high = sectionCount( StopSection ) - 1;
+    while ( low <= high ) {
+        const int middle = (low + high) / 2;
+        if ( stops[middle].stopId < stopId ) {
+            low = middle + 1;
+        } else if ( stops[middle].stopId > stopId ) {
+            high = middle - 1;
+        } else {
+            return middle;
+        }
+    }
+    return -1;
+}
+
+int GtfsTimetableSnapshot::stopIndexByName( const QString &stopName ) const
+{
+    if ( !m_data ) {
+        return -1;
+    }
+
+    // Binary search in the stop indices, which are sorted by name
+    const QByteArray name = stopName.toUtf8();
+    const StopEntry *stops = section< StopEntry >( StopSection );
+    const quint32 *stopsByName = section< quint32 >( StopNameSection );
+    const char *strings = section< char >( StringSection );
+    int low = 0;
+    int high = sectionCount( StopNameSection ) - 1;
+    while ( low <= high ) {
+        const int middle = (low + high) / 2;
+        const int comparison = qstrcmp( strings + stops[stopsByName[middle]].name, name );
+        if ( comparison < 0 ) {
+            low = middle + 1;
+        } else if ( comparison > 0 ) {
+            high = middle - 1;
+        } else {
+            return stopsByName[ middle ];
+        }
+    }
+    return -1;
+}
+
+uint GtfsTimetableSnapshot::stopId( int stopIndex ) const
+{
+    Q_ASSERT( stopIndex >= 0 && stopIndex < stopCount() );
+    return section< StopEntry >( StopSection )[ stopIndex ].stopId;
+}
+
+bool GtfsTimetableSnapshot::isServiceAvailable( quint32 service, int julianDay ) const
+{
+    if ( service == NO_INDEX ) {
+        return true; // No matching record in calendar/calendar_dates => always available
+    }
+
+    const ServiceEntry &entry = section< ServiceEntry >( ServiceSection )[ service ];
+    const int day = julianDay - entry.firstDay;
+    if ( day < 0 || day >= int(entry.dayCount) ) {
+        return false;
+    }
+    const quint8 *days = section< quint8 >( ServiceDaySection ) + entry.days;
+    return days[day / 8] & (1 << (day % 8));
+}
+
+QList< QSqlRecord > GtfsTimetableSnapshot::departures( int stopIndex, int julianDay, int time,
+                                                       int count, bool arrivals ) const
+{
+    QList< QSqlRecord > records;
+    if ( !m_data || stopIndex < 0 || stopIndex >= stopCount() ) {
+        return records;
+    }
+
+    // Use the columns of GtfsDatabase::DeparturesStatement
+    QSqlRecord columns;
+    columns.append( QSqlField("departure_time", QVariant::Int) );
+    columns.append( QSqlField("arrival_time", QVariant::Int) );
+    columns.append( QSqlField("stop_headsign", QVariant::String) );
+    columns.append( QSqlField("route_type", QVariant::Int) );
+    columns.append( QSqlField("route_short_name", QVariant::String) );
+    columns.append( QSqlField("route_long_name", QVariant::String) );
+    columns.append( QSqlField("trip_headsign", QVariant::String) );
+    columns.append( QSqlField("agency_id", QVariant::UInt) );
+    columns.append( QSqlField("stop_id", QVariant::UInt) );
+    columns.append( QSqlField("trip_id", QVariant::UInt) );
+    columns.append( QSqlField("route_id", QVariant::UInt) );
+    columns.append( QSqlField("stop_sequence", QVariant::UInt) );
+    columns.append( QSqlField("route_stops", QVariant::String) );
+    columns.append( QSqlField("route_times", QVariant::String) );
+
+    const StopEntry *stops = section< StopEntry >( StopSection );
+    const RouteEntry *routes = section< RouteEntry >( RouteSection );
+    const PatternEntry *patterns = section< PatternEntry >( PatternSection );
+    const quint32 *patternStops = section< quint32 >( PatternStopSection );
+    const TripEntry *trips = section< TripEntry >( TripSection );
+    const StopTimeEntry *stopTimes = section< StopTimeEntry >( StopTimeSection );
+    const StopEntry &stop = stops[ stopIndex ];
+    const DepartureEntry *begin = section< DepartureEntry >( DepartureSection ) +
+                                  stop.firstDeparture;
+    const DepartureEntry *end = begin + stop.departureCount;
+    const QLatin1String separator( GtfsDatabase::ROUTE_SEPARATOR );
+
+    // Find the first departure after the given time
+    DepartureEntry first;
+    first.time = time;
+    for ( const DepartureEntry *departure = qUpperBound(begin, end, first, departureLessThan);
+          departure != end && records.count() < count; ++departure )
+    {
+        const TripEntry &trip = trips[ departure->trip ];
+        if ( !isServiceAvailable(trip.service, julianDay) ) {
+            continue;
+        }
+
+        const RouteEntry &route = routes[ trip.route ];
+        const PatternEntry &pattern = patterns[ trip.pattern ];
+        const StopTimeEntry &stopTime = stopTimes[ trip.firstStopTime + departure->position ];
+
+        // For arrivals route stops/times contain the stops before the home stop
+        const quint32 firstPosition = arrivals ? 0 : departure->position;
+        const quint32 lastPosition = arrivals ? departure->position : pattern.stopCount - 1;
+        QStringList routeStops, routeTimes;
+        for ( quint32 position = firstPosition; position <= lastPosition; ++position ) {
+            routeStops << string( stops[patternStops[pattern.firstStop + position]].name );
+            routeTimes << QString::number(
+                    stopTimes[trip.firstStopTime + position].departureTime );
+        }
+
+        QSqlRecord record = columns;
+        record.setValue( 0, stopTime.departureTime );
+        record.setValue( 1, stopTime.arrivalTime );
+        record.setValue( 2, string(stopTime.headsign) );
+        record.setValue( 3, route.routeType );
+        record.setValue( 4, string(route.shortName) );
+        record.setValue( 5, string(route.longName) );
+        record.setValue( 6, string(trip.headsign) );
+        record.setValue( 7, route.agencyId == NO_INDEX ? QVariant() : QVariant(route.agencyId) );
+        record.setValue( 8, stop.stopId );
+        record.setValue( 9, trip.tripId );
+        record.setValue( 10, route.routeId );
+        record.setValue( 11, stopTime.sequence );
+        record.setValue( 12, routeStops.join(separator) );
+        record.setValue( 13, routeTimes.join(separator) );
+        records << record;
+    }
+    return records;
+}
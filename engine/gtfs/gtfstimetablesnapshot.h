@@ -0,0 +1,168 @@
+/*
+ *   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/** @file
+* @brief This file contains a read-only, memory mapped snapshot of a GTFS timetable.
+* @author Friedrich Pülz <fpuelz@gmx.de> */
+
+#ifndef GTFSTIMETABLESNAPSHOT_HEADER
+#define GTFSTIMETABLESNAPSHOT_HEADER
+
+// Qt includes
+#include <QFile>
+#include <QSharedPointer>
+#include <QSqlRecord>
+
+class QSqlDatabase;
+
+/**
+ * @brief A read-only, memory mapped snapshot of the timetable in a GTFS database.
+ *
+ * The snapshot gets compiled from the GTFS database of a provider after a GTFS feed was
+ * imported, see write(). It contains dense arrays for stops, routes, patterns (sequences of
+ * stops shared by multiple trips), trips, stop times and the days at which services are
+ * available. For each stop all departures are stored sorted by time, so that departures can be
+ * looked up without a database query, see departures().
+ *
+ * The snapshot file gets mapped into memory read-only. Only GtfsQueryJob reads the snapshot,
+ * ie. the data engine and ProviderBenchmark. TimetableMate imports GTFS feeds using the GTFS
+ * service of the engine, which writes the snapshot, but the GTFS database tab of TimetableMate
+ * browses the tables of the database. The file starts with a header containing a version number,
+ * an import ID and a CRC-32 checksum of the data, open() rejects files with another version or
+ * a wrong checksum. Use snapshot() to get the snapshot of a provider, which is shared by all
+ * threads of a process and gets reopened when the snapshot was written again.
+ *
+ * Trips from the 'frequencies' table are not contained in the snapshot, use hasFrequencies() to
+ * test if the database needs to be queried for them.
+ **/
+class GtfsTimetableSnapshot {
+public:
+    /** @brief The version of the file format, files with another version get rejected. */
+    static const quint32 VERSION;
+
+    /** @brief Create a snapshot object, use open() to open a snapshot file. */
+    GtfsTimetableSnapshot();
+
+    /** @brief Destructor, unmaps the snapshot file. */
+    ~GtfsTimetableSnapshot();
+
+    /**
+     * @brief Get the full path to the snapshot file for the given @p providerName.
+     *
+     * The snapshot file is stored next to the GTFS database, see GtfsDatabase::databasePath().
+     **/
+    static QString snapshotPath( const QString &providerName );
+
+    /**
+     * @brief Get the shared snapshot for @p providerName.
+     *
+     * The snapshot gets opened on first use and shared by all threads. If the import ID or the
+     * checksum in the header of the snapshot file changed since it was opened, ie. the snapshot
+     * was written again, it gets opened again.
+     *
+     * @return The snapshot or a null pointer, if there is no valid snapshot file.
+     **/
+    static QSharedPointer< GtfsTimetableSnapshot > snapshot( const QString &providerName );
+
+    /**
+     * @brief Delete the snapshot file of @p providerName, eg. before a new GTFS feed gets imported.
+     *
+     * Already opened snapshots stay valid, until they are no longer used.
+     **/
+    static void remove( const QString &providerName );
+
+    /**
+     * @brief Compile a snapshot from the GTFS @p database and write it to @p fileName.
+     *
+     * The 'service_days' table needs to be filled, see GtfsDatabase::updateServiceDays().
+     *
+     * @param fileName The name of the snapshot file to write, see snapshotPath().
+     * @param database An open connection to the GTFS database.
+     * @param errorText Gets set to a string explaining an error, if this returns false.
+     *
+     * @returns True, if the snapshot was written successfully. False, otherwise.
+     **/
+    static bool write( const QString &fileName, const QSqlDatabase &database,
+                       QString *errorText );
+
+    /**
+     * @brief Map the snapshot file @p fileName into memory and validate it.
+     *
+     * @param fileName The name of the snapshot file to open.
+     * @param errorText Gets set to a string explaining an error, if this returns false.
+     *
+     * @returns True, if the file was opened and is valid. False, otherwise.
+     **/
+    bool open( const QString &fileName, QString *errorText = 0 );
+
+    /** @brief Whether or not a valid snapshot file is opened. */
+    bool isValid() const { return m_data != 0; };
+
+    /** @brief Whether or not the GTFS feed contains trips from the 'frequencies' table. */
+    bool hasFrequencies() const;
+
+    /** @brief The number of stops in the snapshot. */
+    int stopCount() const;
+
+    /** @brief The number of trips in the snapshot, without trips from 'frequencies'. */
+    int tripCount() const;
+
+    /** @brief Get the index of the stop with @p stopId or -1 if there is no such stop. */
+    int stopIndex( uint stopId ) const;
+
+    /**
+     * @brief Get the index of the stop (not a station) with @p stopName or -1 if there is no
+     *   such stop.
+     **/
+    int stopIndexByName( const QString &stopName ) const;
+
+    /** @brief Get the ID of the stop at @p stopIndex. */
+    uint stopId( int stopIndex ) const;
+
+    /**
+     * @brief Get departures or arrivals at a stop without querying the database.
+     *
+     * @param stopIndex The index of the stop, see stopIndex() and stopIndexByName().
+     * @param julianDay The julian day of the date of the departures.
+     * @param time The time of the departures in seconds since midnight, only departures after
+     *   this time get returned.
+     * @param count The maximal number of departures to return.
+     * @param arrivals Whether route stops/times should contain the stops before the stop at
+     *   @p stopIndex (arrivals) or after it (departures).
+     *
+     * @return Records sorted by departure time, with the same columns as records of
+     *   GtfsDatabase::DeparturesStatement.
+     **/
+    QList< QSqlRecord > departures( int stopIndex, int julianDay, int time, int count,
+                                    bool arrivals = false ) const;
+
+private:
+    Q_DISABLE_COPY( GtfsTimetableSnapshot )
+
+    template< typename T >
+    inline const T *section( int section ) const;
+    inline int sectionCount( int section ) const;
+    inline QString string( quint32 offset ) const;
+    bool isServiceAvailable( quint32 service, int julianDay ) const;
+
+    QFile m_file;
+    const uchar *m_data; // The mapped snapshot file or 0, if no valid file is opened
+};
+
+#endif // Multiple inclusion guard
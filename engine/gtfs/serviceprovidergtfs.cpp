@@ -25,6 +25,7 @@
 #include "serviceproviderglobal.h"
 #include "departureinfo.h"
 #include "gtfsservice.h"
+#include "gtfsqueryjob.h"
 #include "gtfsrealtime.h"
 #include "request.h"
 
@@ -41,6 +42,7 @@
 #include <KConfigGroup>
 #include <KIO/Job>
 #include <Plasma/DataEngine>
+#include <ThreadWeaver/Weaver>
 
 // Qt includes
 #include <QSqlQuery>
@@ -82,6 +84,28 @@ ServiceProviderGtfs::ServiceProviderGtfs(
 
 ServiceProviderGtfs::~ServiceProviderGtfs()
 {
+    // Abort running query jobs and wait for them to finish for proper cleanup
+    foreach ( GtfsQueryJob *job, m_runningJobs ) {
+        disconnect( job, 0, this, 0 );
+        if ( ThreadWeaver::Weaver::instance()->dequeue(job) ) {
+            delete job;
+            continue;
+        }
+
+        // Wait for the job to get aborted, the currently executed SQL statement gets finished
+        job->requestAbort();
+        QEventLoop loop;
+        connect( job, SIGNAL(done(ThreadWeaver::Job*)), &loop, SLOT(quit()) );
+        QTimer::singleShot( 1000, &loop, SLOT(quit()) );
+        if ( !job->isFinished() ) {
+            loop.exec(); // The job is still not finished, wait for it
+        }
+
+        // The job has finished or the timeout was reached
+        job->deleteLater();
+    }
+    m_runningJobs.clear();
+
     // Free all agency objects
     qDeleteAll( m_agencyCache );
 
@@ -394,136 +418,121 @@ void ServiceProviderGtfs::requestArrivals( const ArrivalRequest &request )
 
 void ServiceProviderGtfs::requestDeparturesOrArrivals( const DepartureRequest *request )
 {
-    QSqlQuery query( QSqlDatabase::database(m_data->id()) );
-    query.setForwardOnly( true ); // Don't cache records
-
-    // TODO If it is known that [stop] contains a stop ID testing for it's ID in stop_times is not necessary!
-    // Try to get the ID for the given stop (fails, if it already is a stop ID). Only select
-    // stops, no stations (with one or more sub stops) by requiring 'location_type=0',
-    // location_type 1 is for stations.
-    // It's fast, because 'stop_name' is part of a compound index in the database.
-    uint stopId;
-    QString stopValue = request->stop();
-    stopValue.replace( '\'', "\'\'" );
-    if ( !query.exec("SELECT stops.stop_id FROM stops "
-                     "WHERE stop_name='" + stopValue + "' "
-                     "AND (location_type IS NULL OR location_type=0)") )
-    {
-        // Check of the error is a "disk I/O error", ie. the database file may have been deleted
-        checkForDiskIoError( query.lastError(), request );
-
-        kDebug() << query.lastError();
-        kDebug() << query.executedQuery();
+    enqueue( new GtfsQueryJob(m_data->id(), request, this) );
+}
+
+void ServiceProviderGtfs::requestStopSuggestions( const StopSuggestionRequest &request )
+{
+    enqueue( new GtfsQueryJob(m_data->id(), &request, this) );
+}
+
+void ServiceProviderGtfs::requestStopsByGeoPosition( const StopsByGeoPositionRequest &request )
+{
+    enqueue( new GtfsQueryJob(m_data->id(), &request, this) );
+}
+
+void ServiceProviderGtfs::enqueue( GtfsQueryJob *job )
+{
+    m_runningJobs << job;
+    connect( job, SIGNAL(done(ThreadWeaver::Job*)), this, SLOT(jobDone(ThreadWeaver::Job*)) );
+    ThreadWeaver::Weaver::instance()->enqueue( job );
+}
+
+bool ServiceProviderGtfs::abortRequests( const QString &sourceName )
+{
+    bool aborted = false;
+    foreach ( GtfsQueryJob *job, m_runningJobs ) {
+        if ( job->request()->sourceName() != sourceName ) {
+            continue;
+        }
+
+        aborted = true;
+        if ( ThreadWeaver::Weaver::instance()->dequeue(job) ) {
+            // The job was not started yet, done() will not be emitted
+            m_runningJobs.removeOne( job );
+            job->deleteLater();
+        } else {
+            // The job is running, results get discarded in jobDone()
+            job->requestAbort();
+        }
+    }
+    return aborted;
+}
+
+void ServiceProviderGtfs::jobDone( ThreadWeaver::Job *job )
+{
+    GtfsQueryJob *queryJob = qobject_cast< GtfsQueryJob* >( job );
+    Q_ASSERT( queryJob );
+    m_runningJobs.removeOne( queryJob );
+    queryJob->deleteLater();
+
+    if ( queryJob->isAborted() ) {
+        // The data source of the request was removed
         return;
     }
 
-    QSqlRecord stopRecord = query.record();
-    if ( query.next() ) {
-        stopId = query.value( query.record().indexOf("stop_id") ).toUInt();
-    } else {
-        bool ok;
-        stopId = request->stop().toUInt( &ok );
-        if ( !ok ) {
-            kDebug() << "No stop with the given name or id found (needs the exact name):"
-                     << request->stop();
-            emit requestFailed( this, ErrorParsingFailed /*TODO*/,
-                    "No stop with the given name or id found (needs the exact name): "
-                    + request->stop(),
-                    QUrl(), request );
-            return;
+    const AbstractRequest *request = queryJob->request();
+    if ( !queryJob->success() ) {
+        // Check if the error is a "disk I/O error", ie. the database file may have been deleted
+        if ( !checkForDiskIoError(queryJob->lastError(), request) ) {
+            emit requestFailed( this, ErrorParsingFailed /*TODO*/, queryJob->errorString(),
+                                QUrl(), request );
         }
+        return;
     }
 
-// This creates a temporary table to calculate min/max fares for departures.
-// These values should be added into the db while importing, doing it here takes too long
-//     const QString createJoinedFareTable = "CREATE TEMPORARY TABLE IF NOT EXISTS tmp_fares AS "
-//             "SELECT * FROM fare_rules JOIN fare_attributes USING (fare_id);";
-//     if ( !query.prepare(createJoinedFareTable) || !query.exec() ) {
-//         kDebug() << "Error while creating a temporary table fore min/max fare calculation:"
-//                  << query.lastError();
-//         kDebug() << query.executedQuery();
-//         return;
-//     }
-
-    // Query the needed departure info from the database.
-    // It's fast, because all JOINs are done using INTEGER PRIMARY KEYs and
-    // because 'stop_id' and 'departure_time' are part of a compound index in the database.
-    // Sorting by 'arrival_time' may be a bit slower because is has no index in the database,
-    // but if arrival_time values do not differ too much from the deaprture_time values, they
-    // are also already sorted.
-    // The tables 'calendar' and 'calendar_dates' are also fully implemented by the query below.
-    // TODO: Create a new (temporary) table for each connected departure/arrival source and use
-    //       that (much smaller) table here for performance reasons
-    const QString routeSeparator = "||";
-    const QTime time = request->dateTime().time();
-    const QString queryString = QString(
-            "SELECT times.departure_time, times.arrival_time, times.stop_headsign, "
-                   "routes.route_type, routes.route_short_name, routes.route_long_name, "
-                   "trips.trip_headsign, routes.agency_id, stops.stop_id, trips.trip_id, "
-                   "routes.route_id, times.stop_sequence, "
-                   "( SELECT group_concat(route_stop.stop_name, '%5') AS route_stops "
-                     "FROM stop_times AS route_times INNER JOIN stops AS route_stop USING (stop_id) "
-                     "WHERE route_times.trip_id=times.trip_id AND route_times.stop_sequence %4= times.stop_sequence "
-                     "ORDER BY departure_time ) AS route_stops, "
-                   "( SELECT group_concat(route_times.departure_time, '%5') AS route_times "
-                     "FROM stop_times AS route_times "
-                     "WHERE route_times.trip_id=times.trip_id AND route_times.stop_sequence %4= times.stop_sequence "
-                     "ORDER BY departure_time ) AS route_times "
-//                    "( SELECT min(price) FROM tmp_fares WHERE origin_id=stops.zone_id AND price>0 ) AS min_price, "
-//                    "( SELECT max(price) FROM tmp_fares WHERE origin_id=stops.zone_id ) AS max_price, "
-//                    "( SELECT currency_type FROM tmp_fares WHERE origin_id=stops.zone_id LIMIT 1 ) AS currency_type "
-            "FROM stops INNER JOIN stop_times AS times USING (stop_id) "
-                       "INNER JOIN trips USING (trip_id) "
-                       "INNER JOIN routes USING (route_id) "
-                       "LEFT JOIN calendar USING (service_id) "
-                       "LEFT JOIN calendar_dates ON (trips.service_id=calendar_dates.service_id "
-                                                    "AND strftime('%Y%m%d')=calendar_dates.date) "
-            "WHERE stop_id=%1 AND departure_time>%2 "
-                  "AND (calendar_dates.date IS NULL " // No matching record in calendar_dates table for today
-                       "OR NOT (calendar_dates.exception_type=2)) " // Journey is not removed today
-                  "AND (calendar.weekdays IS NULL " // No matching record in calendar table => always available
-                       "OR (strftime('%Y%m%d') BETWEEN calendar.start_date " // Current date is in the range...
-                                              "AND calendar.end_date " // ...where the service is available...
-                           "AND substr(calendar.weekdays, strftime('%w') + 1, 1)='1') " // ...and it's available at the current weekday
-                       "OR (calendar_dates.date IS NOT NULL " // Or there is a matching record in calendar_dates for today...
-                           "AND calendar_dates.exception_type=1)) " // ...and this record adds availability of the service for today
-            "ORDER BY departure_time "
-            "LIMIT %3" )
-            .arg( stopId )
-            .arg( time.hour() * 60 * 60 + time.minute() * 60 + time.second() )
-            .arg( request->count() )
-            .arg( request->parseMode() == ParseForArrivals ? '<' : '>' ) // For arrivals route_stops/route_times need stops before the home stop
-            .arg( routeSeparator );
-    if ( !query.prepare(queryString) || !query.exec() ) {
-        kDebug() << "Error while querying for departures:" << query.lastError();
-        kDebug() << query.executedQuery();
+    // Emit the results, also if there are no records, to not let the data source wait
+    const StopSuggestionRequest *stopSuggestionRequest =
+            dynamic_cast< const StopSuggestionRequest* >( request );
+    if ( stopSuggestionRequest ) {
+        emit stopsReceived( this, QUrl(),
+                            stopsFromRecords(queryJob->records(), stopSuggestionRequest),
+                            *stopSuggestionRequest );
         return;
     }
-    if ( query.size() == 0 ) {
-        kDebug() << "Got an empty record";
-        return;
+
+    const DepartureRequest *departureRequest = dynamic_cast< const DepartureRequest* >( request );
+    Q_ASSERT( departureRequest );
+    const DepartureInfoList departures =
+            departuresFromRecords( queryJob->records(), departureRequest );
+
+    const ArrivalRequest *arrivalRequest = dynamic_cast< const ArrivalRequest* >( request );
+    if ( arrivalRequest ) {
+        emit arrivalsReceived( this, QUrl(), departures, GlobalTimetableInfo(), *arrivalRequest );
+    } else {
+        emit departuresReceived( this, QUrl(), departures, GlobalTimetableInfo(),
+                                 *departureRequest );
     }
-    kDebug() << "Query executed";
-    kDebug() << query.executedQuery();
+}
 
-    QSqlRecord record = query.record();
-    const int agencyIdColumn = record.indexOf( "agency_id" );
-    const int tripIdColumn = record.indexOf( "trip_id" );
-    const int routeIdColumn = record.indexOf( "route_id" );
-    const int stopIdColumn = record.indexOf( "stop_id" );
-    const int arrivalTimeColumn = record.indexOf( "arrival_time" );
-    const int departureTimeColumn = record.indexOf( "departure_time" );
-    const int routeShortNameColumn = record.indexOf( "route_short_name" );
-    const int routeLongNameColumn = record.indexOf( "route_long_name" );
-    const int routeTypeColumn = record.indexOf( "route_type" );
-    const int tripHeadsignColumn = record.indexOf( "trip_headsign" );
-    const int stopSequenceColumn = record.indexOf( "stop_sequence" );
-    const int stopHeadsignColumn = record.indexOf( "stop_headsign" );
-    const int routeStopsColumn = record.indexOf( "route_stops" );
-    const int routeTimesColumn = record.indexOf( "route_times" );
-//     const int fareMinPriceColumn = record.indexOf( "min_price" );
-//     const int fareMaxPriceColumn = record.indexOf( "max_price" );
-//     const int fareCurrencyColumn  = record.indexOf( "currency_type" );
+DepartureInfoList ServiceProviderGtfs::departuresFromRecords(
+        const QList<QSqlRecord> &records, const DepartureRequest *request ) const
+{
+    DepartureInfoList departures;
+    if ( records.isEmpty() ) {
+        kDebug() << "No departures found";
+        return departures;
+    }
+    departures.reserve( records.count() );
+
+    const QSqlRecord &firstRecord = records.first();
+    const int agencyIdColumn = firstRecord.indexOf( "agency_id" );
+    const int tripIdColumn = firstRecord.indexOf( "trip_id" );
+    const int routeIdColumn = firstRecord.indexOf( "route_id" );
+    const int stopIdColumn = firstRecord.indexOf( "stop_id" );
+    const int arrivalTimeColumn = firstRecord.indexOf( "arrival_time" );
+    const int departureTimeColumn = firstRecord.indexOf( "departure_time" );
+    const int routeShortNameColumn = firstRecord.indexOf( "route_short_name" );
+    const int routeLongNameColumn = firstRecord.indexOf( "route_long_name" );
+    const int routeTypeColumn = firstRecord.indexOf( "route_type" );
+    const int tripHeadsignColumn = firstRecord.indexOf( "trip_headsign" );
+    const int stopSequenceColumn = firstRecord.indexOf( "stop_sequence" );
+    const int stopHeadsignColumn = firstRecord.indexOf( "stop_headsign" );
+    const int routeStopsColumn = firstRecord.indexOf( "route_stops" );
+    const int routeTimesColumn = firstRecord.indexOf( "route_times" );
+//     const int fareMinPriceColumn = firstRecord.indexOf( "min_price" );
+//     const int fareMaxPriceColumn = firstRecord.indexOf( "max_price" );
+//     const int fareCurrencyColumn  = firstRecord.indexOf( "currency_type" );
 
     // Prepare agency information, if only one is given, it is used for all records
     AgencyInformation *agency = 0;
@@ -532,21 +541,20 @@ void ServiceProviderGtfs::requestDeparturesOrArrivals( const DepartureRequest *r
     }
 
     // Create a list of DepartureInfo objects from the query result
-    DepartureInfoList departures;
-    while ( query.next() ) {
+    foreach ( const QSqlRecord &record, records ) {
         QDate arrivalDate = request->dateTime().date();
         QDate departureDate = request->dateTime().date();
 
         // Load agency information from cache
-        const QVariant agencyIdValue = query.value( agencyIdColumn );
+        const QVariant agencyIdValue = record.value( agencyIdColumn );
         if ( m_agencyCache.count() > 1 ) {
             Q_ASSERT( agencyIdValue.isValid() ); // GTFS says, that agency_id can only be null, if there is only one agency
             agency = m_agencyCache[ agencyIdValue.toUInt() ];
         }
 
         // Time values are stored as seconds since midnight of the associated date
-        int arrivalTimeValue = query.value(arrivalTimeColumn).toInt();
-        int departureTimeValue = query.value(departureTimeColumn).toInt();
+        int arrivalTimeValue = record.value(arrivalTimeColumn).toInt();
+        int departureTimeValue = record.value(departureTimeColumn).toInt();
 
         QDateTime arrivalTime( arrivalDate,
                                timeFromSecondsSinceMidnight(arrivalTimeValue, &arrivalDate) );
@@ -562,18 +570,19 @@ void ServiceProviderGtfs::requestDeparturesOrArrivals( const DepartureRequest *r
 
         TimetableData data;
         data[ Enums::DepartureDateTime ] = request->parseMode() == ParseForArrivals ? arrivalTime : departureTime;
-        data[ Enums::TypeOfVehicle ] = vehicleTypeFromGtfsRouteType( query.value(routeTypeColumn).toInt() );
+        data[ Enums::TypeOfVehicle ] = vehicleTypeFromGtfsRouteType( record.value(routeTypeColumn).toInt() );
         data[ Enums::Operator ] = agency ? agency->name : QString();
 
-        const QString transportLine = query.value(routeShortNameColumn).toString();
+        const QString transportLine = record.value(routeShortNameColumn).toString();
         data[ Enums::TransportLine ] = !transportLine.isEmpty() ? transportLine
-                         : query.value(routeLongNameColumn).toString();
+                         : record.value(routeLongNameColumn).toString();
 
-        const QString tripHeadsign = query.value(tripHeadsignColumn).toString();
+        const QString tripHeadsign = record.value(tripHeadsignColumn).toString();
         data[ Enums::Target ] = !tripHeadsign.isEmpty() ? tripHeadsign
-                         : query.value(stopHeadsignColumn).toString();
+                         : record.value(stopHeadsignColumn).toString();
 
-        const QStringList routeStops = query.value(routeStopsColumn).toString().split( routeSeparator );
+        const QStringList routeStops = record.value(routeStopsColumn).toString()
+                .split( QLatin1String(GtfsDatabase::ROUTE_SEPARATOR) );
         if ( routeStops.isEmpty() ) {
             // This happens, if the current departure is actually no departure, but an arrival at
             // the target station and vice versa for arrivals.
@@ -582,17 +591,18 @@ void ServiceProviderGtfs::requestDeparturesOrArrivals( const DepartureRequest *r
         data[ Enums::RouteStops ] = routeStops;
         data[ Enums::RouteExactStops ] = routeStops.count();
 
-        const QStringList routeTimeValues = query.value(routeTimesColumn).toString().split( routeSeparator );
+        const QStringList routeTimeValues = record.value(routeTimesColumn).toString()
+                .split( QLatin1String(GtfsDatabase::ROUTE_SEPARATOR) );
         QVariantList routeTimes;
         foreach ( const QString routeTimeValue, routeTimeValues ) {
             routeTimes << timeFromSecondsSinceMidnight( routeTimeValue.toInt(), &arrivalDate );
         }
         data[ Enums::RouteTimes ] = routeTimes;
 
-//         const QString symbol = KCurrencyCode( query.value(fareCurrencyColumn).toString() ).defaultSymbol();
+//         const QString symbol = KCurrencyCode( record.value(fareCurrencyColumn).toString() ).defaultSymbol();
 //         data[ Pricing ] = KGlobal::locale()->formatMoney(
-//                 query.value(fareMinPriceColumn).toDouble(), symbol ) + " - " +
-//                 KGlobal::locale()->formatMoney( query.value(fareMaxPriceColumn).toDouble(), symbol );
+//                 record.value(fareMinPriceColumn).toDouble(), symbol ) + " - " +
+//                 KGlobal::locale()->formatMoney( record.value(fareMaxPriceColumn).toDouble(), symbol );
 
 #ifdef BUILD_GTFS_REALTIME
         if ( m_alerts ) {
@@ -611,10 +621,10 @@ void ServiceProviderGtfs::requestDeparturesOrArrivals( const DepartureRequest *r
         }
 
         if ( m_tripUpdates ) {
-            uint tripId = query.value(tripIdColumn).toUInt();
-            uint routeId = query.value(routeIdColumn).toUInt();
-            uint stopId = query.value(stopIdColumn).toUInt();
-            uint stopSequence = query.value(stopSequenceColumn).toUInt();
+            uint tripId = record.value(tripIdColumn).toUInt();
+            uint routeId = record.value(routeIdColumn).toUInt();
+            uint stopId = record.value(stopIdColumn).toUInt();
+            uint stopSequence = record.value(stopSequenceColumn).toUInt();
             foreach ( const GtfsRealtimeTripUpdate &tripUpdate, *m_tripUpdates ) {
                 if ( (tripUpdate.tripId > 0 && tripId == tripUpdate.tripId) ||
                      (tripUpdate.routeId > 0 && routeId == tripUpdate.routeId) ||
@@ -642,73 +652,33 @@ void ServiceProviderGtfs::requestDeparturesOrArrivals( const DepartureRequest *r
         // Create new departure information object and add it to the departure list.
         // Do not use any corrections in the DepartureInfo constructor, because all values
         // from the database are already in the correct format
-        departures << DepartureInfoPtr( new DepartureInfo(data, PublicTransportInfo::NoCorrection) );
+        departures << DepartureInfo( data, PublicTransportInfo::NoCorrection );
     }
 
-    // TODO Do not use a list of pointers here, maybe use data sharing for PublicTransportInfo/StopInfo?
-    // The objects in departures are deleted in a connected slot in the data engine...
-    const ArrivalRequest *arrivalRequest = dynamic_cast< const ArrivalRequest* >( request );
-    if ( arrivalRequest ) {
-        emit arrivalsReceived( this, QUrl(), departures, GlobalTimetableInfo(), *arrivalRequest );
-    } else {
-        emit departuresReceived( this, QUrl(), departures, GlobalTimetableInfo(), *request );
-    }
+    return departures;
 }
 
-void ServiceProviderGtfs::requestStopSuggestions( const StopSuggestionRequest &request )
+StopInfoList ServiceProviderGtfs::stopsFromRecords( const QList<QSqlRecord> &records,
+                                                    const StopSuggestionRequest *request ) const
 {
-    QSqlQuery query( QSqlDatabase::database(m_data->id()) );
-    query.setForwardOnly( true );
-    QString stopValue = request.stop();
-    stopValue.replace( '\'', "\'\'" );
-    if ( !query.prepare(QString("SELECT * FROM stops WHERE stop_name LIKE '%%2%' LIMIT %1")
-                        .arg(STOP_SUGGESTION_LIMIT).arg(stopValue))
-         || !query.exec() )
-    {
-        // Check of the error is a "disk I/O error", ie. the database file may have been deleted
-        checkForDiskIoError( query.lastError(), &request );
-        kDebug() << query.lastError();
-        kDebug() << query.executedQuery();
-        return;
-    }
-    emit stopsReceived( this, QUrl(), stopsFromQuery(&query, &request), request );
-}
-
-void ServiceProviderGtfs::requestStopsByGeoPosition( const StopsByGeoPositionRequest &request )
-{
-    QSqlQuery query( QSqlDatabase::database(m_data->id()) );
-    query.setForwardOnly( true );
-    kDebug() << "Get stops near:" << request.distance() << "meters ==" << (request.distance() * 0.009 / 2);
-    if ( !query.prepare(QString("SELECT * FROM stops "
-                                "WHERE stop_lon between (%2-%4) and (%2+%4) "
-                                "AND stop_lat between (%3-%4) and (%3+%4) LIMIT %1")
-                        .arg(STOP_SUGGESTION_LIMIT).arg(request.longitude()).arg(request.latitude())
-                        .arg(request.distance() * 0.000009 / 2)) // Calculate degree from meters = 360/40,070,000
-         || !query.exec() )
-    {
-        // Check of the error is a "disk I/O error", ie. the database file may have been deleted
-        checkForDiskIoError( query.lastError(), &request );
-        kDebug() << query.lastError();
-        kDebug() << query.executedQuery();
-        return;
+    StopInfoList stops;
+    if ( records.isEmpty() ) {
+        kDebug() << "No stops found";
+        return stops;
     }
-    emit stopsReceived( this, QUrl(), stopsFromQuery(&query, &request), request );
-}
+    stops.reserve( records.count() );
 
-StopInfoList ServiceProviderGtfs::stopsFromQuery( QSqlQuery *query,
-                                                  const StopSuggestionRequest *request ) const {
-    QSqlRecord record = query->record();
-    const int stopIdColumn = record.indexOf( "stop_id" );
-    const int stopNameColumn = record.indexOf( "stop_name" );
-    const int stopLongitudeColumn = record.indexOf( "stop_lon" );
-    const int stopLatitudeColumn = record.indexOf( "stop_lat" );
+    const QSqlRecord &firstRecord = records.first();
+    const int stopIdColumn = firstRecord.indexOf( "stop_id" );
+    const int stopNameColumn = firstRecord.indexOf( "stop_name" );
+    const int stopLongitudeColumn = firstRecord.indexOf( "stop_lon" );
+    const int stopLatitudeColumn = firstRecord.indexOf( "stop_lat" );
 
-    StopInfoList stops;
-    while ( query->next() ) {
-        const QString stopName = query->value(stopNameColumn).toString();
-        const QString id = query->value(stopIdColumn).toString();
-        const qreal longitude = query->value(stopLongitudeColumn).toReal();
-        const qreal latitude = query->value(stopLatitudeColumn).toReal();
+    foreach ( const QSqlRecord &record, records ) {
+        const QString stopName = record.value(stopNameColumn).toString();
+        const QString id = record.value(stopIdColumn).toString();
+        const qreal longitude = record.value(stopLongitudeColumn).toReal();
+        const qreal latitude = record.value(stopLatitudeColumn).toReal();
         int weight = -1;
 
         if ( !dynamic_cast<const StopsByGeoPositionRequest*>(request) ) {
@@ -738,12 +708,7 @@ StopInfoList ServiceProviderGtfs::stopsFromQuery( QSqlQuery *query,
             }
         }
 
-        stops << StopInfoPtr( new StopInfo(stopName, id, weight,
-                                           longitude, latitude, request->city()) );
-    }
-
-    if ( stops.isEmpty() ) {
-        kDebug() << "No stops found";
+        stops << StopInfo( stopName, id, weight, longitude, latitude, request->city() );
     }
     return stops;
 }
@@ -34,8 +34,12 @@
 namespace Plasma {
     class Service;
 }
+namespace ThreadWeaver {
+    class Job;
+}
 
 class GtfsService;
+class GtfsQueryJob;
 class QNetworkReply;
 class KTimeZone;
 
@@ -50,9 +54,11 @@ class KTimeZone;
  * This is because importing GTFS feeds can require quite a lot disk space and importing can take
  * some time. The user should be asked to import a new GTFS feed.
  *
- * This class immediately emits the ...Received() signal in the associated request...() functions,
- * because making timetable data available is very fast using the GTFS database. Requesting data
- * from the database is very fast even for big databases (eg. 300MB).
+ * Requests get answered asynchronously using GtfsQueryJob, which queries the database in a
+ * thread of ThreadWeaver using a read-only connection. Slow queries on big databases do not block
+ * the data engine and the database can be read while a GTFS feed gets imported. The records
+ * read by the job get converted to timetable items in the main thread, then the associated
+ * ...Received() signal gets emitted. Use abortRequests() to abort running requests.
  *
  * To add support for a new service provider using this accessor type you need to write an accessor
  * XML file for the service provider.
@@ -175,7 +181,24 @@ public:
     /** @brief Gets the size in bytes of the database containing the GTFS data. */
     qint64 databaseSize() const;
 
+    /**
+     * @brief Abort running queries for the data source @p sourceName.
+     *
+     * Jobs that were not started yet get removed from the queue, running jobs are aborted and
+     * their results get discarded.
+     **/
+    virtual bool abortRequests( const QString &sourceName );
+
 protected slots:
+    /**
+     * @brief A GtfsQueryJob is done, emit the associated ...Received() signal.
+     *
+     * The signal also gets emitted with an empty list, if the query was successful but found
+     * no records, eg. for dates outside of the feed. Failed jobs emit requestFailed() and
+     * nothing gets emitted for aborted jobs.
+     **/
+    void jobDone( ThreadWeaver::Job *job );
+
 #ifdef BUILD_GTFS_REALTIME
     /**
      * @brief GTFS-realtime TripUpdates data received.
@@ -229,8 +252,16 @@ protected:
     /** @brief Check @p error for IO errors, emit requestFailed() on failure. */
     bool checkForDiskIoError( const QSqlError &error, const AbstractRequest *request );
 
-    /** @brief Get a list of stops from a successfully executed @p query. */
-    StopInfoList stopsFromQuery( QSqlQuery *query, const StopSuggestionRequest *request = 0 ) const;
+    /** @brief Get a list of stops from @p records of a finished GtfsQueryJob. */
+    StopInfoList stopsFromRecords( const QList<QSqlRecord> &records,
+                                   const StopSuggestionRequest *request = 0 ) const;
+
+    /** @brief Get a list of departures/arrivals from @p records of a finished GtfsQueryJob. */
+    DepartureInfoList departuresFromRecords( const QList<QSqlRecord> &records,
+                                             const DepartureRequest *request ) const;
+
+    /** @brief Enqueue @p job into the global ThreadWeaver queue. */
+    void enqueue( GtfsQueryJob *job );
 
     /**
      * @brief Whether or not realtime data is available in the @p data of a timetable data source.
@@ -258,6 +289,7 @@ private:
     State m_state; // Current state
     AgencyInformations m_agencyCache; // Cache contents of the "agency" DB table, usally small, eg. only one agency
     Plasma::Service *m_service;
+    QList< GtfsQueryJob* > m_runningJobs; // Enqueued or running query jobs
 #ifdef BUILD_GTFS_REALTIME
     GtfsRealtimeTripUpdates *m_tripUpdates;
     GtfsRealtimeAlerts *m_alerts;
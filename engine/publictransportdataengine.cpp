@@ -32,6 +32,7 @@
 
 #ifdef BUILD_PROVIDER_TYPE_SCRIPT
     #include "script/serviceproviderscript.h"
+    #include "script/scriptapi.h"
 #endif
 #ifdef BUILD_PROVIDER_TYPE_GTFS
     #include "gtfs/serviceprovidergtfs.h"
@@ -266,7 +267,8 @@ QStringList PublicTransportEngine::sources() const
     sources << sourceTypeKeyword(LocationsSource)
             << sourceTypeKeyword(ServiceProvidersSource)
             << sourceTypeKeyword(ErroneousServiceProvidersSource)
-            << sourceTypeKeyword(VehicleTypesSource);
+            << sourceTypeKeyword(VehicleTypesSource)
+            << sourceTypeKeyword(DiagnosticsSource);
     sources.removeDuplicates();
     return sources;
 }
@@ -356,6 +358,12 @@ void PublicTransportEngine::slotSourceRemoved( const QString &sourceName )
         Q_ASSERT( dataSource );
         if ( dataSource->data().contains("serviceProvider") ) {
             const QString providerId = dataSource->value("serviceProvider").toString();
+            if ( m_providers.contains(providerId) && m_runningSources.contains(nonAmbiguousName) &&
+                 m_providers[providerId]->abortRequests(sourceName) )
+            {
+                // A running request for the removed data source was aborted
+                m_runningSources.removeOne( nonAmbiguousName );
+            }
             if ( !providerId.isEmpty() && !isProviderUsed(providerId) ) {
                 // Remove provider from the list,
                 // if no other ProviderPointer to that provider exists, this deletes the provider
@@ -1266,6 +1274,8 @@ const QLatin1String PublicTransportEngine::sourceTypeKeyword( SourceType sourceT
         return QLatin1String("Locations");
     case VehicleTypesSource:
         return QLatin1String("VehicleTypes");
+    case DiagnosticsSource:
+        return QLatin1String("Diagnostics");
     case DeparturesSource:
         return QLatin1String("Departures");
     case ArrivalsSource:
@@ -1299,6 +1309,8 @@ PublicTransportEngine::SourceType PublicTransportEngine::sourceTypeFromName(
         return LocationsSource;
     } else if ( sourceName.compare(sourceTypeKeyword(VehicleTypesSource)) == 0 ) {
         return VehicleTypesSource;
+    } else if ( sourceName.compare(sourceTypeKeyword(DiagnosticsSource)) == 0 ) {
+        return DiagnosticsSource;
     } else if ( sourceName.startsWith(sourceTypeKeyword(DeparturesSource)) ) {
         return DeparturesSource;
     } else if ( sourceName.startsWith(sourceTypeKeyword(ArrivalsSource)) ) {
@@ -1543,6 +1555,8 @@ bool PublicTransportEngine::requestOrUpdateSourceEvent( const SourceRequestData
         return updateErroneousServiceProviderSource();
     case LocationsSource:
         return updateLocationSource();
+    case DiagnosticsSource:
+        return updateDiagnosticsSource();
     case DeparturesSource:
     case ArrivalsSource:
     case StopsSource:
@@ -1584,6 +1598,25 @@ void PublicTransportEngine::initVehicleTypesSource()
     setData( sourceTypeKeyword(VehicleTypesSource), vehicleTypes );
 }
 
+bool PublicTransportEngine::updateDiagnosticsSource()
+{
+    Data diagnostics;
+#ifdef BUILD_PROVIDER_TYPE_SCRIPT
+    const ScriptApi::RegExpCache::Statistics regExpStatistics =
+            ScriptApi::RegExpCache::instance()->statistics();
+    QVariantHash regExpCache;
+    regExpCache.insert( "hits", regExpStatistics.hits );
+    regExpCache.insert( "misses", regExpStatistics.misses );
+    regExpCache.insert( "hitRate", regExpStatistics.hitRate() );
+    regExpCache.insert( "size", regExpStatistics.size );
+    regExpCache.insert( "maxSize", regExpStatistics.maxSize );
+    diagnostics.insert( "regExpCache", regExpCache );
+#endif
+
+    setData( sourceTypeKeyword(DiagnosticsSource), diagnostics );
+    return true;
+}
+
 void PublicTransportEngine::timetableDataReceived( ServiceProvider *provider,
         const QUrl &requestUrl, const DepartureInfoList &items,
         const GlobalTimetableInfo &globalInfo, const DepartureRequest &request,
@@ -1604,27 +1637,30 @@ void PublicTransportEngine::timetableDataReceived( ServiceProvider *provider,
     TimetableDataSource *dataSource =
             dynamic_cast< TimetableDataSource* >( m_dataSources[nonAmbiguousName] );
     Q_ASSERT( dataSource );
-    m_runningSources.removeOne( nonAmbiguousName );
-    QVariantList departuresData;
     const QString itemKey = isDepartureData ? "departures" : "arrivals";
 
+    // Providers may publish the items of a request in multiple chunks, each chunk only contains
+    // new items. The first chunk replaces the items of the data source and removes the source
+    // from the running sources, later chunks get appended to the items taken out of the source
+    const bool isFirstChunk = m_runningSources.removeOne( nonAmbiguousName );
+    QVariantList departuresData;
     QHash< uint, TimetableData > stillUsedAdditionalData;
-    foreach( const DepartureInfoPtr &departureInfo, items ) {
-        QVariantHash departureData;
-        TimetableData departure = departureInfo->data();
-        for ( TimetableData::ConstIterator it = departure.constBegin();
-              it != departure.constEnd(); ++it )
-        {
-            if ( it.value().isValid() ) {
-                departureData.insert( Global::timetableInformationToString(it.key()), it.value() );
-            }
-        }
-
-        departureData.insert( "Nightline", departureInfo->isNightLine() );
-        departureData.insert( "Expressline", departureInfo->isExpressLine() );
+    if ( !isFirstChunk ) {
+        departuresData = dataSource->takeTimetableItems();
+        stillUsedAdditionalData = dataSource->additionalData();
+    }
+    departuresData.reserve( departuresData.count() + items.count() );
+    foreach ( const DepartureInfo &departureInfo, items ) {
+        QVariantHash departureData = departureInfo.toVariantHash();
+        departureData.insert( "Nightline", departureInfo.isNightLine() );
+        departureData.insert( "Expressline", departureInfo.isExpressLine() );
 
         // Add existing additional data
-        const uint hash = hashForDeparture( departure );
+        const uint hash = hashForDeparture(
+                departureInfo.value(Enums::DepartureDateTime).toDateTime(),
+                static_cast<Enums::VehicleType>(departureInfo.value(Enums::TypeOfVehicle).toInt()),
+                departureInfo.value(Enums::TransportLine).toString(),
+                departureInfo.value(Enums::Target).toString() );
         if ( dataSource->additionalData().contains(hash) ) {
             // Found already downloaded additional data, add it to the updated departure data
             const TimetableData additionalData = dataSource->additionalData( hash );
@@ -1653,7 +1689,7 @@ void PublicTransportEngine::timetableDataReceived( ServiceProvider *provider,
     // Store a proposal for the next download time
     const QDateTime dateTime = QDateTime::currentDateTime();
     QDateTime last = items.isEmpty() ? dateTime
-            : items.last()->value(Enums::DepartureDateTime).toDateTime();
+            : items.last().value(Enums::DepartureDateTime).toDateTime();
     dataSource->setNextDownloadTimeProposal( dateTime.addSecs(dateTime.secsTo(last) / 3) );
     const QDateTime nextUpdateTime = provider->nextUpdateTime( dataSource->updateFlags(),
             dataSource->lastUpdate(), dataSource->nextDownloadTimeProposal(), dataSource->data() );
@@ -1840,7 +1876,7 @@ void PublicTransportEngine::journeysReceived( ServiceProvider* provider,
     DEBUG_ENGINE_JOBS( journeys.count() << "journeys received" << sourceName );
 
     const QString nonAmbiguousName = disambiguateSourceName( sourceName );
-    m_runningSources.removeOne( nonAmbiguousName );
+    const bool isFirstChunk = m_runningSources.removeOne( nonAmbiguousName );
     if ( !m_dataSources.contains(nonAmbiguousName) ) {
         kWarning() << "Data source already removed" << nonAmbiguousName;
         return;
@@ -1851,33 +1887,29 @@ void PublicTransportEngine::journeysReceived( ServiceProvider* provider,
         kWarning() << "Data source already deleted" << nonAmbiguousName;
         return;
     }
-    dataSource->clear();
+    // Append journeys of later chunks of the request, see timetableDataReceived()
     QVariantList journeysData;
-    foreach( const JourneyInfoPtr &journeyInfo, journeys ) {
-        if ( !journeyInfo->isValid() ) {
+    if ( !isFirstChunk ) {
+        journeysData = dataSource->takeTimetableItems();
+    }
+    dataSource->clear();
+    foreach ( const JourneyInfo &journeyInfo, journeys ) {
+        if ( !journeyInfo.isValid() ) {
             continue;
         }
 
-        QVariantHash journeyData;
-        TimetableData journey = journeyInfo->data();
-        for ( TimetableData::ConstIterator it = journey.constBegin();
-              it != journey.constEnd(); ++it )
-        {
-            if ( it.value().isValid() ) {
-                journeyData.insert( Global::timetableInformationToString(it.key()), it.value() );
-            }
-        }
-
-        journeysData << journeyData;
+        journeysData << journeyInfo.toVariantHash();
     }
 
     dataSource->setValue( "journeys", journeysData );
 
-    int journeyCount = journeys.count();
+    // Use all journeys of the data source, not only the ones of the received chunk
+    const QString dateTimeKey = Global::timetableInformationToString( Enums::DepartureDateTime );
+    int journeyCount = journeysData.count();
     QDateTime first, last;
     if ( journeyCount > 0 ) {
-        first = journeys.first()->value(Enums::DepartureDateTime).toDateTime();
-        last = journeys.last()->value(Enums::DepartureDateTime).toDateTime();
+        first = journeysData.first().toHash()[ dateTimeKey ].toDateTime();
+        last = journeysData.last().toHash()[ dateTimeKey ].toDateTime();
     } else {
         first = last = QDateTime::currentDateTime();
     }
@@ -1911,21 +1943,16 @@ void PublicTransportEngine::stopsReceived( ServiceProvider *provider,
     Q_UNUSED( deleteStopInfos );
 
     const QString sourceName = request.sourceName();
-    m_runningSources.removeOne( disambiguateSourceName(sourceName) );
+    const bool isFirstChunk = m_runningSources.removeOne( disambiguateSourceName(sourceName) );
     DEBUG_ENGINE_JOBS( stops.count() << "stop suggestions received" << sourceName );
 
+    // Append stops of later chunks of the request, see timetableDataReceived()
     QVariantList stopsData;
-    foreach( const StopInfoPtr &stopInfo, stops ) {
-        QVariantHash stopData;
-        TimetableData stop = stopInfo->data();
-        for ( TimetableData::ConstIterator it = stop.constBegin();
-              it != stop.constEnd(); ++it )
-        {
-            if ( it.value().isValid() ) {
-                stopData.insert( Global::timetableInformationToString(it.key()), it.value() );
-            }
-        }
-        stopsData << stopData;
+    if ( !isFirstChunk ) {
+        stopsData = query( sourceName )[ "stops" ].toList();
+    }
+    foreach( const StopInfo &stopInfo, stops ) {
+        stopsData << stopInfo.toVariantHash();
     }
     setData( sourceName, "stops", stopsData );
     setData( sourceName, "serviceProvider", provider->id() );
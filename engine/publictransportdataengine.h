@@ -95,6 +95,8 @@ public:
                 * (libpublictransporthelper) enumerations. The information stored in this
                 * data source can also be retrieved from PublicTransport::VehicleType
                 * using libpublictransporthelper. See also @ref usage_vehicletypes_sec.  */
+        DiagnosticsSource = 6, /**< The source contains diagnostic information about the engine,
+                * eg. hit rates of internal caches. See also @ref usage_diagnostics_sec. */
 
         // Data sources providing timetable data
         DeparturesSource = 10, /**< The source contains timetable data for departures.
@@ -524,6 +526,16 @@ protected:
     /** @brief Fill the VehicleTypes data source. */
     void initVehicleTypesSource();
 
+    /**
+     * @brief Updates the "Diagnostics" data source.
+     *
+     * The data source contains statistics about internal caches of the engine.
+     * It gets updated each time it gets requested or updated.
+     *
+     * @return @c True, if the data source could be updated successfully. @c False, otherwise.
+     **/
+    bool updateDiagnosticsSource();
+
     /**
      * @brief Wheather or not the data source with the given @p name is up to date.
      *
@@ -688,10 +700,11 @@ private:
     static uint hashForDeparture( const QDateTime &departure, Enums::VehicleType vehicleType,
                                   const QString &lineString, const QString &target )
     {
-        return qHash( QString("%1%2%3%4").arg(departure.toString("dMMyyhhmmss"))
-                      .arg(static_cast<int>(vehicleType))
-                      .arg(lineString)
-                      .arg(target.trimmed().toLower()) );
+        // Combine the hashes of the values instead of hashing a formatted string
+        uint hash = departure.toTime_t();
+        hash = 31 * hash + static_cast<uint>( vehicleType );
+        hash = 31 * hash + qHash( lineString );
+        return 31 * hash + qHash( target.trimmed().toLower() );
     };
 
     /**
@@ -0,0 +1,279 @@
+/*
+ *   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// Header
+#include "networkreplay.h"
+
+// KDE includes
+#include <KDebug>
+#include <KGlobal>
+
+// Qt includes
+#include <QCryptographicHash>
+#include <QTimer>
+#include <QMutex>
+#include <QFile>
+#include <QDir>
+
+// Serializes writing fixtures and index files of all recorders
+K_GLOBAL_STATIC( QMutex, globalRecorderMutex )
+
+// Get the HTTP method used for the fixture key of a request with the given operation
+static QByteArray methodForOperation( QNetworkAccessManager::Operation operation,
+                                      const QByteArray &customVerb = QByteArray() )
+{
+    switch ( operation ) {
+    case QNetworkAccessManager::HeadOperation:
+        return "HEAD";
+    case QNetworkAccessManager::GetOperation:
+        return "GET";
+    case QNetworkAccessManager::PostOperation:
+        return "POST";
+    case QNetworkAccessManager::PutOperation:
+        return "PUT";
+    case QNetworkAccessManager::DeleteOperation:
+        return "DELETE";
+    default:
+        return customVerb;
+    }
+}
+
+// Get the file name of the status code and headers recorded for the fixture at @p fixturePath
+static QString headersFilePath( const QString &fixturePath )
+{
+    return fixturePath + ".headers";
+}
+
+FixtureReply::FixtureReply( QNetworkAccessManager::Operation operation,
+                            const QNetworkRequest &request, const QByteArray &data, bool found,
+                            int statusCode, const QList< QPair<QByteArray, QByteArray> > &headers,
+                            int latency, QObject *parent )
+        : QNetworkReply(parent), m_data(data), m_offset(0)
+{
+    setOperation( operation );
+    setRequest( request );
+    setUrl( request.url() );
+    open( QIODevice::ReadOnly | QIODevice::Unbuffered );
+
+    if ( found ) {
+        for ( int i = 0; i < headers.count(); ++i ) {
+            setRawHeader( headers[i].first, headers[i].second );
+        }
+        setAttribute( QNetworkRequest::HttpStatusCodeAttribute, statusCode );
+        setHeader( QNetworkRequest::ContentLengthHeader, m_data.size() );
+    } else {
+        setAttribute( QNetworkRequest::HttpStatusCodeAttribute, 404 );
+        setError( QNetworkReply::ContentNotFoundError,
+                  QString("No fixture for %1").arg(request.url().toString()) );
+    }
+
+    QTimer::singleShot( latency, this, SLOT(emitFinished()) );
+}
+
+void FixtureReply::emitFinished()
+{
+    if ( isFinished() ) {
+        // Already aborted
+        return;
+    }
+
+    if ( error() != QNetworkReply::NoError ) {
+        emit error( error() );
+    } else if ( !m_data.isEmpty() ) {
+        emit readyRead();
+    }
+    setFinished( true );
+    emit finished();
+}
+
+void FixtureReply::abort()
+{
+    if ( isFinished() ) {
+        return;
+    }
+
+    m_data.clear();
+    m_offset = 0;
+    setError( QNetworkReply::OperationCanceledError, "Aborted" );
+    setFinished( true );
+    emit error( QNetworkReply::OperationCanceledError );
+    emit finished();
+}
+
+qint64 FixtureReply::bytesAvailable() const
+{
+    return m_data.size() - m_offset + QNetworkReply::bytesAvailable();
+}
+
+qint64 FixtureReply::readData( char *data, qint64 maxSize )
+{
+    if ( m_offset >= m_data.size() ) {
+        return -1;
+    }
+
+    const qint64 count = qMin( maxSize, m_data.size() - m_offset );
+    memcpy( data, m_data.constData() + m_offset, count );
+    m_offset += count;
+    return count;
+}
+
+ReplayNetworkAccessManager::ReplayNetworkAccessManager( const QString &fixtureDir, int latency,
+                                                        QObject *parent )
+        : QNetworkAccessManager(parent), m_fixtureDir(fixtureDir), m_latency(latency)
+{
+}
+
+QString ReplayNetworkAccessManager::fixtureKey( const QByteArray &method, const QUrl &url,
+                                                const QByteArray &postData )
+{
+    return QCryptographicHash::hash( method + ' ' + url.toEncoded() + '\n' + postData,
+                                     QCryptographicHash::Sha1 ).toHex();
+}
+
+QNetworkReply *ReplayNetworkAccessManager::createRequest( Operation operation,
+        const QNetworkRequest &request, QIODevice *outgoingData )
+{
+    const QByteArray method = methodForOperation( operation,
+            request.attribute(QNetworkRequest::CustomVerbAttribute).toByteArray() );
+    const QByteArray postData = outgoingData ? outgoingData->readAll() : QByteArray();
+    QFile file( QDir(m_fixtureDir).filePath(fixtureKey(method, request.url(), postData)) );
+    const bool found = file.open( QIODevice::ReadOnly );
+    QByteArray data;
+    int statusCode = 200;
+    QList< QPair<QByteArray, QByteArray> > headers;
+    if ( found ) {
+        if ( operation != HeadOperation ) {
+            data = file.readAll();
+        }
+
+        // Read the status code from the first line, followed by "Name: value" header lines.
+        // Fixtures recorded without headers get replayed with status code 200
+        QFile headersFile( headersFilePath(file.fileName()) );
+        if ( headersFile.open(QIODevice::ReadOnly) ) {
+            statusCode = headersFile.readLine().trimmed().toInt();
+            while ( !headersFile.atEnd() ) {
+                const QByteArray line = headersFile.readLine().trimmed();
+                const int pos = line.indexOf( ':' );
+                if ( pos > 0 ) {
+                    headers << qMakePair( line.left(pos).trimmed(), line.mid(pos + 1).trimmed() );
+                }
+            }
+        }
+    } else {
+        kWarning() << "No fixture found for" << method << request.url();
+    }
+
+    return new FixtureReply( operation, request, data, found, statusCode, headers,
+                             m_latency, this );
+}
+
+NetworkRecorder::NetworkRecorder( const QString &fixtureDir, Network *network )
+        : QObject(network), m_fixtureDir(fixtureDir)
+{
+    connect( network,
+             SIGNAL(requestFinished(NetworkRequest::Ptr,QByteArray,bool,QString,QDateTime,int,int)),
+             this,
+             SLOT(requestFinished(NetworkRequest::Ptr,QByteArray,bool,QString,QDateTime,int,int)) );
+    connect( network, SIGNAL(synchronousRequestFinished(QString,QByteArray,bool,int,int,int)),
+             this, SLOT(synchronousRequestFinished(QString,QByteArray,bool,int,int,int)) );
+}
+
+void NetworkRecorder::requestFinished( const NetworkRequest::Ptr &request, const QByteArray &data,
+                                       bool error, const QString &errorString,
+                                       const QDateTime &timestamp, int statusCode, int size )
+{
+    Q_UNUSED( errorString );
+    Q_UNUSED( timestamp );
+    Q_UNUSED( size );
+    if ( !error ) {
+        record( methodForOperation(request->operation()), QUrl(request->url()),
+                request->postDataByteArray(), data, statusCode, request->replyHeaders(),
+                request->replyCharset() );
+    }
+}
+
+void NetworkRecorder::synchronousRequestFinished( const QString &url, const QByteArray &data,
+                                                  bool cancelled, int statusCode, int waitTime,
+                                                  int size )
+{
+    Q_UNUSED( waitTime );
+    Q_UNUSED( size );
+    if ( !cancelled ) {
+        // Synchronous requests are always GET requests, the reply data does not get decoded
+        const Network *network = qobject_cast< Network* >( parent() );
+        record( "GET", QUrl(url), QByteArray(), data, statusCode,
+                network ? network->lastSynchronousReplyHeaders()
+                        : QList< QPair<QByteArray, QByteArray> >() );
+    }
+}
+
+void NetworkRecorder::record( const QByteArray &method, const QUrl &url,
+                              const QByteArray &postData, const QByteArray &data, int statusCode,
+                              const QList< QPair<QByteArray, QByteArray> > &headers,
+                              const QByteArray &charset )
+{
+    QByteArray headerData = QByteArray::number( statusCode ) + '\n';
+    for ( int i = 0; i < headers.count(); ++i ) {
+        // Drop headers that do not match the stored data, which is already decompressed
+        const QByteArray name = headers[i].first.toLower();
+        if ( name == "content-encoding" || name == "content-length" ||
+             name == "transfer-encoding" )
+        {
+            continue;
+        }
+
+        QByteArray value = headers[i].second;
+        if ( name == "content-type" && !charset.isEmpty() &&
+             !value.toLower().contains("charset=") )
+        {
+            // Store the charset that was used to decode the reply
+            value += "; charset=" + charset;
+        }
+        headerData += headers[i].first + ": " + value + '\n';
+    }
+
+    const QString key = ReplayNetworkAccessManager::fixtureKey( method, url, postData );
+    const QString fixturePath = QDir( m_fixtureDir ).filePath( key );
+    QMutexLocker locker( globalRecorderMutex );
+    const bool indexed = QFile::exists( fixturePath );
+    QFile file( fixturePath );
+    if ( !file.open(QIODevice::WriteOnly) ) {
+        kWarning() << "Cannot write fixture" << file.fileName() << file.errorString();
+        return;
+    }
+    file.write( data );
+    file.close();
+
+    QFile headersFile( headersFilePath(fixturePath) );
+    if ( !headersFile.open(QIODevice::WriteOnly) ) {
+        kWarning() << "Cannot write fixture headers" << headersFile.fileName()
+                   << headersFile.errorString();
+    } else {
+        headersFile.write( headerData );
+    }
+
+    // Write an index to be able to find fixtures for URLs,
+    // fixtures that already existed are already listed
+    if ( !indexed ) {
+        QFile index( QDir(m_fixtureDir).filePath("index.txt") );
+        if ( index.open(QIODevice::WriteOnly | QIODevice::Append) ) {
+            index.write( key.toLatin1() + ' ' + method + ' ' + url.toEncoded() + '\n' );
+        }
+    }
+}
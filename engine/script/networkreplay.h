@@ -0,0 +1,140 @@
+/*
+ *   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/** @file
+ * @brief Record and replay network replies of scripts, for tests and benchmarks.
+ *
+ * This file is not compiled into the data engine, it gets used by the provider benchmark and
+ * by TimetableMate's batch test mode.
+ **/
+
+#ifndef NETWORKREPLAY_HEADER
+#define NETWORKREPLAY_HEADER
+
+// Own includes
+#include "scriptapi.h"
+
+// Qt includes
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+
+using namespace ScriptApi;
+
+/**
+ * @brief A reply with data read from a fixture file, created by ReplayNetworkAccessManager.
+ *
+ * If no fixture was found for the request, the reply finishes with
+ * QNetworkReply::ContentNotFoundError and HTTP status code 404. Otherwise the recorded
+ * @p statusCode and @p headers get used.
+ **/
+class FixtureReply : public QNetworkReply {
+    Q_OBJECT
+
+public:
+    FixtureReply( QNetworkAccessManager::Operation operation, const QNetworkRequest &request,
+                  const QByteArray &data, bool found, int statusCode,
+                  const QList< QPair<QByteArray, QByteArray> > &headers, int latency,
+                  QObject *parent = 0 );
+
+    virtual void abort();
+    virtual qint64 bytesAvailable() const;
+    virtual bool isSequential() const { return true; };
+
+protected:
+    virtual qint64 readData( char *data, qint64 maxSize );
+
+private slots:
+    void emitFinished();
+
+private:
+    QByteArray m_data;
+    qint64 m_offset;
+};
+
+/**
+ * @brief Answers all requests with replies read from a local fixture directory.
+ *
+ * The fixture file for a request is named by fixtureKey(), ie. the SHA1 hash of the HTTP
+ * method, the URL and the POST data. HEAD and GET requests use different fixtures.
+ * If a file with the same name and a ".headers" suffix exists, the recorded status code and
+ * reply headers get replayed, too. Fixture files can be created with NetworkRecorder.
+ * Use Network::setNetworkAccessManager() to replay fixtures in scripts.
+ **/
+class ReplayNetworkAccessManager : public QNetworkAccessManager {
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Create a new manager replaying fixtures from @p fixtureDir.
+     *
+     * @param latency Simulated network latency in milliseconds for each reply.
+     **/
+    ReplayNetworkAccessManager( const QString &fixtureDir, int latency = 0,
+                                QObject *parent = 0 );
+
+    /** @brief Get the fixture file name for a request with the given values. */
+    static QString fixtureKey( const QByteArray &method, const QUrl &url,
+                               const QByteArray &postData = QByteArray() );
+
+protected:
+    virtual QNetworkReply *createRequest( Operation operation, const QNetworkRequest &request,
+                                          QIODevice *outgoingData = 0 );
+
+private:
+    const QString m_fixtureDir;
+    const int m_latency;
+};
+
+/**
+ * @brief Writes data received by a Network object into a fixture directory.
+ *
+ * The recorder is a child of the Network object, it writes fixtures for all finished
+ * synchronous and asynchronous requests. The status code and the reply headers get written
+ * into a ".headers" file next to each fixture. The received data gets stored decompressed,
+ * therefore the Content-Encoding and Content-Length headers are not recorded. The charset
+ * used to decode the reply gets added to the Content-Type header, if it was not set there.
+ *
+ * An index.txt file in the fixture directory lists the recorded URLs, each fixture once.
+ * Writing fixtures and the index is serialized, recorders of multiple Network objects in
+ * different threads can write into the same directory.
+ **/
+class NetworkRecorder : public QObject {
+    Q_OBJECT
+
+public:
+    /** @brief Record replies received by @p network into @p fixtureDir. */
+    NetworkRecorder( const QString &fixtureDir, Network *network );
+
+protected slots:
+    void requestFinished( const NetworkRequest::Ptr &request, const QByteArray &data,
+                          bool error, const QString &errorString, const QDateTime &timestamp,
+                          int statusCode, int size );
+    void synchronousRequestFinished( const QString &url, const QByteArray &data,
+                                     bool cancelled, int statusCode, int waitTime, int size );
+
+private:
+    void record( const QByteArray &method, const QUrl &url, const QByteArray &postData,
+                 const QByteArray &data, int statusCode,
+                 const QList< QPair<QByteArray, QByteArray> > &headers,
+                 const QByteArray &charset = QByteArray() );
+
+    const QString m_fixtureDir;
+};
+
+#endif // Multiple inclusion guard
@@ -212,7 +212,9 @@ void ScriptJob::run()
 
     // If data for the current job has already been published, do not emit
     // xxxReady() with an empty resultset
-    if ( m_published == 0 || m_objects.result->count() > m_published ) {
+    if ( m_published == 0 || m_objects.result->hasUnpublishedData() ) {
+        // Get the not yet published data, without copying the items
+        const QList< TimetableData > data = m_objects.result->takeUnpublishedData();
         const bool couldNeedForcedUpdate = m_published > 0;
         const MoreItemsRequest *moreItemsRequest =
                 dynamic_cast< const MoreItemsRequest* >( request() );
@@ -220,14 +222,14 @@ void ScriptJob::run()
                 moreItemsRequest ? moreItemsRequest->request().data() : request();
         switch ( _request->parseMode() ) {
         case ParseForDepartures:
-            emit departuresReady( m_objects.result->data().mid(m_published),
+            emit departuresReady( data,
                     m_objects.result->features(), m_objects.result->hints(),
                     m_objects.network->lastUserUrl(), globalInfo,
                     *dynamic_cast<const DepartureRequest*>(_request),
                     couldNeedForcedUpdate );
             break;
         case ParseForArrivals: {
-            emit arrivalsReady( m_objects.result->data().mid(m_published),
+            emit arrivalsReady( data,
                     m_objects.result->features(), m_objects.result->hints(),
                     m_objects.network->lastUserUrl(), globalInfo,
                     *dynamic_cast< const ArrivalRequest* >(_request),
@@ -236,14 +238,14 @@ void ScriptJob::run()
         }
         case ParseForJourneysByDepartureTime:
         case ParseForJourneysByArrivalTime:
-            emit journeysReady( m_objects.result->data().mid(m_published),
+            emit journeysReady( data,
                     m_objects.result->features(), m_objects.result->hints(),
                     m_objects.network->lastUserUrl(), globalInfo,
                     *dynamic_cast<const JourneyRequest*>(_request),
                     couldNeedForcedUpdate );
             break;
         case ParseForStopSuggestions:
-            emit stopSuggestionsReady( m_objects.result->data().mid(m_published),
+            emit stopSuggestionsReady( data,
                     m_objects.result->features(), m_objects.result->hints(),
                     m_objects.network->lastUserUrl(), globalInfo,
                     *dynamic_cast<const StopSuggestionRequest*>(_request),
@@ -251,7 +253,6 @@ void ScriptJob::run()
             break;
 
         case ParseForAdditionalData: {
-            const QList< TimetableData > data = m_objects.result->data();
             if ( data.isEmpty() ) {
                 handleError( i18nc("@info/plain", "Did not find any additional data.") );
                 return;
@@ -269,6 +270,7 @@ void ScriptJob::run()
             kDebug() << "Parse mode unsupported:" << _request->parseMode();
             break;
         }
+        m_published += data.count();
     }
 
     // Check for exceptions
@@ -540,6 +542,7 @@ bool ScriptJob::loadScript( QScriptProgram *script )
     // It lives in the GUI thread and gets used in all thread jobs to not erase non-persistently
     // stored data after each request.
     m_objects.createObjects( m_data );
+    scriptObjectsCreated();
     m_objects.attachToEngine( m_engine, m_data );
 
     // Connect the publish() signal directly (the result object lives in the thread that gets
@@ -562,6 +565,7 @@ bool ScriptJob::loadScript( QScriptProgram *script )
         m_success = false;
         return false;
     } else {
+        scriptLoaded();
         return true;
     }
 }
@@ -569,7 +573,7 @@ bool ScriptJob::loadScript( QScriptProgram *script )
 bool ScriptJob::hasDataToBePublished() const
 {
     QMutexLocker locker( m_mutex );
-    return !m_objects.isValid() ? false : m_objects.result->count() > m_published;
+    return !m_objects.isValid() ? false : m_objects.result->hasUnpublishedData();
 }
 
 void ScriptJob::publish()
@@ -577,66 +581,64 @@ void ScriptJob::publish()
     // This slot gets run in the thread of this job
     // Only publish, if there is data which is not already published
     QMutexLocker locker( m_mutex );
-    if ( hasDataToBePublished() ) {
-        GlobalTimetableInfo globalInfo;
-        QList< TimetableData > data = m_objects.result->data().mid( m_published );
-        const bool couldNeedForcedUpdate = m_published > 0;
-        const MoreItemsRequest *moreItemsRequest =
-                dynamic_cast< const MoreItemsRequest* >( request() );
-        const AbstractRequest *childRequest =
-                moreItemsRequest ? moreItemsRequest->request().data() : request();
-        switch ( request()->parseMode() ) {
-        case ParseForDepartures:
-            emit departuresReady( m_objects.result->data().mid(m_published),
-                    m_objects.result->features(), m_objects.result->hints(),
-                    m_objects.network->lastUserUrl(), globalInfo,
-                    *dynamic_cast<const DepartureRequest*>(childRequest), couldNeedForcedUpdate );
-            break;
-        case ParseForArrivals:
-            emit arrivalsReady( m_objects.result->data().mid(m_published),
-                    m_objects.result->features(), m_objects.result->hints(),
-                    m_objects.network->lastUserUrl(), globalInfo,
-                    *dynamic_cast<const ArrivalRequest*>(childRequest), couldNeedForcedUpdate );
-            break;
-        case ParseForJourneysByDepartureTime:
-        case ParseForJourneysByArrivalTime: {
-            emit journeysReady( m_objects.result->data().mid(m_published),
-                    m_objects.result->features(), m_objects.result->hints(),
-                    m_objects.network->lastUserUrl(), globalInfo,
-                    *dynamic_cast<const JourneyRequest*>(childRequest), couldNeedForcedUpdate );
-        } break;
-        case ParseForStopSuggestions:
-            emit stopSuggestionsReady( m_objects.result->data().mid(m_published),
-                    m_objects.result->features(), m_objects.result->hints(),
-                    m_objects.network->lastUserUrl(), globalInfo,
-                    *dynamic_cast<const StopSuggestionRequest*>(childRequest),
-                    couldNeedForcedUpdate );
-            break;
-        case ParseForAdditionalData: {
-            // Additional data gets requested per timetable item, only one result expected
-            if ( m_objects.result->data().isEmpty() ) {
-                kWarning() << "Got no additional data";
-                return;
-            }
-            const TimetableData additionalData = m_objects.result->data().first();
-            if ( additionalData.isEmpty() ) {
-                kWarning() << "Did not find any additional data.";
-                return;
-            }
-            emit additionalDataReady( data.first(), m_objects.result->features(),
-                    m_objects.result->hints(), m_objects.network->lastUserUrl(), globalInfo,
-                    *dynamic_cast<const AdditionalDataRequest*>(childRequest),
-                    couldNeedForcedUpdate );
-            break;
-        }
+    if ( !hasDataToBePublished() ) {
+        return;
+    }
 
-        default:
-            kDebug() << "Parse mode unsupported:" << request()->parseMode();
-            break;
+    if ( request()->parseMode() == ParseForAdditionalData ) {
+        // Additional data gets requested per timetable item, only one result expected
+        const QList< TimetableData > data = m_objects.result->data();
+        if ( data.isEmpty() || data.first().isEmpty() ) {
+            kWarning() << "Did not find any additional data.";
+            return;
         }
+    }
 
-        m_published += data.count();
+    // Get the new data from the result object, the items stay available to the script.
+    // The data list gets handed over to the provider without copying the items
+    GlobalTimetableInfo globalInfo;
+    const QList< TimetableData > data = m_objects.result->takeUnpublishedData();
+    const bool couldNeedForcedUpdate = m_published > 0;
+    const MoreItemsRequest *moreItemsRequest =
+            dynamic_cast< const MoreItemsRequest* >( request() );
+    const AbstractRequest *childRequest =
+            moreItemsRequest ? moreItemsRequest->request().data() : request();
+    switch ( request()->parseMode() ) {
+    case ParseForDepartures:
+        emit departuresReady( data, m_objects.result->features(), m_objects.result->hints(),
+                m_objects.network->lastUserUrl(), globalInfo,
+                *dynamic_cast<const DepartureRequest*>(childRequest), couldNeedForcedUpdate );
+        break;
+    case ParseForArrivals:
+        emit arrivalsReady( data, m_objects.result->features(), m_objects.result->hints(),
+                m_objects.network->lastUserUrl(), globalInfo,
+                *dynamic_cast<const ArrivalRequest*>(childRequest), couldNeedForcedUpdate );
+        break;
+    case ParseForJourneysByDepartureTime:
+    case ParseForJourneysByArrivalTime:
+        emit journeysReady( data, m_objects.result->features(), m_objects.result->hints(),
+                m_objects.network->lastUserUrl(), globalInfo,
+                *dynamic_cast<const JourneyRequest*>(childRequest), couldNeedForcedUpdate );
+        break;
+    case ParseForStopSuggestions:
+        emit stopSuggestionsReady( data, m_objects.result->features(), m_objects.result->hints(),
+                m_objects.network->lastUserUrl(), globalInfo,
+                *dynamic_cast<const StopSuggestionRequest*>(childRequest),
+                couldNeedForcedUpdate );
+        break;
+    case ParseForAdditionalData:
+        emit additionalDataReady( data.first(), m_objects.result->features(),
+                m_objects.result->hints(), m_objects.network->lastUserUrl(), globalInfo,
+                *dynamic_cast<const AdditionalDataRequest*>(childRequest),
+                couldNeedForcedUpdate );
+        break;
+
+    default:
+        kDebug() << "Parse mode unsupported:" << request()->parseMode();
+        break;
     }
+
+    m_published += data.count();
 }
 
 class DepartureJobPrivate {
@@ -197,6 +197,18 @@ protected:
     /** @brief Load @p script into the engine and insert some objects/functions. */
     bool loadScript( QScriptProgram *script );
 
+    /**
+     * @brief Called by loadScript() after the script objects were created.
+     *
+     * The objects are not yet attached to the engine and the script is not yet evaluated.
+     * The default implementation does nothing. Can be used to eg. replace the
+     * QNetworkAccessManager of the Network object.
+     **/
+    virtual void scriptObjectsCreated() {};
+
+    /** @brief Called by loadScript() after the script was evaluated without errors. */
+    virtual void scriptLoaded() {};
+
     bool waitFor( QObject *sender, const char *signal, WaitForType type );
 
     bool hasDataToBePublished() const;
@@ -31,6 +31,7 @@
 #include <KConfigGroup>
 #include <KDebug>
 #include <KLocalizedString>
+#include <KGlobal>
 
 // Qt includes
 #include <QFile>
@@ -41,6 +42,7 @@
 #include <QEventLoop>
 #include <QTimer>
 #include <QTextCodec>
+#include <QTextDecoder>
 #include <QWaitCondition>
 #include <QReadLocker>
 #include <QWriteLocker>
@@ -53,9 +55,21 @@
 
 namespace ScriptApi {
 
+/** @brief Size of the output buffer used to decompress received data. */
+const int INFLATE_BUFFER_SIZE = 64 * 1024;
+
+/**
+ * @brief Number of bytes to receive before detecting the charset from the document.
+ * QTextCodec::codecForHtml() only searches the first 512 bytes for a charset.
+ **/
+const int CHARSET_DETECTION_SIZE = 512;
+
 NetworkRequest::NetworkRequest( QObject *parent )
         : QObject(parent), m_mutex(new QMutex(QMutex::Recursive)), m_network(0),
-          m_isFinished(false), m_request(0), m_reply(0)
+          m_isFinished(false), m_request(0), m_reply(0),
+          m_operation(QNetworkAccessManager::GetOperation), m_uncompressedSize(0),
+          m_compressionDetected(false), m_inflateStream(0), m_inflateFinished(false),
+          m_textDecoder(0), m_textOnly(false)
 {
 }
 
@@ -63,14 +77,19 @@ NetworkRequest::NetworkRequest( const QString &url, const QString &userUrl,
                                 Network *network, QObject* parent )
         : QObject(parent), m_mutex(new QMutex(QMutex::Recursive)), m_url(url),
           m_userUrl(userUrl.isEmpty() ? url : userUrl), m_network(network),
-          m_isFinished(false), m_request(new QNetworkRequest(url)), m_reply(0)
+          m_isFinished(false), m_request(new QNetworkRequest(url)), m_reply(0),
+          m_operation(QNetworkAccessManager::GetOperation), m_uncompressedSize(0),
+          m_compressionDetected(false), m_inflateStream(0), m_inflateFinished(false),
+          m_textDecoder(0), m_textOnly(false)
 {
 }
 
 NetworkRequest::~NetworkRequest()
 {
     abort();
+    endInflate();
 
+    delete m_textDecoder;
     delete m_request;
     delete m_mutex;
 }
@@ -95,6 +114,7 @@ void NetworkRequest::abort()
 
     emit aborted( timedOut );
     emit finished( QByteArray(), true, i18nc("@info/plain", "The request was aborted") );
+    emit textFinished( QString(), true, i18nc("@info/plain", "The request was aborted") );
 }
 
 void NetworkRequest::slotReadyRead()
@@ -107,71 +127,206 @@ void NetworkRequest::slotReadyRead()
         return;
     }
 
-    // Read all data, decode it and give it to the script
-    QByteArray data = m_reply->readAll();
-    m_data.append( data );
-
-    if ( data.isEmpty() ) {
-        kWarning() << "Error downloading" << m_url << m_reply->errorString();
-    }
+    // Read available data, decompress it if needed and give it to the script
+    const QByteArray data = processReceivedData( m_reply->readAll() );
+    const bool emitReadyRead = !data.isEmpty() && receivers(SIGNAL(readyRead(QByteArray))) > 0;
     m_mutex->unlockInline();
 
-    emit readyRead( data );
+    if ( emitReadyRead ) {
+        emit readyRead( data );
+    }
 }
 
-QByteArray gzipDecompress( QByteArray compressData )
+QByteArray NetworkRequest::processReceivedData( const QByteArray &receivedData, bool finished )
 {
-    // Strip header and trailer
-    compressData.remove( 0, 10 );
-    compressData.chop( 12 );
+    QByteArray data = receivedData;
+    if ( !m_compressionDetected ) {
+        // Wait for the first two bytes to check if the data is compressed
+        // and was not decompressed by QNetworkAccessManager
+        m_receivedHead.append( data );
+        if ( m_receivedHead.length() < 2 && !finished ) {
+            return QByteArray();
+        }
+        data = m_receivedHead;
+        m_receivedHead.clear();
+        m_compressionDetected = true;
+
+        const bool isGzip = data.length() >= 2 &&
+                quint8(data[0]) == 0x1f && quint8(data[1]) == 0x8b;
+        const bool isDeflate = !isGzip && data.length() >= 2 && m_reply &&
+                m_reply->rawHeader("Content-Encoding").toLower().contains("deflate") &&
+                (quint8(data[0]) & 0x0f) == Z_DEFLATED &&
+                ((quint8(data[0]) << 8) | quint8(data[1])) % 31 == 0;
+        if ( isGzip || isDeflate ) {
+            // Data is compressed, 16 is added to the window bits to read a gzip header,
+            // otherwise a zlib header gets read
+            m_inflateStream = new z_stream;
+            m_inflateStream->next_in = Z_NULL;
+            m_inflateStream->avail_in = 0;
+            m_inflateStream->zalloc = Z_NULL;
+            m_inflateStream->zfree = Z_NULL;
+            m_inflateStream->opaque = Z_NULL;
+            if ( inflateInit2(m_inflateStream, isGzip ? MAX_WBITS + 16 : MAX_WBITS) != Z_OK ) {
+                kWarning() << "Cannot initialize decompression" << m_inflateStream->msg;
+                m_receiveError = i18nc("@info/plain", "Cannot decompress the received data");
+                m_inflateFinished = true;
+                delete m_inflateStream;
+                m_inflateStream = 0;
+            } else if ( m_inflateBuffer.isEmpty() ) {
+                m_inflateBuffer.resize( INFLATE_BUFFER_SIZE );
+            }
+        }
+    }
 
-    // FIXME Decompress in one chunk, because otherwise it fails with error -3 "distance too far back",
-    // estimate size of uncompressed data, expect that the data was compressed at best to 20% size,
-    // limit to 512KB
-    const int chunkSize = qMin( int(compressData.size() / 0.2), 512 * 1024 );
-    kDebug() << "Chunk size:" << chunkSize;
-    if ( chunkSize == 512 * 1024 ) {
-        kWarning() << "Maximum chunk size for decompression reached, may fail";
+    if ( m_inflateStream ) {
+        data = inflateData( data );
+    } else if ( m_inflateFinished ) {
+        // The compressed stream has ended or is broken, do not append the compressed data
+        if ( !data.isEmpty() ) {
+            kDebug() << "Ignoring" << data.size() << "bytes after the compressed data";
+        }
+        data.clear();
+    }
+    if ( !m_textOnly ) {
+        m_data.append( data );
+    }
+    m_uncompressedSize += data.size();
+
+    if ( finished && m_inflateStream ) {
+        // The reply ended before the end of the compressed stream
+        kWarning() << "Compressed data is incomplete" << m_url;
+        m_receiveError = i18nc("@info/plain", "The compressed data is incomplete");
+        endInflate();
+    }
+
+    // Decode text while downloading if needed
+    if ( m_textDecoder ) {
+        m_text.append( m_textDecoder->toUnicode(data) );
+    } else if ( m_replyCharset.isEmpty() && !m_data.isEmpty() ) {
+        // Wait for enough data to detect the charset from the document,
+        // if it is not given by the script or the ContentType header
+        QTextCodec *codec = explicitCodec();
+        if ( codec || finished || m_data.size() >= CHARSET_DETECTION_SIZE ) {
+            if ( !codec ) {
+                codec = codecForReply( m_data );
+            }
+            m_replyCharset = codec->name();
+            if ( receivers(SIGNAL(textFinished(QString,bool,QString,int,int))) > 0 ) {
+                // Decode all data received until now
+                m_textDecoder = codec->makeDecoder();
+                m_text = m_textDecoder->toUnicode( m_data );
+                if ( !isDataNeeded() ) {
+                    // Only the text is needed, release the data and only decode new data
+                    m_textOnly = true;
+                    m_data.clear();
+                }
+            }
+        }
     }
 
-    unsigned char buffer[ chunkSize ];
-    z_stream stream;
-    stream.next_in = (Bytef*)(compressData.data());
-    stream.avail_in = compressData.size();
-    stream.total_in = 0;
-    stream.total_out = 0;
-    stream.zalloc = Z_NULL;
-    stream.zfree = Z_NULL;
-    stream.opaque = Z_NULL;
+    if ( finished && m_textDecoder ) {
+        // Flush the decoder
+        m_text.append( m_textDecoder->toUnicode(QByteArray()) );
+        delete m_textDecoder;
+        m_textDecoder = 0;
+    }
+    return data;
+}
 
-    if ( inflateInit2(&stream, -8) != Z_OK ) {
-        kDebug() << "cmpr_stream error!";
-        return QByteArray();
+bool NetworkRequest::isDataNeeded() const
+{
+    // Network::createRequest() connects finished() to pass the data on with requestFinished()
+    const char *finishedSignal = SIGNAL(finished(QByteArray,bool,QString,int,int));
+    if ( !m_network ) {
+        return receivers( finishedSignal ) > 0;
     }
+    const char *requestFinishedSignal =
+            SIGNAL(requestFinished(NetworkRequest::Ptr,QByteArray,bool,QString,QDateTime,int,int));
+    return receivers( finishedSignal ) > 1 || m_network->receivers( requestFinishedSignal ) > 0;
+}
+
+QByteArray NetworkRequest::inflateData( const QByteArray &data )
+{
+    m_inflateStream->next_in = (Bytef*)data.constData();
+    m_inflateStream->avail_in = data.size();
 
+    // Decompress into the reused buffer, until all input is consumed
     QByteArray uncompressed;
     do {
-        stream.next_out = buffer;
-        stream.avail_out = chunkSize;
-        int status = inflate( &stream, Z_SYNC_FLUSH );
-        if ( status == Z_OK || status == Z_STREAM_END ) {
-            uncompressed.append( QByteArray::fromRawData(
-                    (char*)buffer, chunkSize - stream.avail_out) );
-            if ( status == Z_STREAM_END ) {
-                break;
-            }
-        } else {
-            kWarning() << "Error while decompressing" << status << stream.msg;
-            if ( status == Z_NEED_DICT || status == Z_DATA_ERROR || status == Z_MEM_ERROR ) {
-                inflateEnd( &stream );
-            }
-            return QByteArray();
+        m_inflateStream->next_out = (Bytef*)m_inflateBuffer.data();
+        m_inflateStream->avail_out = m_inflateBuffer.size();
+        const int status = inflate( m_inflateStream, Z_NO_FLUSH );
+        if ( status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR ) {
+            kWarning() << "Error while decompressing" << status << m_inflateStream->msg;
+            m_receiveError = i18nc("@info/plain", "Cannot decompress the received data: %1",
+                                   QString::fromLatin1(m_inflateStream->msg));
+            m_inflateFinished = true;
+            endInflate();
+            return uncompressed;
         }
-    } while( stream.avail_out == 0 );
-    inflateEnd( &stream );
+
+        uncompressed.append( m_inflateBuffer.constData(),
+                             m_inflateBuffer.size() - m_inflateStream->avail_out );
+        if ( status == Z_STREAM_END ) {
+            DEBUG_NETWORK("Uncompressed data from" << m_inflateStream->total_in << "Bytes to"
+                          << m_inflateStream->total_out << "Bytes");
+            m_inflateFinished = true;
+            endInflate();
+            break;
+        }
+    } while ( m_inflateStream->avail_out == 0 || m_inflateStream->avail_in > 0 );
+
     return uncompressed;
 }
 
+void NetworkRequest::endInflate()
+{
+    if ( m_inflateStream ) {
+        inflateEnd( m_inflateStream );
+        delete m_inflateStream;
+        m_inflateStream = 0;
+    }
+}
+
+QTextCodec *NetworkRequest::explicitCodec() const
+{
+    // Use the charset given by the script
+    QTextCodec *codec = 0;
+    if ( !m_charset.isEmpty() ) {
+        codec = QTextCodec::codecForName( m_charset );
+        if ( !codec ) {
+            kDebug() << "Charset" << m_charset << "not found";
+        }
+    }
+
+    // Use the charset from the ContentType header of the reply
+    if ( !codec && m_reply ) {
+        QRegExp charsetRegExp( "charset\\s*=\\s*\"?([^\";\\s]+)", Qt::CaseInsensitive );
+        const QString contentType =
+                m_reply->header( QNetworkRequest::ContentTypeHeader ).toString();
+        if ( charsetRegExp.indexIn(contentType) != -1 ) {
+            codec = QTextCodec::codecForName( charsetRegExp.cap(1).toLatin1() );
+        }
+    }
+    return codec;
+}
+
+QTextCodec *NetworkRequest::codecForReply( const QByteArray &data ) const
+{
+    QTextCodec *codec = explicitCodec();
+
+    // Use a byte order mark or a charset in HTML meta tags of the document
+    if ( !codec ) {
+        codec = QTextCodec::codecForHtml( data, 0 );
+    }
+
+    // Use the fallback charset of the provider or utf8
+    if ( !codec && !m_fallbackCharset.isEmpty() ) {
+        codec = QTextCodec::codecForName( m_fallbackCharset );
+    }
+    return codec ? codec : QTextCodec::codecForName( "UTF-8" );
+}
+
 void NetworkRequest::slotFinished()
 {
     m_mutex->lockInline();
@@ -208,37 +363,40 @@ void NetworkRequest::slotFinished()
     const int size = m_reply->size();
     const int statusCode = m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
 
-    // Read all data, decode it and give it to the script
-    m_data.append( m_reply->readAll() );
+    // Read remaining data, decompress/decode it and give it to the script
+    processReceivedData( m_reply->readAll(), true );
 
-    if ( m_data.isEmpty() ) {
+    if ( m_uncompressedSize == 0 ) {
         kWarning() << "Error downloading" << m_url
                    << (m_reply ? m_reply->errorString() : "Reply already deleted");
     }
 
-    // Check if the data is compressed and was not decompressed by QNetworkAccessManager
-    if ( m_data.length() >= 2 && quint8(m_data[0]) == 0x1f && quint8(m_data[1]) == 0x8b ) {
-        // Data is compressed, uncompress it
-        // NOTE qUncompress() did not work here, "invalid zip"
-        m_data = gzipDecompress( m_data );
-        DEBUG_NETWORK("Uncompressed data from" << size << "Bytes to" << m_data.size()
-                << "Bytes, ratio:" << (100 - (m_data.isEmpty() ? 100 : qRound(100 * size / m_data.size()))) << '%');
-    }
-
     DEBUG_NETWORK("Request finished" << m_reply->url());
     if ( m_reply->url().isEmpty() ) {
         kWarning() << "Empty URL in QNetworkReply!";
     }
-    const bool hasError = m_reply->error() != QNetworkReply::NoError;
-    const QString errorString = m_reply->errorString();
+    // Report errors while decompressing, if there was no network error
+    const bool hasError = m_reply->error() != QNetworkReply::NoError || !m_receiveError.isEmpty();
+    const QString errorString = m_reply->error() != QNetworkReply::NoError
+            ? m_reply->errorString() : m_receiveError;
+    m_replyHeaders = m_reply->rawHeaderPairs();
     m_reply->deleteLater();
     m_reply = 0;
 
     m_isFinished = true;
     const QByteArray data = m_data;
+    if ( !m_text.isEmpty() ) {
+        // The text was decoded while downloading, text() uses it instead of the raw data
+        m_data.clear();
+    }
+    const bool emitText = receivers( SIGNAL(textFinished(QString,bool,QString,int,int)) ) > 0;
+    const QString text = emitText ? m_text : QString();
     m_mutex->unlockInline();
 
     emit finished( data, hasError, errorString, statusCode, size );
+    if ( emitText ) {
+        emit textFinished( text, hasError, errorString, statusCode, size );
+    }
 }
 
 void NetworkRequest::started( QNetworkReply* reply, int timeout )
@@ -249,17 +407,31 @@ void NetworkRequest::started( QNetworkReply* reply, int timeout )
         m_mutex->unlockInline();
         return;
     }
+    m_fallbackCharset = m_network->fallbackCharset();
+
+    // Reset data, eg. when started again after a redirection
     m_data.clear();
+    m_text.clear();
+    m_textOnly = false;
+    m_receivedHead.clear();
+    m_replyCharset.clear();
+    m_uncompressedSize = 0;
+    m_compressionDetected = false;
+    m_inflateFinished = false;
+    m_receiveError.clear();
+    m_replyHeaders.clear();
+    endInflate();
+    delete m_textDecoder;
+    m_textDecoder = 0;
     m_reply = reply;
+    m_operation = reply->operation();
 
     if ( timeout > 0 ) {
         QTimer::singleShot( timeout, this, SLOT(abort()) );
     }
 
-    // Connect to signals of reply only when the associated signals of this class are connected
-    if ( receivers(SIGNAL(readyRead(QByteArray))) > 0 ) {
-        connect( m_reply, SIGNAL(readyRead()), this, SLOT(slotReadyRead()) );
-    }
+    // Process data while it gets downloaded to decompress and decode it in chunks
+    connect( m_reply, SIGNAL(readyRead()), this, SLOT(slotReadyRead()) );
     connect( m_reply, SIGNAL(finished()), this, SLOT(slotFinished()) );
     m_mutex->unlockInline();
 
@@ -585,6 +757,7 @@ QByteArray Network::getSynchronous( const QString &url, const QString &userUrl,
     m_lastUrl = url;
     m_lastUserUrl = userUrl.isEmpty() ? url : userUrl;
     m_lastDownloadAborted = false;
+    m_lastSynchronousReplyHeaders.clear();
     m_mutex->unlockInline();
 
     emit synchronousRequestStarted( url );
@@ -658,13 +831,15 @@ QByteArray Network::getSynchronous( const QString &url, const QString &userUrl,
         return QByteArray();
     } else {
         QMutexLocker locker( m_mutex );
+        m_lastSynchronousReplyHeaders = reply->rawHeaderPairs();
         emit synchronousRequestFinished( url, data, false, statusCode, time, data.size() );
         return data;
     }
 }
 
 ResultObject::ResultObject( QObject* parent )
-        : QObject(parent), m_mutex(new QMutex()), m_features(DefaultFeatures), m_hints(NoHint)
+        : QObject(parent), m_publishedCount(0), m_mutex(new QMutex()),
+          m_features(DefaultFeatures), m_hints(NoHint)
 {
 }
 
@@ -719,8 +894,11 @@ void ResultObject::dataList( const QList< TimetableData > &dataList,
     Q_UNUSED( features );
     QDate curDate;
     QTime lastTime;
+
+    // Read the current date and time only once for all items
+    const QDateTime now = QDateTime::currentDateTime();
     int dayAdjustment = hints.testFlag(DatesNeedAdjustment)
-            ? QDate::currentDate().daysTo(globalInfo->requestDate) : 0;
+            ? now.date().daysTo(globalInfo->requestDate) : 0;
     if ( dayAdjustment != 0 ) {
         kDebug() << "Dates get adjusted by" << dayAdjustment << "days";
     }
@@ -739,13 +917,14 @@ void ResultObject::dataList( const QList< TimetableData > &dataList,
 
     // This regular expression gets used to search for word at the end, possibly including
     // a colon before the last word
-    QRegExp rxLastWord( ",?\\s+\\S+$" );
+    QRegExp rxLastWord = RegExpCache::instance()->regExp( ",?\\s+\\S+$" );
 
     // These strings store the words with the most occurrences in stop names at the beginning/end
     QString removeFirstWord;
     QString removeLastWord;
 
     // Read timetable data from the script
+    infoList->reserve( infoList->count() + dataList.count() );
     for ( int i = 0; i < dataList.count(); ++i ) {
         TimetableData timetableData = dataList[ i ];
 
@@ -771,12 +950,12 @@ void ResultObject::dataList( const QList< TimetableData > &dataList,
                     dateTime = QDateTime( departureDate, departureTime );
                 } else if ( curDate.isNull() ) {
                     // First departure
-                    if ( QTime::currentTime().hour() < 3 && departureTime.hour() > 21 ) {
-                        dateTime.setDate( QDate::currentDate().addDays(-1) );
-                    } else if ( QTime::currentTime().hour() > 21 && departureTime.hour() < 3 ) {
-                        dateTime.setDate( QDate::currentDate().addDays(1) );
+                    if ( now.time().hour() < 3 && departureTime.hour() > 21 ) {
+                        dateTime.setDate( now.date().addDays(-1) );
+                    } else if ( now.time().hour() > 21 && departureTime.hour() < 3 ) {
+                        dateTime.setDate( now.date().addDays(1) );
                     } else {
-                        dateTime.setDate( QDate::currentDate() );
+                        dateTime.setDate( now.date() );
                     }
                 } else if ( lastTime.secsTo(departureTime) < -5 * 60 ) {
                     // Time too much ealier than last time, estimate it's tomorrow
@@ -796,19 +975,18 @@ void ResultObject::dataList( const QList< TimetableData > &dataList,
         }
 
         // Create info object for the timetable data
-        PublicTransportInfoPtr info;
+        PublicTransportInfo info;
         if ( parseMode == ParseForJourneysByDepartureTime ||
              parseMode == ParseForJourneysByArrivalTime )
         {
-            info = QSharedPointer<JourneyInfo>( new JourneyInfo(timetableData) );
+            info = JourneyInfo( timetableData, PublicTransportInfo::CorrectEverything, now );
         } else if ( parseMode == ParseForDepartures || parseMode == ParseForArrivals ) {
-            info = QSharedPointer<DepartureInfo>( new DepartureInfo(timetableData) );
+            info = DepartureInfo( timetableData, PublicTransportInfo::CorrectEverything, now );
         } else if ( parseMode == ParseForStopSuggestions ) {
-            info = QSharedPointer<StopInfo>( new StopInfo(timetableData) );
+            info = StopInfo( timetableData );
         }
 
-        if ( !info->isValid() ) {
-            info.clear();
+        if ( !info.isValid() ) {
             continue;
         }
 
@@ -818,7 +996,7 @@ void ResultObject::dataList( const QList< TimetableData > &dataList,
              removeFirstWord.isEmpty() && removeLastWord.isEmpty() )
         {
             // First count the first/last word of the target stop name
-            const QString target = info->value( Enums::Target ).toString();
+            const QString target = info.value( Enums::Target ).toString();
             int pos = target.indexOf( ' ' );
             if ( pos > 0 && ++firstWordCounts[target.left(pos)] >= maxWordOccurrence ) {
                 removeFirstWord = target.left(pos);
@@ -830,9 +1008,9 @@ void ResultObject::dataList( const QList< TimetableData > &dataList,
             }
 
             // Check if route stop names are available
-            if ( info->contains(Enums::RouteStops) ) {
-                QStringList stops = info->value( Enums::RouteStops ).toStringList();
-                QString target = info->value( Enums::Target ).toString();
+            if ( info.contains(Enums::RouteStops) ) {
+                QStringList stops = info.value( Enums::RouteStops ).toStringList();
+                QString target = info.value( Enums::Target ).toString();
 
                 // TODO Break if 70% or at least three of the route stop names
                 // begin/end with the same word
@@ -901,43 +1079,142 @@ void ResultObject::dataList( const QList< TimetableData > &dataList,
         if ( !removeFirstWord.isEmpty() ) {
             // Remove removeFirstWord from all stop names
             for ( int i = 0; i < infoList->count(); ++i ) {
-                QSharedPointer<PublicTransportInfo> info = infoList->at( i );
-                QString target = info->value( Enums::Target ).toString();
+                PublicTransportInfo &info = (*infoList)[ i ];
+                QString target = info.value( Enums::Target ).toString();
                 if ( target.startsWith(removeFirstWord) ) {
                     target = target.mid( removeFirstWord.length() + 1 );
-                    info->insert( Enums::TargetShortened, target );
+                    info.insert( Enums::TargetShortened, target );
                 }
 
-                QStringList stops = info->value( Enums::RouteStops ).toStringList();
+                QStringList stops = info.value( Enums::RouteStops ).toStringList();
                 for ( int i = 0; i < stops.count(); ++i ) {
                     if ( stops[i].startsWith(removeFirstWord) ) {
                         stops[i] = stops[i].mid( removeFirstWord.length() + 1 );
                     }
                 }
-                info->insert( Enums::RouteStopsShortened, stops );
+                info.insert( Enums::RouteStopsShortened, stops );
             }
         } else if ( !removeLastWord.isEmpty() ) {
             // Remove removeLastWord from all stop names
             for ( int i = 0; i < infoList->count(); ++i ) {
-                QSharedPointer<PublicTransportInfo> info = infoList->at( i );
-                QString target = info->value( Enums::Target ).toString();
+                PublicTransportInfo &info = (*infoList)[ i ];
+                QString target = info.value( Enums::Target ).toString();
                 if ( target.endsWith(removeLastWord) ) {
                     target = target.left( target.length() - removeLastWord.length() );
-                    info->insert( Enums::TargetShortened, target );
+                    info.insert( Enums::TargetShortened, target );
                 }
 
-                QStringList stops = info->value( Enums::RouteStops ).toStringList();
+                QStringList stops = info.value( Enums::RouteStops ).toStringList();
                 for ( int i = 0; i < stops.count(); ++i ) {
                     if ( stops[i].endsWith(removeLastWord) ) {
                         stops[i] = stops[i].left( stops[i].length() - removeLastWord.length() );
                     }
                 }
-                info->insert( Enums::RouteStopsShortened, stops );
+                info.insert( Enums::RouteStopsShortened, stops );
             }
         }
     }
 }
 
+K_GLOBAL_STATIC( RegExpCache, globalRegExpCache )
+
+RegExpCache *RegExpCache::instance()
+{
+    return globalRegExpCache;
+}
+
+RegExpCache::RegExpCache( int maxSize )
+        : m_mutex(new QMutex()), m_cache(maxSize), m_hits(0), m_misses(0)
+{
+}
+
+RegExpCache::~RegExpCache()
+{
+    delete m_mutex;
+}
+
+QRegExp RegExpCache::regExp( const QString &pattern, Qt::CaseSensitivity caseSensitivity,
+                             bool minimal, QRegExp::PatternSyntax syntax )
+{
+    // Encode the options into the key, a null character never occurs in patterns
+    const QString key = pattern + QChar(QChar::Null)
+            + QChar('0' + (caseSensitivity == Qt::CaseSensitive ? 1 : 0) + (minimal ? 2 : 0))
+            + QChar('0' + static_cast<int>(syntax));
+
+    QMutexLocker locker( m_mutex );
+    QRegExp *cached = m_cache.object( key );
+    if ( cached ) {
+        ++m_hits;
+        return *cached;
+    }
+
+    ++m_misses;
+    QRegExp *regExp = new QRegExp( pattern, caseSensitivity, syntax );
+    regExp->setMinimal( minimal );
+    if ( !regExp->isValid() ) {
+        DEBUG_SCRIPT_HELPER("Invalid regular expression pattern" << pattern
+                            << regExp->errorString());
+    }
+
+    // Match once to make QRegExp compile the pattern before it gets copied into the cache,
+    // copies then share the compiled pattern
+    regExp->indexIn( QString() );
+    const QRegExp result = *regExp;
+    m_cache.insert( key, regExp );
+    return result;
+}
+
+RegExpCache::Statistics RegExpCache::statistics() const
+{
+    QMutexLocker locker( m_mutex );
+    Statistics statistics;
+    statistics.hits = m_hits;
+    statistics.misses = m_misses;
+    statistics.size = m_cache.count();
+    statistics.maxSize = m_cache.maxCost();
+    return statistics;
+}
+
+int RegExpCache::maxSize() const
+{
+    QMutexLocker locker( m_mutex );
+    return m_cache.maxCost();
+}
+
+void RegExpCache::setMaxSize( int maxSize )
+{
+    QMutexLocker locker( m_mutex );
+    m_cache.setMaxCost( maxSize );
+}
+
+void RegExpCache::clear()
+{
+    QMutexLocker locker( m_mutex );
+    m_cache.clear();
+    m_hits = 0;
+    m_misses = 0;
+}
+
+CompiledRegExp::CompiledRegExp( const QRegExp &regExp, QObject *parent )
+        : QObject(parent), m_regExp(regExp)
+{
+}
+
+QVariantList CompiledRegExp::matchAll( const QString &str, int maxCount )
+{
+    QVariantList matches;
+    int pos = 0;
+    while ( (maxCount <= 0 || matches.count() < maxCount) &&
+            (pos = m_regExp.indexIn(str, pos)) != -1 )
+    {
+        matches << m_regExp.capturedTexts();
+
+        // Prevent endless loops with patterns that can match empty strings
+        pos += qMax( 1, m_regExp.matchedLength() );
+    }
+    return matches;
+}
+
 QString Helper::decodeHtmlEntities( const QString& html )
 {
     return Global::decodeHtmlEntities( html );
@@ -1066,7 +1343,7 @@ void ResultObject::addData( const QVariantMap& map )
             kDebug() << "Unknown timetable information" << it.key() << "with value" << value;
             const QString message = i18nc("@info/plain", "Invalid timetable information \"%1\" "
                                           "with value \"%2\"", it.key(), value.toString());
-            const int count = m_timetableData.count();
+            const int count = m_publishedCount + m_timetableData.count();
             m_mutex->unlockInline();
             emit invalidDataReceived( info, message, context()->parentContext(), count, map );
             m_mutex->lockInline();
@@ -1078,7 +1355,7 @@ void ResultObject::addData( const QVariantMap& map )
             kDebug() << "Value for" << info << "is invalid or null" << value;
             const QString message = i18nc("@info/plain", "Invalid value received for \"%1\"",
                                           it.key());
-            const int count = m_timetableData.count();
+            const int count = m_publishedCount + m_timetableData.count();
             m_mutex->unlockInline();
             emit invalidDataReceived( info, message, context()->parentContext(), count, map );
             m_mutex->lockInline();
@@ -1090,7 +1367,7 @@ void ResultObject::addData( const QVariantMap& map )
             kDebug() << "Invalid type of vehicle value" << value;
             const QString message = i18nc("@info/plain",
                     "Invalid type of vehicle received: \"%1\"", value.toString());
-            const int count = m_timetableData.count();
+            const int count = m_publishedCount + m_timetableData.count();
             m_mutex->unlockInline();
             emit invalidDataReceived( info, message, context()->parentContext(), count, map );
             m_mutex->lockInline();
@@ -1105,7 +1382,7 @@ void ResultObject::addData( const QVariantMap& map )
                     const QString message = i18nc("@info/plain",
                             "Invalid type of vehicle received in \"%1\": \"%2\"",
                             Global::timetableInformationToString(info), type.toString());
-                    const int count = m_timetableData.count();
+                    const int count = m_publishedCount + m_timetableData.count();
                     m_mutex->unlockInline();
                     emit invalidDataReceived( info, message, context()->parentContext(),
                                               count, map );
@@ -1143,7 +1420,7 @@ void ResultObject::addData( const QVariantMap& map )
     }
     m_timetableData << data;
 
-    if ( m_features.testFlag(AutoPublish) && m_timetableData.count() == 10 ) {
+    if ( m_features.testFlag(AutoPublish) && m_publishedCount + m_timetableData.count() == 10 ) {
         // Publish the first 10 data items automatically
         m_mutex->unlockInline();
         emit publish();
@@ -1155,28 +1432,31 @@ void ResultObject::addData( const QVariantMap& map )
 QString Helper::trim( const QString& str )
 {
     return QString(str).trimmed()
-                       .replace( QRegExp("^(&nbsp;)+|(&nbsp;)+$", Qt::CaseInsensitive), QString() )
+                       .replace( RegExpCache::instance()->regExp("^(&nbsp;)+|(&nbsp;)+$",
+                                                                 Qt::CaseInsensitive), QString() )
                        .trimmed();
 }
 
 QString Helper::simplify( const QString &str )
 {
-    return QString(str).replace( QRegExp("(&nbsp;)+", Qt::CaseInsensitive), QString() )
+    return QString(str).replace( RegExpCache::instance()->regExp("(&nbsp;)+",
+                                                                 Qt::CaseInsensitive), QString() )
                        .simplified();
 }
 
 QString Helper::stripTags( const QString& str )
 {
     const QString attributePattern = "\\w+(?:\\s*=\\s*(?:\"[^\"]*\"|'[^']*'|[^\"'>\\s]+))?";
-    QRegExp rx( QString("<\\/?\\w+(?:\\s+%1)*(?:\\s*/)?>").arg(attributePattern) );
-    rx.setMinimal( true );
+    const QRegExp rx = RegExpCache::instance()->regExp(
+            QString("<\\/?\\w+(?:\\s+%1)*(?:\\s*/)?>").arg(attributePattern),
+            Qt::CaseSensitive, true );
     return QString( str ).remove( rx );
 }
 
 QString Helper::camelCase( const QString& str )
 {
     QString ret = str.toLower();
-    QRegExp rx( "(^\\w)|\\W(\\w)" );
+    QRegExp rx = RegExpCache::instance()->regExp( "(^\\w)|\\W(\\w)" );
     int pos = 0;
     while ( (pos = rx.indexIn(ret, pos)) != -1 ) {
         if ( rx.pos(2) == -1 || rx.pos(2) >= ret.length() ) {
@@ -1212,14 +1492,14 @@ QVariantMap Helper::matchTime( const QString& str, const QString& format )
               .replace( "ap", "(am|pm)" );
 
     QVariantMap ret;
-    QRegExp rx( pattern );
+    QRegExp rx = RegExpCache::instance()->regExp( pattern );
     if ( rx.indexIn(str) != -1 ) {
         QTime time = QTime::fromString( rx.cap(), format );
         ret.insert( "hour", time.hour() );
         ret.insert( "minute", time.minute() );
     } else if ( format != "hh:mm" ) {
         // Try default format if the one specified doesn't work
-        QRegExp rx2( "\\d{1,2}:\\d{2}" );
+        QRegExp rx2 = RegExpCache::instance()->regExp( "\\d{1,2}:\\d{2}" );
         if ( rx2.indexIn(str) != -1 ) {
             QTime time = QTime::fromString( rx2.cap(), "hh:mm" );
             ret.insert( "hour", time.hour() );
@@ -1245,13 +1525,13 @@ QDate Helper::matchDate( const QString& str, const QString& format )
               .replace( "yyyy", "\\d{4}" )
               .replace( "yy", "\\d{2}" );
 
-    QRegExp rx( pattern );
+    QRegExp rx = RegExpCache::instance()->regExp( pattern );
     QDate date;
     if ( rx.indexIn(str) != -1 ) {
         date = QDate::fromString( rx.cap(), format );
     } else if ( format != "yyyy-MM-dd" ) {
         // Try default format if the one specified doesn't work
-        QRegExp rx2( "\\d{2,4}-\\d{2}-\\d{2}" );
+        QRegExp rx2 = RegExpCache::instance()->regExp( "\\d{2,4}-\\d{2}-\\d{2}" );
         if ( rx2.indexIn(str) != -1 ) {
             date = QDate::fromString( rx2.cap(), "yyyy-MM-dd" );
         }
@@ -1268,6 +1548,26 @@ QDate Helper::matchDate( const QString& str, const QString& format )
     return date;
 }
 
+QScriptValue Helper::compileRegExp( const QString &pattern, const QVariantMap &options )
+{
+    if ( !engine() ) {
+        kDebug() << "Can only be used from scripts";
+        return QScriptValue();
+    }
+
+    const bool caseSensitive = options.value( "caseSensitive", true ).toBool();
+    const bool minimal = options.value( "minimal", false ).toBool();
+    const QRegExp regExp = RegExpCache::instance()->regExp( pattern,
+            caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive, minimal );
+    if ( !regExp.isValid() ) {
+        context()->throwError( i18nc("@info/plain", "Invalid regular expression pattern "
+                                     "<icode>%1</icode>: %2", pattern, regExp.errorString()) );
+        return QScriptValue();
+    }
+
+    return engine()->newQObject( new CompiledRegExp(regExp), QScriptEngine::ScriptOwnership );
+}
+
 QString Helper::formatTime( int hour, int minute, const QString& format )
 {
     return QTime( hour, minute ).toString( format );
@@ -1369,20 +1669,21 @@ QVariantList Helper::findHtmlTags( const QString &str, const QString &tagName,
     // Matching the attributes with all details here is required to prevent eg. having a match
     // end after a ">" character in a string in an attribute.
     const QString attributePattern = "\\w+(?:\\s*=\\s*(?:\"[^\"]*\"|'[^']*'|[^\"'>\\s]+))?";
-    QRegExp htmlTagRegExp( noContent
+    RegExpCache *regExpCache = RegExpCache::instance();
+    QRegExp htmlTagRegExp = regExpCache->regExp( noContent
             ? QString("<%1((?:\\s+%2)*)(?:\\s*/)?>").arg(tagName).arg(attributePattern)
             : QString("<%1((?:\\s+%2)*)>").arg(tagName).arg(attributePattern),
                            // TODO TEST does this need a "\\s*" before the ">"?
 //             : QString("<%1((?:\\s+%2)*)>%3</%1\\s*>").arg(tagName).arg(attributePattern)
 //                     .arg(contentsRegExpPattern),
-            Qt::CaseInsensitive );
-    QRegExp htmlCloseTagRegExp( QString("</%1\\s*>").arg(tagName), Qt::CaseInsensitive );
-    QRegExp contentsRegExp( contentsRegExpPattern, Qt::CaseInsensitive );
-    htmlTagRegExp.setMinimal( true );
+            Qt::CaseInsensitive, true );
+    QRegExp htmlCloseTagRegExp = regExpCache->regExp( QString("</%1\\s*>").arg(tagName),
+                                                      Qt::CaseInsensitive );
+    QRegExp contentsRegExp = regExpCache->regExp( contentsRegExpPattern, Qt::CaseInsensitive );
 
     // Match attributes with or without value, with single/double/not quoted value
-    QRegExp attributeRegExp( "(\\w+)(?:\\s*=\\s*(?:\"([^\"]*)\"|'([^']*)'|([^\"'>\\s]+)))?",
-                             Qt::CaseInsensitive );
+    QRegExp attributeRegExp = regExpCache->regExp(
+            "(\\w+)(?:\\s*=\\s*(?:\"([^\"]*)\"|'([^']*)'|([^\"'>\\s]+)))?", Qt::CaseInsensitive );
 
     QVariantList foundTags;
     while ( (foundTags.count() < maxCount || maxCount <= 0) &&
@@ -1414,7 +1715,8 @@ QVariantList Helper::findHtmlTags( const QString &str, const QString &tagName,
             if ( !foundAttributes.contains(it.key()) ) {
                 // Did not find exact attribute name, try to use it as regular expression pattern
                 attributesMatch = false;
-                QRegExp attributeNameRegExp( it.key(), Qt::CaseInsensitive );
+                const QRegExp attributeNameRegExp =
+                        regExpCache->regExp( it.key(), Qt::CaseInsensitive );
                 foreach ( const QString &attributeName, foundAttributes.keys() ) {
                     if ( attributeNameRegExp.indexIn(attributeName) != -1 ) {
                         // Matched the attribute name
@@ -1435,7 +1737,7 @@ QVariantList Helper::findHtmlTags( const QString &str, const QString &tagName,
             const QString value = foundAttributes[ it.key() ].toString();
             const QString valueRegExpPattern = it.value().toString();
             if ( !(value.isEmpty() && valueRegExpPattern.isEmpty()) ) {
-                QRegExp valueRegExp( valueRegExpPattern, Qt::CaseInsensitive );
+                QRegExp valueRegExp = regExpCache->regExp( valueRegExpPattern, Qt::CaseInsensitive );
                 if ( valueRegExp.indexIn(value) == -1 ) {
                     // Attribute value regexp did not matched
                     attributesMatch = false;
@@ -1564,7 +1866,8 @@ QString Helper::getTagName( const QVariantMap &searchResult, const QString &type
             : searchResult["contents"].toString() );
     if ( !regExp.isEmpty() ) {
         // Use "regexp" property of namePosition to match the header name
-        QRegExp namePositionRegExp( regExp, Qt::CaseInsensitive );
+        QRegExp namePositionRegExp =
+                RegExpCache::instance()->regExp( regExp, Qt::CaseInsensitive );
         if ( namePositionRegExp.indexIn(name) != -1 ) {
             name = namePositionRegExp.cap( qMin(1, namePositionRegExp.captureCount()) );
         }
@@ -1605,7 +1908,7 @@ QVariantMap Helper::findNamedHtmlTags( const QString &str, const QString &tagNam
         // Check if the newly found name was already found
         // and decide what to do based on the "ambiguousNameResolution" option
         if ( ambiguousNameResolution == QLatin1String("addnumber") && foundTagsMap.contains(name) ) {
-            QRegExp rx( "(\\d+)$" );
+            QRegExp rx = RegExpCache::instance()->regExp( "(\\d+)$" );
             if ( rx.indexIn(name) != -1 ) {
                 name += QString::number( rx.cap(1).toInt() + 1 );
             } else {
@@ -2059,32 +2362,83 @@ QByteArray Network::fallbackCharset() const
     return m_fallbackCharset;
 }
 
+bool Network::setNetworkAccessManager( QNetworkAccessManager *manager )
+{
+    if ( !manager ) {
+        kWarning() << "No QNetworkAccessManager given";
+        return false;
+    } else if ( hasRunningRequests() ) {
+        kWarning() << "Cannot replace the QNetworkAccessManager while requests are running";
+        return false;
+    }
+
+    QMutexLocker locker( m_mutex );
+    if ( manager != m_manager ) {
+        delete m_manager;
+        manager->setParent( this );
+        m_manager = manager;
+    }
+    return true;
+}
+
+QList< QPair<QByteArray, QByteArray> > Network::lastSynchronousReplyHeaders() const
+{
+    QMutexLocker locker( m_mutex );
+    return m_lastSynchronousReplyHeaders;
+}
+
 QList< TimetableData > ResultObject::data() const
 {
     QMutexLocker locker( m_mutex );
     return m_timetableData;
 }
 
+QList< TimetableData > ResultObject::takeUnpublishedData()
+{
+    // Hand the shared list over and release it from this object, clear() does not copy it
+    QMutexLocker locker( m_mutex );
+    const QList< TimetableData > data = m_timetableData;
+    m_timetableData.clear();
+    m_publishedCount += data.count();
+    return data;
+}
+
+bool ResultObject::hasUnpublishedData() const
+{
+    QMutexLocker locker( m_mutex );
+    return !m_timetableData.isEmpty();
+}
+
+int ResultObject::publishedCount() const
+{
+    QMutexLocker locker( m_mutex );
+    return m_publishedCount;
+}
+
 QVariant ResultObject::data( int index, Enums::TimetableInformation information ) const
 {
     QMutexLocker locker( m_mutex );
-    if ( index < 0 || index >= m_timetableData.count() ) {
+    if ( index < 0 || index >= m_publishedCount + m_timetableData.count() ) {
         context()->throwError( QScriptContext::RangeError, "Index out of range" );
         return QVariant();
+    } else if ( index < m_publishedCount ) {
+        // Published items were handed over to the data engine and released
+        kDebug() << "Item" << index << "was already published";
+        return QVariant();
     }
-    return m_timetableData[ index ][ information ];
+    return m_timetableData[ index - m_publishedCount ][ information ];
 }
 
 bool ResultObject::hasData() const
 {
     QMutexLocker locker( m_mutex );
-    return !m_timetableData.isEmpty();
+    return m_publishedCount > 0 || !m_timetableData.isEmpty();
 }
 
 int ResultObject::count() const
 {
     QMutexLocker locker( m_mutex );
-    return m_timetableData.count();
+    return m_publishedCount + m_timetableData.count();
 }
 
 ResultObject::Features ResultObject::features() const
@@ -2103,6 +2457,7 @@ void ResultObject::clear()
 {
     QMutexLocker locker( m_mutex );
     m_timetableData.clear();
+    m_publishedCount = 0;
 }
 
 QScriptValue constructStream( QScriptContext *context, QScriptEngine *engine )
@@ -2287,6 +2642,54 @@ quint64 NetworkRequest::uncompressedSize() const
     return m_uncompressedSize;
 }
 
+QNetworkAccessManager::Operation NetworkRequest::operation() const
+{
+    QMutexLocker locker( m_mutex );
+    return m_operation;
+}
+
+QList< QPair<QByteArray, QByteArray> > NetworkRequest::replyHeaders() const
+{
+    QMutexLocker locker( m_mutex );
+    return m_replyHeaders;
+}
+
+QByteArray NetworkRequest::replyCharset() const
+{
+    QMutexLocker locker( m_mutex );
+    return m_replyCharset;
+}
+
+void NetworkRequest::setCharset( const QString &charset )
+{
+    if ( isRunning() ) {
+        kDebug() << "Cannot set the charset for an already running request!";
+        return;
+    }
+
+    QMutexLocker locker( m_mutex );
+    m_charset = charset.toLatin1();
+}
+
+QString NetworkRequest::charset() const
+{
+    QMutexLocker locker( m_mutex );
+    return m_charset;
+}
+
+QString NetworkRequest::text() const
+{
+    QMutexLocker locker( m_mutex );
+    if ( !m_text.isEmpty() || m_data.isEmpty() ) {
+        // Already decoded while downloading
+        return m_text;
+    }
+
+    // Decode now, the text was not needed while downloading
+    return Global::decode( m_data, m_replyCharset.isEmpty()
+                           ? codecForReply(m_data)->name() : m_replyCharset );
+}
+
 #include "scriptapi.moc"
 
 }; // namespace ScriptApi
@@ -33,6 +33,9 @@
 #include <QScriptEngine>
 #include <QScriptable> // Base class
 #include <QUrl>
+#include <QRegExp>
+#include <QCache>
+#include <QNetworkAccessManager>
 
 class PublicTransportInfo;
 class ServiceProviderData;
@@ -41,8 +44,11 @@ class QScriptContextInfo;
 class QNetworkRequest;
 class QReadWriteLock;
 class QNetworkReply;
-class QNetworkAccessManager;
 class QMutex;
+class QTextCodec;
+class QTextDecoder;
+struct z_stream_s;
+class ScriptApiTest;
 
 /** @brief Stores information about a departure/arrival/journey/stop suggestion. */
 typedef QHash<Enums::TimetableInformation, QVariant> TimetableData;
@@ -58,6 +64,23 @@ class Network;
  * @brief Represents one asynchronous request, created with Network::createRequest().
  *
  * To get notified about new data, connect to either the finished() or the readyRead() signal.
+ * Compressed replies (gzip or deflate) get decompressed while they are downloaded.
+ *
+ * If compressed data cannot be decompressed, the request finishes with an error.
+ *
+ * To get the document already decoded to a string, connect to textFinished() instead of
+ * finished(). The text gets decoded while the document gets downloaded, use setCharset() if
+ * the charset of the document cannot be detected.
+ * @code
+    var request = network.createRequest( url );
+    request.setCharset( "latin1" ); // Only needed if the charset cannot be detected
+    request.textFinished.connect( handler );
+    network.get( request );
+
+    function handler( html ) {
+        // No need to call helper.decode() here
+    };
+   @endcode
  **/
 class NetworkRequest : public QObject {
     Q_OBJECT
@@ -67,7 +90,9 @@ class NetworkRequest : public QObject {
     Q_PROPERTY( bool isFinished READ isFinished )
     Q_PROPERTY( bool isRedirected READ isRedirected )
     Q_PROPERTY( QString postData READ postData )
+    Q_PROPERTY( QString charset READ charset WRITE setCharset )
     friend class Network;
+    friend class ::ScriptApiTest; // Tests processReceivedData() without network access
 
 public:
     /** @brief Creates an invalid request object. Needed for Q_DECLARE_METATYPE. */
@@ -153,8 +178,49 @@ public:
     Q_INVOKABLE void setHeader( const QString &header, const QString &value,
                                 const QString &charset = QString() );
 
+    /**
+     * @brief Set the charset to use to decode the received document to text.
+     *
+     * If @p charset is empty (the default), the charset gets read from the "ContentType" header
+     * of the reply or from the document itself (eg. HTML meta tags or a byte order mark).
+     * If that fails the fallback charset of the provider gets used, then utf8.
+     * @note If the request is already started, the charset cannot be changed and this function
+     *   will do nothing.
+     * @see text()
+     * @see textFinished()
+     **/
+    Q_INVOKABLE void setCharset( const QString &charset );
+
+    /** @brief Get the charset set with setCharset(), if any. */
+    QString charset() const;
+
+    /**
+     * @brief Get the received document decoded to a string.
+     *
+     * If textFinished() is connected the text gets decoded while downloading, otherwise this
+     * function decodes the received data using the charset set with setCharset() or the
+     * detected charset.
+     **/
+    Q_INVOKABLE QString text() const;
+
+    /** @brief The size of the received data after decompression. */
     quint64 uncompressedSize() const;
 
+    /** @brief The operation used to start this request, eg. a HEAD or GET operation. */
+    QNetworkAccessManager::Operation operation() const;
+
+    /** @brief Get the data to sent to the server encoded like it gets sent. */
+    QByteArray postDataByteArray() const;
+
+    /**
+     * @brief The raw headers of the reply, available when the request has finished.
+     * @note Not available for scripts, used to record replies, see NetworkRecorder.
+     **/
+    QList< QPair<QByteArray, QByteArray> > replyHeaders() const;
+
+    /** @brief The charset used to decode the reply or an empty string if it was not decoded. */
+    QByteArray replyCharset() const;
+
 public Q_SLOTS:
     /**
      * @brief Aborts this (running) request.
@@ -195,6 +261,24 @@ Q_SIGNALS:
      **/
     void readyRead( const QByteArray &data );
 
+    /**
+     * @brief Emitted after finished() with the received document decoded to a string.
+     *
+     * The document gets decoded while downloading. If the received data is not needed for
+     * finished() or Network::requestFinished(), it gets released while decoding and finished()
+     * gets emitted with an empty QByteArray.
+     *
+     * @param text The complete document downloaded for this request, decoded using the charset
+     *   set with setCharset() or the detected charset.
+     * @param error @c True, if there was an error executing the request, @c false otherwise.
+     * @param errorString A human readable description of the error if @p error is @c true.
+     * @param statusCode The HTTP status code that was received or -1 if there was an error.
+     * @param size The size in bytes of the received data.
+     **/
+    void textFinished( const QString &text = QString(), bool error = false,
+                       const QString &errorString = QString(), int statusCode = -1,
+                       int size = 0 );
+
     void redirected( const QUrl &newUrl );
 
 protected Q_SLOTS:
@@ -203,11 +287,26 @@ protected Q_SLOTS:
 
 protected:
     void started( QNetworkReply* reply, int timeout = 0 );
-    QByteArray postDataByteArray() const;
     QNetworkRequest *request() const;
     QByteArray getCharset( const QString &charset = QString() ) const;
     bool isValid() const;
 
+    // Whether or not the received data is needed when finished, ie. there are receivers for
+    // finished() other than the Network object or for Network::requestFinished()
+    bool isDataNeeded() const;
+
+    // Decompress (if needed) and decode newly received data, m_mutex needs to be locked.
+    // Use finished = true for the last data of the reply to finish decompression/decoding
+    QByteArray processReceivedData( const QByteArray &data, bool finished = false );
+    QByteArray inflateData( const QByteArray &data );
+    void endInflate();
+
+    // Get the codec set by the script or from the ContentType header, m_mutex needs to be locked
+    QTextCodec *explicitCodec() const;
+
+    // Get the codec to decode the reply with, m_mutex needs to be locked
+    QTextCodec *codecForReply( const QByteArray &data ) const;
+
 private:
     QMutex *m_mutex;
     const QString m_url;
@@ -217,9 +316,24 @@ private:
     bool m_isFinished;
     QNetworkRequest *m_request;
     QNetworkReply *m_reply;
+    QNetworkAccessManager::Operation m_operation;
+    QList< QPair<QByteArray, QByteArray> > m_replyHeaders; // Stored when the reply has finished
     QByteArray m_data;
     QByteArray m_postData;
     quint32 m_uncompressedSize;
+
+    QByteArray m_receivedHead; // Received data, until the compression could be detected
+    bool m_compressionDetected;
+    z_stream_s *m_inflateStream; // Used to decompress data while downloading, if compressed
+    bool m_inflateFinished; // The compressed stream has ended or is broken
+    QString m_receiveError; // Set if the received data cannot be decompressed
+    QByteArray m_inflateBuffer; // Reused output buffer for inflate()
+    QByteArray m_charset; // Set by the script
+    QByteArray m_fallbackCharset; // The fallback charset of the Network object
+    QByteArray m_replyCharset; // The charset used for decoding (with codecForReply())
+    QTextDecoder *m_textDecoder; // Decodes data while downloading, if textFinished() is used
+    QString m_text;
+    bool m_textOnly; // Only the decoded text gets kept, the received data is not needed
 };
 /** \} */ // @ingroup scriptApi
 
@@ -286,6 +400,25 @@ public:
     /** @brief Destructor. */
     virtual ~Network();
 
+    /**
+     * @brief Replace the QNetworkAccessManager used for all requests with @p manager.
+     *
+     * Ownership of @p manager is taken and the previously used manager gets deleted.
+     * This is not available to scripts, it allows to eg. replay recorded replies in tests and
+     * benchmarks. The manager cannot be replaced while requests are running.
+     *
+     * @return @c True, if @p manager is now used, @c false otherwise.
+     **/
+    bool setNetworkAccessManager( QNetworkAccessManager *manager );
+
+    /**
+     * @brief The raw reply headers of the last successful synchronous request.
+     *
+     * Not available to scripts, valid while synchronousRequestFinished() gets emitted.
+     * Used to record replies, see NetworkRecorder.
+     **/
+    QList< QPair<QByteArray, QByteArray> > lastSynchronousReplyHeaders() const;
+
     /**
      * @brief Get the last requested URL.
      *
@@ -514,11 +647,165 @@ private:
     QString m_lastUrl;
     QString m_lastUserUrl;
     bool m_lastDownloadAborted;
+    QList< QPair<QByteArray, QByteArray> > m_lastSynchronousReplyHeaders;
     QList< NetworkRequest::Ptr > m_requests;
     QList< NetworkRequest::Ptr > m_finishedRequests;
 };
 /** \} */ // @ingroup scriptApi
 
+/**
+ * @brief A thread safe, bounded cache of compiled regular expressions.
+ *
+ * Scripts call Helper functions like Helper::matchTime() or Helper::findHtmlTags() once for
+ * each parsed row, which would compile the same patterns again and again. Instead these
+ * functions get their QRegExp objects from the global instance of this class.
+ * Compiled patterns are stored by pattern string, case sensitivity, pattern syntax and minimal
+ * matching. The least recently used patterns get removed, if more than maxSize() patterns
+ * are cached.
+ *
+ * The returned QRegExp objects are copies of the cached ones. Copies share the compiled
+ * pattern, but not the match state, ie. they can be used in different threads.
+ **/
+class RegExpCache {
+public:
+    /** @brief The default maximum number of cached patterns. */
+    static const int DEFAULT_MAX_SIZE = 256;
+
+    /** @brief Statistics about the usage of a RegExpCache. */
+    struct Statistics {
+        Statistics() : hits(0), misses(0), size(0), maxSize(0) {};
+
+        /** @brief The ratio of cache hits to all lookups, 0.0 if there were no lookups. */
+        qreal hitRate() const {
+            return hits + misses == 0 ? 0.0 : qreal(hits) / qreal(hits + misses); };
+
+        quint64 hits; /**< The number of lookups that found a compiled pattern. */
+        quint64 misses; /**< The number of lookups that needed to compile the pattern. */
+        int size; /**< The current number of cached patterns. */
+        int maxSize; /**< The maximum number of cached patterns. */
+    };
+
+    /** @brief Get the global RegExpCache instance, used by Helper and ResultObject. */
+    static RegExpCache *instance();
+
+    /** @brief Create a new cache storing up to @p maxSize compiled patterns. */
+    explicit RegExpCache( int maxSize = DEFAULT_MAX_SIZE );
+
+    ~RegExpCache();
+
+    /**
+     * @brief Get a compiled regular expression for @p pattern.
+     *
+     * If the pattern was used before with the same options, a copy of the cached regular
+     * expression gets returned. Otherwise the pattern gets compiled and added to the cache.
+     **/
+    QRegExp regExp( const QString &pattern, Qt::CaseSensitivity caseSensitivity = Qt::CaseSensitive,
+                    bool minimal = false, QRegExp::PatternSyntax syntax = QRegExp::RegExp );
+
+    /** @brief Get statistics about cache hits/misses and the current size of the cache. */
+    Statistics statistics() const;
+
+    /** @brief Get the maximum number of cached patterns. */
+    int maxSize() const;
+
+    /** @brief Set the maximum number of cached patterns to @p maxSize. */
+    void setMaxSize( int maxSize );
+
+    /** @brief Remove all cached patterns and reset statistics. */
+    void clear();
+
+private:
+    Q_DISABLE_COPY( RegExpCache )
+
+    QMutex *m_mutex;
+    QCache< QString, QRegExp > m_cache;
+    quint64 m_hits;
+    quint64 m_misses;
+};
+
+/** @ingroup scriptApi
+ * @{ */
+/**
+ * @brief A precompiled regular expression, created with Helper::compileRegExp().
+ *
+ * Scripts that match the same pattern for each parsed row should create a regular expression
+ * object once and use it in the loop, instead of creating new RegExp objects for each row:
+ * @code
+ * var rxTime = helper.compileRegExp( "(\\d{2}):(\\d{2})" );
+ * for ( var i = 0; i < rows.length; ++i ) {
+ *     if ( rxTime.indexIn(rows[i]) != -1 ) {
+ *         var hour = rxTime.cap( 1 );
+ *         var minute = rxTime.cap( 2 );
+ *     }
+ * }
+ * @endcode
+ *
+ * The compiled pattern is shared with other users of the same pattern through RegExpCache.
+ **/
+class CompiledRegExp : public QObject {
+    Q_OBJECT
+    Q_PROPERTY( QString pattern READ pattern )
+    Q_PROPERTY( bool isValid READ isValid )
+    Q_PROPERTY( int matchedLength READ matchedLength )
+    Q_PROPERTY( int captureCount READ captureCount )
+
+public:
+    /** @brief Create a new object for the compiled regular expression @p regExp. */
+    explicit CompiledRegExp( const QRegExp &regExp, QObject *parent = 0 );
+
+    /** @brief The pattern string of this regular expression. */
+    QString pattern() const { return m_regExp.pattern(); };
+
+    /** @brief Whether or not the pattern is valid. */
+    bool isValid() const { return m_regExp.isValid(); };
+
+    /** @brief The length of the last matched string or -1 if there was no match. */
+    int matchedLength() const { return m_regExp.matchedLength(); };
+
+    /** @brief The number of captures contained in the pattern. */
+    int captureCount() const { return m_regExp.captureCount(); };
+
+    /**
+     * @brief Search for the first match in @p str, starting at @p offset.
+     * @return The position of the first match or -1 if there was no match.
+     **/
+    Q_INVOKABLE int indexIn( const QString &str, int offset = 0 ) {
+        return m_regExp.indexIn(str, offset); };
+
+    /**
+     * @brief Search backwards for a match in @p str, starting at @p offset.
+     * @return The position of the match or -1 if there was no match.
+     **/
+    Q_INVOKABLE int lastIndexIn( const QString &str, int offset = -1 ) {
+        return m_regExp.lastIndexIn(str, offset); };
+
+    /** @brief Whether or not @p str is matched exactly. */
+    Q_INVOKABLE bool exactMatch( const QString &str ) { return m_regExp.exactMatch(str); };
+
+    /** @brief Get the text captured by the @p nth subexpression of the last match. */
+    Q_INVOKABLE QString cap( int nth = 0 ) { return m_regExp.cap(nth); };
+
+    /** @brief Get the position of the @p nth captured text of the last match. */
+    Q_INVOKABLE int pos( int nth = 0 ) { return m_regExp.pos(nth); };
+
+    /** @brief Get a list of all captured texts of the last match. */
+    Q_INVOKABLE QStringList capturedTexts() { return m_regExp.capturedTexts(); };
+
+    /**
+     * @brief Get all matches in @p str.
+     *
+     * @param str The string to search for matches.
+     * @param maxCount The maximum number of matches to return, 0 returns all matches.
+     * @return A list with one item for each match. Each item is a list of all captured
+     *   texts of the match, like returned by capturedTexts().
+     **/
+    Q_INVOKABLE QVariantList matchAll( const QString &str, int maxCount = 0 );
+
+private:
+    QRegExp m_regExp;
+};
+/** \} */ // @ingroup scriptApi
+
 /** @ingroup scriptApi
  * @{ */
 /**
@@ -733,6 +1020,23 @@ public:
      **/
     Q_INVOKABLE static QDate matchDate( const QString &str, const QString &format = "yyyy-MM-dd" );
 
+    /**
+     * @brief Get a precompiled regular expression object for @p pattern.
+     *
+     * Use this function to create a regular expression once, that gets used for many rows.
+     * Compiled patterns are cached and shared, see CompiledRegExp.
+     *
+     * @param pattern The regular expression pattern.
+     * @param options A map with options for the regular expression:
+     *   @li @b caseSensitive: Whether or not matching is case sensitive, default is @c true.
+     *   @li @b minimal: Whether or not matching is non-greedy, default is @c false.
+     * @return A CompiledRegExp object or an undefined value if this function was not called
+     *   from a script.
+     * @see CompiledRegExp
+     **/
+    Q_INVOKABLE QScriptValue compileRegExp( const QString &pattern,
+                                            const QVariantMap &options = QVariantMap() );
+
     /**
      * @brief Formats the time given by the values @p hour and @p minute
      *   as string in the given @p format.
@@ -1116,26 +1420,53 @@ public:
     virtual ~ResultObject();
 
     /**
-     * @brief Get the list of stored TimetableData objects.
+     * @brief Get the list of stored TimetableData objects, that were not published yet.
      *
-     * @return The list of stored TimetableData objects.
+     * @return The list of stored TimetableData objects, that were not taken out using
+     *   takeUnpublishedData().
      **/
     QList< TimetableData > data() const;
 
+    /**
+     * @brief Take all stored TimetableData objects out of the resultset, that were not published.
+     *
+     * The returned items get released from the resultset without copying them, the next call
+     * only returns items that were added in the meantime. Published items are still counted
+     * by count() and hasData(), but they can no longer be read using data().
+     * @return The list of stored TimetableData objects, that were not published before.
+     * @see hasUnpublishedData(), publishedCount()
+     **/
+    QList< TimetableData > takeUnpublishedData();
+
+    /** @brief Whether or not there are items, that were not published using
+     *    takeUnpublishedData(). */
+    bool hasUnpublishedData() const;
+
+    /** @brief Get the number of items that were published using takeUnpublishedData(). */
+    int publishedCount() const;
+
     Q_INVOKABLE inline QVariant data( int index, int information ) const {
         return data( index, static_cast<Enums::TimetableInformation>(information) );
     };
+    /**
+     * @brief Get the value of @p information of the item at @p index.
+     *
+     * Items that were already published get released, an invalid value gets returned for them.
+     **/
     Q_INVOKABLE QVariant data( int index, Enums::TimetableInformation information ) const;
 
     /**
      * @brief Checks whether or not the list of TimetableData objects is empty.
      *
      * @return @c True, if the list of TimetableData objects isn't empty. @c False, otherwise.
+     *   Items that were already published are included.
      **/
     Q_INVOKABLE bool hasData() const;
 
     /**
-     * @brief Returns the number of timetable elements currently in the resultset.
+     * @brief Returns the number of timetable elements added to the resultset.
+     *
+     * This includes elements that were already published.
      **/
     Q_INVOKABLE int count() const;
 
@@ -1319,7 +1650,8 @@ public Q_SLOTS:
 //     bool contains( TimetableInformation info ) const { return m_timetableData.contains(info); };
 
 private:
-    QList< TimetableData > m_timetableData;
+    QList< TimetableData > m_timetableData; // Items that were not published yet
+    int m_publishedCount; // Number of items that were taken out using takeUnpublishedData()
 
     // Protect data from concurrent access by the script in a separate thread and usage in C++
     QMutex *m_mutex;
@@ -1695,6 +2027,7 @@ Q_DECLARE_METATYPE(ScriptApi::ResultObject::Feature)
 Q_DECLARE_METATYPE(ScriptApi::ResultObject::Features)
 
 Q_DECLARE_METATYPE(ScriptApi::NetworkRequest*)
+Q_DECLARE_METATYPE(ScriptApi::CompiledRegExp*)
 Q_DECLARE_METATYPE(ScriptApi::NetworkRequest::Ptr)
 Q_SCRIPT_DECLARE_QMETAOBJECT(ScriptApi::NetworkRequest, QObject*)
 
@@ -420,14 +420,15 @@ void ServiceProviderScript::departuresReady( const QList<TimetableData> &data,
         emit requestFailed( this, ErrorParsingFailed,
                            i18n("Error while parsing the departure document."), url, &request );
     } else {
-        // Create PublicTransportInfo objects for new data and combine with already published data
+        // Create PublicTransportInfo objects only for the new chunk of data, the data engine
+        // appends them to the items of the data source that were already published
         PublicTransportInfoList newResults;
         ResultObject::dataList( data, &newResults, request.parseMode(),
                                 m_data->defaultVehicleType(), &globalInfo, features, hints );
-        PublicTransportInfoList results = (m_publishedData[request.sourceName()] << newResults);
         DepartureInfoList departures;
-        foreach( const PublicTransportInfoPtr &info, results ) {
-            departures << info.dynamicCast<DepartureInfo>();
+        departures.reserve( newResults.count() );
+        foreach( const PublicTransportInfo &info, newResults ) {
+            departures << DepartureInfo( info );
         }
 
         emit departuresReceived( this, url, departures, globalInfo, request );
@@ -448,14 +449,15 @@ void ServiceProviderScript::arrivalsReady( const QList< TimetableData > &data,
         emit requestFailed( this, ErrorParsingFailed,
                            i18n("Error while parsing the arrival document."), url, &request );
     } else {
-        // Create PublicTransportInfo objects for new data and combine with already published data
+        // Create PublicTransportInfo objects only for the new chunk of data, the data engine
+        // appends them to the items of the data source that were already published
         PublicTransportInfoList newResults;
         ResultObject::dataList( data, &newResults, request.parseMode(),
                                 m_data->defaultVehicleType(), &globalInfo, features, hints );
-        PublicTransportInfoList results = (m_publishedData[request.sourceName()] << newResults);
         ArrivalInfoList arrivals;
-        foreach( const PublicTransportInfoPtr &info, results ) {
-            arrivals << info.dynamicCast<ArrivalInfo>();
+        arrivals.reserve( newResults.count() );
+        foreach( const PublicTransportInfo &info, newResults ) {
+            arrivals << ArrivalInfo( info );
         }
 
         emit arrivalsReceived( this, url, arrivals, globalInfo, request );
@@ -477,15 +479,15 @@ void ServiceProviderScript::journeysReady( const QList<TimetableData> &data,
         emit requestFailed( this, ErrorParsingFailed,
                            i18n("Error while parsing the journey document."), url, &request );
     } else {
-        // Create PublicTransportInfo objects for new data and combine with already published data
+        // Create PublicTransportInfo objects only for the new chunk of data, the data engine
+        // appends them to the items of the data source that were already published
         PublicTransportInfoList newResults;
         ResultObject::dataList( data, &newResults, request.parseMode(),
                                 m_data->defaultVehicleType(), &globalInfo, features, hints );
-        PublicTransportInfoList results =
-                (m_publishedData[request.sourceName()] << newResults);
         JourneyInfoList journeys;
-        foreach( const PublicTransportInfoPtr &info, results ) {
-            journeys << info.dynamicCast<JourneyInfo>();
+        journeys.reserve( newResults.count() );
+        foreach( const PublicTransportInfo &info, newResults ) {
+            journeys << JourneyInfo( info );
         }
 
         emit journeysReceived( this, url, journeys, globalInfo, request );
@@ -501,16 +503,16 @@ void ServiceProviderScript::stopSuggestionsReady( const QList<TimetableData> &da
 //     TODO use hints
     kDebug() << "Received" << data.count() << "items";
 
-    // Create PublicTransportInfo objects for new data and combine with already published data
+    // Create PublicTransportInfo objects only for the new chunk of data, the data engine
+    // appends them to the stops of the data source that were already published
     PublicTransportInfoList newResults;
     ResultObject::dataList( data, &newResults, request.parseMode(),
                             m_data->defaultVehicleType(), &globalInfo, features, hints );
-    PublicTransportInfoList results( m_publishedData[request.sourceName()] << newResults );
-    kDebug() << "Results:" << results;
 
     StopInfoList stops;
-    foreach( const PublicTransportInfoPtr &info, results ) {
-        stops << info.dynamicCast<StopInfo>();
+    stops.reserve( newResults.count() );
+    foreach( const PublicTransportInfo &info, newResults ) {
+        stops << StopInfo( info );
     }
 
     emit stopsReceived( this, url, stops, request );
@@ -535,32 +537,11 @@ void ServiceProviderScript::additionDataReady( const TimetableData &data,
     }
 }
 
-void ServiceProviderScript::jobStarted( ThreadWeaver::Job* job )
-{
-    ScriptJob *scriptJob = qobject_cast< ScriptJob* >( job );
-    Q_ASSERT( scriptJob );
-
-    // Warn if there is published data for the request,
-    // but not for additional data requests because they point to existing departure data sources.
-    // There may be multiple AdditionalDataJob requests for the same data source but different
-    // timetable items in the source.
-    if ( !qobject_cast<AdditionalDataJob*>(scriptJob) &&
-         m_publishedData.contains(scriptJob->request()->sourceName()) &&
-         !m_publishedData[scriptJob->request()->sourceName()].isEmpty() )
-    {
-        kWarning() << "Data source already exists for job"
-                   << scriptJob << scriptJob->request()->sourceName();
-    }
-}
-
 void ServiceProviderScript::jobDone( ThreadWeaver::Job* job )
 {
     ScriptJob *scriptJob = qobject_cast< ScriptJob* >( job );
     Q_ASSERT( scriptJob );
 
-    const QString sourceName = scriptJob->request()->sourceName();
-    PublicTransportInfoList results = m_publishedData.take( sourceName );
-
     m_runningJobs.removeOne( scriptJob );
     scriptJob->deleteLater();
 }
@@ -654,7 +635,6 @@ void ServiceProviderScript::requestMoreItems( const MoreItemsRequest &moreItemsR
 void ServiceProviderScript::enqueue( ScriptJob *job )
 {
     m_runningJobs << job;
-    connect( job, SIGNAL(started(ThreadWeaver::Job*)), this, SLOT(jobStarted(ThreadWeaver::Job*)) );
     connect( job, SIGNAL(done(ThreadWeaver::Job*)), this, SLOT(jobDone(ThreadWeaver::Job*)) );
     connect( job, SIGNAL(failed(ThreadWeaver::Job*)), this, SLOT(jobFailed(ThreadWeaver::Job*)) );
     ThreadWeaver::Weaver::instance()->enqueue( job );
@@ -223,9 +223,6 @@ protected slots:
                             const AdditionalDataRequest &request,
                             bool couldNeedForcedUpdate = false );
 
-    /** @brief A @p job was started. */
-    void jobStarted( ThreadWeaver::Job *job );
-
     /** @brief A @p job was done. */
     void jobDone( ThreadWeaver::Job *job );
 
@@ -258,7 +255,6 @@ private:
 
     ScriptState m_scriptState; // The state of the script
     QList<Enums::ProviderFeature> m_scriptFeatures; // Caches the features the script provides
-    QHash< QString, PublicTransportInfoList > m_publishedData;
 
     ScriptData m_scriptData;
     QSharedPointer< Storage > m_scriptStorage;
@@ -233,6 +233,18 @@ public:
     /** @brief Request more items for a data source. */
     virtual void requestMoreItems( const MoreItemsRequest &moreItemsRequest );
 
+    /**
+     * @brief Abort running requests for the data source @p sourceName, if supported.
+     *
+     * Gets called when the data source was removed. No ...Received() signal gets emitted for
+     * aborted requests. The default implementation does nothing.
+     * @return True, if a request for @p sourceName was aborted.
+     **/
+    virtual bool abortRequests( const QString &sourceName ) {
+        Q_UNUSED( sourceName );
+        return false;
+    };
+
     /** @brief Whether or not the city should be put into the "raw" url. */
     virtual bool useSeparateCityValue() const;
 
@@ -20,8 +20,40 @@
 #include "GeneralTransitTest.h"
 
 #include "gtfs/gtfsimporter.h"
+#include "gtfs/gtfsdatabase.h"
+#include "gtfs/gtfstimetablesnapshot.h"
+#include "gtfs/gtfsqueryjob.h"
+#include "request.h"
 #include <KGlobal>
+#include <ThreadWeaver/Weaver>
 #include <QtTest/QTest>
+#include <QtTest/QSignalSpy>
+#include <QEventLoop>
+#include <QTimer>
+#include <QSharedPointer>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QSqlError>
+#include <QStringList>
+#include <QDate>
+#include <QDateTime>
+#include <QFile>
+#include <QTime>
+
+Q_DECLARE_METATYPE( GtfsDatabase::Statement )
+
+/** @brief Enqueue @p job into the global ThreadWeaver queue and wait until it is done. */
+static bool runJob( GtfsQueryJob *job )
+{
+    // done() gets emitted in the thread of the job, quit() gets queued to the event loop
+    QEventLoop loop;
+    QObject::connect( job, SIGNAL(done(ThreadWeaver::Job*)), &loop, SLOT(quit()),
+                      Qt::QueuedConnection );
+    QTimer::singleShot( 10000, &loop, SLOT(quit()) );
+    ThreadWeaver::Weaver::instance()->enqueue( job );
+    loop.exec();
+    return job->isFinished();
+}
 
 void GeneralTransitTest::init()
 {
@@ -36,7 +68,8 @@ void GeneralTransitTest::cleanup()
 
 void GeneralTransitTest::initTestCase()
 {
-
+    // For the queued done() signal of jobs and for QSignalSpy
+    qRegisterMetaType< ThreadWeaver::Job* >( "ThreadWeaver::Job*" );
 }
 
 void GeneralTransitTest::cleanupTestCase()
@@ -57,5 +90,346 @@ void GeneralTransitTest::readGtfsDataTest()
     QCOMPARE( importer.hasError(), false );
 }
 
+void GeneralTransitTest::serviceDaysTest_data()
+{
+    QTest::addColumn< QString >( "serviceId" );
+    QTest::addColumn< QDate >( "date" );
+    QTest::addColumn< bool >( "available" );
+
+    // Services from calendar.txt and calendar_dates.txt of sample-feed.zip
+    QTest::newRow("Full week, first day") << "FULLW" << QDate(2007, 1, 1) << true;
+    QTest::newRow("Full week, removed day") << "FULLW" << QDate(2007, 6, 4) << false;
+    QTest::newRow("Full week, day after removed day") << "FULLW" << QDate(2007, 6, 5) << true;
+    QTest::newRow("Full week, last day") << "FULLW" << QDate(2010, 12, 31) << true;
+    QTest::newRow("Full week, before start date") << "FULLW" << QDate(2006, 12, 31) << false;
+    QTest::newRow("Full week, after end date") << "FULLW" << QDate(2011, 1, 1) << false;
+    QTest::newRow("Weekend, saturday") << "WE" << QDate(2007, 6, 2) << true;
+    QTest::newRow("Weekend, sunday") << "WE" << QDate(2007, 6, 3) << true;
+    QTest::newRow("Weekend, monday") << "WE" << QDate(2007, 6, 4) << false;
+}
+
+void GeneralTransitTest::serviceDaysTest()
+{
+    QFETCH( QString, serviceId );
+    QFETCH( QDate, date );
+    QFETCH( bool, available );
+
+    // Uses the database imported in readGtfsDataTest(), service IDs are stored as hash values
+    QSqlDatabase database = GtfsDatabase::database( "sample_gtfs" );
+    QVERIFY( database.isOpen() );
+    QSqlQuery query( database );
+    QVERIFY( query.prepare("SELECT first_day, days FROM service_days WHERE service_id=:id") );
+    query.bindValue( ":id", qHash(serviceId.toUtf8()) );
+    QVERIFY2( query.exec(), query.lastError().text().toUtf8() );
+    QVERIFY( query.next() );
+
+    const int day = date.toJulianDay() - query.value( 0 ).toInt();
+    const QString days = query.value( 1 ).toString();
+    QCOMPARE( day >= 0 && day < days.length() && days[day] == '1', available );
+}
+
+void GeneralTransitTest::timetableSnapshotTest_data()
+{
+    QTest::addColumn< QString >( "stopName" );
+    QTest::addColumn< bool >( "arrivals" );
+    QTest::addColumn< QDate >( "date" );
+    QTest::addColumn< QTime >( "time" );
+
+    QTest::newRow("Departures, weekday") << "Bullfrog (Demo)" << false
+            << QDate(2008, 1, 7) << QTime(0, 0);
+    QTest::newRow("Arrivals, weekday") << "Bullfrog (Demo)" << true
+            << QDate(2008, 1, 7) << QTime(0, 0);
+    QTest::newRow("Departures, weekend") << "Bullfrog (Demo)" << false
+            << QDate(2008, 1, 5) << QTime(8, 0);
+    QTest::newRow("Departures, removed service day") << "Nye County Airport (Demo)" << false
+            << QDate(2007, 6, 4) << QTime(0, 0);
+    QTest::newRow("Departures, outside of the feed dates") << "Bullfrog (Demo)" << false
+            << QDate(2012, 1, 2) << QTime(0, 0);
+}
+
+void GeneralTransitTest::timetableSnapshotTest()
+{
+    QFETCH( QString, stopName );
+    QFETCH( bool, arrivals );
+    QFETCH( QDate, date );
+    QFETCH( QTime, time );
+
+    // The snapshot gets written by the importer in readGtfsDataTest(),
+    // use the shared snapshot like GtfsQueryJob
+    const QSharedPointer< GtfsTimetableSnapshot > snapshot =
+            GtfsTimetableSnapshot::snapshot( "sample_gtfs" );
+    QVERIFY( snapshot );
+    const int stopIndex = snapshot->stopIndexByName( stopName );
+    QVERIFY( stopIndex >= 0 );
+    QCOMPARE( snapshot->stopIndex(snapshot->stopId(stopIndex)), stopIndex );
+
+    // Departures from the snapshot need to be the same as from the database
+    const int seconds = QTime(0, 0).secsTo( time );
+    QList< QSqlRecord > snapshotRecords =
+            snapshot->departures( stopIndex, date.toJulianDay(), seconds, 100, arrivals );
+    QString errorText;
+
+    QSqlDatabase database = GtfsDatabase::database( "sample_gtfs" );
+    QSqlQuery *query = GtfsDatabase::preparedQuery( arrivals ? GtfsDatabase::ArrivalsStatement
+            : GtfsDatabase::DeparturesStatement, database, &errorText );
+    QVERIFY2( query, errorText.toUtf8() );
+    query->bindValue( ":stopId", snapshot->stopId(stopIndex) );
+    query->bindValue( ":day", date.toJulianDay() );
+    query->bindValue( ":time", seconds );
+    query->bindValue( ":count", 100 );
+    QVERIFY2( query->exec(), query->lastError().text().toUtf8() );
+    QList< QSqlRecord > databaseRecords;
+    while ( query->next() ) {
+        databaseRecords << query->record();
+    }
+    query->finish();
+
+    QCOMPARE( snapshotRecords.count(), databaseRecords.count() );
+    const QStringList columns = QStringList() << "departure_time" << "arrival_time" << "trip_id"
+            << "route_id" << "route_short_name" << "trip_headsign" << "stop_sequence"
+            << "route_stops" << "route_times";
+    for ( int i = 0; i < snapshotRecords.count(); ++i ) {
+        foreach ( const QString &column, columns ) {
+            QCOMPARE( snapshotRecords[i].value(column).toString(),
+                      databaseRecords[i].value(column).toString() );
+        }
+    }
+}
+
+void GeneralTransitTest::timetableSnapshotReloadTest()
+{
+    // The shared snapshot gets reused until the snapshot file gets written again
+    const QSharedPointer< GtfsTimetableSnapshot > snapshot =
+            GtfsTimetableSnapshot::snapshot( "sample_gtfs" );
+    QVERIFY( snapshot );
+    QCOMPARE( GtfsTimetableSnapshot::snapshot("sample_gtfs"), snapshot );
+
+    // Write the snapshot again, most probably in the same second as the last import,
+    // the modification time of the file does not need to change
+    QString errorText;
+    QVERIFY2( GtfsTimetableSnapshot::write(GtfsTimetableSnapshot::snapshotPath("sample_gtfs"),
+                                           GtfsDatabase::database("sample_gtfs"), &errorText),
+              errorText.toUtf8() );
+    const QSharedPointer< GtfsTimetableSnapshot > newSnapshot =
+            GtfsTimetableSnapshot::snapshot( "sample_gtfs" );
+    QVERIFY( newSnapshot );
+    QVERIFY( newSnapshot != snapshot );
+    QCOMPARE( newSnapshot->stopCount(), snapshot->stopCount() );
+    QCOMPARE( newSnapshot->tripCount(), snapshot->tripCount() );
+}
+
+void GeneralTransitTest::timetableSnapshotValidationTest()
+{
+    const QString fileName = GtfsTimetableSnapshot::snapshotPath( "sample_gtfs" );
+    QFile file( fileName );
+    QVERIFY( file.open(QIODevice::ReadOnly) );
+    const QByteArray data = file.readAll();
+    file.close();
+
+    // Change one byte of the data, the checksum does not match
+    const QString corruptedFileName = fileName + ".corrupted";
+    QByteArray corruptedData = data;
+    corruptedData[ corruptedData.size() - 1 ] = corruptedData[corruptedData.size() - 1] ^ 0xff;
+    QFile corruptedFile( corruptedFileName );
+    QVERIFY( corruptedFile.open(QIODevice::WriteOnly) );
+    corruptedFile.write( corruptedData );
+    corruptedFile.close();
+
+    GtfsTimetableSnapshot snapshot;
+    QVERIFY( !snapshot.open(corruptedFileName) );
+    QVERIFY( !snapshot.isValid() );
+
+    // Truncate the file
+    QVERIFY( corruptedFile.open(QIODevice::WriteOnly | QIODevice::Truncate) );
+    corruptedFile.write( data.left(data.size() / 2) );
+    corruptedFile.close();
+    QVERIFY( !snapshot.open(corruptedFileName) );
+
+    // Write a wrong version, the version is stored after the magic number
+    corruptedData = data;
+    const quint32 version = GtfsTimetableSnapshot::VERSION + 1;
+    corruptedData.replace( sizeof(quint32), sizeof(quint32),
+                           reinterpret_cast<const char*>(&version), sizeof(quint32) );
+    QVERIFY( corruptedFile.open(QIODevice::WriteOnly | QIODevice::Truncate) );
+    corruptedFile.write( corruptedData );
+    corruptedFile.close();
+    QVERIFY( !snapshot.open(corruptedFileName) );
+
+    QFile::remove( corruptedFileName );
+    QVERIFY( snapshot.open(fileName) );
+    QVERIFY( snapshot.stopCount() > 0 );
+    QVERIFY( snapshot.tripCount() > 0 );
+    QVERIFY( snapshot.hasFrequencies() );
+}
+
+void GeneralTransitTest::queryPlanTest_data()
+{
+    QTest::addColumn< GtfsDatabase::Statement >( "statement" );
+    QTest::addColumn< QStringList >( "expectedPlanDetails" );
+
+    // Only test hot queries, stop suggestions need to scan all stops anyway
+    // because of "LIKE '%...%'"
+    QTest::newRow("Stop ID") << GtfsDatabase::StopIdStatement
+            << (QStringList() << "USING INDEX stops_stop_name (stop_name=?)");
+    QTest::newRow("Departures") << GtfsDatabase::DeparturesStatement
+            << (QStringList()
+                << "USING INDEX sqlite_autoindex_stop_times_1 (stop_id=? AND departure_time>?)"
+                << "USING INDEX stop_times_trip (trip_id=? AND stop_sequence>?)"
+                << "service_days USING INTEGER PRIMARY KEY (rowid=?)");
+    QTest::newRow("Arrivals") << GtfsDatabase::ArrivalsStatement
+            << (QStringList()
+                << "USING INDEX sqlite_autoindex_stop_times_1 (stop_id=? AND departure_time>?)"
+                << "USING INDEX stop_times_trip (trip_id=? AND stop_sequence<?)"
+                << "service_days USING INTEGER PRIMARY KEY (rowid=?)");
+    QTest::newRow("Frequency departures") << GtfsDatabase::FrequencyDeparturesStatement
+            << (QStringList()
+                << "USING INDEX sqlite_autoindex_stop_times_1 (stop_id=?)"
+                << "frequencies USING INDEX sqlite_autoindex_frequencies_1 (trip_id=?)"
+                << "first_times USING INDEX stop_times_trip (trip_id=?)");
+    QTest::newRow("Frequency arrivals") << GtfsDatabase::FrequencyArrivalsStatement
+            << (QStringList()
+                << "USING INDEX sqlite_autoindex_stop_times_1 (stop_id=?)"
+                << "frequencies USING INDEX sqlite_autoindex_frequencies_1 (trip_id=?)"
+                << "USING INDEX stop_times_trip (trip_id=? AND stop_sequence<?)");
+}
+
+void GeneralTransitTest::queryPlanTest()
+{
+    QFETCH( GtfsDatabase::Statement, statement );
+    QFETCH( QStringList, expectedPlanDetails );
+
+    // Uses the database imported in readGtfsDataTest()
+    QSqlDatabase database = GtfsDatabase::database( "sample_gtfs" );
+    QVERIFY( database.isOpen() );
+
+    // Test that the statement can be prepared and is cached
+    QString errorText;
+    QSqlQuery *query = GtfsDatabase::preparedQuery( statement, database, &errorText );
+    QVERIFY2( query, errorText.toUtf8() );
+    QCOMPARE( GtfsDatabase::preparedQuery(statement, database), query );
+
+    // Get the query plan, the last column contains the plan details
+    QSqlQuery planQuery( database );
+    QVERIFY2( planQuery.prepare("EXPLAIN QUERY PLAN " + GtfsDatabase::statementSql(statement)),
+              planQuery.lastError().text().toUtf8() );
+    const QStringList placeholders = QStringList() << ":stopName" << ":stopId" << ":day"
+            << ":time" << ":count";
+    foreach ( const QString &placeholder, placeholders ) {
+        if ( GtfsDatabase::statementSql(statement).contains(placeholder) ) {
+            planQuery.bindValue( placeholder, 1 );
+        }
+    }
+    QVERIFY2( planQuery.exec(), planQuery.lastError().text().toUtf8() );
+
+    QStringList planDetails;
+    while ( planQuery.next() ) {
+        planDetails << planQuery.value( planQuery.record().count() - 1 ).toString();
+    }
+    const QString plan = planDetails.join( "\n" );
+
+    // Fail if a hot query stops using it's index, ie. if a table gets scanned
+    foreach ( const QString &expectedPlanDetail, expectedPlanDetails ) {
+        QVERIFY2( plan.contains(expectedPlanDetail),
+                  QString("Index not used: %1\nQuery plan:\n%2")
+                  .arg(expectedPlanDetail).arg(plan).toUtf8() );
+    }
+    foreach ( const QString &planDetail, planDetails ) {
+        QVERIFY2( !planDetail.startsWith(QLatin1String("SCAN")),
+                  QString("Table scan in query plan:\n%1").arg(plan).toUtf8() );
+    }
+}
+
+void GeneralTransitTest::queryJobTest_data()
+{
+    QTest::addColumn< QString >( "requestType" );
+    QTest::addColumn< QString >( "stop" );
+    QTest::addColumn< QDateTime >( "dateTime" );
+    QTest::addColumn< bool >( "success" );
+    QTest::addColumn< bool >( "hasRecords" );
+
+    const QDateTime weekday( QDate(2008, 1, 7), QTime(0, 0) );
+    QTest::newRow("Departures") << "departures" << "Bullfrog (Demo)" << weekday << true << true;
+    QTest::newRow("Arrivals") << "arrivals" << "Bullfrog (Demo)" << weekday << true << true;
+    QTest::newRow("Stop suggestions") << "stopSuggestions" << "Demo" << QDateTime()
+            << true << true;
+
+    // Successful queries without results, ServiceProviderGtfs emits empty lists for them
+    QTest::newRow("Departures, outside of the feed dates") << "departures" << "Bullfrog (Demo)"
+            << QDateTime(QDate(2012, 1, 2), QTime(0, 0)) << true << false;
+    QTest::newRow("Stop suggestions, no matching stop") << "stopSuggestions"
+            << "No Such Stop" << QDateTime() << true << false;
+
+    // Failing queries, ServiceProviderGtfs emits requestFailed() for them
+    QTest::newRow("Departures, unknown stop") << "departures" << "No Such Stop" << weekday
+            << false << false;
+}
+
+void GeneralTransitTest::queryJobTest()
+{
+    QFETCH( QString, requestType );
+    QFETCH( QString, stop );
+    QFETCH( QDateTime, dateTime );
+    QFETCH( bool, success );
+    QFETCH( bool, hasRecords );
+
+    QSharedPointer< AbstractRequest > request;
+    if ( requestType == "stopSuggestions" ) {
+        request = QSharedPointer< AbstractRequest >(
+                new StopSuggestionRequest("GTFS Test", stop, 10) );
+    } else if ( requestType == "arrivals" ) {
+        request = QSharedPointer< AbstractRequest >(
+                new ArrivalRequest("GTFS Test", stop, dateTime, 10) );
+    } else {
+        request = QSharedPointer< AbstractRequest >(
+                new DepartureRequest("GTFS Test", stop, dateTime, 10) );
+    }
+
+    // Run the job in a thread of ThreadWeaver like ServiceProviderGtfs does,
+    // uses the database imported in readGtfsDataTest()
+    GtfsQueryJob job( "sample_gtfs", request.data() );
+    QVERIFY( runJob(&job) );
+    QVERIFY( !job.isAborted() );
+    QVERIFY2( job.success() == success, job.errorString().toUtf8() );
+    QCOMPARE( !job.records().isEmpty(), hasRecords );
+    QCOMPARE( job.errorString().isEmpty(), success );
+    QVERIFY( job.records().count() <= 10 );
+}
+
+void GeneralTransitTest::queryJobAbortTest()
+{
+    // Abort a job before it gets started, like ServiceProviderGtfs::abortRequests() does for
+    // running jobs. The job is done without reading records and without success
+    const DepartureRequest request( "GTFS Test", "Bullfrog (Demo)",
+                                    QDateTime(QDate(2008, 1, 7), QTime(0, 0)), 10 );
+    GtfsQueryJob job( "sample_gtfs", &request );
+    job.requestAbort();
+    QVERIFY( job.isAborted() );
+    QVERIFY( runJob(&job) );
+    QVERIFY( job.isAborted() );
+    QVERIFY( !job.success() );
+    QVERIFY( job.records().isEmpty() );
+}
+
+void GeneralTransitTest::queryJobDequeueTest()
+{
+    // Remove a job that was not started yet from the queue,
+    // like ServiceProviderGtfs::abortRequests() does. done() does not get emitted
+    const DepartureRequest request( "GTFS Test", "Bullfrog (Demo)",
+                                    QDateTime(QDate(2008, 1, 7), QTime(0, 0)), 10 );
+    GtfsQueryJob job( "sample_gtfs", &request );
+    QSignalSpy doneSpy( &job, SIGNAL(done(ThreadWeaver::Job*)) );
+    ThreadWeaver::Weaver *weaver = ThreadWeaver::Weaver::instance();
+    weaver->suspend();
+    weaver->enqueue( &job );
+    QVERIFY( weaver->dequeue(&job) );
+    weaver->resume();
+    weaver->finish();
+
+    QCOMPARE( doneSpy.count(), 0 );
+    QVERIFY( !job.isFinished() );
+    QVERIFY( !job.success() );
+    QVERIFY( job.records().isEmpty() );
+}
+
 QTEST_MAIN(GeneralTransitTest)
 #include "GeneralTransitTest.moc"
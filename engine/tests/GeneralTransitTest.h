@@ -33,6 +33,22 @@ private slots:
     void cleanupTestCase();
 
     void readGtfsDataTest();
+
+    void serviceDaysTest_data();
+    void serviceDaysTest();
+
+    void timetableSnapshotTest_data();
+    void timetableSnapshotTest();
+    void timetableSnapshotReloadTest();
+    void timetableSnapshotValidationTest();
+
+    void queryPlanTest_data();
+    void queryPlanTest();
+
+    void queryJobTest_data();
+    void queryJobTest();
+    void queryJobAbortTest();
+    void queryJobDequeueTest();
 };
 
 #endif // GeneralTransitTest_H
@@ -0,0 +1,734 @@
+/*
+ *   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// Header
+#include "ProviderBenchmark.h"
+
+// Own includes
+#include "global.h"
+#include "request.h"
+#include "departureinfo.h"
+#include "serviceproviderdata.h"
+#include "serviceproviderdatareader.h"
+#include "script/scriptobjects.h"
+#include "script/script_thread.h"
+#include "script/networkreplay.h"
+#ifdef BUILD_PROVIDER_TYPE_GTFS
+    #include "gtfs/gtfsimporter.h"
+    #include "gtfs/gtfsqueryjob.h"
+    #include "gtfs/gtfsdatabase.h"
+#endif
+
+// KDE includes
+#include <KAboutData>
+#include <KCmdLineArgs>
+#include <KComponentData>
+#include <KLocalizedString>
+#include <KDebug>
+
+// Qt includes
+#include <QCoreApplication>
+#include <QThreadPool>
+#include <QTextStream>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <qmath.h>
+
+// System includes
+#include <time.h>
+#include <cstdlib>
+#include <new>
+
+// Count calls to operator new per thread, to report allocations per phase.
+// Allocations done by Qt containers using qMalloc() directly are not counted.
+static __thread quint64 s_allocations = 0;
+
+void *operator new( size_t size ) throw(std::bad_alloc)
+{
+    ++s_allocations;
+    void *pointer = std::malloc( size == 0 ? 1 : size );
+    if ( !pointer ) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void *operator new[]( size_t size ) throw(std::bad_alloc)
+{
+    return operator new( size );
+}
+
+void operator delete( void *pointer ) throw()
+{
+    std::free( pointer );
+}
+
+void operator delete[]( void *pointer ) throw()
+{
+    std::free( pointer );
+}
+
+/** @brief Get the CPU time used by the current thread in microseconds. */
+static qint64 threadCpuTime( clockid_t clock = CLOCK_THREAD_CPUTIME_ID )
+{
+    timespec time;
+    clock_gettime( clock, &time );
+    return qint64(time.tv_sec) * 1000000 + time.tv_nsec / 1000;
+}
+
+void PhaseMeter::start()
+{
+    m_timer.start();
+    m_cpuTime = threadCpuTime();
+    m_allocations = s_allocations;
+}
+
+PhaseSample PhaseMeter::stop() const
+{
+    PhaseSample sample;
+    sample.wallTime = m_timer.nsecsElapsed() / 1000;
+    sample.cpuTime = threadCpuTime() - m_cpuTime;
+    sample.allocations = s_allocations - m_allocations;
+    sample.measured = true;
+    return sample;
+}
+
+DownloadMonitor::DownloadMonitor( Network *network )
+        : QObject(network), m_downloadTime(0)
+{
+    m_timer.start();
+    connect( network, SIGNAL(requestStarted(NetworkRequest::Ptr)),
+             this, SLOT(requestStarted(NetworkRequest::Ptr)) );
+    connect( network,
+             SIGNAL(requestFinished(NetworkRequest::Ptr,QByteArray,bool,QString,QDateTime,int,int)),
+             this,
+             SLOT(requestFinished(NetworkRequest::Ptr,QByteArray,bool,QString,QDateTime,int,int)) );
+    connect( network, SIGNAL(synchronousRequestFinished(QString,QByteArray,bool,int,int,int)),
+             this, SLOT(synchronousRequestFinished(QString,QByteArray,bool,int,int,int)) );
+}
+
+void DownloadMonitor::requestStarted( const NetworkRequest::Ptr &request )
+{
+    m_started.insert( request.data(), m_timer.nsecsElapsed() / 1000 );
+}
+
+void DownloadMonitor::requestFinished( const NetworkRequest::Ptr &request, const QByteArray &data,
+                                       bool error, const QString &errorString,
+                                       const QDateTime &timestamp, int statusCode, int size )
+{
+    Q_UNUSED( data );
+    Q_UNUSED( error );
+    Q_UNUSED( errorString );
+    Q_UNUSED( timestamp );
+    Q_UNUSED( statusCode );
+    Q_UNUSED( size );
+    if ( m_started.contains(request.data()) ) {
+        m_downloadTime += m_timer.nsecsElapsed() / 1000 - m_started.take( request.data() );
+    }
+}
+
+void DownloadMonitor::synchronousRequestFinished( const QString &url, const QByteArray &data,
+                                                  bool cancelled, int statusCode, int waitTime,
+                                                  int size )
+{
+    Q_UNUSED( url );
+    Q_UNUSED( data );
+    Q_UNUSED( cancelled );
+    Q_UNUSED( statusCode );
+    Q_UNUSED( size );
+    m_downloadTime += qint64(waitTime) * 1000;
+}
+
+BenchmarkResults::BenchmarkResults() : m_items(0)
+{
+}
+
+void BenchmarkResults::addSamples( const PhaseSample samples[BenchmarkPhaseCount], int items )
+{
+    QMutexLocker locker( &m_mutex );
+    for ( int phase = 0; phase < BenchmarkPhaseCount; ++phase ) {
+        if ( samples[phase].measured ) {
+            m_samples[ phase ] << samples[ phase ];
+        }
+    }
+    m_items += items;
+}
+
+void BenchmarkResults::addError( const QString &errorMessage )
+{
+    QMutexLocker locker( &m_mutex );
+    m_errors << errorMessage;
+}
+
+static bool wallTimeLessThan( const PhaseSample &sample1, const PhaseSample &sample2 )
+{
+    return sample1.wallTime < sample2.wallTime;
+}
+
+/** @brief Get the wall time in milliseconds at the given @p percentile of sorted @p samples. */
+static qreal percentile( const QVector< PhaseSample > &samples, qreal percentile )
+{
+    if ( samples.isEmpty() ) {
+        return 0.0;
+    }
+    const int index = qBound( 0, qCeil(percentile * samples.count()) - 1, samples.count() - 1 );
+    return samples[ index ].wallTime / 1000.0;
+}
+
+void BenchmarkResults::printReport( const QString &title ) const
+{
+    QMutexLocker locker( &m_mutex );
+    const char *phaseNames[ BenchmarkPhaseCount ] = {
+            "download", "script eval", "parse", "dataList()", "publish", "query", "total" };
+
+    QTextStream out( stdout );
+    const int requests = m_samples[ TotalPhase ].count();
+    out << title << '\n'
+        << requests << " requests, " << m_errors.count() << " errors, "
+        << m_items << " items\n\n";
+    out << qSetFieldWidth(14) << left << "Phase" << right
+        << "p50 [ms]" << "p99 [ms]" << "CPU [ms]" << "Allocations" << qSetFieldWidth(0) << '\n';
+    out.setRealNumberPrecision( 2 );
+    out.setRealNumberNotation( QTextStream::FixedNotation );
+
+    for ( int phase = 0; phase < BenchmarkPhaseCount; ++phase ) {
+        if ( phase == DownloadPhase || m_samples[phase].isEmpty() ) {
+            // Downloads are reported below the table, phases the provider type does not use
+            // (eg. the query phase for scripted providers) get skipped
+            continue;
+        }
+
+        QVector< PhaseSample > samples = m_samples[ phase ];
+        qSort( samples.begin(), samples.end(), wallTimeLessThan );
+
+        qint64 cpuTime = 0;
+        quint64 allocations = 0;
+        foreach ( const PhaseSample &sample, samples ) {
+            cpuTime += sample.cpuTime;
+            allocations += sample.allocations;
+        }
+
+        out << qSetFieldWidth(14) << left << phaseNames[phase] << right
+            << percentile(samples, 0.5) << percentile(samples, 0.99)
+            << (cpuTime / 1000.0 / samples.count()) << (allocations / samples.count())
+            << qSetFieldWidth(0) << '\n';
+    }
+
+    // Only the wall time of downloads can be measured, the CPU time and allocations used
+    // to process network replies are included in the parse phase
+    QVector< PhaseSample > downloads = m_samples[ DownloadPhase ];
+    if ( !downloads.isEmpty() ) {
+        qSort( downloads.begin(), downloads.end(), wallTimeLessThan );
+        out << "\nDownloads (wall time, already subtracted from the parse phase): p50 "
+            << percentile(downloads, 0.5) << " ms, p99 " << percentile(downloads, 0.99)
+            << " ms\n";
+    }
+
+    if ( !m_errors.isEmpty() ) {
+        out << "\nErrors:\n";
+        foreach ( const QString &error, m_errors.toSet() ) {
+            out << "  " << m_errors.count(error) << "x " << error << '\n';
+        }
+    }
+    out << '\n';
+}
+
+/** @brief Add values of @p other to @p sample. */
+static void addSample( PhaseSample *sample, const PhaseSample &other )
+{
+    sample->wallTime += other.wallTime;
+    sample->cpuTime += other.cpuTime;
+    sample->allocations += other.allocations;
+    sample->measured = true;
+}
+
+ScriptJobMeter::ScriptJobMeter( const ServiceProviderData *provider, ParseDocumentMode parseMode,
+                                const QString &fixtureDir, bool record, int latency )
+        : QObject(), m_provider(provider), m_parseMode(parseMode), m_fixtureDir(fixtureDir),
+          m_record(record), m_latency(latency), m_monitor(0), m_items(0)
+{
+}
+
+void ScriptJobMeter::connectJob( ScriptJob *job )
+{
+    // Connect directly to process the results in the thread of the job while it is running,
+    // ServiceProviderScript processes them in the main thread
+    const char *dataSlot = SLOT(dataReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo));
+    connect( job, SIGNAL(departuresReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,DepartureRequest,bool)),
+             this, dataSlot, Qt::DirectConnection );
+    connect( job, SIGNAL(arrivalsReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,ArrivalRequest,bool)),
+             this, dataSlot, Qt::DirectConnection );
+    connect( job, SIGNAL(journeysReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,JourneyRequest,bool)),
+             this, dataSlot, Qt::DirectConnection );
+    connect( job, SIGNAL(stopSuggestionsReady(QList<TimetableData>,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,StopSuggestionRequest,bool)),
+             this, dataSlot, Qt::DirectConnection );
+    connect( job, SIGNAL(additionalDataReady(TimetableData,ResultObject::Features,ResultObject::Hints,QString,GlobalTimetableInfo,AdditionalDataRequest,bool)),
+             this, SLOT(additionalDataReady(TimetableData,ResultObject::Features,ResultObject::Hints)),
+             Qt::DirectConnection );
+}
+
+void ScriptJobMeter::objectsCreated( Network *network )
+{
+    if ( m_record ) {
+        new NetworkRecorder( m_fixtureDir, network );
+    } else {
+        network->setNetworkAccessManager(
+                new ReplayNetworkAccessManager(m_fixtureDir, m_latency) );
+    }
+
+    // The job deletes the network object when it is done, keep the monitor to read it's results
+    m_monitor = new DownloadMonitor( network );
+    m_monitor->setParent( this );
+}
+
+void ScriptJobMeter::scriptLoaded()
+{
+    m_samples[ ScriptEvalPhase ] = m_meter.stop();
+    m_meter.start();
+}
+
+void ScriptJobMeter::dataReady( const QList<TimetableData> &data,
+                                ResultObject::Features features, ResultObject::Hints hints,
+                                const QString &url, const GlobalTimetableInfo &globalInfo )
+{
+    Q_UNUSED( url );
+
+    // The script published results, the parse phase continues if it publishes more results
+    addSample( &m_samples[ParsePhase], m_meter.stop() );
+
+    // Create PublicTransportInfo objects like ServiceProviderScript
+    PhaseMeter meter;
+    PublicTransportInfoList infoList;
+    ResultObject::dataList( data, &infoList, m_parseMode, m_provider->defaultVehicleType(),
+                            &globalInfo, features, hints );
+    addSample( &m_samples[DataListPhase], meter.stop() );
+
+    // Convert the items for data sources like PublicTransportEngine
+    meter.start();
+    QVariantList publishedItems;
+    publishedItems.reserve( infoList.count() );
+    foreach ( const PublicTransportInfo &info, infoList ) {
+        publishedItems << info.toVariantHash();
+    }
+    addSample( &m_samples[PublishPhase], meter.stop() );
+
+    m_items += publishedItems.count();
+    m_meter.start();
+}
+
+void ScriptJobMeter::additionalDataReady( const TimetableData &data,
+                                          ResultObject::Features features,
+                                          ResultObject::Hints hints )
+{
+    Q_UNUSED( features );
+    Q_UNUSED( hints );
+    addSample( &m_samples[ParsePhase], m_meter.stop() );
+
+    // Additional data does not get post-processed using dataList(),
+    // convert it for data sources like PublicTransportEngine
+    PhaseMeter meter;
+    QVariantHash additionalData;
+    for ( TimetableData::ConstIterator it = data.constBegin(); it != data.constEnd(); ++it ) {
+        additionalData.insert( Global::timetableInformationToString(it.key()), it.value() );
+    }
+    addSample( &m_samples[PublishPhase], meter.stop() );
+
+    if ( !additionalData.isEmpty() ) {
+        ++m_items;
+    }
+    m_meter.start();
+}
+
+bool ScriptJobMeter::finish( PhaseSample samples[BenchmarkPhaseCount], int *items,
+                             QString *errorMessage )
+{
+    if ( m_items == 0 ) {
+        *errorMessage = "The script did not return any results";
+        return false;
+    }
+
+    for ( int phase = 0; phase < BenchmarkPhaseCount; ++phase ) {
+        samples[ phase ] = m_samples[ phase ];
+    }
+
+    // Downloads are measured separately, only wall time of the parse phase is corrected
+    if ( m_monitor ) {
+        samples[ DownloadPhase ].wallTime = m_monitor->downloadTime();
+        samples[ DownloadPhase ].measured = true;
+        samples[ ParsePhase ].wallTime =
+                qMax( qint64(0), samples[ParsePhase].wallTime - m_monitor->downloadTime() );
+    }
+
+    samples[ TotalPhase ] = m_totalMeter.stop();
+    *items = m_items;
+    return true;
+}
+
+/**
+ * @brief A script job of type @p Job, which gets run directly in the current thread.
+ *
+ * The hooks of ScriptJob get forwarded to a ScriptJobMeter.
+ **/
+template< class Job, class Request >
+class BenchmarkScriptJob : public Job {
+public:
+    BenchmarkScriptJob( const ScriptData &data, const QSharedPointer< Storage > &storage,
+                        const Request &request, ScriptJobMeter *meter )
+            : Job(data, storage, request), m_meter(meter)
+    {
+        meter->connectJob( this );
+    };
+
+    /** @brief Run the job in the current thread instead of a thread of ThreadWeaver. */
+    void runInCurrentThread() { this->run(); };
+
+protected:
+    virtual void scriptObjectsCreated() {
+        m_meter->objectsCreated( this->m_objects.network.data() );
+    };
+
+    virtual void scriptLoaded() { m_meter->scriptLoaded(); };
+
+private:
+    ScriptJobMeter *m_meter;
+};
+
+/** @brief Run a BenchmarkScriptJob of type @p Job for @p request in the current thread. */
+template< class Job, class Request >
+static bool runScriptJob( const ScriptData &data, const QSharedPointer< Storage > &storage,
+                          const AbstractRequest *request, ScriptJobMeter *meter,
+                          QString *errorMessage )
+{
+    BenchmarkScriptJob< Job, Request > job( data, storage,
+                                             *dynamic_cast<const Request*>(request), meter );
+    job.runInCurrentThread();
+    if ( !job.success() ) {
+        *errorMessage = job.errorString();
+        return false;
+    }
+    return true;
+}
+
+BenchmarkTask::BenchmarkTask( const ServiceProviderData *provider, const QScriptProgram &program,
+                              const QSharedPointer< Storage > &storage,
+                              const AbstractRequest *request, BenchmarkResults *results,
+                              const QString &fixtureDir, bool record, int latency )
+        : m_provider(provider), m_program(program), m_storage(storage),
+          m_request(request->clone()), m_results(results), m_fixtureDir(fixtureDir),
+          m_record(record), m_latency(latency)
+{
+}
+
+BenchmarkTask::~BenchmarkTask()
+{
+    delete m_request;
+}
+
+void BenchmarkTask::run()
+{
+    PhaseSample samples[ BenchmarkPhaseCount ];
+    int items = 0;
+    QString errorMessage;
+    const bool success = m_provider->type() == Enums::GtfsProvider
+            ? runGtfsQuery(samples, &items, &errorMessage)
+            : runScript(samples, &items, &errorMessage);
+    if ( success ) {
+        m_results->addSamples( samples, items );
+    } else {
+        m_results->addError( errorMessage );
+    }
+}
+
+bool BenchmarkTask::runScript( PhaseSample samples[BenchmarkPhaseCount], int *items,
+                               QString *errorMessage )
+{
+    // Run the same job as ServiceProviderScript for the request
+    ScriptJobMeter meter( m_provider, m_request->parseMode(), m_fixtureDir, m_record, m_latency );
+    const ScriptData data( m_provider, m_program );
+    bool success;
+    switch ( m_request->parseMode() ) {
+    case ParseForDepartures:
+        success = runScriptJob< DepartureJob, DepartureRequest >(
+                data, m_storage, m_request, &meter, errorMessage );
+        break;
+    case ParseForArrivals:
+        success = runScriptJob< ArrivalJob, ArrivalRequest >(
+                data, m_storage, m_request, &meter, errorMessage );
+        break;
+    case ParseForJourneysByDepartureTime:
+    case ParseForJourneysByArrivalTime:
+        success = runScriptJob< JourneyJob, JourneyRequest >(
+                data, m_storage, m_request, &meter, errorMessage );
+        break;
+    case ParseForStopSuggestions:
+        success = runScriptJob< StopSuggestionsJob, StopSuggestionRequest >(
+                data, m_storage, m_request, &meter, errorMessage );
+        break;
+    case ParseForAdditionalData:
+        success = runScriptJob< AdditionalDataJob, AdditionalDataRequest >(
+                data, m_storage, m_request, &meter, errorMessage );
+        break;
+    default:
+        *errorMessage = "Unknown parse mode";
+        return false;
+    }
+
+    // The job deletes it's script engine using deleteLater(),
+    // but threads of the pool do not run an event loop
+    QCoreApplication::sendPostedEvents( 0, QEvent::DeferredDelete );
+
+    return success && meter.finish( samples, items, errorMessage );
+}
+
+#ifdef BUILD_PROVIDER_TYPE_GTFS
+/** @brief A GtfsQueryJob, which gets run directly in the current thread. */
+class BenchmarkGtfsQueryJob : public GtfsQueryJob {
+public:
+    BenchmarkGtfsQueryJob( const QString &providerId, const AbstractRequest *request )
+            : GtfsQueryJob(providerId, request) {};
+
+    /** @brief Run the job in the current thread instead of a thread of ThreadWeaver. */
+    void runInCurrentThread() { run(); };
+};
+
+bool BenchmarkTask::runGtfsQuery( PhaseSample samples[BenchmarkPhaseCount], int *items,
+                                  QString *errorMessage )
+{
+    // Run the same job as ServiceProviderGtfs for the request. The records get converted to
+    // timetable items by ServiceProviderGtfs, which can only be created by the data engine
+    const PhaseMeter totalMeter;
+    BenchmarkGtfsQueryJob job( m_provider->id(), m_request );
+    job.runInCurrentThread();
+    samples[ QueryPhase ] = totalMeter.stop();
+    if ( !job.success() ) {
+        *errorMessage = job.errorString();
+        return false;
+    } else if ( job.records().isEmpty() ) {
+        *errorMessage = "The database query did not return any results";
+        return false;
+    }
+
+    *items = job.records().count();
+    samples[ TotalPhase ] = totalMeter.stop();
+    return true;
+}
+#else
+bool BenchmarkTask::runGtfsQuery( PhaseSample samples[BenchmarkPhaseCount], int *items,
+                                  QString *errorMessage )
+{
+    Q_UNUSED( samples );
+    Q_UNUSED( items );
+    *errorMessage = "Built without GTFS support";
+    return false;
+}
+#endif
+
+#ifdef BUILD_PROVIDER_TYPE_GTFS
+/** @brief Import the GTFS feed at @p fileName into a separate database and print timings. */
+static int benchmarkGtfsImport( const QString &providerId, const QString &fileName )
+{
+    // Use a separate database to not touch the database of the provider
+    const QString databaseName = "benchmark_" + providerId;
+    const qint64 cpuTime = threadCpuTime( CLOCK_PROCESS_CPUTIME_ID );
+    QElapsedTimer timer;
+    timer.start();
+
+    GtfsImporter importer( databaseName );
+    importer.startImport( fileName );
+    importer.wait();
+
+    QTextStream out( stdout );
+    out.setRealNumberPrecision( 2 );
+    out.setRealNumberNotation( QTextStream::FixedNotation );
+    out << "GTFS import of " << fileName << " into " << databaseName << '\n'
+        << "Wall time: " << (timer.nsecsElapsed() / 1000000.0) << " ms\n"
+        << "Process CPU time: "
+        << ((threadCpuTime(CLOCK_PROCESS_CPUTIME_ID) - cpuTime) / 1000.0) << " ms\n";
+    if ( importer.hasError() ) {
+        out << "Error: " << importer.lastError() << '\n';
+        return 1;
+    }
+    return 0;
+}
+#endif
+
+static const char description[] =
+    I18N_NOOP("Benchmarks service providers of the PublicTransport data engine without "
+              "a running Plasma shell, replaying recorded network replies. "
+              "Use the same --datetime when recording and replaying, because the "
+              "requested time is usually part of the requested URLs. "
+              "For GTFS providers the database queries get benchmarked, the GTFS feed "
+              "needs to be imported by the data engine before.");
+
+int main( int argc, char **argv )
+{
+    KAboutData about( "providerbenchmark", 0, ki18n("Provider Benchmark"), "0.1",
+                      ki18n(description), KAboutData::License_GPL_V2,
+                      ki18n("© 2012 Friedrich Pülz"), KLocalizedString(), 0,
+                      "fpuelz@gmx.de" );
+    KCmdLineArgs::init( argc, argv, &about );
+
+    KCmdLineOptions options;
+    options.add( "+provider", ki18n("The ID of the service provider to benchmark") );
+    options.add( "mode <mode>", ki18n("The request to benchmark: departures, arrivals, journeys, "
+                                      "stopsuggestions or additionaldata"), "departures" );
+    options.add( "stop <name>", ki18n("The stop name to use for requests") );
+    options.add( "target <name>", ki18n("The target stop for journeys or the target of the "
+                                        "departure to get additional data for") );
+    options.add( "line <name>", ki18n("The transport line of the departure to get additional "
+                                      "data for") );
+    options.add( "city <name>", ki18n("The city to use for requests") );
+    options.add( "count <count>", ki18n("The number of items to request"), "20" );
+    options.add( "datetime <datetime>", ki18n("The date and time to use for requests in ISO "
+                                              "format, the current time by default") );
+    options.add( "iterations <count>", ki18n("The number of measured requests"), "10" );
+    options.add( "warmup <count>", ki18n("The number of requests before measuring"), "1" );
+    options.add( "concurrency <count>", ki18n("The number of requests running in parallel"),
+                 "1" );
+    options.add( "fixtures <dir>", ki18n("The directory containing recorded replies, "
+                                         "not used for GTFS providers") );
+    options.add( "record", ki18n("Use the network and record replies into the fixtures "
+                                 "directory") );
+    options.add( "latency <ms>", ki18n("Simulated network latency for replayed replies"), "0" );
+    options.add( "gtfs-feed <file>", ki18n("Import a GTFS feed from disk instead of running "
+                                           "requests") );
+    KCmdLineArgs::addCmdLineOptions( options );
+    KComponentData componentData( &about );
+    QCoreApplication app( KCmdLineArgs::qtArgc(), KCmdLineArgs::qtArgv() );
+    KCmdLineArgs *args = KCmdLineArgs::parsedArgs();
+
+    if ( args->count() != 1 ) {
+        KCmdLineArgs::usageError( i18nc("@info/plain", "No service provider ID given") );
+    }
+    const QString providerId = args->arg( 0 );
+
+    if ( args->isSet("gtfs-feed") ) {
+#ifdef BUILD_PROVIDER_TYPE_GTFS
+        return benchmarkGtfsImport( providerId, args->getOption("gtfs-feed") );
+#else
+        KCmdLineArgs::usageError( i18nc("@info/plain", "Built without GTFS support") );
+#endif
+    }
+
+    // Read the provider
+    QString errorMessage;
+    QScopedPointer< ServiceProviderData > provider(
+            ServiceProviderDataReader::read(providerId, &errorMessage) );
+    if ( !provider ) {
+        kError() << "Cannot read provider" << providerId << errorMessage;
+        return 1;
+    }
+
+    const QString mode = args->getOption( "mode" );
+    const QString fixtureDir = args->getOption( "fixtures" );
+    const bool record = args->isSet( "record" );
+    QScriptProgram program;
+    if ( provider->type() == Enums::GtfsProvider ) {
+#ifdef BUILD_PROVIDER_TYPE_GTFS
+        // Query the database of the provider like ServiceProviderGtfs,
+        // the GTFS feed needs to be imported by the data engine before
+        if ( !QFileInfo(GtfsDatabase::databasePath(providerId)).exists() ) {
+            kError() << "No GTFS database found for" << providerId
+                     << "the GTFS feed needs to be imported first";
+            return 1;
+        } else if ( mode == QLatin1String("journeys") ||
+                    mode == QLatin1String("additionaldata") )
+        {
+            KCmdLineArgs::usageError( i18nc("@info/plain", "Mode %1 is not supported by "
+                                            "GTFS providers", mode) );
+        }
+#else
+        KCmdLineArgs::usageError( i18nc("@info/plain", "Built without GTFS support") );
+#endif
+    } else if ( provider->type() == Enums::ScriptedProvider ) {
+        if ( fixtureDir.isEmpty() ) {
+            KCmdLineArgs::usageError( i18nc("@info/plain", "No fixtures directory given") );
+        } else if ( record && !QDir().mkpath(fixtureDir) ) {
+            KCmdLineArgs::usageError( i18nc("@info/plain",
+                                            "Cannot create the fixtures directory") );
+        }
+
+        QFile scriptFile( provider->scriptFileName() );
+        if ( !scriptFile.open(QIODevice::ReadOnly) ) {
+            kError() << "Cannot read script" << scriptFile.fileName() << scriptFile.errorString();
+            return 1;
+        }
+        program = QScriptProgram( QString::fromUtf8(scriptFile.readAll()),
+                                  provider->scriptFileName() );
+        scriptFile.close();
+    } else {
+        kError() << "Provider" << providerId << "has an unsupported type" << provider->type();
+        return 1;
+    }
+
+    // Create the request to benchmark
+    const QString stop = args->getOption( "stop" );
+    const QString city = args->getOption( "city" );
+    const int count = args->getOption( "count" ).toInt();
+    const QDateTime dateTime = args->isSet("datetime")
+            ? QDateTime::fromString(args->getOption("datetime"), Qt::ISODate)
+            : QDateTime::currentDateTime();
+    QScopedPointer< AbstractRequest > request;
+    if ( mode == QLatin1String("departures") ) {
+        request.reset( new DepartureRequest("Benchmark", stop, dateTime, count, city) );
+    } else if ( mode == QLatin1String("arrivals") ) {
+        request.reset( new ArrivalRequest("Benchmark", stop, dateTime, count, city) );
+    } else if ( mode == QLatin1String("journeys") ) {
+        request.reset( new JourneyRequest("Benchmark", stop, args->getOption("target"),
+                                          dateTime, count, QString(), city) );
+    } else if ( mode == QLatin1String("stopsuggestions") ) {
+        request.reset( new StopSuggestionRequest("Benchmark", stop, count, city) );
+    } else if ( mode == QLatin1String("additionaldata") ) {
+        request.reset( new AdditionalDataRequest("Benchmark", 0, stop, dateTime,
+                args->getOption("line"), args->getOption("target"), city) );
+    } else {
+        KCmdLineArgs::usageError( i18nc("@info/plain", "Unknown mode %1", mode) );
+    }
+
+    // Use one global storage object like ServiceProviderScript
+    const QSharedPointer< Storage > storage( new Storage(providerId) );
+    QThreadPool pool;
+    pool.setMaxThreadCount( qMax(1, args->getOption("concurrency").toInt()) );
+
+    // Warm up, eg. to fill caches and load extensions, results get discarded
+    BenchmarkResults warmupResults;
+    const int warmup = args->getOption( "warmup" ).toInt();
+    for ( int i = 0; i < warmup; ++i ) {
+        pool.start( new BenchmarkTask(provider.data(), program, storage, request.data(),
+                                      &warmupResults, fixtureDir, record, 0) );
+    }
+    pool.waitForDone();
+
+    BenchmarkResults results;
+    const int iterations = args->getOption( "iterations" ).toInt();
+    const int latency = args->getOption( "latency" ).toInt();
+    for ( int i = 0; i < iterations; ++i ) {
+        pool.start( new BenchmarkTask(provider.data(), program, storage, request.data(),
+                                      &results, fixtureDir, record, latency) );
+    }
+    pool.waitForDone();
+
+    results.printReport( QString("Provider %1, %2, concurrency %3")
+                         .arg(providerId).arg(mode).arg(pool.maxThreadCount()) );
+    args->clear();
+    return 0;
+}
+
+#include "ProviderBenchmark.moc"
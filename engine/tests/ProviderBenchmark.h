@@ -0,0 +1,207 @@
+/*
+ *   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef PROVIDERBENCHMARK_H
+#define PROVIDERBENCHMARK_H
+
+// Own includes
+#include "config.h"
+#include "enums.h"
+#include "script/scriptapi.h"
+#include "script/script_thread.h"
+
+// Qt includes
+#include <QScriptProgram>
+#include <QElapsedTimer>
+#include <QRunnable>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVector>
+#include <QMutex>
+#include <QHash>
+
+class AbstractRequest;
+class ServiceProviderData;
+class DownloadMonitor;
+
+using namespace ScriptApi;
+
+/** @brief Phases of a benchmarked request, measured separately. */
+enum BenchmarkPhase {
+    DownloadPhase = 0, /**< Waiting for network replies (only wall time gets measured). */
+    ScriptEvalPhase, /**< Creating the script engine and objects, evaluating the script. */
+    ParsePhase, /**< Running the script function, without the time spent downloading. */
+    DataListPhase, /**< Post-processing results using ResultObject::dataList(). */
+    PublishPhase, /**< Converting the results for data sources. */
+    QueryPhase, /**< Running the database queries of a GTFS provider using GtfsQueryJob. */
+    TotalPhase, /**< The complete request. */
+
+    BenchmarkPhaseCount
+};
+
+/** @brief A measurement of one phase of one request. */
+struct PhaseSample {
+    PhaseSample() : wallTime(0), cpuTime(0), allocations(0), measured(false) {};
+
+    qint64 wallTime; /**< Elapsed time in microseconds. */
+    qint64 cpuTime; /**< CPU time of the running thread in microseconds. */
+    quint64 allocations; /**< Number of calls to operator new in the running thread. */
+    bool measured; /**< Whether or not the phase was measured, not all requests use all phases. */
+};
+
+/** @brief Measures wall time, CPU time and allocations of a phase in the current thread. */
+class PhaseMeter {
+public:
+    PhaseMeter() { start(); };
+
+    void start();
+    PhaseSample stop() const;
+
+private:
+    QElapsedTimer m_timer;
+    qint64 m_cpuTime;
+    quint64 m_allocations;
+};
+
+/** @brief Collects samples from all benchmark tasks and prints a report. */
+class BenchmarkResults {
+public:
+    BenchmarkResults();
+
+    void addSamples( const PhaseSample samples[BenchmarkPhaseCount], int items );
+    void addError( const QString &errorMessage );
+    void printReport( const QString &title ) const;
+
+private:
+    mutable QMutex m_mutex;
+    QVector< PhaseSample > m_samples[ BenchmarkPhaseCount ];
+    QStringList m_errors;
+    int m_items;
+};
+
+/**
+ * @brief Runs one request in the current thread.
+ *
+ * For scripted providers the ScriptJob for the request gets run, like ServiceProviderScript
+ * does in a thread of ThreadWeaver. Each task uses it's own script engine and Network object,
+ * the Storage object is shared like in the engine.
+ *
+ * For GTFS providers the GtfsQueryJob for the request gets run, like ServiceProviderGtfs does.
+ **/
+class BenchmarkTask : public QRunnable {
+public:
+    BenchmarkTask( const ServiceProviderData *provider, const QScriptProgram &program,
+                   const QSharedPointer< Storage > &storage,
+                   const AbstractRequest *request, BenchmarkResults *results,
+                   const QString &fixtureDir, bool record, int latency );
+    virtual ~BenchmarkTask();
+
+    virtual void run();
+
+private:
+    bool runScript( PhaseSample samples[BenchmarkPhaseCount], int *items,
+                    QString *errorMessage );
+    bool runGtfsQuery( PhaseSample samples[BenchmarkPhaseCount], int *items,
+                       QString *errorMessage );
+
+    const ServiceProviderData *m_provider;
+    const QScriptProgram m_program;
+    QSharedPointer< Storage > m_storage;
+    AbstractRequest *m_request;
+    BenchmarkResults *m_results;
+    const QString m_fixtureDir;
+    const bool m_record;
+    const int m_latency;
+};
+
+/**
+ * @brief Measures the phases of a ScriptJob running in the current thread.
+ *
+ * objectsCreated() and scriptLoaded() get called from the hooks of the job, see
+ * ScriptJob::scriptObjectsCreated(). The slots get connected directly to the xxxReady() signals
+ * of the job using connectJob() and post-process the results like ServiceProviderScript.
+ **/
+class ScriptJobMeter : public QObject {
+    Q_OBJECT
+
+public:
+    ScriptJobMeter( const ServiceProviderData *provider, ParseDocumentMode parseMode,
+                    const QString &fixtureDir, bool record, int latency );
+
+    /** @brief Connect the signals of @p job, which provide the results of the script. */
+    void connectJob( ScriptJob *job );
+
+    /** @brief Replace the network access manager of @p network, start measuring downloads. */
+    void objectsCreated( Network *network );
+
+    /** @brief The script was evaluated, start measuring the parse phase. */
+    void scriptLoaded();
+
+    /**
+     * @brief Stop measuring and store the samples of the job into @p samples.
+     *
+     * @return True, if the job returned any items. Otherwise @p errorMessage gets set.
+     **/
+    bool finish( PhaseSample samples[BenchmarkPhaseCount], int *items, QString *errorMessage );
+
+public slots:
+    void dataReady( const QList<TimetableData> &data,
+                    ResultObject::Features features, ResultObject::Hints hints,
+                    const QString &url, const GlobalTimetableInfo &globalInfo );
+    void additionalDataReady( const TimetableData &data,
+                              ResultObject::Features features, ResultObject::Hints hints );
+
+private:
+    const ServiceProviderData *m_provider;
+    const ParseDocumentMode m_parseMode;
+    const QString m_fixtureDir;
+    const bool m_record;
+    const int m_latency;
+    DownloadMonitor *m_monitor;
+    PhaseMeter m_totalMeter;
+    PhaseMeter m_meter;
+    PhaseSample m_samples[ BenchmarkPhaseCount ];
+    int m_items;
+};
+
+/** @brief Measures download times using the signals of a Network object. */
+class DownloadMonitor : public QObject {
+    Q_OBJECT
+
+public:
+    explicit DownloadMonitor( Network *network );
+
+    /** @brief The time in microseconds spent waiting for downloads. */
+    qint64 downloadTime() const { return m_downloadTime; };
+
+public slots:
+    void requestStarted( const NetworkRequest::Ptr &request );
+    void requestFinished( const NetworkRequest::Ptr &request, const QByteArray &data,
+                          bool error, const QString &errorString, const QDateTime &timestamp,
+                          int statusCode, int size );
+    void synchronousRequestFinished( const QString &url, const QByteArray &data,
+                                     bool cancelled, int statusCode, int waitTime, int size );
+
+private:
+    QHash< NetworkRequest*, qint64 > m_started;
+    QElapsedTimer m_timer;
+    qint64 m_downloadTime;
+};
+
+#endif // PROVIDERBENCHMARK_H
@@ -19,10 +19,73 @@
 
 #include "ScriptApiTest.h"
 #include "script/scriptapi.h"
+#include "script/networkreplay.h"
+#include "departureinfo.h"
+
+#include <KTempDir>
 
 #include <QtTest/QTest>
 #include <QSignalSpy>
 #include <QTimer>
+#include <QMutexLocker>
+#include <QTextCodec>
+#include <QThreadPool>
+#include <QSet>
+#include <QNetworkReply>
+
+#include <zlib.h>
+
+// Records synchronous replies for a few URLs, used to test recorders in multiple threads
+class RecordTask : public QRunnable {
+public:
+    explicit RecordTask( NetworkRecorder *recorder ) : m_recorder(recorder) {};
+
+    virtual void run() {
+        for ( int i = 0; i < 20; ++i ) {
+            QMetaObject::invokeMethod( m_recorder, "synchronousRequestFinished",
+                    Qt::DirectConnection,
+                    Q_ARG(QString, QString("http://www.example.com/%1").arg(i % 5)),
+                    Q_ARG(QByteArray, QByteArray("Document")), Q_ARG(bool, false),
+                    Q_ARG(int, 200), Q_ARG(int, 0), Q_ARG(int, 8) );
+        }
+    };
+
+private:
+    NetworkRecorder *m_recorder;
+};
+
+/** @brief Compress @p data in gzip format. */
+static QByteArray gzipCompress( const QByteArray &data )
+{
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    // 16 is added to the window bits to write a gzip header
+    if ( deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, MAX_WBITS + 16, 8,
+                      Z_DEFAULT_STRATEGY) != Z_OK )
+    {
+        return QByteArray();
+    }
+
+    QByteArray compressed( deflateBound(&stream, data.size()), 0 );
+    stream.next_in = (Bytef*)data.constData();
+    stream.avail_in = data.size();
+    stream.next_out = (Bytef*)compressed.data();
+    stream.avail_out = compressed.size();
+    const int status = deflate( &stream, Z_FINISH );
+    compressed.resize( compressed.size() - stream.avail_out );
+    deflateEnd( &stream );
+    return status == Z_STREAM_END ? compressed : QByteArray();
+}
+
+void ScriptApiTest::receiveChunks( ScriptApi::NetworkRequest *request, const QByteArray &data,
+                                   int chunkSize )
+{
+    for ( int i = 0; i < data.size(); i += chunkSize ) {
+        request->processReceivedData( data.mid(i, chunkSize), i + chunkSize >= data.size() );
+    }
+}
 
 void ScriptApiTest::initTestCase()
 {
@@ -651,6 +714,51 @@ void ScriptApiTest::helperFindNamedHtmlTagsTest()
     }
 }
 
+void ScriptApiTest::regExpCacheTest()
+{
+    ScriptApi::RegExpCache cache( 2 );
+    QCOMPARE( cache.maxSize(), 2 );
+
+    // First lookup compiles the pattern, second one uses the cached pattern
+    QRegExp rx1 = cache.regExp( "(\\d{2}):(\\d{2})" );
+    QRegExp rx2 = cache.regExp( "(\\d{2}):(\\d{2})" );
+    ScriptApi::RegExpCache::Statistics statistics = cache.statistics();
+    QCOMPARE( statistics.misses, quint64(1) );
+    QCOMPARE( statistics.hits, quint64(1) );
+    QCOMPARE( statistics.size, 1 );
+
+    // Copies do not share the match state
+    QCOMPARE( rx1.indexIn("at 12:34"), 3 );
+    QCOMPARE( rx2.indexIn("15:20"), 0 );
+    QCOMPARE( rx1.cap(1), QString("12") );
+    QCOMPARE( rx2.cap(1), QString("15") );
+
+    // Different options are cached separately
+    QRegExp rxMinimal = cache.regExp( "(\\d{2}):(\\d{2})", Qt::CaseSensitive, true );
+    QVERIFY( rxMinimal.isMinimal() );
+    QVERIFY( !cache.regExp("(\\d{2}):(\\d{2})").isMinimal() );
+    QCOMPARE( cache.statistics().misses, quint64(2) );
+
+    // The cache is bounded, adding a third pattern removes the least recently used one
+    cache.regExp( "\\w+" );
+    QCOMPARE( cache.statistics().size, 2 );
+    cache.regExp( "(\\d{2}):(\\d{2})", Qt::CaseSensitive, true );
+    QCOMPARE( cache.statistics().misses, quint64(4) );
+
+    cache.clear();
+    statistics = cache.statistics();
+    QCOMPARE( statistics.size, 0 );
+    QCOMPARE( statistics.hits, quint64(0) );
+    QCOMPARE( statistics.misses, quint64(0) );
+
+    // Test CompiledRegExp::matchAll()
+    ScriptApi::CompiledRegExp compiled( cache.regExp("(\\d{2}):(\\d{2})") );
+    const QVariantList matches = compiled.matchAll( "08:15, 09:30 and 10:45" );
+    QCOMPARE( matches.count(), 3 );
+    QCOMPARE( matches[1].toStringList(), QStringList() << "09:30" << "09" << "30" );
+    QCOMPARE( compiled.matchAll("08:15, 09:30 and 10:45", 2).count(), 2 );
+}
+
 void ScriptApiTest::storageReadWriteTest_data()
 {
     QTest::addColumn<QString>("name");
@@ -835,6 +943,115 @@ void ScriptApiTest::resultDataTest()
     QCOMPARE( dataRoute.count(), 2 ); // Contains RouteStops and RouteTimes
     QCOMPARE( dataRoute[Enums::RouteStops].toStringList(), routeStops );
     QCOMPARE( dataRoute[Enums::RouteTimes].toStringList(), routeTimes );
+
+    // Test takeUnpublishedData(), published items get released but are still counted
+    data = result.takeUnpublishedData();
+    QCOMPARE( data.count(), 11 );
+    QCOMPARE( result.publishedCount(), 11 );
+    QCOMPARE( result.count(), 11 );
+    QVERIFY( result.hasData() );
+    QVERIFY( !result.hasUnpublishedData() );
+    QVERIFY( result.data().isEmpty() );
+
+    // Only items added after the last takeUnpublishedData() call get returned
+    result.addData( map );
+    QVERIFY( result.hasUnpublishedData() );
+    QCOMPARE( result.count(), 12 );
+    QCOMPARE( result.data().count(), 1 );
+    data = result.takeUnpublishedData();
+    QCOMPARE( data.count(), 1 );
+    QCOMPARE( data.first()[Enums::TransportLine].toString(), QString("N1") );
+    QVERIFY( result.takeUnpublishedData().isEmpty() );
+
+    // Test clear() after takeUnpublishedData()
+    result.clear();
+    QCOMPARE( result.count(), 0 );
+    QCOMPARE( result.publishedCount(), 0 );
+}
+
+void ScriptApiTest::resultAutoPublishTest()
+{
+    // Publish like ScriptJob, which gets connected to publish() using Qt::DirectConnection
+    ScriptApi::ResultObject result( this );
+    result.enableFeature( ScriptApi::ResultObject::AutoPublish, true );
+    m_publishedData.clear();
+    connect( &result, SIGNAL(publish()), this, SLOT(publishResults()), Qt::DirectConnection );
+
+    QVariantMap map;
+    map.insert( "DepartureTime", QTime(11, 10) );
+    map.insert( "TypeOfVehicle", "Bus" );
+    map.insert( "Target", "Test-Target" );
+    for ( int i = 0; i < 15; ++i ) {
+        map.insert( "TransportLine", QString::number(i) );
+        result.addData( map );
+    }
+    QCOMPARE( m_publishedData.count(), 10 );
+
+    // Scripts still count all items after the first 10 items were published and released,
+    // eg. "return result.hasData();" at the end of a script
+    QVERIFY( result.hasData() );
+    QCOMPARE( result.count(), 15 );
+    QCOMPARE( result.publishedCount(), 10 );
+    QCOMPARE( result.data().count(), 5 );
+    QVERIFY( !result.data(0, Enums::TransportLine).isValid() );
+    QCOMPARE( result.data(14, Enums::TransportLine).toString(), QString("14") );
+
+    // Publishing again only returns the remaining items
+    QVERIFY( result.hasUnpublishedData() );
+    m_publishedData << result.takeUnpublishedData();
+    QCOMPARE( m_publishedData.count(), 15 );
+    QCOMPARE( m_publishedData[10][Enums::TransportLine].toString(), QString("10") );
+    QVERIFY( !result.hasUnpublishedData() );
+    QVERIFY( result.data().isEmpty() );
+    QVERIFY( result.hasData() );
+    QCOMPARE( result.count(), 15 );
+}
+
+void ScriptApiTest::publishResults()
+{
+    ScriptApi::ResultObject *result = qobject_cast< ScriptApi::ResultObject* >( sender() );
+    m_publishedData << result->takeUnpublishedData();
+}
+
+void ScriptApiTest::departureInfoTest()
+{
+    // A departure with only a time, earlier than now, guessed to be tomorrow
+    const QDateTime now( QDate(2012, 11, 20), QTime(12, 0) );
+    TimetableData data;
+    data[ Enums::DepartureTime ] = QTime( 8, 15 );
+    data[ Enums::TransportLine ] = "N1";
+    data[ Enums::Target ] = "Test-Target";
+    data[ Enums::JourneyNews ] = "Test-News"; // Not stored in a fixed slot
+    DepartureInfo departure( data, PublicTransportInfo::CorrectEverything, now );
+    QVERIFY( departure.isValid() );
+    QCOMPARE( departure.value(Enums::DepartureDateTime).toDateTime(),
+              QDateTime(QDate(2012, 11, 21), QTime(8, 15)) );
+    QVERIFY( !departure.contains(Enums::DepartureTime) );
+    QCOMPARE( departure.value(Enums::Delay).toInt(), -1 );
+    QCOMPARE( departure.value(Enums::JourneyNews).toString(), QString("Test-News") );
+
+    // Test conversion to data source items
+    const QVariantHash item = departure.toVariantHash();
+    QCOMPARE( item.count(), 5 );
+    QCOMPARE( item["TransportLine"].toString(), QString("N1") );
+    QCOMPARE( item["JourneyNews"].toString(), QString("Test-News") );
+
+    // Copies share data until they get modified
+    DepartureInfo copy = departure;
+    QVERIFY( copy.isSharedWith(departure) );
+    const PublicTransportInfo baseCopy = departure;
+    QVERIFY( DepartureInfo(baseCopy).isSharedWith(departure) );
+    copy.insert( Enums::Target, "Other-Target" );
+    QVERIFY( !copy.isSharedWith(departure) );
+    QCOMPARE( departure.value(Enums::Target).toString(), QString("Test-Target") );
+    copy.remove( Enums::JourneyNews );
+    QVERIFY( !copy.contains(Enums::JourneyNews) );
+    QVERIFY( departure.contains(Enums::JourneyNews) );
+
+    // Missing required values
+    data.remove( Enums::TransportLine );
+    QVERIFY( !DepartureInfo(data, PublicTransportInfo::CorrectEverything, now).isValid() );
+    QVERIFY( !DepartureInfo().isValid() );
 }
 
 void ScriptApiTest::networkSynchronousTest()
@@ -968,5 +1185,186 @@ void ScriptApiTest::networkAsynchronousMultipleTest()
     QCOMPARE( network.lastUrl(), url2 );
 }
 
+void ScriptApiTest::networkRequestGzipTest()
+{
+    // Create a document that is bigger than the buffer used for decompression
+    QByteArray document;
+    for ( int i = 0; i < 5000; ++i ) {
+        document.append( QString::fromUtf8("Line %1: Hauptbahnhof, Gleis 2, Süd\n")
+                         .arg(i).toUtf8() );
+    }
+    const QByteArray compressed = gzipCompress( document );
+    QVERIFY( !compressed.isEmpty() );
+
+    // Decompress while receiving small chunks, garbage after the compressed data gets ignored
+    ScriptApi::NetworkRequest request;
+    QSignalSpy textSpy( &request, SIGNAL(textFinished(QString,bool,QString,int,int)) );
+    QMutexLocker locker( request.m_mutex );
+    request.processReceivedData( compressed.left(1) ); // Waits for the gzip header
+    QVERIFY( request.m_data.isEmpty() );
+    receiveChunks( &request, compressed.mid(1) + "Not compressed", 100 );
+    QVERIFY( request.m_receiveError.isEmpty() );
+    QVERIFY( request.m_data.isEmpty() ); // Only the text is needed
+    QCOMPARE( request.uncompressedSize(), quint64(document.size()) );
+    QCOMPARE( request.text(), QString::fromUtf8(document) );
+
+    // Broken data gets reported, no compressed data gets appended after the error
+    QByteArray broken = compressed;
+    broken[2] = 7; // Unknown compression method in the gzip header
+    ScriptApi::NetworkRequest brokenRequest;
+    QMutexLocker brokenLocker( brokenRequest.m_mutex );
+    receiveChunks( &brokenRequest, broken, 100 );
+    QVERIFY( !brokenRequest.m_receiveError.isEmpty() );
+    QVERIFY( brokenRequest.m_data.isEmpty() );
+
+    // Incomplete data gets reported
+    ScriptApi::NetworkRequest incompleteRequest;
+    QMutexLocker incompleteLocker( incompleteRequest.m_mutex );
+    receiveChunks( &incompleteRequest, compressed.left(compressed.size() / 2), 100 );
+    QVERIFY( !incompleteRequest.m_receiveError.isEmpty() );
+    QVERIFY( document.startsWith(incompleteRequest.m_data) );
+
+    // Uncompressed data is used as is
+    ScriptApi::NetworkRequest uncompressedRequest;
+    QMutexLocker uncompressedLocker( uncompressedRequest.m_mutex );
+    receiveChunks( &uncompressedRequest, document, 1000 );
+    QVERIFY( uncompressedRequest.m_receiveError.isEmpty() );
+    QCOMPARE( uncompressedRequest.m_data, document );
+}
+
+void ScriptApiTest::networkRequestCharsetTest()
+{
+    // A latin1 document with the charset in a meta tag after the first received chunk
+    QByteArray document = "<html><head><title>Gr\xfcnstra\xdf" "e</title>"
+            "<meta http-equiv=\"Content-Type\" content=\"text/html; charset=iso-8859-1\">"
+            "</head><body>";
+    for ( int i = 0; i < 100; ++i ) {
+        document.append( "<p>Stra\xdf" "e</p>" );
+    }
+    document.append( "</body></html>" );
+    const QString expectedText = QTextCodec::codecForName( "iso-8859-1" )->toUnicode( document );
+
+    // The text gets decoded while receiving, if textFinished() is connected
+    ScriptApi::NetworkRequest request;
+    QSignalSpy textSpy( &request, SIGNAL(textFinished(QString,bool,QString,int,int)) );
+    QMutexLocker locker( request.m_mutex );
+    request.processReceivedData( document.left(16) );
+    QVERIFY( request.m_replyCharset.isEmpty() ); // Waits for more data
+    receiveChunks( &request, document.mid(16), 16 );
+    QCOMPARE( QTextCodec::codecForName(request.m_replyCharset),
+              QTextCodec::codecForName("iso-8859-1") );
+    QCOMPARE( request.m_text, expectedText );
+    QCOMPARE( request.text(), expectedText );
+    QVERIFY( request.m_data.isEmpty() ); // Only the text is needed
+
+    // The data is kept for finished(), if it is connected
+    ScriptApi::NetworkRequest dataRequest;
+    QSignalSpy dataSpy( &dataRequest, SIGNAL(finished(QByteArray,bool,QString,int,int)) );
+    QSignalSpy dataTextSpy( &dataRequest, SIGNAL(textFinished(QString,bool,QString,int,int)) );
+    QMutexLocker dataLocker( dataRequest.m_mutex );
+    receiveChunks( &dataRequest, document, 16 );
+    QCOMPARE( dataRequest.m_data, document );
+    QCOMPARE( dataRequest.m_text, expectedText );
+
+    // Without textFinished() the text gets decoded only when it is requested
+    ScriptApi::NetworkRequest charsetRequest;
+    charsetRequest.setCharset( "iso-8859-1" );
+    QMutexLocker charsetLocker( charsetRequest.m_mutex );
+    receiveChunks( &charsetRequest, document, 16 );
+    QVERIFY( charsetRequest.m_text.isEmpty() );
+    QCOMPARE( charsetRequest.m_data, document );
+    QCOMPARE( charsetRequest.text(), expectedText );
+
+    // Short documents get decoded when finished
+    const QByteArray shortDocument = document.left( 200 );
+    ScriptApi::NetworkRequest shortRequest;
+    QSignalSpy shortTextSpy( &shortRequest, SIGNAL(textFinished(QString,bool,QString,int,int)) );
+    QMutexLocker shortLocker( shortRequest.m_mutex );
+    receiveChunks( &shortRequest, shortDocument, 16 );
+    QCOMPARE( shortRequest.m_text,
+              QTextCodec::codecForName("iso-8859-1")->toUnicode(shortDocument) );
+}
+
+void ScriptApiTest::networkRecorderTest()
+{
+    KTempDir fixtureDir;
+    QVERIFY( fixtureDir.exists() );
+    const QString url = "http://www.example.com/timetable";
+    ScriptApi::Network network;
+    NetworkRecorder *recorder = new NetworkRecorder( fixtureDir.name(), &network );
+
+    // Record a HEAD and a GET reply for the same URL
+    NetworkRequest::Ptr headRequest( new NetworkRequest(url, url, &network) );
+    headRequest->m_operation = QNetworkAccessManager::HeadOperation;
+    headRequest->m_replyHeaders << qMakePair( QByteArray("Content-Type"), QByteArray("text/html") )
+            << qMakePair( QByteArray("Content-Encoding"), QByteArray("gzip") )
+            << qMakePair( QByteArray("X-Timetable"), QByteArray("Head") );
+    headRequest->m_replyCharset = "iso-8859-1";
+    QVERIFY( QMetaObject::invokeMethod(recorder, "requestFinished", Qt::DirectConnection,
+            Q_ARG(NetworkRequest::Ptr, headRequest), Q_ARG(QByteArray, QByteArray()),
+            Q_ARG(bool, false), Q_ARG(QString, QString()),
+            Q_ARG(QDateTime, QDateTime::currentDateTime()), Q_ARG(int, 203), Q_ARG(int, 0)) );
+
+    const QByteArray document = "<html><body>Timetable</body></html>";
+    NetworkRequest::Ptr getRequest( new NetworkRequest(url, url, &network) );
+    getRequest->m_replyHeaders
+            << qMakePair( QByteArray("Content-Type"), QByteArray("text/html; charset=utf-8") )
+            << qMakePair( QByteArray("Content-Length"), QByteArray("12") )
+            << qMakePair( QByteArray("X-Timetable"), QByteArray("Get") );
+    getRequest->m_replyCharset = "iso-8859-1";
+    QVERIFY( QMetaObject::invokeMethod(recorder, "requestFinished", Qt::DirectConnection,
+            Q_ARG(NetworkRequest::Ptr, getRequest), Q_ARG(QByteArray, document),
+            Q_ARG(bool, false), Q_ARG(QString, QString()),
+            Q_ARG(QDateTime, QDateTime::currentDateTime()), Q_ARG(int, 200),
+            Q_ARG(int, document.size())) );
+
+    // HEAD and GET requests use different fixtures
+    const QString headKey = ReplayNetworkAccessManager::fixtureKey( "HEAD", QUrl(url) );
+    const QString getKey = ReplayNetworkAccessManager::fixtureKey( "GET", QUrl(url) );
+    QVERIFY( headKey != getKey );
+    QVERIFY( QFile::exists(fixtureDir.name() + headKey) );
+    QVERIFY( QFile::exists(fixtureDir.name() + getKey) );
+
+    // Replay with the recorded status code and headers, the charset gets added if missing,
+    // headers for compressed data get dropped
+    ReplayNetworkAccessManager manager( fixtureDir.name() );
+    QNetworkReply *headReply = manager.head( QNetworkRequest(QUrl(url)) );
+    QNetworkReply *getReply = manager.get( QNetworkRequest(QUrl(url)) );
+    for ( int i = 0; i < 100 && !(headReply->isFinished() && getReply->isFinished()); ++i ) {
+        QTest::qWait( 10 );
+    }
+    QVERIFY( headReply->isFinished() );
+    QCOMPARE( headReply->error(), QNetworkReply::NoError );
+    QCOMPARE( headReply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 203 );
+    QCOMPARE( headReply->rawHeader("Content-Type"), QByteArray("text/html; charset=iso-8859-1") );
+    QCOMPARE( headReply->rawHeader("X-Timetable"), QByteArray("Head") );
+    QVERIFY( !headReply->hasRawHeader("Content-Encoding") );
+    QVERIFY( headReply->readAll().isEmpty() );
+
+    QVERIFY( getReply->isFinished() );
+    QCOMPARE( getReply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(), 200 );
+    QCOMPARE( getReply->rawHeader("Content-Type"), QByteArray("text/html; charset=utf-8") );
+    QCOMPARE( getReply->rawHeader("X-Timetable"), QByteArray("Get") );
+    QCOMPARE( getReply->header(QNetworkRequest::ContentLengthHeader).toInt(), document.size() );
+    QCOMPARE( getReply->readAll(), document );
+
+    // Record the same URLs using multiple recorders in multiple threads,
+    // each fixture gets listed once in the index
+    QList< ScriptApi::Network* > networks;
+    QThreadPool pool;
+    for ( int i = 0; i < 4; ++i ) {
+        networks << new ScriptApi::Network();
+        pool.start( new RecordTask(new NetworkRecorder(fixtureDir.name(), networks.last())) );
+    }
+    pool.waitForDone();
+    qDeleteAll( networks );
+
+    QFile index( fixtureDir.name() + "index.txt" );
+    QVERIFY( index.open(QIODevice::ReadOnly) );
+    const QList< QByteArray > lines = index.readAll().trimmed().split( '\n' );
+    QCOMPARE( lines.count(), 7 ); // HEAD and GET, five URLs recorded by the tasks
+    QCOMPARE( lines.toSet().count(), lines.count() );
+}
+
 QTEST_MAIN(ScriptApiTest)
 #include "ScriptApiTest.moc"
@@ -22,8 +22,14 @@
 
 #define QT_GUI_LIB
 
+#include "enums.h" // For TimetableData
+
 #include <QtCore/QObject>
 
+namespace ScriptApi {
+    class NetworkRequest;
+}
+
 /*
 class TestVisualization : public QObject
 {
@@ -47,6 +53,10 @@ class ScriptApiTest : public QObject
 {
     Q_OBJECT
 
+public slots:
+    // Publish new items of the sending ResultObject like ScriptJob::publish()
+    void publishResults();
+
 private slots:
     void initTestCase();
     void init();
@@ -121,6 +131,9 @@ private slots:
 
     // No testing of deprecated Helper::extractBlock()
 
+    // Test RegExpCache::regExp(), RegExpCache::statistics() and CompiledRegExp::matchAll()
+    void regExpCacheTest();
+
     // Test Storage::read(), Storage::writePersistent(), Storage::remove() and Storage::hasData()
     void storageReadWriteTest_data();
     void storageReadWriteTest();
@@ -136,14 +149,36 @@ private slots:
     // ResultObject::enableFeature(), ResultObject::isHintGiven(), ResultObject::isFeatureEnabled()
     void resultFeaturesHintsTest();
 
-    // Test ResultObject::addData(), ResultObject::clear(), ResultObject::hasData() and signal
-    // ResultObject::publish()
+    // Test ResultObject::addData(), ResultObject::clear(), ResultObject::hasData(),
+    // ResultObject::takeUnpublishedData() and signal ResultObject::publish()
     void resultDataTest();
 
+    // Test that published items get released, but are still counted for scripts
+    void resultAutoPublishTest();
+
+    // Test DepartureInfo corrections with a given current date and time and data sharing
+    void departureInfoTest();
+
     void networkSynchronousTest();
     void networkAsynchronousTest();
     void networkAsynchronousAbortTest();
     void networkAsynchronousMultipleTest();
+
+    // Test decompression of gzip data received in chunks, broken and incomplete data
+    void networkRequestGzipTest();
+
+    // Test charset detection from a meta tag that is not in the first received chunk
+    void networkRequestCharsetTest();
+
+    // Test recording fixtures with NetworkRecorder and replaying them, also from multiple threads
+    void networkRecorderTest();
+
+private:
+    /** @brief Give @p data in chunks of @p chunkSize bytes to @p request. */
+    static void receiveChunks( ScriptApi::NetworkRequest *request, const QByteArray &data,
+                               int chunkSize );
+
+    QList< TimetableData > m_publishedData;
 };
 
 #endif // SCRIPTAPITEST_H
@@ -0,0 +1,301 @@
+/*
+ *   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// Header
+#include "batchtestrunner.h"
+
+// Own includes
+#include "project.h"
+
+// PublicTransport engine includes
+#include <engine/serviceproviderglobal.h>
+
+// KDE includes
+#include <KDebug>
+#include <KLocalizedString>
+
+// Qt includes
+#include <QXmlStreamWriter>
+#include <QFileInfo>
+#include <QTimer>
+
+BatchTestRunner::BatchTestRunner( const WeaverInterfacePointer &weaver, QObject *parent )
+        : QObject(parent), m_weaver(weaver), m_nextProject(0), m_maximumRunningProjects(4),
+          m_timeout(0), m_finished(false)
+{
+}
+
+BatchTestRunner::~BatchTestRunner()
+{
+    qDeleteAll( m_running.keys() );
+}
+
+bool BatchTestRunner::addProject( const QString &providerIdOrFileName )
+{
+    ProjectResult result;
+    if ( QFileInfo(providerIdOrFileName).isFile() ) {
+        result.fileName = providerIdOrFileName;
+        result.providerId = ServiceProviderGlobal::idFromFileName( providerIdOrFileName );
+    } else {
+        result.providerId = providerIdOrFileName;
+        result.fileName = ServiceProviderGlobal::fileNameFromId( providerIdOrFileName );
+    }
+
+    if ( result.fileName.isEmpty() ) {
+        kWarning() << "No provider plugin found for" << providerIdOrFileName;
+        return false;
+    }
+
+    m_results << result;
+    return true;
+}
+
+void BatchTestRunner::setMaximumRunningProjects( int count )
+{
+    m_maximumRunningProjects = qMax( 1, count );
+}
+
+void BatchTestRunner::start()
+{
+    m_finished = false;
+    m_nextProject = 0;
+    startNextProjects();
+}
+
+void BatchTestRunner::startNextProjects()
+{
+    while ( m_running.count() < m_maximumRunningProjects && m_nextProject < m_results.count() ) {
+        const int index = m_nextProject++;
+        ProjectResult &result = m_results[ index ];
+
+        Project *project = new Project( m_weaver );
+        project->setQuestionsEnabled( false );
+        project->setTestDateTime( m_testDateTime );
+        result.loaded = project->loadProject( result.fileName );
+        if ( !result.loaded ) {
+            result.errorMessage = project->lastError();
+            kWarning() << "Cannot load project" << result.fileName << result.errorMessage;
+            delete project;
+            emit projectFinished( result.providerId, false );
+            continue;
+        }
+
+        kDebug() << "Start testing" << result.providerId;
+        connect( project, SIGNAL(testFinished(bool)), this, SLOT(testFinished(bool)) );
+        m_running.insert( project, index );
+        m_runningTimers[ project ].start();
+        if ( m_timeout > 0 ) {
+            QTimer *timer = new QTimer( this );
+            timer->setSingleShot( true );
+            connect( timer, SIGNAL(timeout()), this, SLOT(projectTimedOut()) );
+            m_timeoutTimers.insert( timer, project );
+            timer->start( m_timeout * 1000 );
+        }
+
+        project->testProject();
+        if ( m_running.contains(project) && !project->isTestRunning() ) {
+            // Tests could not be started and no testFinished() signal was emitted
+            finishProject( project );
+        }
+    }
+
+    if ( m_running.isEmpty() && m_nextProject >= m_results.count() && !m_finished ) {
+        m_finished = true;
+        emit finished();
+    }
+}
+
+void BatchTestRunner::testFinished( bool success )
+{
+    Q_UNUSED( success );
+    Project *project = qobject_cast< Project* >( sender() );
+    if ( !project || !m_running.contains(project) ) {
+        kWarning() << "Unknown project finished testing" << sender();
+        return;
+    }
+
+    finishProject( project );
+
+    // Do not start new projects from inside the testFinished() signal of the finished project
+    QTimer::singleShot( 0, this, SLOT(startNextProjects()) );
+}
+
+void BatchTestRunner::projectTimedOut()
+{
+    QTimer *timer = qobject_cast< QTimer* >( sender() );
+    Project *project = m_timeoutTimers.take( timer );
+    timer->deleteLater();
+    if ( !project || !m_running.contains(project) ) {
+        return;
+    }
+
+    // Abort running tests, testFinished() gets emitted when all tests are aborted
+    ProjectResult &result = m_results[ m_running[project] ];
+    kWarning() << "Timeout while testing" << result.providerId;
+    result.timedOut = true;
+    project->abortTests();
+}
+
+void BatchTestRunner::finishProject( Project *project )
+{
+    const int index = m_running.take( project );
+    ProjectResult &result = m_results[ index ];
+    result.duration = m_runningTimers.take( project ).elapsed();
+
+    // Stop the timeout timer of the project
+    for ( QHash< QTimer*, Project* >::Iterator it = m_timeoutTimers.begin();
+          it != m_timeoutTimers.end(); ++it )
+    {
+        if ( it.value() == project ) {
+            it.key()->deleteLater();
+            m_timeoutTimers.erase( it );
+            break;
+        }
+    }
+
+    // Collect results of all tests
+    const TestModel *model = project->testModel();
+    foreach ( TestModel::Test test, TestModel::allTests() ) {
+        const QString explanation = model->indexFromTest( test, TestModel::ExplanationColumn )
+                .data().toString();
+        result.tests << TestResult( test, model->testState(test), explanation,
+                                    model->testDuration(test) );
+    }
+
+    const bool success = !result.timedOut && !model->hasErroneousTests();
+    kDebug() << "Finished testing" << result.providerId << "in" << result.duration << "ms"
+             << (success ? "successfully" : "with errors");
+    project->disconnect( this );
+    project->deleteLater();
+    emit projectFinished( result.providerId, success );
+}
+
+bool BatchTestRunner::hasErrors() const
+{
+    foreach ( const ProjectResult &result, m_results ) {
+        if ( !result.loaded || result.timedOut ) {
+            return true;
+        }
+        foreach ( const TestResult &test, result.tests ) {
+            if ( test.state == TestModel::TestFinishedWithErrors ||
+                 test.state == TestModel::TestCouldNotBeStarted ||
+                 test.state == TestModel::TestAborted )
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void BatchTestRunner::writeReport( QIODevice *device ) const
+{
+    QXmlStreamWriter writer( device );
+    writer.setAutoFormatting( true );
+    writer.writeStartDocument();
+    writer.writeStartElement( "testsuites" );
+
+    foreach ( const ProjectResult &result, m_results ) {
+        int failures = 0, errors = 0, skipped = 0;
+        foreach ( const TestResult &test, result.tests ) {
+            switch ( test.state ) {
+            case TestModel::TestFinishedWithErrors:
+                ++failures;
+                break;
+            case TestModel::TestCouldNotBeStarted:
+            case TestModel::TestAborted:
+                ++errors;
+                break;
+            case TestModel::TestNotStarted:
+            case TestModel::TestDisabled:
+            case TestModel::TestNotApplicable:
+                ++skipped;
+                break;
+            default:
+                break;
+            }
+        }
+        if ( !result.loaded || result.timedOut ) {
+            ++errors;
+        }
+
+        writer.writeStartElement( "testsuite" );
+        writer.writeAttribute( "name", result.providerId );
+        writer.writeAttribute( "tests", QString::number(result.tests.count()) );
+        writer.writeAttribute( "failures", QString::number(failures) );
+        writer.writeAttribute( "errors", QString::number(errors) );
+        writer.writeAttribute( "skipped", QString::number(skipped) );
+        writer.writeAttribute( "time", QString::number(result.duration / 1000.0, 'f', 3) );
+
+        if ( !result.loaded ) {
+            writer.writeStartElement( "error" );
+            writer.writeAttribute( "message", i18nc("@info/plain", "Cannot load project %1: %2",
+                                                    result.fileName, result.errorMessage) );
+            writer.writeEndElement(); // error
+        } else if ( result.timedOut ) {
+            writer.writeStartElement( "error" );
+            writer.writeAttribute( "message", i18nc("@info/plain", "Tests were aborted after a "
+                                                    "timeout of %1 seconds", m_timeout) );
+            writer.writeEndElement(); // error
+        }
+
+        foreach ( const TestResult &test, result.tests ) {
+            writer.writeStartElement( "testcase" );
+            writer.writeAttribute( "classname", QString("%1.%2").arg(result.providerId)
+                    .arg(TestModel::nameForTestCase(TestModel::testCaseOfTest(test.test))) );
+            writer.writeAttribute( "name", TestModel::nameForTest(test.test) );
+            if ( test.duration >= 0 ) {
+                writer.writeAttribute( "time", QString::number(test.duration / 1000.0, 'f', 3) );
+            }
+
+            switch ( test.state ) {
+            case TestModel::TestFinishedWithErrors:
+                writer.writeStartElement( "failure" );
+                writer.writeAttribute( "message", test.explanation );
+                writer.writeEndElement(); // failure
+                break;
+            case TestModel::TestCouldNotBeStarted:
+            case TestModel::TestAborted:
+                writer.writeStartElement( "error" );
+                writer.writeAttribute( "message", TestModel::nameForState(test.state) );
+                writer.writeCharacters( test.explanation );
+                writer.writeEndElement(); // error
+                break;
+            case TestModel::TestNotStarted:
+            case TestModel::TestDisabled:
+            case TestModel::TestNotApplicable:
+                writer.writeStartElement( "skipped" );
+                writer.writeAttribute( "message", TestModel::nameForState(test.state) );
+                writer.writeEndElement(); // skipped
+                break;
+            case TestModel::TestFinishedWithWarnings:
+                writer.writeTextElement( "system-out", test.explanation );
+                break;
+            default:
+                break;
+            }
+            writer.writeEndElement(); // testcase
+        }
+
+        writer.writeEndElement(); // testsuite
+    }
+
+    writer.writeEndElement(); // testsuites
+    writer.writeEndDocument();
+}
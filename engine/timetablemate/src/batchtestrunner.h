@@ -0,0 +1,157 @@
+/*
+ *   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef BATCHTESTRUNNER_H
+#define BATCHTESTRUNNER_H
+
+// Own includes
+#include "testmodel.h"
+
+// Qt includes
+#include <QObject>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QSharedPointer>
+#include <QHash>
+
+namespace ThreadWeaver {
+    class WeaverInterface;
+}
+typedef QSharedPointer< ThreadWeaver::WeaverInterface > WeaverInterfacePointer;
+
+class Project;
+class QIODevice;
+class QTimer;
+
+/**
+ * @brief Tests multiple projects without a main window, eg. for continuous integration.
+ *
+ * Projects get added using addProject() and tested after start() was called. Multiple projects
+ * get tested at the same time, the script jobs of all projects run in the thread pool of the
+ * weaver given to the constructor. After all projects are tested finished() gets emitted and
+ * a report can be written using writeReport().
+ **/
+class BatchTestRunner : public QObject {
+    Q_OBJECT
+
+public:
+    /** @brief Result of a single test of a tested project. */
+    struct TestResult {
+        TestResult( TestModel::Test test = TestModel::InvalidTest,
+                    TestModel::TestState state = TestModel::TestNotStarted,
+                    const QString &explanation = QString(), qint64 duration = -1 )
+                : test(test), state(state), explanation(explanation), duration(duration) {};
+
+        TestModel::Test test;
+        TestModel::TestState state;
+        QString explanation;
+        qint64 duration; /**< The duration of the test in milliseconds or -1 if unknown. */
+    };
+
+    /** @brief Results of all tests of a tested project. */
+    struct ProjectResult {
+        ProjectResult() : duration(0), loaded(false), timedOut(false) {};
+
+        QString providerId;
+        QString fileName;
+        QString errorMessage; /**< An error message, if the project could not be tested. */
+        QList< TestResult > tests;
+        qint64 duration; /**< The duration of all tests of the project in milliseconds. */
+        bool loaded;
+        bool timedOut;
+    };
+
+    /**
+     * @brief Create a new batch test runner.
+     *
+     * @param weaver The weaver to use for all projects. Use setMaximumNumberOfThreads() on the
+     *   weaver to control how many script jobs run at the same time.
+     **/
+    explicit BatchTestRunner( const WeaverInterfacePointer &weaver, QObject *parent = 0 );
+
+    /** @brief Destructor. */
+    virtual ~BatchTestRunner();
+
+    /**
+     * @brief Add a project to be tested.
+     *
+     * @param providerIdOrFileName Either the file name of a provider plugin XML file or the ID
+     *   of an installed provider plugin.
+     * @return False, if no provider plugin file was found for @p providerIdOrFileName.
+     **/
+    bool addProject( const QString &providerIdOrFileName );
+
+    /** @brief Set how many projects get tested at the same time, the default is 4. */
+    void setMaximumRunningProjects( int count );
+
+    /** @brief Set the date and time to use in test requests, see Project::setTestDateTime(). */
+    void setTestDateTime( const QDateTime &dateTime ) { m_testDateTime = dateTime; };
+
+    /** @brief Abort tests of a project after @p seconds, 0 disables the timeout (default). */
+    void setTimeout( int seconds ) { m_timeout = seconds; };
+
+    /** @brief Start testing all added projects. */
+    void start();
+
+    /** @brief Whether or not all projects are tested. */
+    bool isFinished() const { return m_finished; };
+
+    /** @brief Whether or not a test failed or a project could not be tested. */
+    bool hasErrors() const;
+
+    /** @brief Results of all tested projects, in the order in which they were added. */
+    QList< ProjectResult > results() const { return m_results; };
+
+    /**
+     * @brief Write a report for all tested projects to @p device.
+     *
+     * The report uses the JUnit XML format, which can be read by most continuous integration
+     * servers. Each project is written as test suite, each test of a project as test case.
+     **/
+    void writeReport( QIODevice *device ) const;
+
+signals:
+    /** @brief Tests of the project with @p providerId have finished. */
+    void projectFinished( const QString &providerId, bool success );
+
+    /** @brief All projects are tested. */
+    void finished();
+
+protected slots:
+    void testFinished( bool success );
+    void projectTimedOut();
+    void startNextProjects();
+
+private:
+    void finishProject( Project *project );
+
+    WeaverInterfacePointer m_weaver;
+    QList< ProjectResult > m_results;
+    QHash< Project*, int > m_running; // Indices into m_results of currently tested projects
+    QHash< Project*, QElapsedTimer > m_runningTimers;
+    QHash< QTimer*, Project* > m_timeoutTimers;
+    QDateTime m_testDateTime;
+    int m_nextProject;
+    int m_maximumRunningProjects;
+    int m_timeout;
+    bool m_finished;
+};
+
+#endif // BATCHTESTRUNNER_H
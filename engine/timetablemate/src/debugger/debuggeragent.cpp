@@ -69,8 +69,10 @@ DebuggerAgent::DebuggerAgent( QScriptEngine *engine, QSemaphore *engineSemaphore
         : QObject(engine), QScriptEngineAgent(engine),
           m_mutex(new QMutex(QMutex::Recursive)), m_interruptWaiter(new QWaitCondition()),
           m_interruptMutex(new QMutex()), m_engineSemaphore(engineSemaphore),
-          m_checkRunningTimer(new QTimer(this)), m_lastRunAborted(false), m_runUntilLineNumber(-1),
-          m_debugFlags(DefaultDebugFlags), m_currentContext(0), m_interruptContext(0)
+          m_checkRunningTimer(new QTimer(this)), m_lastRunAborted(false),
+          m_breakpointLineCount(0), m_currentBreakpointLinesScriptId(-2), m_checkPositions(1),
+          m_runUntilLineNumber(-1), m_debugFlags(DefaultDebugFlags), m_currentContext(0),
+          m_interruptContext(0)
 {
     qRegisterMetaType< VariableChange >( "VariableChange" );
     qRegisterMetaType< BacktraceChange >( "BacktraceChange" );
@@ -90,6 +92,7 @@ DebuggerAgent::DebuggerAgent( QScriptEngine *engine, QSemaphore *engineSemaphore
     m_uncaughtExceptionLineNumber = -1;
     m_interruptFunctionLevel = -2;
     m_functionDepth = 0;
+    m_modelFunctionDepth = 0;
     m_mutex->unlockInline();
 
     // Install custom print function (overwriting the builtin print function)
@@ -512,6 +515,7 @@ void DebuggerAgent::continueToDoSomething()
 
     // Wake from interrupt, then emit doSomething() and directly interrupt again
     m_executionControl = ExecuteInterrupt;
+    requirePositionChecks();
     m_interruptWaiter->wakeAll();
 }
 
@@ -527,6 +531,7 @@ QScriptValue DebuggerAgent::evaluateInContext( const QString &program, const QSt
     const ExecutionControl executionType = m_executionControl;
     const DebugFlags oldDebugFlags = m_debugFlags;
     m_debugFlags = debugFlags;
+    requirePositionChecks();
     m_mutex->unlockInline();
 
     QTimer timer;
@@ -550,6 +555,7 @@ QScriptValue DebuggerAgent::evaluateInContext( const QString &program, const QSt
     if ( debugFlags.testFlag(InterruptAtStart) ) {
         m_mutex->lockInline();
         m_executionControl = executionType;
+        requirePositionChecks();
         m_mutex->unlockInline();
     }
 
@@ -557,6 +563,7 @@ QScriptValue DebuggerAgent::evaluateInContext( const QString &program, const QSt
     if ( debugFlags != oldDebugFlags ) {
         m_mutex->lockInline();
         m_debugFlags = oldDebugFlags;
+        requirePositionChecks();
         m_mutex->unlockInline();
     }
 
@@ -598,6 +605,7 @@ void DebuggerAgent::cancelInjectedCodeExecution()
     if ( m_injectedScriptState == InjectedScriptEvaluating ) {
         DEBUGGER_EVENT("Evaluation did not finish in time or was cancelled");
         m_executionControl = ExecuteAbortInjectedProgram;
+        requirePositionChecks();
     } else {
         // Is not running injected code
         checkHasExited();
@@ -608,14 +616,76 @@ void DebuggerAgent::cancelInjectedCodeExecution()
 
 void DebuggerAgent::addBreakpoint( const Breakpoint &breakpoint )
 {
+    QMutexLocker locker( m_mutex );
     QHash< uint, Breakpoint > &breakpoints = breakpointsForFile( breakpoint.fileName() );
     breakpoints.insert( breakpoint.lineNumber(), breakpoint );
+    updateBreakpointLines( breakpoint.fileName() );
 }
 
 void DebuggerAgent::removeBreakpoint( const Breakpoint &breakpoint )
 {
+    QMutexLocker locker( m_mutex );
     QHash< uint, Breakpoint > &breakpoints = breakpointsForFile( breakpoint.fileName() );
     breakpoints.remove( breakpoint.lineNumber() );
+    updateBreakpointLines( breakpoint.fileName() );
+}
+
+void DebuggerAgent::updateBreakpointLines( const QString &fileName )
+{
+    QMutexLocker locker( m_mutex );
+    const QHash< uint, Breakpoint > &breakpoints = breakpointsForFile( fileName );
+    QBitArray lines;
+    for ( QHash< uint, Breakpoint >::ConstIterator it = breakpoints.constBegin();
+          it != breakpoints.constEnd(); ++it )
+    {
+        if ( it->isEnabled() ) {
+            if ( int(it.key()) >= lines.size() ) {
+                lines.resize( it.key() + 1 );
+            }
+            lines.setBit( it.key() );
+        }
+    }
+
+    m_breakpointLineCount += lines.count( true ) - m_breakpointLines[ fileName ].count( true );
+    if ( lines.isEmpty() ) {
+        m_breakpointLines.remove( fileName );
+    } else {
+        m_breakpointLines[ fileName ] = lines;
+    }
+
+    // Invalidate the cached bitmap for the current script and leave run mode,
+    // if a breakpoint was added
+    m_currentBreakpointLinesScriptId = -2;
+    requirePositionChecks();
+}
+
+bool DebuggerAgent::hasBreakpointAt( qint64 scriptId, int lineNumber )
+{
+    QMutexLocker locker( m_mutex );
+    if ( m_breakpointLineCount == 0 ) {
+        return false;
+    }
+
+    if ( scriptId != m_currentBreakpointLinesScriptId ) {
+        // The current script has changed, get the bitmap for the associated file
+        m_currentBreakpointLines = m_breakpointLines.value( m_scriptIdToFileName.value(scriptId) );
+        m_currentBreakpointLinesScriptId = scriptId;
+    }
+    return lineNumber >= 0 && lineNumber < m_currentBreakpointLines.size() &&
+           m_currentBreakpointLines.testBit( lineNumber );
+}
+
+void DebuggerAgent::updateRunMode()
+{
+    QMutexLocker locker( m_mutex );
+    if ( m_state == Running && m_executionControl == ExecuteRun && m_runUntilLineNumber == -1 &&
+         m_injectedScriptState == InjectedScriptNotRunning &&
+         (m_breakpointLineCount == 0 || !m_debugFlags.testFlag(InterruptOnBreakpoints)) )
+    {
+        // Nothing to check in positionChange(), until another value changes
+        // and requirePositionChecks() gets called
+        m_checkPositions.fetchAndStoreOrdered( 0 );
+    }
 }
 
 bool DebuggerAgent::debugControl( DebuggerAgent::ConsoleCommandExecutionControl controlType,
@@ -753,6 +823,7 @@ void DebuggerAgent::setExecutionControlType( ExecutionControl executionType )
     QMutexLocker locker( m_mutex );
     m_executionControl = executionType;
     m_repeatExecutionTypeCount = 0; // If execution type is repeatable, ie. stepInto/stepOver/stepOut
+    requirePositionChecks();
 }
 
 void DebuggerAgent::abortDebugger()
@@ -793,6 +864,7 @@ void DebuggerAgent::debugInterrupt()
     }
 
     m_executionControl = ExecuteInterrupt;
+    requirePositionChecks();
 }
 
 void DebuggerAgent::debugContinue()
@@ -820,6 +892,7 @@ void DebuggerAgent::debugStepInto( int repeat )
     // Wake from interrupt and run until the next statement
     m_repeatExecutionTypeCount = repeat;
     m_executionControl = ExecuteStepInto;
+    requirePositionChecks();
     m_interruptWaiter->wakeAll();
 }
 
@@ -836,6 +909,7 @@ void DebuggerAgent::debugStepOver( int repeat )
     m_interruptFunctionLevel = 0;
     m_repeatExecutionTypeCount = repeat;
     m_executionControl = ExecuteStepOver;
+    requirePositionChecks();
     m_interruptWaiter->wakeAll();
 }
 
@@ -852,6 +926,7 @@ void DebuggerAgent::debugStepOut( int repeat )
     m_interruptFunctionLevel = 0;
     m_repeatExecutionTypeCount = repeat;
     m_executionControl = ExecuteStepOut;
+    requirePositionChecks();
     m_interruptWaiter->wakeAll();
 }
 
@@ -862,6 +937,7 @@ void DebuggerAgent::debugRunUntilLineNumber( const QString &fileName, int lineNu
 
     QMutexLocker locker( m_mutex );
     m_runUntilLineNumber = runUntilLineNumber;
+    requirePositionChecks();
     if ( runUntilLineNumber != -1 ) {
         m_executionControl = ExecuteRun;
         wakeFromInterrupt();
@@ -876,6 +952,7 @@ void DebuggerAgent::debugRunInjectedProgram()
     m_injectedScriptState = InjectedScriptInitializing; // Update in next scriptLoad()
     m_previousExecutionControl = m_executionControl;
     m_executionControl = ExecuteRunInjectedProgram;
+    requirePositionChecks();
     // Do not wake from interrupt here, because the script should stay interrupted,
     // while the injected program runs in another thread
 }
@@ -888,6 +965,7 @@ void DebuggerAgent::debugStepIntoInjectedProgram()
     m_injectedScriptState = InjectedScriptInitializing; // Update in next scriptLoad()
     m_previousExecutionControl = m_executionControl;
     m_executionControl = ExecuteStepIntoInjectedProgram;
+    requirePositionChecks();
     // Do not wake from interrupt here, because the script should stay interrupted,
     // while the injected program runs in another thread
 }
@@ -980,7 +1058,7 @@ void DebuggerAgent::contextPop()
 void DebuggerAgent::functionEntry( qint64 scriptId )
 {
     if ( scriptId != -1 ) {
-        QMutexLocker locker( m_mutex );
+        m_mutex->lockInline();
         ++m_functionDepth;
         if ( m_interruptFunctionLevel >= -1 &&
             (m_executionControl == ExecuteStepOver || m_executionControl == ExecuteStepOut) )
@@ -988,8 +1066,18 @@ void DebuggerAgent::functionEntry( qint64 scriptId )
             ++m_interruptFunctionLevel;
         }
 
-        emit variablesChanged( VariableChange(PushVariableStack) );
-        emit backtraceChanged( BacktraceChange(PushBacktraceFrame) );
+        // In run mode frames are not pushed to the models here, but in pushSkippedFrames()
+        // when the script gets interrupted
+        const bool pushFrame = m_checkPositions != 0 && m_modelFunctionDepth == m_functionDepth - 1;
+        if ( pushFrame ) {
+            ++m_modelFunctionDepth;
+        }
+        m_mutex->unlockInline();
+
+        if ( pushFrame ) {
+            emit variablesChanged( VariableChange(PushVariableStack) );
+            emit backtraceChanged( BacktraceChange(PushBacktraceFrame) );
+        }
     }
 }
 
@@ -997,8 +1085,21 @@ void DebuggerAgent::functionEntry( qint64 scriptId )
 void DebuggerAgent::functionExit( qint64 scriptId, const QScriptValue& returnValue )
 {
     if ( scriptId != -1 ) {
-        emit variablesChanged( VariableChange(PopVariableStack) );
-        emit backtraceChanged( BacktraceChange(PopBacktraceFrame) );
+        // Only pop frames that were pushed to the models, m_functionDepth does not get
+        // decreased when aborting
+        m_mutex->lockInline();
+        const bool popFrame = m_modelFunctionDepth > 0 &&
+                (m_modelFunctionDepth >= m_functionDepth ||
+                 m_executionControl == ExecuteAbort || m_state == Aborting);
+        if ( popFrame ) {
+            --m_modelFunctionDepth;
+        }
+        m_mutex->unlockInline();
+
+        if ( popFrame ) {
+            emit variablesChanged( VariableChange(PopVariableStack) );
+            emit backtraceChanged( BacktraceChange(PopBacktraceFrame) );
+        }
     }
 
     QMutexLocker locker( m_mutex );
@@ -1104,6 +1205,8 @@ void DebuggerAgent::emitChanges() {
     QScriptContext *context = engine()->currentContext();
     m_currentContext = context;
     if ( context ) {
+        pushSkippedFrames( context );
+
         // Construct backtrace/variable change objects
         // The Frame object is already created and added to the model with empty values
         // (in DebuggerAgent::functionEntry())
@@ -1119,9 +1222,61 @@ void DebuggerAgent::emitChanges() {
     m_engineSemaphore->release();
 }
 
+void DebuggerAgent::pushSkippedFrames( QScriptContext *context )
+{
+    QMutexLocker locker( m_mutex );
+    const int skippedFrames = m_functionDepth - m_modelFunctionDepth;
+    if ( skippedFrames <= 0 ) {
+        return;
+    }
+
+    // Collect contexts of the skipped frames, innermost last, native functions do not call
+    // functionEntry() with a valid script ID
+    QList< QScriptContext* > contexts;
+    for ( QScriptContext *frameContext = context; frameContext && contexts.count() < skippedFrames;
+          frameContext = frameContext->parentContext() )
+    {
+        const QScriptContextInfo info( frameContext );
+        if ( info.functionType() != QScriptContextInfo::NativeFunction ) {
+            contexts.prepend( frameContext );
+        }
+    }
+
+    // Push the skipped frames and fill all but the innermost frame,
+    // which gets updated by emitChanges()
+    const int missingContexts = skippedFrames - contexts.count();
+    for ( int i = 0; i < skippedFrames; ++i ) {
+        emit variablesChanged( VariableChange(PushVariableStack) );
+        emit backtraceChanged( BacktraceChange(PushBacktraceFrame) );
+
+        const int contextIndex = i - missingContexts;
+        if ( contextIndex >= 0 && i < skippedFrames - 1 ) {
+            QScriptContext *frameContext = contexts[ contextIndex ];
+            const bool isGlobal = frameContext->thisObject().equals( engine()->globalObject() );
+            const Frame frame( QScriptContextInfo(frameContext), isGlobal );
+            emit backtraceChanged( BacktraceChange(UpdateBacktraceFrame, frame) );
+            emit variablesChanged( VariableChange::fromContext(frameContext) );
+        }
+    }
+    m_modelFunctionDepth = m_functionDepth;
+}
+
 void DebuggerAgent::positionChange( qint64 scriptId, int lineNumber, int columnNumber )
 {
-    Q_UNUSED( scriptId );
+    if ( m_checkPositions == 0 ) {
+        // Run mode, no breakpoints to check, no interrupt/step requested,
+        // only update the current execution position
+        m_mutex->lockInline();
+        m_currentScriptId = scriptId;
+        m_lineNumber = lineNumber;
+        m_columnNumber = columnNumber;
+        m_mutex->unlockInline();
+
+        // Let other threads use the engine between two statements, like in the code below
+        m_engineSemaphore->release();
+        m_engineSemaphore->acquire();
+        return;
+    }
 
     // Lock the engine if not already locked (should normally be locked before script execution,
     // but it may get unlocked before the script is really done, eg. waiting idle for network
@@ -1168,7 +1323,9 @@ void DebuggerAgent::positionChange( qint64 scriptId, int lineNumber, int columnN
         }
 
         // Check for breakpoints at the current line
-        if ( m_debugFlags.testFlag(InterruptOnBreakpoints) ) {
+        if ( m_debugFlags.testFlag(InterruptOnBreakpoints) &&
+             hasBreakpointAt(scriptId, lineNumber) )
+        {
             Breakpoint *breakpoint = 0;
             bool conditionError = false;
             if ( findActiveBreakpoint(lineNumber, breakpoint, &conditionError) ) {
@@ -1246,6 +1403,9 @@ void DebuggerAgent::positionChange( qint64 scriptId, int lineNumber, int columnN
         // it should be aborted by terminating the executing thread
         doInterrupt( true );
     } else if ( state != NotRunning && state != Aborting ) {
+        // Enter run mode if possible
+        updateRunMode();
+
         // Protect further script execution
         m_engineSemaphore->acquire();
     }
@@ -1316,6 +1476,7 @@ void DebuggerAgent::setState( DebuggerState newState )
     const DebuggerState oldState = m_state;
     DEBUGGER_STATE_CHANGE( oldState, newState );
     m_state = newState;
+    requirePositionChecks();
     emit stateChanged( newState, oldState );
 }
 
@@ -1517,6 +1678,7 @@ void DebuggerAgent::shutdown()
     const QDateTime timestamp = QDateTime::currentDateTime();
 
     m_functionDepth = 0;
+    m_modelFunctionDepth = 0;
     const bool isPositionChanged = m_lineNumber != -1 || m_columnNumber != -1;
 
     // Context will be invalid
@@ -1664,6 +1826,7 @@ void DebuggerAgent::setDebugFlags( DebugFlags debugFlags )
 {
     QMutexLocker locker( m_mutex );
     m_debugFlags = debugFlags;
+    requirePositionChecks();
 }
 
 void DebuggerAgent::slotOutput( const QString &outputString, const QScriptContextInfo &contextInfo )
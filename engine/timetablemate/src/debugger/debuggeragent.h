@@ -33,6 +33,8 @@
 
 // Qt includes
 #include <QScriptEngineAgent>
+#include <QBitArray>
+#include <QAtomicInt>
 
 struct ScriptObjects;
 
@@ -68,6 +70,12 @@ struct BreakpointChange;
  * The position at which a script got interrupted can be retrieved using lineNumber() and
  * columnNumber().
  *
+ * While the script runs without breakpoints and without a requested interrupt, step or
+ * "run until" command, the agent is in run mode. QtScript still calls positionChange() for each
+ * statement, but only the current position gets stored. Frames of called functions are also not
+ * pushed to the variable and backtrace models in run mode, the models get filled from the
+ * context stack once the script gets interrupted.
+ *
  * Breakpoints can be added/removed using addBreakpoint(), removeBreakpoint() and
  * updateBreakpoint(). If a breakpoint is reached the breakpointReached() signal gets emitted and
  * the hit count of the breakpoint gets increased. These functions are used by BreakpointModel to
@@ -379,6 +387,23 @@ private:
     // Looks for breakpoints at the current execution position (tests conditions, enabled/disabled)
     bool findActiveBreakpoint( int lineNumber, Breakpoint *&foundBreakpoint, bool *conditionError );
 
+    // Whether or not there is an enabled breakpoint at @p lineNumber in the script with ID
+    // @p scriptId, uses a precomputed bitmap of lines with breakpoints for each file
+    bool hasBreakpointAt( qint64 scriptId, int lineNumber );
+
+    // Update the bitmap of lines with enabled breakpoints in @p fileName
+    void updateBreakpointLines( const QString &fileName );
+
+    // Leave run mode, ie. check breakpoints/execution control in the next positionChange() call.
+    // Needs to be called whenever a value gets changed, that is checked in updateRunMode()
+    inline void requirePositionChecks() { m_checkPositions.fetchAndStoreOrdered( 1 ); };
+
+    // Enter run mode, if there is nothing to check in positionChange()
+    void updateRunMode();
+
+    // Push frames of functions entered in run mode to the variable and backtrace models
+    void pushSkippedFrames( QScriptContext *context );
+
     int currentFunctionLineNumber() const;
     void fireup();
     void shutdown();
@@ -416,6 +441,11 @@ private:
     QScriptValue m_uncaughtException;
     QStringList m_uncaughtExceptionBacktrace;
     QHash< QString, QHash< uint, Breakpoint > > m_breakpoints; // Outer key: filename, inner key: line number
+    QHash< QString, QBitArray > m_breakpointLines; // Key: filename, bit set => enabled breakpoint
+    int m_breakpointLineCount; // Number of bits set in all m_breakpointLines bitmaps
+    QBitArray m_currentBreakpointLines; // Cached value of m_breakpointLines for the current script
+    qint64 m_currentBreakpointLinesScriptId; // Script ID of m_currentBreakpointLines, -2 if invalid
+    QAtomicInt m_checkPositions; // 0 in run mode, read without locking m_mutex in positionChange()
     int m_runUntilLineNumber; // -1 => "run until line number" not active
 
     DebuggerState m_state;
@@ -431,6 +461,7 @@ private:
 
     int m_interruptFunctionLevel;
     int m_functionDepth;
+    int m_modelFunctionDepth; // Number of frames pushed to the variable/backtrace models
 
     QHash< qint64, QString > m_scriptIdToFileName;
     QString m_mainScriptFileName;
@@ -29,10 +29,12 @@
 
 // PublicTransport engine includes
 #include <engine/script/serviceproviderscript.h> // For ServiceProviderScript::SCRIPT_FUNCTION_...
+#include <engine/script/networkreplay.h>
 
 // KDE includes
 #include <KLocalizedString>
 #include <KDebug>
+#include <KGlobal>
 #include <ThreadWeaver/DependencyPolicy>
 #include <ThreadWeaver/Thread>
 
@@ -46,6 +48,29 @@
 
 namespace Debugger {
 
+/** @brief Network fixture settings shared by all debugger jobs. */
+struct NetworkFixtureSettings {
+    NetworkFixtureSettings() : record(false) {};
+
+    QMutex mutex;
+    QString directory;
+    bool record;
+};
+K_GLOBAL_STATIC( NetworkFixtureSettings, networkFixtureSettings )
+
+void DebuggerJob::setNetworkFixtureDirectory( const QString &directory, bool record )
+{
+    QMutexLocker locker( &networkFixtureSettings->mutex );
+    networkFixtureSettings->directory = directory;
+    networkFixtureSettings->record = record;
+}
+
+QString DebuggerJob::networkFixtureDirectory()
+{
+    QMutexLocker locker( &networkFixtureSettings->mutex );
+    return networkFixtureSettings->directory;
+}
+
 DebuggerJob::DebuggerJob( const ScriptData &scriptData, const QString &useCase, QObject *parent )
         : ThreadWeaver::Job(parent), m_agent(0), m_data(scriptData), m_debugger(0),
           m_success(true), m_aborted(false), m_mutex(new QMutex(QMutex::Recursive)),
@@ -369,6 +394,21 @@ DebuggerAgent *DebuggerJob::createAgent() {
     QMutexLocker locker( m_mutex );
     const ScriptData data = m_data;
     m_objects.createObjects( data );
+
+    // Replay or record network fixtures, if enabled
+    networkFixtureSettings->mutex.lock();
+    const QString fixtureDir = networkFixtureSettings->directory;
+    const bool recordFixtures = networkFixtureSettings->record;
+    networkFixtureSettings->mutex.unlock();
+    if ( !fixtureDir.isEmpty() ) {
+        if ( recordFixtures ) {
+            new NetworkRecorder( fixtureDir, m_objects.network.data() );
+        } else {
+            m_objects.network->setNetworkAccessManager(
+                    new ReplayNetworkAccessManager(fixtureDir) );
+        }
+    }
+
     if ( !m_objects.attachToEngine(engine, data) ) {
         kDebug() << "Cannot attach script objects to engine" << m_objects.lastError;
         engine->setAgent( 0 );
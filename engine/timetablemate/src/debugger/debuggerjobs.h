@@ -115,6 +115,19 @@ public:
 
     static QString typeToString( JobType type );
 
+    /**
+     * @brief Let all jobs created afterwards use network fixtures from @p directory.
+     *
+     * If @p record is false, network requests of scripts get answered with fixtures from
+     * @p directory, see ReplayNetworkAccessManager. Otherwise the real network gets used and all
+     * replies get recorded into @p directory. Use an empty @p directory to use the real network
+     * without recording, which is the default.
+     **/
+    static void setNetworkFixtureDirectory( const QString &directory, bool record = false );
+
+    /** @brief The directory used for network fixtures, empty if the real network gets used. */
+    static QString networkFixtureDirectory();
+
     virtual QString defaultUseCase() const { return QString(); };
     void setUseCase( const QString &useCase );
     QString useCase() const;
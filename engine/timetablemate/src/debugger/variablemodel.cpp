@@ -915,7 +915,7 @@ VariableTreeData VariableTreeData::fromScripValue( const QString &name, const QS
 
             VariableTreeData dataItem( SpecialVariable, i18nc("@info/plain", "Data"),
                                     data.description, KIcon("documentinfo") );
-            int i = 1;
+            int i = result->publishedCount() + 1; // Published items are no longer stored
             QList<Enums::TimetableInformation> shortInfoTypes = QList<Enums::TimetableInformation>()
                     << Enums::Target << Enums::TargetStopName << Enums::DepartureDateTime
                     << Enums::DepartureTime << Enums::StopName;
@@ -955,7 +955,7 @@ VariableTreeData VariableTreeData::fromScripValue( const QString &name, const QS
 
             VariableTreeData requestsItem( SpecialVariable,  i18nc("@info/plain", "Running Requests"),
                                         data.description, KIcon("documentinfo") );
-            int i = 1;
+            int i = result->publishedCount() + 1; // Published items are no longer stored
             foreach ( const QSharedPointer< NetworkRequest > &networkRequest,
                       network->runningRequests() )
             {
@@ -0,0 +1,400 @@
+/*
+*   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU Library General Public License as
+*   published by the Free Software Foundation; either version 2 or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details
+*
+*   You should have received a copy of the GNU Library General Public
+*   License along with this program; if not, write to the
+*   Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+// Header
+#include "gtfsdatabasemodel.h"
+
+// PublicTransport engine includes
+#include <engine/gtfs/gtfsdatabase.h>
+
+// KDE includes
+#include <KDebug>
+#include <ThreadWeaver/Weaver>
+
+// Qt includes
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QSqlError>
+
+GtfsDatabaseQueryJob::GtfsDatabaseQueryJob( const QString &providerId, const QString &sql,
+                                            const QVariantList &values, int generation, int page,
+                                            QObject *parent )
+        : ThreadWeaver::Job(parent), m_providerId(providerId), m_sql(sql), m_values(values),
+          m_generation(generation), m_page(page), m_success(false)
+{
+}
+
+void GtfsDatabaseQueryJob::run()
+{
+    // Get a read-only connection to the database for this thread
+    QSqlDatabase database = GtfsDatabase::readOnlyDatabase( m_providerId, &m_errorString );
+    if ( !database.isOpen() ) {
+        return;
+    }
+
+    QSqlQuery query( database );
+    query.setForwardOnly( true );
+    if ( !query.prepare(m_sql) ) {
+        m_errorString = query.lastError().text();
+        return;
+    }
+    foreach ( const QVariant &value, m_values ) {
+        query.addBindValue( value );
+    }
+    if ( !query.exec() ) {
+        m_errorString = query.lastError().text();
+        return;
+    }
+
+    const int columns = query.record().count();
+    while ( query.next() ) {
+        QVector< QVariant > row( columns );
+        for ( int column = 0; column < columns; ++column ) {
+            row[ column ] = query.value( column );
+        }
+        m_rows << row;
+    }
+    m_success = true;
+}
+
+GtfsDatabaseModel::GtfsDatabaseModel( const QString &providerId, QObject *parent )
+        : QAbstractTableModel(parent), m_providerId(providerId), m_sortColumn(-1),
+          m_sortOrder(Qt::AscendingOrder), m_rowCount(0), m_rowCountExact(true),
+          m_rowCountUpperLimit(false), m_generation(0), m_pages(MAXIMUM_CACHED_PAGES)
+{
+}
+
+GtfsDatabaseModel::~GtfsDatabaseModel()
+{
+    foreach ( GtfsDatabaseQueryJob *job, m_runningJobs ) {
+        disconnect( job, 0, this, 0 );
+        if ( ThreadWeaver::Weaver::instance()->dequeue(job) ) {
+            delete job;
+        } else {
+            // The job is running, delete it when it is done
+            connect( job, SIGNAL(done(ThreadWeaver::Job*)), job, SLOT(deleteLater()) );
+            if ( job->isFinished() ) {
+                job->deleteLater();
+            }
+        }
+    }
+}
+
+void GtfsDatabaseModel::setTable( const QString &tableName )
+{
+    m_tableName = tableName;
+    m_sortColumn = -1;
+    reload();
+}
+
+void GtfsDatabaseModel::setFilter( const QString &filter )
+{
+    m_filter = filter.trimmed();
+    reload();
+}
+
+void GtfsDatabaseModel::sort( int column, Qt::SortOrder order )
+{
+    m_sortColumn = column >= 0 && column < m_columns.count() ? column : -1;
+    m_sortOrder = order;
+    reload();
+}
+
+void GtfsDatabaseModel::reload()
+{
+    beginResetModel();
+    ++m_generation;
+    m_pages.clear();
+    m_requestedPages.clear();
+    m_columns.clear();
+    m_rowCount = 0;
+    m_rowCountExact = true;
+    m_rowCountUpperLimit = false;
+
+    if ( !m_tableName.isEmpty() ) {
+        QSqlDatabase database = GtfsDatabase::database( m_providerId );
+        const QSqlRecord record = database.record( m_tableName );
+        for ( int i = 0; i < record.count(); ++i ) {
+            m_columns << record.fieldName( i );
+        }
+
+        if ( !m_columns.isEmpty() ) {
+            m_rowCountExact = false;
+            if ( m_filter.isEmpty() ) {
+                // Use the maximal rowid as estimate for the row count,
+                // it gets read from the table's B-tree without visiting all rows.
+                // Rowids start at 1, but can have gaps, ie. the estimate is an upper limit
+                QSqlQuery query( database );
+                if ( query.exec(QString("SELECT max(rowid) FROM %1").arg(m_tableName)) &&
+                     query.next() )
+                {
+                    m_rowCount = query.value( 0 ).toInt();
+                    m_rowCountUpperLimit = true;
+                }
+            }
+        }
+    }
+    endResetModel();
+    emit rowCountChanged( m_rowCount, m_rowCountExact );
+
+    if ( m_rowCountExact ) {
+        // No table or an unknown table
+        return;
+    }
+
+    // Count rows in the background, views show the estimated number of rows until then
+    enqueue( new GtfsDatabaseQueryJob(m_providerId,
+            QString("SELECT count(*) FROM %1%2").arg(m_tableName, whereClause()),
+            QVariantList(), m_generation) );
+
+    if ( !m_filter.isEmpty() ) {
+        // There is no cheap estimate for the number of matching rows,
+        // start with the first page, rows get added when pages are read
+        requestPage( 0 );
+    }
+}
+
+QString GtfsDatabaseModel::whereClause( const QString &keysetCondition ) const
+{
+    QStringList conditions;
+    if ( !m_filter.isEmpty() ) {
+        conditions << QString("(%1)").arg(m_filter);
+    }
+    if ( !keysetCondition.isEmpty() ) {
+        conditions << keysetCondition;
+    }
+    return conditions.isEmpty() ? QString() : " WHERE " + conditions.join(" AND ");
+}
+
+void GtfsDatabaseModel::requestPage( int page ) const
+{
+    if ( page < 0 || m_pages.contains(page) || m_requestedPages.contains(page) ) {
+        return;
+    }
+
+    // Rows are always ordered by rowid, optionally after the sort column.
+    // The order needs to be unique to continue reading after the last row of the previous page
+    const bool ascending = m_sortColumn < 0 || m_sortOrder == Qt::AscendingOrder;
+    const QString compare = ascending ? ">" : "<";
+    const QString sortColumn = m_sortColumn < 0 ? QString() : m_columns[m_sortColumn];
+    const QString orderBy = sortColumn.isEmpty() ? "rowid"
+            : QString("%1 %2, rowid %2").arg(sortColumn, ascending ? "ASC" : "DESC");
+
+    // Use the key of the last row of the previous page if it is cached,
+    // otherwise all rows before the page need to be skipped using OFFSET
+    QString keysetCondition;
+    QVariantList values;
+    const Page *previousPage = page > 0 ? m_pages.object(page - 1) : 0;
+    if ( previousPage && !previousPage->isEmpty() ) {
+        const QVector< QVariant > &lastRow = previousPage->last();
+        const QVariant lastRowId = lastRow.first();
+        if ( sortColumn.isEmpty() ) {
+            keysetCondition = "rowid > ?";
+            values << lastRowId;
+        } else {
+            const QVariant lastSortValue = lastRow[m_sortColumn + 1];
+            if ( !lastSortValue.isNull() ) {
+                // NULL values are sorted first, ie. they follow non-NULL values in descending order
+                keysetCondition = QString("(%1 %2 ?%3 OR (%1 = ? AND rowid %2 ?))")
+                        .arg(sortColumn, compare,
+                             ascending ? QString() : QString(" OR %1 IS NULL").arg(sortColumn));
+                values << lastSortValue << lastSortValue << lastRowId;
+            }
+        }
+    }
+
+    QString sql = QString("SELECT rowid, %1 FROM %2%3 ORDER BY %4 LIMIT ?")
+            .arg(m_columns.join(", "), m_tableName, whereClause(keysetCondition), orderBy);
+    values << PAGE_SIZE;
+    if ( keysetCondition.isEmpty() ) {
+        sql += " OFFSET ?";
+        values << page * PAGE_SIZE;
+    }
+
+    // Dequeue the oldest requests, if they were not started yet.
+    // Pages that are no longer visible after scrolling quickly do not need to be read
+    while ( m_requestedPages.count() >= MAXIMUM_REQUESTED_PAGES ) {
+        const int oldestPage = m_requestedPages.takeFirst();
+        foreach ( GtfsDatabaseQueryJob *job, m_runningJobs ) {
+            if ( job->page() == oldestPage && job->generation() == m_generation ) {
+                if ( ThreadWeaver::Weaver::instance()->dequeue(job) ) {
+                    m_runningJobs.removeOne( job );
+                    delete job;
+                }
+                break;
+            }
+        }
+    }
+
+    m_requestedPages << page;
+    enqueue( new GtfsDatabaseQueryJob(m_providerId, sql, values, m_generation, page) );
+}
+
+void GtfsDatabaseModel::enqueue( GtfsDatabaseQueryJob *job ) const
+{
+    if ( job->page() >= 0 ) {
+        connect( job, SIGNAL(done(ThreadWeaver::Job*)),
+                 this, SLOT(pageJobDone(ThreadWeaver::Job*)) );
+    } else {
+        connect( job, SIGNAL(done(ThreadWeaver::Job*)),
+                 this, SLOT(countJobDone(ThreadWeaver::Job*)) );
+    }
+    m_runningJobs << job;
+    ThreadWeaver::Weaver::instance()->enqueue( job );
+}
+
+bool GtfsDatabaseModel::takeJob( GtfsDatabaseQueryJob *job )
+{
+    m_runningJobs.removeOne( job );
+    job->deleteLater();
+    if ( job->generation() != m_generation ) {
+        // The table, filter or sort order has changed since the job was started
+        return false;
+    }
+
+    if ( !job->success() ) {
+        kDebug() << "Error while reading from the GTFS database:" << job->errorString();
+        emit errorOccurred( job->errorString() );
+        return false;
+    }
+    return true;
+}
+
+void GtfsDatabaseModel::pageJobDone( ThreadWeaver::Job *job )
+{
+    GtfsDatabaseQueryJob *pageJob = qobject_cast< GtfsDatabaseQueryJob* >( job );
+    Q_ASSERT( pageJob );
+    if ( pageJob->generation() == m_generation ) {
+        m_requestedPages.removeOne( pageJob->page() );
+    }
+    if ( !takeJob(pageJob) ) {
+        return;
+    }
+
+    const Page rows = pageJob->rows();
+    const int firstRow = pageJob->page() * PAGE_SIZE;
+    const int lastRow = firstRow + rows.count();
+    m_pages.insert( pageJob->page(), new Page(rows) );
+    if ( !m_rowCountExact ) {
+        if ( rows.count() < PAGE_SIZE ) {
+            // A short or empty page was read, there are no more rows than lastRow. This is only
+            // an upper limit, rows may have changed since the previous page was read, the exact
+            // number of rows gets counted in the background, see countJobDone()
+            if ( !m_rowCountUpperLimit || lastRow < m_rowCount ) {
+                m_rowCountUpperLimit = true;
+                setRowCount( lastRow, false );
+            }
+        } else if ( lastRow > m_rowCount ) {
+            setRowCount( lastRow, false );
+        }
+    }
+
+    if ( !rows.isEmpty() ) {
+        emit dataChanged( index(firstRow, 0),
+                          index(firstRow + rows.count() - 1, m_columns.count() - 1) );
+    }
+}
+
+void GtfsDatabaseModel::countJobDone( ThreadWeaver::Job *job )
+{
+    GtfsDatabaseQueryJob *countJob = qobject_cast< GtfsDatabaseQueryJob* >( job );
+    Q_ASSERT( countJob );
+    if ( !takeJob(countJob) || countJob->rows().isEmpty() ) {
+        return;
+    }
+
+    setRowCount( countJob->rows().first().first().toInt(), true );
+}
+
+void GtfsDatabaseModel::setRowCount( int count, bool exact )
+{
+    if ( count == m_rowCount && exact == m_rowCountExact ) {
+        return;
+    }
+
+    if ( count > m_rowCount ) {
+        beginInsertRows( QModelIndex(), m_rowCount, count - 1 );
+        m_rowCount = count;
+        endInsertRows();
+    } else if ( count < m_rowCount ) {
+        beginRemoveRows( QModelIndex(), count, m_rowCount - 1 );
+        m_rowCount = count;
+        endRemoveRows();
+    }
+    m_rowCountExact = exact;
+    emit rowCountChanged( m_rowCount, m_rowCountExact );
+}
+
+int GtfsDatabaseModel::rowCount( const QModelIndex &parent ) const
+{
+    return parent.isValid() ? 0 : m_rowCount;
+}
+
+int GtfsDatabaseModel::columnCount( const QModelIndex &parent ) const
+{
+    return parent.isValid() ? 0 : m_columns.count();
+}
+
+QVariant GtfsDatabaseModel::data( const QModelIndex &index, int role ) const
+{
+    if ( !index.isValid() || (role != Qt::DisplayRole && role != Qt::EditRole) ) {
+        return QVariant();
+    }
+
+    const int pageIndex = index.row() / PAGE_SIZE;
+    const int pageRow = index.row() % PAGE_SIZE;
+    const Page *page = m_pages.object( pageIndex );
+    if ( !page ) {
+        // Rows get shown when the page was read, see pageJobDone()
+        requestPage( pageIndex );
+        return QVariant();
+    }
+
+    if ( pageRow >= PAGE_SIZE * 3 / 4 && (pageIndex + 1) * PAGE_SIZE < m_rowCount ) {
+        // Read the next page before it gets shown, using the key of the last row of this page
+        requestPage( pageIndex + 1 );
+    }
+
+    // The first value of each row is the rowid
+    return pageRow < page->count() ? page->at(pageRow).value(index.column() + 1) : QVariant();
+}
+
+QVariant GtfsDatabaseModel::headerData( int section, Qt::Orientation orientation, int role ) const
+{
+    if ( orientation == Qt::Horizontal && role == Qt::DisplayRole ) {
+        return m_columns.value( section );
+    }
+    return QAbstractTableModel::headerData( section, orientation, role );
+}
+
+bool GtfsDatabaseModel::canFetchMore( const QModelIndex &parent ) const
+{
+    // Only filtered tables start without an estimate, the row count grows with read pages
+    // until a short page was read. Other rows get shown until the exact row count is known
+    return !parent.isValid() && !m_rowCountExact && !m_rowCountUpperLimit;
+}
+
+void GtfsDatabaseModel::fetchMore( const QModelIndex &parent )
+{
+    if ( !parent.isValid() ) {
+        // Read the page following the last known row, which adds rows if it is not empty
+        requestPage( m_rowCount / PAGE_SIZE );
+    }
+}
@@ -0,0 +1,204 @@
+/*
+*   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU Library General Public License as
+*   published by the Free Software Foundation; either version 2 or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details
+*
+*   You should have received a copy of the GNU Library General Public
+*   License along with this program; if not, write to the
+*   Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef GTFSDATABASEMODEL_H
+#define GTFSDATABASEMODEL_H
+
+// KDE includes
+#include <ThreadWeaver/Job> // Base class
+
+// Qt includes
+#include <QAbstractTableModel>
+#include <QCache>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+
+/**
+ * @brief Runs an SQL statement on a GTFS database in a ThreadWeaver thread.
+ *
+ * Uses a read-only connection to the GTFS database for the thread it runs in, see
+ * GtfsDatabase::readOnlyDatabase(). Values get bound to positional placeholders in the order
+ * in which they are given.
+ **/
+class GtfsDatabaseQueryJob : public ThreadWeaver::Job {
+    Q_OBJECT
+
+public:
+    GtfsDatabaseQueryJob( const QString &providerId, const QString &sql,
+                          const QVariantList &values, int generation, int page = -1,
+                          QObject *parent = 0 );
+
+    /** @brief Overwritten from ThreadWeaver::Job to return whether or not the job was successful. */
+    virtual bool success() const { return m_success; };
+
+    /** @brief The generation of the model state for which this job was started. */
+    int generation() const { return m_generation; };
+
+    /** @brief The page of rows queried by this job or -1, if it does not query a page. */
+    int page() const { return m_page; };
+
+    /**
+     * @brief The rows of the query result.
+     * @note This should only be used after the job is done.
+     **/
+    QList< QVector<QVariant> > rows() const { return m_rows; };
+
+    /** @brief A string describing the error, if success() returns false. */
+    QString errorString() const { return m_errorString; };
+
+protected:
+    /** @brief Perform the job. */
+    virtual void run();
+
+private:
+    const QString m_providerId;
+    const QString m_sql;
+    const QVariantList m_values;
+    const int m_generation;
+    const int m_page;
+    QList< QVector<QVariant> > m_rows;
+    QString m_errorString;
+    bool m_success;
+};
+
+/**
+ * @brief A read-only model for a table of a GTFS database, which loads rows lazily.
+ *
+ * GTFS databases can contain millions of rows, eg. in the 'stop_times' table. Unlike
+ * QSqlTableModel this model does not read all rows of the table. Rows get read in pages of
+ * PAGE_SIZE rows in a ThreadWeaver thread, when they are first requested by a view. At most
+ * MAXIMUM_CACHED_PAGES pages are kept in memory, the least recently used pages get dropped.
+ * When scrolling quickly only the MAXIMUM_REQUESTED_PAGES most recently requested pages get read,
+ * older requests get dequeued if they were not started yet.
+ *
+ * A page directly following a cached page gets read using the last key of the cached page
+ * ("keyset pagination", eg. "WHERE rowid > :lastRowId"), which can use an index instead of
+ * skipping all previous rows like OFFSET does.
+ *
+ * Filtering (see setFilter()) and sorting (see sort()) is done by the database. The row count
+ * starts with a cheap estimate, ie. the maximal rowid of the table, while the exact number of
+ * rows gets counted in the background, see isRowCountExact() and rowCountChanged(). Short or
+ * empty pages, eg. after jumping to the end of the table, only reduce the estimate, only the
+ * counted number of rows is exact. Filtered tables start without rows, rows get added when
+ * views fetch more rows, see canFetchMore().
+ **/
+class GtfsDatabaseModel : public QAbstractTableModel {
+    Q_OBJECT
+
+public:
+    /** @brief The number of rows read at once. */
+    static const int PAGE_SIZE = 256;
+
+    /** @brief The maximal number of pages kept in memory. */
+    static const int MAXIMUM_CACHED_PAGES = 16;
+
+    /** @brief The maximal number of pages waiting to be read. */
+    static const int MAXIMUM_REQUESTED_PAGES = 4;
+
+    /** @brief Create a new model for the GTFS database of the provider with @p providerId. */
+    explicit GtfsDatabaseModel( const QString &providerId, QObject *parent = 0 );
+
+    /** @brief Destructor, running jobs get deleted when they are done. */
+    virtual ~GtfsDatabaseModel();
+
+    /** @brief The name of the currently shown table. */
+    QString tableName() const { return m_tableName; };
+
+    /** @brief Show the table with @p tableName. */
+    void setTable( const QString &tableName );
+
+    /** @brief The currently used filter, an SQL WHERE clause without the WHERE keyword. */
+    QString filter() const { return m_filter; };
+
+    /**
+     * @brief Only show rows matching @p filter.
+     *
+     * @param filter An SQL WHERE clause without the WHERE keyword, eg. "stop_name LIKE 'A%'".
+     *   Use an empty string to show all rows.
+     **/
+    void setFilter( const QString &filter );
+
+    /** @brief Whether or not rowCount() is exact or an estimate. */
+    bool isRowCountExact() const { return m_rowCountExact; };
+
+    /** @brief Sort the table by @p column in the database. */
+    virtual void sort( int column, Qt::SortOrder order = Qt::AscendingOrder );
+
+    virtual int rowCount( const QModelIndex &parent = QModelIndex() ) const;
+    virtual int columnCount( const QModelIndex &parent = QModelIndex() ) const;
+    virtual QVariant data( const QModelIndex &index, int role = Qt::DisplayRole ) const;
+    virtual QVariant headerData( int section, Qt::Orientation orientation,
+                                 int role = Qt::DisplayRole ) const;
+    virtual bool canFetchMore( const QModelIndex &parent = QModelIndex() ) const;
+    virtual void fetchMore( const QModelIndex &parent = QModelIndex() );
+
+signals:
+    /** @brief The number of rows has changed to @p count, @p exact is false for estimates. */
+    void rowCountChanged( int count, bool exact );
+
+    /** @brief An error occurred while reading rows, eg. because of an invalid filter. */
+    void errorOccurred( const QString &errorText );
+
+protected slots:
+    void pageJobDone( ThreadWeaver::Job *job );
+    void countJobDone( ThreadWeaver::Job *job );
+
+private:
+    /** @brief Rows of a page, the first value of each row is its rowid. */
+    typedef QList< QVector<QVariant> > Page;
+
+    /** @brief Drop all cached rows, estimate the row count and start counting rows. */
+    void reload();
+
+    /** @brief Start a job to read @p page, if it is not already cached or being read. */
+    void requestPage( int page ) const;
+
+    /** @brief Start @p job in a ThreadWeaver thread, pageJobDone()/countJobDone() gets called. */
+    void enqueue( GtfsDatabaseQueryJob *job ) const;
+
+    /** @brief Set the number of rows to @p count and notify views. */
+    void setRowCount( int count, bool exact );
+
+    /** @brief Get the WHERE clause for the current filter and @p keysetCondition. */
+    QString whereClause( const QString &keysetCondition = QString() ) const;
+
+    /** @brief Remove a finished job, returns false if it failed or its results are outdated. */
+    bool takeJob( GtfsDatabaseQueryJob *job );
+
+    const QString m_providerId;
+    QString m_tableName;
+    QString m_filter;
+    QStringList m_columns;
+    int m_sortColumn;
+    Qt::SortOrder m_sortOrder;
+
+    int m_rowCount;
+    bool m_rowCountExact;
+    bool m_rowCountUpperLimit; // Whether m_rowCount is not smaller than the exact row count
+
+    // Incremented when the table, filter or sort order changes, to discard outdated results
+    int m_generation;
+
+    mutable QCache< int, Page > m_pages;
+    mutable QList< int > m_requestedPages; // Pages being read, the most recently requested last
+    mutable QList< GtfsDatabaseQueryJob* > m_runningJobs;
+};
+
+#endif // Multiple inclusion guard
@@ -431,16 +431,50 @@ QList< CodeNode::Ptr > JavaScriptModel::childFunctions( const CodeNode::Ptr &nod
 
 void JavaScriptModel::setNodes( const QList< CodeNode::Ptr > nodes )
 {
-    clear();
-
-    QList< CodeNode::Ptr > flatNodes = QList< CodeNode::Ptr >() << nodes;
+    // Keep the empty node at the beginning, if any,
+    // child functions get inserted after their top level node
+    QList< CodeNode::Ptr > flatNodes;
+    if ( !m_nodes.isEmpty() && m_nodes.first().dynamicCast<EmptyNode>() ) {
+        flatNodes << m_nodes.first();
+    }
     foreach ( const CodeNode::Ptr &node, nodes ) {
-        flatNodes << childFunctions( node );
+        flatNodes << node << childFunctions( node );
     }
 
-    beginInsertRows( QModelIndex(), 0, flatNodes.count() - 1 );
-    m_nodes = flatNodes;
-    endInsertRows();
+    // Only replace rows between unchanged nodes at the beginning and at the end,
+    // nodes reused by the parser (see JavaScriptParser) are unchanged
+    int unchangedBegin = 0;
+    while ( unchangedBegin < m_nodes.count() && unchangedBegin < flatNodes.count() &&
+            m_nodes[unchangedBegin] == flatNodes[unchangedBegin] )
+    {
+        ++unchangedBegin;
+    }
+    int unchangedEnd = 0;
+    while ( unchangedEnd < m_nodes.count() - unchangedBegin &&
+            unchangedEnd < flatNodes.count() - unchangedBegin &&
+            m_nodes[m_nodes.count() - 1 - unchangedEnd] ==
+            flatNodes[flatNodes.count() - 1 - unchangedEnd] )
+    {
+        ++unchangedEnd;
+    }
+
+    const int removeCount = m_nodes.count() - unchangedBegin - unchangedEnd;
+    if ( removeCount > 0 ) {
+        beginRemoveRows( QModelIndex(), unchangedBegin, unchangedBegin + removeCount - 1 );
+        for ( int i = 0; i < removeCount; ++i ) {
+            m_nodes.removeAt( unchangedBegin );
+        }
+        endRemoveRows();
+    }
+
+    const int insertCount = flatNodes.count() - unchangedBegin - unchangedEnd;
+    if ( insertCount > 0 ) {
+        beginInsertRows( QModelIndex(), unchangedBegin, unchangedBegin + insertCount - 1 );
+        for ( int i = 0; i < insertCount; ++i ) {
+            m_nodes.insert( unchangedBegin + i, flatNodes[unchangedBegin + i] );
+        }
+        endInsertRows();
+    }
 
     updateFirstEmptyNodeName();
 }
@@ -56,6 +56,12 @@ public:
 
     void clear();
     void appendNodes( const QList< CodeNode::Ptr > nodes );
+    /**
+     * @brief Show @p nodes, replacing the current nodes.
+     *
+     * Only rows of changed nodes get removed/inserted, nodes which are also contained in the
+     * current nodes are kept, eg. nodes reused by JavaScriptParser.
+     **/
     void setNodes( const QList< CodeNode::Ptr > nodes );
 
     QStringList functionNames() const;
@@ -33,6 +33,14 @@ CodeNode::CodeNode( const QString& text, int line, int colStart, int colEnd ) :
     m_id = text;
 }
 
+void CodeNode::moveLines( int lineDelta )
+{
+    m_line += lineDelta;
+    foreach ( const CodeNode::Ptr &child, children() ) {
+        child->moveLines( lineDelta );
+    }
+}
+
 CodeNode* CodeNode::topLevelParent() const
 {
     CodeNode *node = const_cast<CodeNode*>( this );
@@ -77,13 +85,26 @@ CodeNode *CodeNode::childFromPosition( int lineNumber, int column ) const
     }
 }
 
-JavaScriptParser::JavaScriptParser( const QString &code )
+JavaScriptParser::JavaScriptParser( const QString &code, const JavaScriptParser *previous )
 {
     m_code = code;
+    m_reusedNodeCount = 0;
+    m_movedNodesBegin = 0;
+    m_lineDelta = 0;
     m_hasError = false;
     m_errorLine = -1;
     m_errorColumn = 0;
-    m_nodes = parse();
+    m_nodes = parse( previous );
+}
+
+void JavaScriptParser::updateLineNumbers()
+{
+    if ( m_lineDelta != 0 ) {
+        for ( int i = m_movedNodesBegin; i < m_nodes.count(); ++i ) {
+            m_nodes[i]->moveLines( m_lineDelta );
+        }
+        m_lineDelta = 0;
+    }
 }
 
 JavaScriptParser::~JavaScriptParser()
@@ -647,21 +668,73 @@ BlockNode::Ptr JavaScriptParser::parseBlock()
     return BlockNode::Ptr( 0 );
 }
 
-QList< CodeNode::Ptr > JavaScriptParser::parse()
+QList< CodeNode::Ptr > JavaScriptParser::parse( const JavaScriptParser *previous )
 {
     clearError();
+    const QStringList lines2 = m_code.split( '\n' );
+
+    // Reuse top level nodes of the previous parser that are not affected by changed lines.
+    // Nodes of a previous parser with an error are not reused, parsing stopped at the error
+    QList< CodeNode::Ptr > nodes;
+    int firstLine = 0; // Index of the line where tokenizing starts
+    int firstColumn = 0; // Column in the first line where tokenizing starts
+    int reusableNode = -1; // Index of the next node of previous, that may get reused
+    if ( previous && !previous->hasError() && !previous->m_nodes.isEmpty() ) {
+        // Find the changed lines, compare lines from the beginning and from the end
+        const QStringList previousLines = previous->m_code.split( '\n' );
+        const int minLineCount = qMin( lines2.count(), previousLines.count() );
+        int unchangedBegin = 0;
+        while ( unchangedBegin < minLineCount &&
+                lines2[unchangedBegin] == previousLines[unchangedBegin] )
+        {
+            ++unchangedBegin;
+        }
+        int unchangedEnd = 0;
+        while ( unchangedEnd < minLineCount - unchangedBegin &&
+                lines2[lines2.count() - 1 - unchangedEnd] ==
+                previousLines[previousLines.count() - 1 - unchangedEnd] )
+        {
+            ++unchangedEnd;
+        }
+
+        // Reuse nodes at the beginning, if the following node starts before the first changed
+        // line. Line numbers are one-based, ie. line unchangedBegin is the last unchanged line
+        const QList< NodePosition > &positions = previous->m_nodePositions;
+        int node = 0;
+        while ( node + 1 < positions.count() && positions[node + 1].line <= unchangedBegin ) {
+            nodes << previous->m_nodes[node];
+            m_nodePositions << positions[node];
+            ++node;
+        }
+        m_reusedNodeCount = node;
+        if ( node > 0 ) {
+            // Start parsing at the first token of the first node that was not reused
+            firstLine = positions[node].line - 1;
+            firstColumn = positions[node].column;
+        }
+
+        // Nodes starting after the last changed line get reused, if parsing reaches their
+        // first token, the code from there up to the end is unchanged
+        const int lastChangedLine = previousLines.count() - unchangedEnd;
+        m_lineDelta = lines2.count() - previousLines.count();
+        reusableNode = node;
+        while ( reusableNode < positions.count() &&
+                positions[reusableNode].line <= lastChangedLine )
+        {
+            ++reusableNode;
+        }
+    }
 
     // Get token from the code, with line number and column begin/end
     m_token.clear();
     QString alpha( "abcdefghijklmnopqrstuvwxyz_" );
     QRegExp rxTokenBegin( "\\S" );
     QRegExp rxTokenEnd( "\\s|[-=#!$%&~;:,<>^`´/\\.\\+\\*\\\\\\(\\)\\{\\}\\[\\]'\"\\?\\|]" );
-    QStringList lines2 = m_code.split( '\n' );
-    for ( int lineNr = 0; lineNr < lines2.count(); ++lineNr ) {
+    for ( int lineNr = firstLine; lineNr < lines2.count(); ++lineNr ) {
         QString line = lines2.at( lineNr );
         QStringList words;
 
-        int posStart = 0;
+        int posStart = lineNr == firstLine ? firstColumn : 0;
         while ( (posStart = rxTokenBegin.indexIn(line, posStart)) != -1 ) {
             int posEnd;
             bool isName;
@@ -689,9 +762,38 @@ QList< CodeNode::Ptr > JavaScriptParser::parse()
     }
 
     // Get nodes from the token
-    QList< CodeNode::Ptr > nodes;
     m_it = m_token.constBegin();
     while ( !atEnd() ) {
+        const Token *token = currentToken();
+        if ( reusableNode >= 0 ) {
+            // Test if the first token of a reusable node of the previous parser is reached,
+            // the positions of the reusable nodes need to be moved by m_lineDelta lines
+            const QList< NodePosition > &positions = previous->m_nodePositions;
+            while ( reusableNode < positions.count() &&
+                    (positions[reusableNode].line + m_lineDelta < token->line ||
+                     (positions[reusableNode].line + m_lineDelta == token->line &&
+                      positions[reusableNode].column < token->posStart)) )
+            {
+                ++reusableNode;
+            }
+            if ( reusableNode == positions.count() ) {
+                // No more reusable nodes
+                reusableNode = -1;
+            } else if ( positions[reusableNode].line + m_lineDelta == token->line &&
+                        positions[reusableNode].column == token->posStart )
+            {
+                // Reuse all following nodes, the code from here up to the end is unchanged
+                m_movedNodesBegin = nodes.count();
+                m_reusedNodeCount += positions.count() - reusableNode;
+                for ( int node = reusableNode; node < positions.count(); ++node ) {
+                    nodes << previous->m_nodes[node];
+                    m_nodePositions << NodePosition( positions[node].line + m_lineDelta,
+                                                     positions[node].column );
+                }
+                break;
+            }
+        }
+
         CodeNode::Ptr node( 0 );
         if ( (node = parseComment())
             || (!m_hasError && (node = parseString()))
@@ -701,6 +803,7 @@ QList< CodeNode::Ptr > JavaScriptParser::parse()
             || (!m_hasError && (node = parseStatement())) )
         {
             nodes << CodeNode::Ptr(node);
+            m_nodePositions << NodePosition( token->line, token->posStart );
 
             if ( m_hasError ) {
                 break;
@@ -713,21 +816,26 @@ QList< CodeNode::Ptr > JavaScriptParser::parse()
     // Done with the tokens, delete them
     qDeleteAll( m_token );
     m_token.clear();
+    if ( m_movedNodesBegin == 0 ) {
+        // No nodes reused after the changed lines, no need to move nodes
+        m_lineDelta = 0;
+    }
 
-    // Check for multiple definitions
-    QHash< QString, FunctionNode::Ptr > functions;
-    foreach ( const CodeNode::Ptr &node, nodes ) {
-        FunctionNode::Ptr function = node.dynamicCast<FunctionNode>();
+    // Check for multiple definitions, use line numbers from m_nodePositions,
+    // because reused nodes are not yet moved to their new line numbers
+    QHash< QString, int > functions; // Function names and indices in nodes
+    for ( int i = 0; i < nodes.count(); ++i ) {
+        FunctionNode::Ptr function = nodes[i].dynamicCast<FunctionNode>();
         if ( function ) {
             QString newFunctionName = function->toString( true );
             if ( functions.contains(newFunctionName) ) {
-                FunctionNode::Ptr previousImpl = functions.value( newFunctionName );
+                const int previousLine = m_nodePositions[ functions.value(newFunctionName) ].line;
                 setErrorState( i18nc("@info/plain", "Multiple definitions of function '%1', "
                                      "previously defined at line %2",
-                                     function->text(), previousImpl->line()),
-                               function->line(), function->column(), previousImpl->line() );
+                                     function->text(), previousLine),
+                               m_nodePositions[i].line, function->column(), previousLine );
             } else {
-                functions.insert( newFunctionName, function );
+                functions.insert( newFunctionName, i );
             }
         }
     }
@@ -764,6 +872,12 @@ MultilineNode::MultilineNode( const QString& text, int line, int colStart, int l
     m_endLine = lineEnd;
 }
 
+void MultilineNode::moveLines( int lineDelta )
+{
+    CodeNode::moveLines( lineDelta );
+    m_endLine += lineDelta;
+}
+
 ChildListNode::ChildListNode( const QString& text, int line, int colStart,
                               int lineEnd, int colEnd, const QList< CodeNode::Ptr > &children )
         : MultilineNode( text, line, colStart, lineEnd, colEnd ), m_children(children)
@@ -126,6 +126,13 @@ public:
     /** @brief The last column of this node in it's last line. */
     int columnEnd() const { return m_colEnd; };
 
+    /**
+     * @brief Move this node and all child nodes by @p lineDelta lines.
+     *
+     * Used to update nodes that get reused after lines were inserted/removed before them.
+     **/
+    virtual void moveLines( int lineDelta );
+
 protected:
     QString m_id;
     QString m_text;
@@ -145,6 +152,8 @@ public:
     /** @brief The last line of this node. */
     virtual int endLine() const { return m_endLine; };
 
+    virtual void moveLines( int lineDelta );
+
 protected:
     int m_endLine;
 };
@@ -361,13 +370,28 @@ private:
     bool m_anonymous;
 };
 
-/** @brief Parses java script code. */
+/**
+ * @brief Parses java script code.
+ *
+ * To parse a changed version of already parsed code, give the parser of the previous version
+ * to the constructor. Top level nodes of the previous parser, which are not affected by the
+ * changed lines, get reused without parsing them again. Only the code from the first affected
+ * top level node up to the first reusable top level node after the changed lines gets parsed.
+ *
+ * Reused nodes get shared with the previous parser, they do not get changed while parsing.
+ * This allows to parse in another thread while the previous nodes are still used. Nodes reused
+ * after the changed lines need to be moved to their new line numbers using updateLineNumbers()
+ * before they get used.
+ **/
 class JavaScriptParser {
 public:
     /** @brief Creates a new parser object and parses the given @p code.
+     * @param code The java script code to parse.
+     * @param previous The parser for a previous version of @p code or 0. If given, nodes of
+     *   @p previous get reused where possible.
      * @see nodes
      * @see hasError */
-    JavaScriptParser( const QString &code );
+    JavaScriptParser( const QString &code, const JavaScriptParser *previous = 0 );
 
     virtual ~JavaScriptParser();
 
@@ -377,6 +401,18 @@ public:
     /** @returns the parsed list of nodes. */
     QList< CodeNode::Ptr > nodes() const { return m_nodes; };
 
+    /** @returns the number of top level nodes reused from the previous parser. */
+    int reusedNodeCount() const { return m_reusedNodeCount; };
+
+    /**
+     * @brief Move nodes reused after the changed lines to their new line numbers.
+     *
+     * This changes nodes shared with the previous parser, it needs to be called in the thread
+     * that uses the nodes, eg. the GUI thread, after the parser has finished. Further calls do
+     * nothing.
+     **/
+    void updateLineNumbers();
+
     /** Wheather or not there was an error while parsing. */
     bool hasError() const { return m_hasError; };
 
@@ -422,7 +458,15 @@ private:
         int posStart, posEnd;
     };
 
-    QList< CodeNode::Ptr > parse();
+    /** @brief The position of the first token of a top level node. */
+    struct NodePosition {
+        NodePosition( int line = 0, int column = 0 ) : line(line), column(column) {};
+
+        int line;
+        int column;
+    };
+
+    QList< CodeNode::Ptr > parse( const JavaScriptParser *previous = 0 );
     CodeNode::Ptr parseComment();
     CodeNode::Ptr parseString();
     CodeNode::Ptr parseBracketed();
@@ -450,6 +494,11 @@ private:
 private:
     QString m_code;
     QList< CodeNode::Ptr > m_nodes;
+    QList< NodePosition > m_nodePositions; // Positions of the top level nodes in m_nodes
+
+    int m_reusedNodeCount;
+    int m_movedNodesBegin; // Index of the first node in m_nodes needing updateLineNumbers()
+    int m_lineDelta; // Number of lines to move nodes beginning at m_movedNodesBegin
 
     QList<Token*> m_token;
     QList<Token*>::const_iterator m_it;
@@ -17,13 +17,26 @@
 *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 */
 
+#include "config.h"
 #include "timetablemate.h"
+#include "batchtestrunner.h"
+#ifdef BUILD_PROVIDER_TYPE_SCRIPT
+    #include "debugger/debuggerjobs.h"
+#endif
+
+#include <engine/serviceproviderglobal.h>
 
 #include <KUniqueApplication>
+#include <KApplication>
 #include <KAboutData>
 #include <KCmdLineArgs>
 #include <KDE/KLocale>
 #include <KMainWindow>
+#include <KDebug>
+#include <ThreadWeaver/Weaver>
+
+#include <QEventLoop>
+#include <QFile>
 
 static const char description[] =
     I18N_NOOP("A little IDE for adding support for new service providers to "
@@ -31,6 +44,75 @@ static const char description[] =
 
 static const char version[] = "0.3";
 
+/**
+ * @brief Test the projects given on the command line without showing a main window.
+ *
+ * A report gets written in the JUnit XML format to the file given with --report or to stdout.
+ * @return 0, if all tests were successful, 1 if there were failing tests, 2 for invalid
+ *   arguments.
+ **/
+int runBatchTests( KCmdLineArgs *args )
+{
+#ifdef BUILD_PROVIDER_TYPE_SCRIPT
+    // Use the real network, replay fixtures or record them
+    if ( args->isSet("fixtures") ) {
+        Debugger::DebuggerJob::setNetworkFixtureDirectory( args->getOption("fixtures"),
+                                                           args->isSet("record-fixtures") );
+    }
+#endif
+
+    // Script jobs of all tested projects run in the thread pool of this weaver
+    bool ok;
+    const int jobs = args->getOption( "jobs" ).toInt( &ok );
+    if ( !ok || jobs < 1 ) {
+        kWarning() << "Invalid number of jobs" << args->getOption("jobs");
+        return 2;
+    }
+    ThreadWeaver::Weaver *weaver = new ThreadWeaver::Weaver();
+    weaver->setMaximumNumberOfThreads( jobs );
+
+    BatchTestRunner runner( WeaverInterfacePointer(weaver) );
+    runner.setMaximumRunningProjects( jobs );
+    runner.setTimeout( args->getOption("timeout").toInt() );
+    if ( args->isSet("test-datetime") ) {
+        const QDateTime dateTime = QDateTime::fromString( args->getOption("test-datetime"),
+                                                          Qt::ISODate );
+        if ( !dateTime.isValid() ) {
+            kWarning() << "Invalid test date and time" << args->getOption("test-datetime");
+            return 2;
+        }
+        runner.setTestDateTime( dateTime );
+    }
+
+    const QStringList providers = args->isSet("test-all")
+            ? ServiceProviderGlobal::installedProviders() : args->getOptionList("test");
+    foreach ( const QString &provider, providers ) {
+        if ( !runner.addProject(provider) ) {
+            return 2;
+        }
+    }
+
+    QEventLoop loop;
+    QObject::connect( &runner, SIGNAL(finished()), &loop, SLOT(quit()) );
+    runner.start();
+    if ( !runner.isFinished() ) {
+        loop.exec();
+    }
+
+    QFile report;
+    if ( args->isSet("report") ) {
+        report.setFileName( args->getOption("report") );
+        if ( !report.open(QIODevice::WriteOnly | QIODevice::Truncate) ) {
+            kWarning() << "Cannot write report" << report.fileName() << report.errorString();
+            return 2;
+        }
+    } else {
+        report.open( stdout, QIODevice::WriteOnly );
+    }
+    runner.writeReport( &report );
+    return runner.hasErrors() ? 1 : 0;
+}
+
 int main(int argc, char **argv)
 {
     KAboutData about( "timetablemate", 0, ki18n("TimetableMate"), version, ki18n(description),
@@ -42,7 +124,32 @@ int main(int argc, char **argv)
 
     KCmdLineOptions options;
     options.add( "+[URL]", ki18n("Project to open") );
+    options.add( "test <provider>", ki18n("Test the given provider ID or provider XML file "
+                                          "without showing a window, can be used multiple times") );
+    options.add( "test-all", ki18n("Test all installed providers without showing a window") );
+    options.add( "jobs <count>", ki18n("Number of tests to run in parallel"), "4" );
+    options.add( "timeout <seconds>",
+                 ki18n("Abort tests of a provider after the given number of seconds, 0 to disable"),
+                 "0" );
+    options.add( "fixtures <directory>",
+                 ki18n("Answer network requests of tests with fixtures from the given directory") );
+    options.add( "record-fixtures",
+                 ki18n("Record network replies of tests into the --fixtures directory") );
+    options.add( "test-datetime <datetime>",
+                 ki18n("Date and time to use in test requests (ISO format), needed to replay "
+                       "recorded fixtures") );
+    options.add( "report <file>",
+                 ki18n("Write a JUnit XML test report to the given file instead of stdout") );
     KCmdLineArgs::addCmdLineOptions( options );
+
+    KCmdLineArgs *batchArgs = KCmdLineArgs::parsedArgs();
+    if ( batchArgs->isSet("test") || batchArgs->isSet("test-all") ) {
+        // Batch mode, no unique application and no main window. A GUI application is still
+        // needed, because projects create actions and use the color scheme.
+        KApplication app;
+        return runBatchTests( batchArgs );
+    }
+
     KUniqueApplication app;
 
     // See if we are starting with session management
@@ -1521,6 +1521,12 @@ public:
         endTesting();
     };
 
+    // Get the date and time to use for test requests
+    QDateTime testRequestDateTime() const
+    {
+        return testDateTime.isValid() ? testDateTime : QDateTime::currentDateTime();
+    };
+
     bool testForCoordinatesSampleData()
     {
 #ifdef BUILD_PROVIDER_TYPE_SCRIPT
@@ -1834,12 +1840,12 @@ public:
                 switch ( test ) {
                 case TestModel::DepartureTest:
                     request = new DepartureRequest( "TEST_DEPARTURES",
-                            data()->sampleStopNames().first(), QDateTime::currentDateTime(),
+                            data()->sampleStopNames().first(), testRequestDateTime(),
                             testItemCount, data()->sampleCity() );
                     break;
                 case TestModel::ArrivalTest: {
                     request = new ArrivalRequest( "TEST_ARRIVALS",
-                            data()->sampleStopNames().first(), QDateTime::currentDateTime(),
+                            data()->sampleStopNames().first(), testRequestDateTime(),
                             testItemCount, data()->sampleCity() );
                     break;
                 }
@@ -1871,7 +1877,7 @@ public:
                 case TestModel::JourneyTest:
                     request = new JourneyRequest( "TEST_JOURNEYS",
                             data()->sampleStopNames().first(), data()->sampleStopNames()[1],
-                            QDateTime::currentDateTime(), testItemCount, QString(),
+                            testRequestDateTime(), testItemCount, QString(),
                             data()->sampleCity() );
                     break;
                 default:
@@ -2513,6 +2519,7 @@ public:
     QStringList includedFiles;
     bool suppressMessages;
     bool enableQuestions;
+    QDateTime testDateTime;
 
 private:
     Project *q_ptr;
@@ -4718,6 +4725,13 @@ void Project::setQuestionsEnabled( bool enable )
     d->enableQuestions = enable;
 }
 
+void Project::setTestDateTime( const QDateTime &dateTime )
+{
+    Q_D( Project );
+    QMutexLocker locker( d->mutex );
+    d->testDateTime = dateTime;
+}
+
 void Project::loadScriptResult( ScriptErrorType lastScriptError,
                                 const QString &lastScriptErrorString,
                                 const QStringList &globalFunctions,
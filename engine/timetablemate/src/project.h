@@ -389,6 +389,15 @@ public:
     /** @brief Whether or not question message boxes should be shown. */
     void setQuestionsEnabled( bool enable = true );
 
+    /**
+     * @brief Use @p dateTime in requests of script execution tests.
+     *
+     * By default (if @p dateTime is invalid) the current date and time gets used. A fixed value
+     * is needed to replay recorded network replies, because the requested URLs usually contain
+     * the date and time.
+     **/
+    void setTestDateTime( const QDateTime &dateTime );
+
     /** @brief Get the current state of this project. */
     Q_INVOKABLE static QString nameFromIcon( const QIcon &icon ) { return icon.name(); };
 
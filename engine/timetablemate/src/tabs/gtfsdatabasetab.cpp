@@ -22,6 +22,7 @@
 
 // Own includes
 #include "../project.h"
+#include "../gtfsdatabasemodel.h"
 
 // Public Transport engine includes
 #include <engine/serviceproviderglobal.h>
@@ -33,6 +34,7 @@
 #include <KConfigGroup>
 #include <KDebug>
 #include <KComboBox>
+#include <KLineEdit>
 #include <KLocalizedString>
 #include <KTabWidget>
 #include <KGlobal>
@@ -50,7 +52,7 @@
 #include <QFormLayout>
 #include <QLabel>
 #include <QProgressBar>
-#include <QSqlTableModel>
+#include <QHeaderView>
 #include <QFileInfo>
 #include <qdeclarative.h>
 #include <QDeclarativeView>
@@ -59,7 +61,7 @@
 
 GtfsDatabaseTab::GtfsDatabaseTab( Project *project, QWidget *parent )
         : AbstractTab(project, type(), parent), m_model(0), m_tabWidget(0), m_qmlView(0),
-          m_tableChooser(0), m_tableView(0)
+          m_tableChooser(0), m_filterEdit(0), m_statusLabel(0), m_tableView(0)
 {
     // Create a tab widget with tabs at the left, because it gets shown in a tab in timetablemate
     m_tabWidget = new KTabWidget( parent );
@@ -118,6 +120,10 @@ GtfsDatabaseTab::GtfsDatabaseTab( Project *project, QWidget *parent )
     m_tableView = new QTableView( tableTab );
     m_tableView->setEditTriggers( QAbstractItemView::NoEditTriggers );
 
+    // Rows get sorted by the database, start unsorted (ordered by rowid)
+    m_tableView->horizontalHeader()->setSortIndicator( -1, Qt::AscendingOrder );
+    m_tableView->setSortingEnabled( true );
+
     m_tableChooser = new KComboBox( tableTab );
     m_tableChooser->addItem( KIcon("table"), i18nc("@info/plain", "Agency(s)"), "agency" );
     m_tableChooser->addItem( KIcon("table"), i18nc("@info/plain", "Stops"), "stops" );
@@ -127,7 +133,7 @@ GtfsDatabaseTab::GtfsDatabaseTab( Project *project, QWidget *parent )
             i18nc("@info/plain", "Trips (sequences of two or more stops"), "trips" );
     m_tableChooser->addItem( KIcon("table"), i18nc("@info/plain", "Stop Times"), "stop_times" );
     m_tableChooser->addItem( KIcon("table"),
-            i18nc("@info/plain", "Calendar (service dates with weekly schedule)"), "clendar" );
+            i18nc("@info/plain", "Calendar (service dates with weekly schedule)"), "calendar" );
     m_tableChooser->addItem( KIcon("table"),
             i18nc("@info/plain", "Calendar Dates (exceptions for weekly schedules services)"),
             "calendar_dates" );
@@ -182,9 +188,26 @@ GtfsDatabaseTab::GtfsDatabaseTab( Project *project, QWidget *parent )
             "</list></para>") );
     connect( m_tableChooser, SIGNAL(currentIndexChanged(int)), this, SLOT(tableChosen(int)) );
 
+    m_filterEdit = new KLineEdit( tableTab );
+    m_filterEdit->setClearButtonShown( true );
+    m_filterEdit->setClickMessage( i18nc("@info/plain", "Filter (SQL condition)") );
+    m_filterEdit->setToolTip( i18nc("@info:tooltip",
+            "<title>Filter rows of the table</title>"
+            "<para>Enter an SQL condition and press enter to only show matching rows, "
+            "eg. <icode>stop_name LIKE 'A%'</icode>.</para>") );
+    connect( m_filterEdit, SIGNAL(returnPressed()), this, SLOT(filterChanged()) );
+    connect( m_filterEdit, SIGNAL(clearButtonClicked()), this, SLOT(filterChanged()) );
+
+    m_statusLabel = new QLabel( tableTab );
+
+    QHBoxLayout *hboxLayout = new QHBoxLayout();
+    hboxLayout->addWidget( m_tableChooser );
+    hboxLayout->addWidget( m_filterEdit );
+
     QVBoxLayout *vboxLayout = new QVBoxLayout( tableTab );
-    vboxLayout->addWidget( m_tableChooser );
+    vboxLayout->addLayout( hboxLayout );
     vboxLayout->addWidget( m_tableView );
+    vboxLayout->addWidget( m_statusLabel );
 
     m_tabWidget->addTab( m_qmlView, KIcon("dashboard-show"), i18nc("@title:tab", "Overview") );
     m_tabWidget->addTab( tableTab, KIcon("server-database"), i18nc("@title:tab", "Database") );
@@ -213,9 +236,32 @@ void GtfsDatabaseTab::tableChosen( int index )
         return;
     }
 
+    // Reset the sort indicator, setTable() resets the sort order of the model
     const QString tableName = m_tableChooser->itemData( index ).toString();
+    m_tableView->horizontalHeader()->setSortIndicator( -1, Qt::AscendingOrder );
     m_model->setTable( tableName );
-    m_model->select();
+}
+
+void GtfsDatabaseTab::filterChanged()
+{
+    if ( !m_model ) {
+        kWarning() << "No database connection";
+        return;
+    }
+
+    m_model->setFilter( m_filterEdit->text() );
+}
+
+void GtfsDatabaseTab::rowCountChanged( int count, bool exact )
+{
+    m_statusLabel->setText( exact ? i18ncp("@info/plain", "%1 row", "%1 rows", count)
+                                  : i18ncp("@info/plain", "About %1 row (counting...)",
+                                           "About %1 rows (counting...)", count) );
+}
+
+void GtfsDatabaseTab::databaseError( const QString &errorText )
+{
+    m_statusLabel->setText( i18nc("@info/plain", "Error: %1", errorText) );
 }
 
 void GtfsDatabaseTab::gtfsDatabaseStateChanged( Project::GtfsDatabaseState state )
@@ -225,8 +271,11 @@ void GtfsDatabaseTab::gtfsDatabaseStateChanged( Project::GtfsDatabaseState state
     case Project::GtfsDatabaseImportFinished:
         m_tableView->setModel( 0 );
         delete m_model;
-        m_model = new QSqlTableModel( this,
-                GtfsDatabase::database(project()->data()->id()) );
+        m_model = new GtfsDatabaseModel( project()->data()->id(), this );
+        connect( m_model, SIGNAL(rowCountChanged(int,bool)),
+                 this, SLOT(rowCountChanged(int,bool)) );
+        connect( m_model, SIGNAL(errorOccurred(QString)), this, SLOT(databaseError(QString)) );
+        m_model->setFilter( m_filterEdit->text() );
         tableChosen( m_tableChooser->currentIndex() );
         m_tableView->setModel( m_model );
         m_tabWidget->setTabEnabled( 1, true );
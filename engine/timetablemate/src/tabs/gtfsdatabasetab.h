@@ -26,7 +26,9 @@
 class KJob;
 class KTabWidget;
 class KComboBox;
-class QSqlTableModel;
+class KLineEdit;
+class GtfsDatabaseModel;
+class QLabel;
 class QTableView;
 class QDeclarativeView;
 
@@ -39,21 +41,26 @@ public:
     static GtfsDatabaseTab *create( Project *project, QWidget *parent );
     virtual inline TabType type() const { return Tabs::GtfsDatabase; };
 
-    QSqlTableModel *model() const { return m_model; };
+    GtfsDatabaseModel *model() const { return m_model; };
     QDeclarativeView *qmlView() const { return m_qmlView; };
 
 protected slots:
     void tableChosen( int index );
+    void filterChanged();
+    void rowCountChanged( int count, bool exact );
+    void databaseError( const QString &errorText );
 
     void gtfsDatabaseStateChanged( Project::GtfsDatabaseState state );
 
 private:
     GtfsDatabaseTab( Project *project, QWidget *parent = 0 );
 
-    QSqlTableModel *m_model;
+    GtfsDatabaseModel *m_model;
     KTabWidget *m_tabWidget;
     QDeclarativeView *m_qmlView;
     KComboBox *m_tableChooser;
+    KLineEdit *m_filterEdit;
+    QLabel *m_statusLabel;
     QTableView *m_tableView;
 };
 
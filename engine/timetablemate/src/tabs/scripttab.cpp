@@ -48,6 +48,7 @@
 #include <KTextEditor/ConfigInterface>
 #include <KMessageBox>
 #include <KMenu>
+#include <ThreadWeaver/Weaver>
 
 // Qt includes
 #include <QWidget>
@@ -60,11 +61,24 @@
 #include <QFileInfo>
 #include <QDir>
 
+JavaScriptParserJob::JavaScriptParserJob( const QString &code,
+                                          const QSharedPointer<JavaScriptParser> &previous,
+                                          QObject *parent )
+        : ThreadWeaver::Job(parent), m_code(code), m_previous(previous)
+{
+}
+
+void JavaScriptParserJob::run()
+{
+    m_parser = QSharedPointer< JavaScriptParser >(
+            new JavaScriptParser(m_code, m_previous.data()) );
+}
+
 ScriptTab::ScriptTab( Project *project, QWidget *parent )
         : AbstractDocumentTab(project, Tabs::Script, parent),
           m_scriptModel(0), m_completionModel(0), m_functionsModel(0), m_functionsWidget(0),
           m_previousFunctionAction(0), m_nextFunctionAction(0), m_backgroundParserTimer(0),
-          m_executionLine(-1)
+          m_parserJob(0), m_parseAgain(false), m_executionLine(-1)
 {
     connect( project->debugger(), SIGNAL(continued(QDateTime,bool)),
              this, SLOT(removeExecutionMarker()) );
@@ -73,6 +87,19 @@ ScriptTab::ScriptTab( Project *project, QWidget *parent )
 
 ScriptTab::~ScriptTab()
 {
+    if ( m_parserJob ) {
+        disconnect( m_parserJob, 0, this, 0 );
+        if ( ThreadWeaver::Weaver::instance()->dequeue(m_parserJob) ) {
+            delete m_parserJob;
+        } else {
+            // The job is running, delete it when it is done
+            connect( m_parserJob, SIGNAL(done(ThreadWeaver::Job*)),
+                     m_parserJob, SLOT(deleteLater()) );
+            if ( m_parserJob->isFinished() ) {
+                m_parserJob->deleteLater();
+            }
+        }
+    }
 }
 
 void ScriptTab::setExecutionPosition( int executionLine, int column )
@@ -547,8 +574,30 @@ void ScriptTab::parseScript()
     delete m_backgroundParserTimer;
     m_backgroundParserTimer = 0;
 
-    // Parse the script
-    JavaScriptParser parser( document()->text() );
+    if ( m_parserJob ) {
+        // Parse again when the running job is done, it reuses nodes of the running job
+        m_parseAgain = true;
+        return;
+    }
+
+    // Parse a snapshot of the script in a thread, reusing unchanged nodes of the last parser
+    m_parserJob = new JavaScriptParserJob( document()->text(), m_parser );
+    connect( m_parserJob, SIGNAL(done(ThreadWeaver::Job*)),
+             this, SLOT(parserJobDone(ThreadWeaver::Job*)) );
+    ThreadWeaver::Weaver::instance()->enqueue( m_parserJob );
+}
+
+void ScriptTab::parserJobDone( ThreadWeaver::Job *job )
+{
+    Q_ASSERT( job == m_parserJob );
+    m_parser = m_parserJob->parser();
+    m_parserJob = 0;
+    job->deleteLater();
+
+    // Reused nodes are shared with the script model, move them to their new line numbers
+    // in this thread
+    m_parser->updateLineNumbers();
+    const JavaScriptParser &parser = *m_parser;
 
     KTextEditor::MarkInterface *markInterface =
             qobject_cast<KTextEditor::MarkInterface*>( document() );
@@ -591,6 +640,12 @@ void ScriptTab::parseScript()
     updateNextPreviousFunctionActions();
 
 //     project()->debugger()->loadScript( project()->scriptText(), project()->provider()->data() );
+
+    if ( m_parseAgain ) {
+        // The script was changed while parsing
+        m_parseAgain = false;
+        parseScript();
+    }
 }
 
 void ScriptTab::goToLine( int lineNumber )
@@ -25,10 +25,15 @@
 
 // KDE includes
 #include <KTextEditor/MarkInterface>
+#include <ThreadWeaver/Job>
+
+// Qt includes
+#include <QSharedPointer>
 
 class KAction;
 class KComboBox;
 class JavaScriptModel;
+class JavaScriptParser;
 namespace Debugger
 {
     class Breakpoint;
@@ -41,6 +46,34 @@ namespace KTextEditor
     class Cursor;
 }
 
+/**
+ * @brief Parses a snapshot of a script document in a ThreadWeaver thread.
+ *
+ * Nodes of the parser of the previous version of the script get reused, if not affected by
+ * changes, see JavaScriptParser. JavaScriptParser::updateLineNumbers() needs to be called for
+ * the resulting parser() in the GUI thread.
+ **/
+class JavaScriptParserJob : public ThreadWeaver::Job {
+    Q_OBJECT
+public:
+    JavaScriptParserJob( const QString &code, const QSharedPointer<JavaScriptParser> &previous,
+                         QObject *parent = 0 );
+
+    /**
+     * @brief The parser, which has parsed the code.
+     * @note This should only be used after the job is done.
+     **/
+    QSharedPointer< JavaScriptParser > parser() const { return m_parser; };
+
+protected:
+    virtual void run();
+
+private:
+    const QString m_code;
+    const QSharedPointer< JavaScriptParser > m_previous;
+    QSharedPointer< JavaScriptParser > m_parser;
+};
+
 /** @brief Represents a script document tab. */
 class ScriptTab : public AbstractDocumentTab {
     Q_OBJECT
@@ -85,6 +118,7 @@ public slots:
 
 protected slots:
     void documentChanged( KTextEditor::Document *document );
+    void parserJobDone( ThreadWeaver::Job *job );
     void scriptCursorPositionChanged( KTextEditor::View *view, const KTextEditor::Cursor &cursor );
     void showTextHint( const KTextEditor::Cursor &position, QString &text );
     void currentFunctionChanged( int index );
@@ -107,6 +141,9 @@ private:
     KAction *m_previousFunctionAction;
     KAction *m_nextFunctionAction;
     QTimer *m_backgroundParserTimer;
+    JavaScriptParserJob *m_parserJob; // The running parser job, if any
+    QSharedPointer< JavaScriptParser > m_parser; // The last finished parser
+    bool m_parseAgain; // Whether or not the script has changed while m_parserJob was running
     int m_executionLine;
 };
 
@@ -65,6 +65,8 @@ void TestModel::markTestAsStarted( TestModel::Test test )
 {
     removeTestChildren( test );
     m_testData[ test ] = TestData( TestIsRunning );
+    m_testTimers[ test ].start();
+    m_testDurations.remove( test );
     testChanged( test );
 }
 
@@ -112,6 +114,10 @@ TestModel::TestState TestModel::setTestState( TestModel::Test test, TestState st
         }
     }
 
+    if ( isFinishedState(state) && m_testTimers.contains(test) ) {
+        m_testDurations[ test ] = m_testTimers.take( test ).elapsed();
+    }
+
     if ( childrenExplanations.isEmpty() ) {
         m_testData[ test ] = TestData( state, explanation, tooltip, solution,
                                        childrenExplanations, results, request );
@@ -143,6 +149,8 @@ void TestModel::clear()
     }
     m_unstartableTestCases.clear();
     m_testData.clear();
+    m_testTimers.clear();
+    m_testDurations.clear();
     emit dataChanged( index(0, 0), index(TestCaseCount - 1, ColumnCount - 1) );
 
     emit testResultsChanged();
@@ -875,6 +883,11 @@ QSharedPointer<AbstractRequest> TestModel::testRequest( TestModel::Test test ) c
     return m_testData.contains(test) ? m_testData[test].request : QSharedPointer<AbstractRequest>();
 }
 
+qint64 TestModel::testDuration( TestModel::Test test ) const
+{
+    return m_testDurations.value( test, -1 );
+}
+
 bool TestModel::isTestApplicableTo( Test test, const ServiceProviderData *data,
                                     QString *errorMessage, QString *tooltip )
 {
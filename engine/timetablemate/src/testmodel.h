@@ -30,6 +30,7 @@
 
 // Qt inlcudes
 #include <QAbstractItemModel>
+#include <QElapsedTimer>
 
 class Project;
 class AbstractRequest;
@@ -275,6 +276,14 @@ public:
     QList< TimetableData > testResults( Test test ) const;
     QSharedPointer<AbstractRequest> testRequest( Test test ) const;
 
+    /**
+     * @brief Get the time in milliseconds @p test was running.
+     *
+     * The time is measured from markTestAsStarted() until a finished state gets set using
+     * setTestState(). If the test was not started or is not finished, -1 gets returned.
+     **/
+    Q_INVOKABLE qint64 testDuration( Test test ) const;
+
     /**
      * @brief Whether or not there are erroneous tests.
      * Uses testCaseState() for all available test cases to check for errors.
@@ -396,6 +405,8 @@ private:
 
     QHash< Test, TestData > m_testData;
     QHash< TestCase, TestCaseData > m_unstartableTestCases;
+    QHash< Test, QElapsedTimer > m_testTimers;
+    QHash< Test, qint64 > m_testDurations;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS( TestModel::TestFlags );
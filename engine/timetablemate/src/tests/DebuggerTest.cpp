@@ -22,6 +22,8 @@
 #include "config.h"
 #include <debugger/debugger.h>
 #include <debugger/debuggerjobs.h>
+#include <debugger/debuggeragent.h>
+#include <debugger/breakpointmodel.h>
 #include <project.h>
 #include <projectmodel.h>
 #include <tabs/webtab.h>
@@ -32,6 +34,7 @@
 #include <QtTest/QTest>
 #include <QTimer>
 #include <QSignalSpy>
+#include <QRegExp>
 #include <QWebView>
 #include <KGlobal>
 #include <KStandardDirs>
@@ -287,5 +290,44 @@ void DebuggerTest::testAbortionTest()
     delete testEndSpy;
 }
 
+void DebuggerTest::breakpointInRunModeTest()
+{
+    // Set a breakpoint at the first statement of getTimetable()
+    const QStringList lines = m_program.split( '\n' );
+    int functionLineNumber = -1;
+    for ( int i = 0; i < lines.count(); ++i ) {
+        if ( lines[i].contains(QRegExp("function\\s+getTimetable\\s*\\(")) ) {
+            functionLineNumber = i + 1;
+            break;
+        }
+    }
+    QVERIFY( functionLineNumber != -1 );
+    const int lineNumber = Debugger::DebuggerAgent::getNextBreakableLineNumber(
+            functionLineNumber + 1, lines );
+    QVERIFY( lineNumber != -1 );
+    Debugger::Breakpoint *breakpoint = m_debugger->breakpointModel()->setBreakpoint(
+            m_data->scriptFileName(), lineNumber );
+    QVERIFY( breakpoint );
+
+    // The script runs in run mode until the breakpoint is reached
+    QEventLoop loop;
+    QSignalSpy interruptSpy( m_debugger, SIGNAL(interrupted(int,QString,QDateTime)) );
+    connect( m_debugger, SIGNAL(interrupted(int,QString,QDateTime)), &loop, SLOT(quit()) );
+    connect( m_debugger, SIGNAL(stopped(ScriptRunData)), &loop, SLOT(quit()) );
+    QTimer::singleShot( 10000, &loop, SLOT(quit()) );
+    DepartureRequest request( "TEST_DEPARTURES", "Berlin", QDateTime::currentDateTime(), 30 );
+    QVERIFY( m_debugger->requestTimetableData(&request, QString(),
+                                              Debugger::InterruptOnBreakpoints) );
+    loop.exec();
+
+    QCOMPARE( interruptSpy.count(), 1 );
+    QCOMPARE( interruptSpy.first().at(0).toInt(), lineNumber );
+
+    // Clean up
+    m_debugger->breakpointModel()->removeBreakpoint( breakpoint );
+    m_debugger->abortDebugger();
+    m_debugger->finish();
+}
+
 QTEST_MAIN(DebuggerTest)
 #include "DebuggerTest.moc"
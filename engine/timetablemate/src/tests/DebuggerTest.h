@@ -43,6 +43,7 @@ private slots:
     void multipleTestsTest();
     void projectTestsTest();
     void testAbortionTest();
+    void breakpointInRunModeTest();
 
 private:
     Debugger::Debugger *m_debugger;
@@ -0,0 +1,165 @@
+/*
+*   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU Library General Public License as
+*   published by the Free Software Foundation; either version 2 or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details
+*
+*   You should have received a copy of the GNU Library General Public
+*   License along with this program; if not, write to the
+*   Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "GtfsDatabaseModelTest.h"
+
+#include <gtfsdatabasemodel.h>
+#include <engine/gtfs/gtfsdatabase.h>
+
+#include <QtTest/QTest>
+#include <QSignalSpy>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QFile>
+#include <KGlobal>
+
+// The name of the provider used for the test database and the number of rows in the test table.
+// Rows get inserted with rowids 3, 6, 9, ..., so max(rowid) is three times the row count
+const QString PROVIDER_ID = "gtfs_model_test";
+const int ROW_COUNT = 1000;
+
+void GtfsDatabaseModelTest::initTestCase()
+{
+    // Initialize for i18n
+    KGlobal::locale();
+
+    QFile::remove( GtfsDatabase::databasePath(PROVIDER_ID) );
+    QString errorText;
+    QVERIFY2( GtfsDatabase::initDatabase(PROVIDER_ID, &errorText), qPrintable(errorText) );
+
+    QSqlDatabase database = GtfsDatabase::database( PROVIDER_ID );
+    QSqlQuery query( database );
+    QVERIFY( query.exec("CREATE TABLE test_rows (value INTEGER)") );
+    QVERIFY( database.transaction() );
+    QVERIFY( query.prepare("INSERT INTO test_rows (rowid, value) VALUES (?, ?)") );
+    for ( int row = 0; row < ROW_COUNT; ++row ) {
+        query.addBindValue( (row + 1) * 3 );
+        query.addBindValue( row );
+        QVERIFY( query.exec() );
+    }
+    QVERIFY( database.commit() );
+}
+
+void GtfsDatabaseModelTest::cleanupTestCase()
+{
+    GtfsDatabase::closeDatabase( PROVIDER_ID );
+    QFile::remove( GtfsDatabase::databasePath(PROVIDER_ID) );
+}
+
+bool GtfsDatabaseModelTest::waitForRowCount( GtfsDatabaseModel *model ) const
+{
+    for ( int i = 0; i < 100 && !model->isRowCountExact(); ++i ) {
+        QTest::qWait( 50 );
+    }
+    return model->isRowCountExact();
+}
+
+QVariant GtfsDatabaseModelTest::waitForRow( GtfsDatabaseModel *model, int row ) const
+{
+    // Rows after the last row get added when the model fetches more rows
+    QVariant value = model->data( model->index(row, 0) );
+    for ( int i = 0; i < 100 && !value.isValid() &&
+                     (row < model->rowCount() || model->canFetchMore()); ++i )
+    {
+        QTest::qWait( 50 );
+        value = model->data( model->index(row, 0) );
+    }
+    return value;
+}
+
+void GtfsDatabaseModelTest::pagingTest()
+{
+    GtfsDatabaseModel model( PROVIDER_ID );
+    QSignalSpy rowCountSpy( &model, SIGNAL(rowCountChanged(int,bool)) );
+    model.setTable( "test_rows" );
+
+    // The maximal rowid is used as estimate
+    QCOMPARE( model.columnCount(), 1 );
+    QCOMPARE( model.rowCount(), ROW_COUNT * 3 );
+    QVERIFY( !model.canFetchMore() );
+
+    // Jump to the last (estimated) page, which is empty, then read pages in order
+    QVERIFY( !waitForRow(&model, ROW_COUNT * 3 - 1).isValid() );
+    QVERIFY( model.rowCount() >= ROW_COUNT );
+    QCOMPARE( waitForRow(&model, 0).toInt(), 0 );
+    QCOMPARE( waitForRow(&model, GtfsDatabaseModel::PAGE_SIZE - 1).toInt(),
+              GtfsDatabaseModel::PAGE_SIZE - 1 );
+    QCOMPARE( waitForRow(&model, GtfsDatabaseModel::PAGE_SIZE).toInt(),
+              GtfsDatabaseModel::PAGE_SIZE );
+
+    // Only the counted number of rows is exact, short or empty pages did not change it
+    QVERIFY( waitForRowCount(&model) );
+    QCOMPARE( model.rowCount(), ROW_COUNT );
+    for ( int i = 0; i < rowCountSpy.count(); ++i ) {
+        const QList<QVariant> arguments = rowCountSpy[i];
+        if ( arguments[1].toBool() ) {
+            QCOMPARE( arguments[0].toInt(), ROW_COUNT );
+        }
+    }
+    QVERIFY( !model.canFetchMore() );
+
+    // Jump to the real last page
+    QCOMPARE( waitForRow(&model, ROW_COUNT - 1).toInt(), ROW_COUNT - 1 );
+    QCOMPARE( model.rowCount(), ROW_COUNT );
+    QVERIFY( model.isRowCountExact() );
+
+    // Sorted descending, the last page contains the first rows
+    model.sort( 0, Qt::DescendingOrder );
+    QVERIFY( waitForRowCount(&model) );
+    QCOMPARE( waitForRow(&model, ROW_COUNT - 1).toInt(), 0 );
+    QCOMPARE( waitForRow(&model, 0).toInt(), ROW_COUNT - 1 );
+}
+
+void GtfsDatabaseModelTest::filteredPagingTest()
+{
+    GtfsDatabaseModel model( PROVIDER_ID );
+    QSignalSpy rowCountSpy( &model, SIGNAL(rowCountChanged(int,bool)) );
+    model.setTable( "test_rows" );
+    model.setFilter( "value % 2 = 0" );
+    const int matchingRows = ROW_COUNT / 2;
+
+    // Filtered tables start without an estimate, read pages add rows
+    QCOMPARE( model.columnCount(), 1 );
+    QCOMPARE( model.rowCount(), 0 );
+    QCOMPARE( waitForRow(&model, 0).toInt(), 0 );
+    if ( !model.isRowCountExact() ) {
+        QCOMPARE( model.rowCount(), GtfsDatabaseModel::PAGE_SIZE );
+        QVERIFY( model.canFetchMore() );
+        model.fetchMore();
+    }
+    QCOMPARE( waitForRow(&model, GtfsDatabaseModel::PAGE_SIZE).toInt(),
+              GtfsDatabaseModel::PAGE_SIZE * 2 );
+
+    QVERIFY( waitForRowCount(&model) );
+    QCOMPARE( model.rowCount(), matchingRows );
+    QVERIFY( !model.canFetchMore() );
+    for ( int i = 0; i < rowCountSpy.count(); ++i ) {
+        const QList<QVariant> arguments = rowCountSpy[i];
+        if ( arguments[1].toBool() ) {
+            QCOMPARE( arguments[0].toInt(), matchingRows );
+        }
+    }
+
+    // Jump to the last page
+    QCOMPARE( waitForRow(&model, matchingRows - 1).toInt(), (matchingRows - 1) * 2 );
+    QCOMPARE( model.rowCount(), matchingRows );
+}
+
+QTEST_MAIN(GtfsDatabaseModelTest)
+#include "GtfsDatabaseModelTest.moc"
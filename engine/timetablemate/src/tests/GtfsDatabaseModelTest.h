@@ -0,0 +1,51 @@
+/*
+*   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU Library General Public License as
+*   published by the Free Software Foundation; either version 2 or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details
+*
+*   You should have received a copy of the GNU Library General Public
+*   License along with this program; if not, write to the
+*   Free Software Foundation, Inc.,
+*   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef GTFSDATABASEMODELTEST_H
+#define GTFSDATABASEMODELTEST_H
+
+#include <QtCore/QObject>
+
+class GtfsDatabaseModel;
+
+/** @brief Tests paging of GtfsDatabaseModel with a table with gaps in the rowids. */
+class GtfsDatabaseModelTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    // Test reading pages in order and jumping to the last page of an unfiltered table,
+    // the estimated row count is too big, because of gaps in the rowids
+    void pagingTest();
+
+    // Test fetching more rows of a filtered table and jumping to the last page
+    void filteredPagingTest();
+
+private:
+    /** @brief Wait until the row count of @p model is exact, returns false on timeout. */
+    bool waitForRowCount( GtfsDatabaseModel *model ) const;
+
+    /** @brief Wait until @p row of @p model was read, returns the value of the first column. */
+    QVariant waitForRow( GtfsDatabaseModel *model, int row ) const;
+};
+
+#endif // GTFSDATABASEMODELTEST_H
@@ -68,6 +68,58 @@ void JavaScriptParserTest::simpleTest()
     QCOMPARE( function->definition()->children().first()->column(), 4 );
 }
 
+void JavaScriptParserTest::incrementalTest()
+{
+    const QString code =
+            "/* Comment */\n"
+            "function first( a ) {\n"
+            "    return a;\n"
+            "}\n"
+            "function second( b ) {\n"
+            "    return b;\n"
+            "}\n"
+            "function third( c ) {\n"
+            "    return c;\n"
+            "}\n";
+    JavaScriptParser previousParser( code );
+    QVERIFY( !previousParser.hasError() );
+    QCOMPARE( previousParser.nodes().count(), 4 );
+    QCOMPARE( previousParser.reusedNodeCount(), 0 );
+
+    // Change the second function, adding a line
+    QString changedCode = code;
+    changedCode.replace( "    return b;\n", "    var x = b;\n    return x;\n" );
+    JavaScriptParser parser( changedCode, &previousParser );
+    QVERIFY( !parser.hasError() );
+    QCOMPARE( parser.nodes().count(), 4 );
+
+    // The comment and the first/third functions get reused, the second function gets parsed
+    QCOMPARE( parser.reusedNodeCount(), 3 );
+    QVERIFY( parser.nodes().at(0) == previousParser.nodes().at(0) );
+    QVERIFY( parser.nodes().at(1) == previousParser.nodes().at(1) );
+    QVERIFY( parser.nodes().at(2) != previousParser.nodes().at(2) );
+    QVERIFY( parser.nodes().at(3) == previousParser.nodes().at(3) );
+    QCOMPARE( parser.nodes().at(2)->endLine(), 8 );
+
+    // Nodes after the changed lines get moved by updateLineNumbers()
+    const QSharedPointer< FunctionNode > third = parser.nodes().at(3).dynamicCast<FunctionNode>();
+    QVERIFY( !third.isNull() );
+    QCOMPARE( third->line(), 8 );
+    parser.updateLineNumbers();
+    QCOMPARE( third->line(), 9 );
+    QCOMPARE( third->definition()->children().first()->line(), 10 );
+
+    // The result needs to be the same as when parsing the changed code without reusing nodes
+    JavaScriptParser fullParser( changedCode );
+    QCOMPARE( fullParser.nodes().count(), parser.nodes().count() );
+    for ( int i = 0; i < fullParser.nodes().count(); ++i ) {
+        QCOMPARE( parser.nodes().at(i)->type(), fullParser.nodes().at(i)->type() );
+        QCOMPARE( parser.nodes().at(i)->line(), fullParser.nodes().at(i)->line() );
+        QCOMPARE( parser.nodes().at(i)->endLine(), fullParser.nodes().at(i)->endLine() );
+        QCOMPARE( parser.nodes().at(i)->column(), fullParser.nodes().at(i)->column() );
+    }
+}
+
 void JavaScriptParserTest::incorrectScript1Test()
 {
     JavaScriptParser parser(
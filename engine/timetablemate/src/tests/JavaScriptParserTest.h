@@ -36,6 +36,9 @@ private slots:
 
     void simpleTest();
 
+    // Test parsing changed code reusing nodes of a previous parser
+    void incrementalTest();
+
     // Test incorrect script code and verify the error, try to produce crashes if possible
     void incorrectScript1Test();
     void incorrectScript2Test();
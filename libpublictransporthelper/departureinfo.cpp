@@ -18,6 +18,7 @@
  */
 
 #include "departureinfo.h"
+#include "stringtable.h"
 
 #include <QVariant>
 #include <qmath.h>
@@ -110,15 +111,17 @@ void JourneyInfo::init( const QString &operatorName, const QSet< VehicleType > &
     m_departure = departure;
     m_arrival = arrival;
     m_pricing = pricing;
-    m_startStopName = startStopName;
-    m_targetStopName = targetStopName;
+    StringTable *stringTable = StringTable::self();
+    m_startStopName = stringTable->intern( startStopName );
+    m_targetStopName = stringTable->intern( targetStopName );
     m_duration = duration;
     m_changes = changes;
     m_journeyNews = journeyNews;
-    m_routeStops = routeStops;
-    m_routeStopsShortened = routeStopsShortened.isEmpty() ? routeStops : routeStopsShortened;
+    m_routeStops = stringTable->intern( routeStops );
+    m_routeStopsShortened = routeStopsShortened.isEmpty() ? m_routeStops
+            : stringTable->intern( routeStopsShortened );
     m_routeNews = routeNews;
-    m_routeTransportLines = routeTransportLines;
+    m_routeTransportLines = stringTable->intern( routeTransportLines );
     m_routePlatformsDeparture = routePlatformsDeparture;
     m_routePlatformsArrival = routePlatformsArrival;
     m_routeVehicleTypes = routeVehicleTypes;
@@ -296,10 +299,14 @@ void DepartureInfo::init( const QString &dataSource, int index, DepartureFlags f
         m_lineNumber = 0;
     }
 
+    // Intern strings that are shared by many departures, see StringTable
+    StringTable *stringTable = StringTable::self();
     m_operator = operatorName;
-    m_lineString = line;
-    m_target = target;
-    m_targetShortened = targetShortened.isEmpty() ? target : targetShortened;
+    m_lineString = stringTable->intern( line );
+    m_target = stringTable->intern( target );
+    m_targetShortened = targetShortened.isEmpty() ? m_target
+                                                  : stringTable->intern( targetShortened );
+    m_targetHandle = stringTable->foldedHandle( target.trimmed() );
     m_departure = departure;
     m_vehicleType = lineType;
     m_lineServices = lineServices;
@@ -308,8 +315,10 @@ void DepartureInfo::init( const QString &dataSource, int index, DepartureFlags f
     m_delayReason = delayReason;
     m_journeyNews = journeyNews;
 
-    m_routeStops = routeStops;
-    m_routeStopsShortened = routeStopsShortened.isEmpty() ? routeStops : routeStopsShortened;
+    m_routeStops = stringTable->intern( routeStops );
+    m_routeStopsShortened = routeStopsShortened.isEmpty() ? m_routeStops
+            : stringTable->intern( routeStopsShortened );
+    m_routeStopHandles = stringTable->foldedHandles( routeStops );
     m_routeTimes = routeTimes;
     m_routeExactStops = routeExactStops;
 
@@ -338,11 +347,13 @@ bool DepartureInfo::operator ==( const DepartureInfo& other ) const
 
 void DepartureInfo::generateHash()
 {
-    m_hash = qHash( QString("%1%2%3%4")
-                    .arg(m_departure.toString("dMMyyhhmmss"))
-                    .arg(static_cast<int>(m_vehicleType))
-                    .arg(m_lineString)
-                    .arg(m_target.trimmed().toLower()) );
+    // Combine the values directly instead of hashing a formatted string,
+    // the line string and the trimmed, case folded target are identified by their StringTable
+    // handles
+    uint hash = m_departure.toTime_t();
+    hash = 31 * hash + static_cast<uint>( m_vehicleType );
+    hash = 31 * hash + static_cast<uint>( StringTable::self()->handle(m_lineString) );
+    m_hash = 31 * hash + static_cast<uint>( m_targetHandle );
 }
 
 void JourneyInfo::generateHash()
@@ -271,7 +271,7 @@ public:
     Q_DECLARE_FLAGS( DepartureFlags, DepartureFlag );
 
     /** Creates an invalid DepartureInfo object. */
-    DepartureInfo() : PublicTransportInfo() {
+    DepartureInfo() : PublicTransportInfo(), m_targetHandle(0) {
     };
 
     DepartureInfo( const QString &dataSource, int index, DepartureFlags flags = NoDepartureFlags,
@@ -389,6 +389,13 @@ public:
     /** @returns the line string of this departure/arrival. */
     QString lineString() const { return m_lineString; };
 
+    /**
+     * @returns the StringTable::foldedHandle() of the trimmed target/origin.
+     *
+     * Compare this with the folded handle of a stop name for a fast case insensitive comparison.
+     **/
+    int targetHandle() const { return m_targetHandle; };
+
     /** @returns the platform at which this departure departs or this arrival arrives. */
     QString platform() const { return m_platform; };
 
@@ -414,6 +421,9 @@ public:
     /** @returns a list of intermediate, shortened stop names. */
     QStringList routeStopsShortened() const { return m_routeStopsShortened; };
 
+    /** @returns the StringTable::foldedHandle() of each stop in @ref routeStops. */
+    QList<int> routeStopHandles() const { return m_routeStopHandles; };
+
     /** @returns a list of QTime objects. Each time corresponds to the stop
      * in @ref routeStops with the same index. */
     QList<QTime> routeTimes() const { return m_routeTimes; };
@@ -450,8 +460,10 @@ private:
     LineServices m_lineServices;
     QStringList m_routeStops;
     QStringList m_routeStopsShortened;
+    QList<int> m_routeStopHandles;
     QList<QTime> m_routeTimes;
     int m_routeExactStops;
+    int m_targetHandle;
     DepartureFlags m_flags;
     QList< int > m_matchedAlarms;
     QString m_dataSource;
@@ -19,6 +19,7 @@
 
 #include "filter.h"
 #include "departureinfo.h"
+#include "stringtable.h"
 
 #include <KDebug>
 
@@ -53,8 +54,13 @@ bool Filter::match( const DepartureInfo& departureInfo ) const
     foreach( const Constraint &constraint, *this ) {
         switch ( constraint.type ) {
         case FilterByTarget:
-            if ( !matchString(constraint.variant, constraint.value.toString(),
-                              departureInfo.target()) ) {
+            if ( isHandleVariant(constraint.variant) ) {
+                if ( !matchHandle(constraint.variant, filterHandle(constraint),
+                                  departureInfo.targetHandle()) ) {
+                    return false;
+                }
+            } else if ( !matchString(constraint.variant, constraint.value.toString(),
+                                     departureInfo.target()) ) {
                 return false;
             }
             break;
@@ -67,6 +73,25 @@ bool Filter::match( const DepartureInfo& departureInfo ) const
             }
 
             bool viaMatched = false;
+            if ( isHandleVariant(constraint.variant) ) {
+                // Compare interned stop name handles instead of the stop names
+                const int handle = filterHandle( constraint );
+                foreach( int viaHandle, departureInfo.routeStopHandles() ) {
+                    if ( matchHandle(constraint.variant, handle, viaHandle) ) {
+                        viaMatched = true;
+                        break;
+                    }
+                }
+
+                // If no route stop matches, try to match the target
+                if ( !viaMatched && !matchHandle(constraint.variant, handle,
+                                                 departureInfo.targetHandle()) )
+                {
+                    return false;
+                }
+                break;
+            }
+
             foreach( const QString &via, departureInfo.routeStops() ) {
                 if ( matchString(constraint.variant, constraint.value.toString(), via) ) {
                     viaMatched = true;
@@ -92,13 +117,22 @@ bool Filter::match( const DepartureInfo& departureInfo ) const
 
             if ( departureInfo.routeStops().count() < 2 || departureInfo.routeExactStops() == 1 ) {
                 // If too less route stops are available use the target as next stop
-                return matchString( constraint.variant, constraint.value.toString(),
-                                    departureInfo.target() );
+                return isHandleVariant(constraint.variant)
+                        ? matchHandle(constraint.variant, filterHandle(constraint),
+                                      departureInfo.targetHandle())
+                        : matchString(constraint.variant, constraint.value.toString(),
+                                      departureInfo.target());
             }
 
-            QString nextStop = !departureInfo.isArrival() ? departureInfo.routeStops()[ 1 ]
-                    : departureInfo.routeStops()[ departureInfo.routeStops().count() - 2 ];
-            if ( !matchString(constraint.variant, constraint.value.toString(), nextStop) ) {
+            const int nextStopIndex = !departureInfo.isArrival()
+                    ? 1 : departureInfo.routeStops().count() - 2;
+            if ( isHandleVariant(constraint.variant) ) {
+                if ( !matchHandle(constraint.variant, filterHandle(constraint),
+                                  departureInfo.routeStopHandles()[nextStopIndex]) ) {
+                    return false;
+                }
+            } else if ( !matchString(constraint.variant, constraint.value.toString(),
+                                     departureInfo.routeStops()[nextStopIndex]) ) {
                 return false;
             }
             break;
@@ -293,6 +327,31 @@ bool Filter::matchString( FilterVariant variant, const QString& filterString,
     }
 }
 
+bool Filter::isHandleVariant( FilterVariant variant )
+{
+    return variant == FilterEquals || variant == FilterDoesntEqual;
+}
+
+int Filter::filterHandle( const Constraint &constraint )
+{
+    // Do not cache the handle, values that are not in the table yet may get added later
+    return StringTable::self()->findFoldedHandle( constraint.value.toString() );
+}
+
+bool Filter::matchHandle( FilterVariant variant, int filterHandle, int testHandle ) const
+{
+    switch ( variant ) {
+    case FilterEquals:
+        return testHandle == filterHandle;
+    case FilterDoesntEqual:
+        return testHandle != filterHandle;
+
+    default:
+        kDebug() << "Invalid filter variant for handle matching:" << variant;
+        return false;
+    }
+}
+
 bool Filter::matchTime( FilterVariant variant, const QTime& filterTime,
                         const QTime& testTime ) const
 {
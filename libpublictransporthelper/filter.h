@@ -112,6 +112,25 @@ public:
 private:
     bool matchString( FilterVariant variant, const QString &filterString,
                       const QString &testString ) const;
+
+    /**
+     * @brief Whether or not string constraints with @p variant can be matched using handles.
+     *
+     * Case insensitive (in)equality of stop names can be tested by comparing their
+     * StringTable::foldedHandle(), see matchHandle().
+     **/
+    static bool isHandleVariant( FilterVariant variant );
+
+    /**
+     * @brief Get the StringTable::findFoldedHandle() of the value of @p constraint.
+     *
+     * The handle gets looked up once per constraint in each call to match(), nothing gets
+     * stored in the constraint, filters get matched from multiple threads. Filter values do
+     * not get added to the table.
+     **/
+    static int filterHandle( const Constraint &constraint );
+
+    bool matchHandle( FilterVariant variant, int filterHandle, int testHandle ) const;
     bool matchInt( FilterVariant variant, int filterInt, int testInt ) const;
     bool matchList( FilterVariant variant, const QVariantList &filterValues,
                     const QVariant &testValue ) const;
@@ -36,11 +36,52 @@
 
 // Qt includes
 #include <qmath.h>
+#include <QPainter>
 #include <QTimer>
 
 /** @brief Namespace for the publictransport helper library. */
 namespace PublicTransport {
 
+/** @brief The width and height in degrees of tiles of level 0, for which stops get loaded. */
+static const qreal STOP_TILE_SIZE = 0.02;
+
+/** @brief The maximal tile level, tiles of level n are 2^n times bigger than level 0 tiles. */
+static const int MAXIMUM_TILE_LEVEL = 8;
+
+/** @brief Bigger tiles get used, if more tiles would need to be requested. */
+static const int MAXIMUM_REQUESTED_TILES = 36;
+
+/** @brief The maximal number of tile requests running at the same time. */
+static const int MAXIMUM_CONCURRENT_REQUESTS = 4;
+
+/** @brief The maximal number of stops loaded for tiles with a level bigger than 0. */
+static const int MAXIMUM_STOPS_PER_BIG_TILE = 100;
+
+/** @brief Loaded tiles get removed, if they are further away from the visible tiles. */
+static const int TILE_EVICTION_DISTANCE = 3;
+
+/** @brief Inactive stops get clustered in cells of this width/height in pixels. */
+static const int CLUSTER_CELL_SIZE = 24;
+
+/** @brief A tile, the longitude and latitude divided by the tile size of it's level. */
+struct StopTile {
+    /** @brief Create a tile of @p level at @p x, @p y. */
+    StopTile( int level = 0, int x = 0, int y = 0 ) : level(level), x(x), y(y) {};
+
+    bool operator ==( const StopTile &other ) const {
+        return level == other.level && x == other.x && y == other.y;
+    };
+
+    int level; /**< The level of the tile, the tile size is STOP_TILE_SIZE * 2^level. */
+    int x; /**< The longitude divided by the tile size. */
+    int y; /**< The latitude divided by the tile size. */
+};
+
+inline uint qHash( const StopTile &tile )
+{
+    return ::qHash( (tile.x << 16) ^ tile.y ) ^ ::qHash( tile.level );
+}
+
 /** @brief Flags for stops. */
 enum StopFlag {
     NoStopFlags  = 0x00, /**< No flags, the stop is not active and will be drawn with
@@ -145,7 +186,7 @@ public:
     PublicTransportLayerPrivate( PublicTransportLayer *q, MarbleWidget *mapWidget,
                                  const QString &serviceProvider, PublicTransportLayer::Flags flags )
             : q_ptr(q), mapWidget(mapWidget), flags(flags), serviceProvider(serviceProvider),
-              loadTimer(0) {};
+              loadTimer(0), tileLevel(-1) {};
 
     /** @brief Add @p stops with the ActiveStop flag and @p inactiveStops without any flags. */
     void addStops( const QList< Stop > &stops, const QList< Stop > &inactiveStops )
@@ -273,24 +314,12 @@ public:
     /** @brief The visible map region changed. */
     void visibleLatLonAltBoxChanged( const GeoDataLatLonAltBox &latLonAltBox )
     {
-        if ( !flags.testFlag(PublicTransportLayer::AutoLoadStopsForMapRegion) ||
-             !showInternalStops() ||
-             (!viewBox.isEmpty() &&
-             (latLonAltBox.width() >= 0.7 * viewBox.width() &&
-             latLonAltBox.width() <= 1.3 * viewBox.width()) &&
-             (latLonAltBox.height() >= 0.7 * viewBox.height() &&
-             latLonAltBox.height() <= 1.3 * viewBox.height()) &&
-             qAbs(latLonAltBox.center().longitude() - viewBox.center().longitude()) <=
-                    viewBox.width() &&
-             qAbs(latLonAltBox.center().latitude() - viewBox.center().latitude()) <=
-                    viewBox.height()) )
-        {
-            // Zoom/center did not change enough for another request or auto stop loading is disabled
-            // or too big region in the view (too many stops)
+        if ( !flags.testFlag(PublicTransportLayer::AutoLoadStopsForMapRegion) ) {
+            // Auto stop loading is disabled
             return;
         }
 
-        // Store view box and start a timer to request the stops
+        // Store view box and start a timer to request stops of missing tiles
         viewBox = latLonAltBox;
         startStopsByGeoPositionRequestLater();
     };
@@ -300,15 +329,6 @@ public:
     {
         Q_Q( PublicTransportLayer );
 
-        // Disconnect running requests,
-        // most probably for a map region that was shortly visible while scrolling
-        if ( !dataSource.isEmpty() ) {
-            Plasma::DataEngine *engine =
-                    Plasma::DataEngineManager::self()->engine( "publictransport" );
-            engine->disconnectSource( dataSource, q );
-            dataSource.clear();
-        }
-
         if ( !loadTimer ) {
             // No running timer, create one
             loadTimer = new QTimer( q );
@@ -326,7 +346,86 @@ public:
         }
     };
 
-    /** @brief Request stops for the currently visible map region now. */
+    /** @brief Get the width and height in degrees of tiles of @p level. */
+    static inline qreal tileSize( int level ) { return STOP_TILE_SIZE * (1 << level); };
+
+    /** @brief Get the tile of @p level containing the given coordinates in degrees. */
+    static inline StopTile tileForCoordinates( int level, qreal longitude, qreal latitude )
+    {
+        const qreal size = tileSize( level );
+        return StopTile( level, qFloor(longitude / size), qFloor(latitude / size) );
+    };
+
+    /** @brief Get the rectangle of tiles of @p level covering @p box, x is longitude. */
+    static QRect tilesForBox( int level, const GeoDataLatLonBox &box )
+    {
+        const GeoDataCoordinates::Unit unit = GeoDataCoordinates::Degree;
+        const StopTile southWest = tileForCoordinates( level, box.west(unit), box.south(unit) );
+        const StopTile northEast = tileForCoordinates( level, box.east(unit), box.north(unit) );
+        return QRect( QPoint(southWest.x, southWest.y), QPoint(northEast.x, northEast.y) );
+    };
+
+    /**
+     * @brief Get the level of the smallest tiles to load for @p box.
+     *
+     * Not more than MAXIMUM_REQUESTED_TILES tiles of the returned level are needed to cover
+     * @p box and one tile around it.
+     *
+     * @return The tile level or -1, if @p box is too big even for tiles of MAXIMUM_TILE_LEVEL.
+     **/
+    static int tileLevelForBox( const GeoDataLatLonBox &box )
+    {
+        for ( int level = 0; level <= MAXIMUM_TILE_LEVEL; ++level ) {
+            const QRect tiles = tilesForBox( level, box ).adjusted( -1, -1, 1, 1 );
+            if ( tiles.width() * tiles.height() <= MAXIMUM_REQUESTED_TILES ) {
+                return level;
+            }
+        }
+        return -1;
+    };
+
+    /** @brief Whether or not @p coords are inside one of @p tiles, which have @p levels. */
+    static bool isInTiles( const GeoDataCoordinates &coords, const QSet<StopTile> &tiles,
+                           const QSet<int> &levels )
+    {
+        const GeoDataCoordinates::Unit unit = GeoDataCoordinates::Degree;
+        foreach ( int level, levels ) {
+            if ( tiles.contains(tileForCoordinates(level, coords.longitude(unit),
+                                                   coords.latitude(unit))) )
+            {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    /** @brief Get the name of the data source to request stops for @p tile. */
+    QString dataSourceForTile( const StopTile &tile ) const
+    {
+        // Arc-length in meters from the center of a tile to it's corners is radius * angle.
+        // The tiles get smaller in longitude direction with bigger latitudes, ie. the distance
+        // covers more than the tile
+        const qreal radius = mapWidget->model()->planetRadius(); // in meters
+        const qreal angle = tileSize( tile.level ) * M_SQRT1_2 * M_PI / 180.0; // in rad
+        const int distance = qBound( 500, qCeil(radius * angle), 1000000 );
+
+        // Load only some stops for bigger tiles, they get drawn in clusters when zoomed out
+        const int count = tile.level == 0 ? 999 : MAXIMUM_STOPS_PER_BIG_TILE;
+        return QString("Stops %1|latitude=%2|longitude=%3|distance=%4|count=%5")
+                .arg(serviceProvider)
+                .arg((tile.y + 0.5) * tileSize(tile.level))
+                .arg((tile.x + 0.5) * tileSize(tile.level))
+                .arg(distance).arg(count);
+    };
+
+    /**
+     * @brief Request stops for tiles of the currently visible map region now.
+     *
+     * The tile level gets chosen using tileLevelForBox(), ie. bigger tiles get used when zoomed
+     * out. Only tiles that are not already loaded or requested get requested, visible tiles
+     * first. Requests for tiles that are no longer needed get aborted and tiles that are no
+     * longer needed get removed, see evictTiles().
+     **/
     void startStopsByGeoPositionRequest()
     {
         Q_Q( PublicTransportLayer );
@@ -340,25 +439,155 @@ public:
             kWarning() << "No service provider specified to use for the AutoLoadStopsForMapRegion"
                           "feature in PublicTransportLayer.";
             return;
+        } else if ( viewBox.isEmpty() ) {
+            return;
         }
 
+        // Also load tiles around the visible ones, to not need to load stops on every map movement
+        tileLevel = tileLevelForBox( viewBox );
+        const QRect visibleTiles = tilesForBox( qMax(0, tileLevel), viewBox );
+        const QRect neededTiles = visibleTiles.adjusted( -1, -1, 1, 1 );
+
+        // Abort requests for tiles that are no longer needed, eg. tiles of another level or
+        // for a map region that was shortly visible while scrolling
         Plasma::DataEngine *engine = Plasma::DataEngineManager::self()->engine( "publictransport" );
-        const Marble::GeoDataCoordinates::Unit unit = Marble::GeoDataCoordinates::Degree;
+        QHash< QString, StopTile >::Iterator it = tileRequests.begin();
+        while ( it != tileRequests.end() ) {
+            if ( it->level == tileLevel && neededTiles.contains(it->x, it->y) ) {
+                ++it;
+            } else {
+                engine->disconnectSource( it.key(), q );
+                it = tileRequests.erase( it );
+            }
+        }
 
-        // Arc-length in meters of the longest side of the view box is radius * angle.
-        // The distance (ie. radius) in which to search for stops is doubled to not need to
-        // reload stops on every map movement
-        const qreal radius = mapWidget->model()->planetRadius(); // in meters
-        const qreal angle = qMax( viewBox.width(), viewBox.height() ); // in rad
-        const qreal distance = qBound( 500, qCeil(2 * radius * angle), 20000 );
+        // Queue tiles that are not loaded or requested, visible tiles first
+        pendingTiles.clear();
+        if ( tileLevel != -1 ) {
+            const QList< StopTile > requestedTiles = tileRequests.values();
+            for ( int x = neededTiles.left(); x <= neededTiles.right(); ++x ) {
+                for ( int y = neededTiles.top(); y <= neededTiles.bottom(); ++y ) {
+                    const StopTile tile( tileLevel, x, y );
+                    if ( loadedTiles.contains(tile) || requestedTiles.contains(tile) ) {
+                        continue;
+                    } else if ( visibleTiles.contains(x, y) ) {
+                        pendingTiles.prepend( tile );
+                    } else {
+                        pendingTiles.append( tile );
+                    }
+                }
+            }
+        }
 
-        // Connect data source
-        dataSource = QString("Stops %1|latitude=%2|longitude=%3|distance=%4|count=999")
-                .arg(serviceProvider)
-                .arg(viewBox.center().latitude(unit))
-                .arg(viewBox.center().longitude(unit))
-                .arg(distance);
-        engine->connectSource( dataSource, q );
+        requestPendingTiles();
+        evictTiles();
+    };
+
+    /** @brief Connect data sources for pending tiles, not more than MAXIMUM_CONCURRENT_REQUESTS. */
+    void requestPendingTiles()
+    {
+        Q_Q( PublicTransportLayer );
+        Plasma::DataEngine *engine = Plasma::DataEngineManager::self()->engine( "publictransport" );
+        while ( !pendingTiles.isEmpty() && tileRequests.count() < MAXIMUM_CONCURRENT_REQUESTS ) {
+            const StopTile tile = pendingTiles.takeFirst();
+            const QString dataSource = dataSourceForTile( tile );
+            tileRequests.insert( dataSource, tile );
+            engine->connectSource( dataSource, q );
+        }
+    };
+
+    /**
+     * @brief Remove loaded tiles, which are no longer needed, and their stops.
+     *
+     * Tiles of the current level get removed, if they are far away from the visible tiles.
+     * Tiles of other levels stay until all tiles of the current level are loaded, so that stops
+     * stay visible while zooming.
+     **/
+    void evictTiles()
+    {
+        const bool allTilesLoaded = tileRequests.isEmpty() && pendingTiles.isEmpty();
+        const QRect keptTiles = tilesForBox( qMax(0, tileLevel), viewBox ).adjusted(
+                -TILE_EVICTION_DISTANCE, -TILE_EVICTION_DISTANCE,
+                TILE_EVICTION_DISTANCE, TILE_EVICTION_DISTANCE );
+        QSet< StopTile > evictedTiles;
+        foreach ( const StopTile &tile, loadedTiles ) {
+            if ( tile.level == tileLevel ? !keptTiles.contains(tile.x, tile.y) : allTilesLoaded ) {
+                evictedTiles << tile;
+            }
+        }
+        if ( !evictedTiles.isEmpty() ) {
+            loadedTiles.subtract( evictedTiles );
+            removeInternalStops( evictedTiles );
+        }
+    };
+
+    /**
+     * @brief Remove stops that were loaded for @p tiles.
+     *
+     * Stops that are also active, hovered or selected do not get removed. Stops inside another
+     * loaded tile, eg. of another level, do not get removed either.
+     * If @p tiles is empty, stops of all tiles get removed.
+     **/
+    void removeInternalStops( const QSet<StopTile> &tiles = QSet<StopTile>() )
+    {
+        QSet< int > levels, loadedLevels;
+        foreach ( const StopTile &tile, tiles ) {
+            levels << tile.level;
+        }
+        foreach ( const StopTile &tile, loadedTiles ) {
+            loadedLevels << tile.level;
+        }
+
+        QMap<Stop, StopData>::Iterator it = stops.begin();
+        while ( it != stops.end() ) {
+            if ( it->flags == StopFlags(InternalStop) && (tiles.isEmpty() ||
+                 (isInTiles(it->coords, tiles, levels) &&
+                  !isInTiles(it->coords, loadedTiles, loadedLevels))) )
+            {
+                it = stops.erase( it );
+            } else {
+                ++it;
+            }
+        }
+    };
+
+    /** @brief Abort all tile requests and remove all loaded tiles with their stops. */
+    void clearTiles()
+    {
+        Q_Q( PublicTransportLayer );
+        Plasma::DataEngine *engine = Plasma::DataEngineManager::self()->engine( "publictransport" );
+        foreach ( const QString &dataSource, tileRequests.keys() ) {
+            engine->disconnectSource( dataSource, q );
+        }
+        tileRequests.clear();
+        pendingTiles.clear();
+        loadedTiles.clear();
+        removeInternalStops();
+    };
+
+    /** @brief Get a pixmap for a cluster of @p count stops. */
+    QPixmap clusterPixmap( int count, const QFontMetrics &metrics )
+    {
+        const QString text = count > 99 ? QLatin1String("99+") : QString::number( count );
+        if ( clusterPixmaps.contains(text) ) {
+            return clusterPixmaps[ text ];
+        }
+
+        // Draw the number of stops into a circle
+        const int size = qMax( 16, metrics.width(text) + 8 );
+        QPixmap pixmap( size, size );
+        pixmap.fill( Qt::transparent );
+        QPainter painter( &pixmap );
+        painter.setRenderHint( QPainter::Antialiasing );
+        painter.setFont( KGlobalSettings::smallestReadableFont() );
+        painter.setPen( KColorScheme(QPalette::Active).foreground().color() );
+        painter.setBrush( KColorScheme(QPalette::Active).background() );
+        painter.drawEllipse( QRectF(0.5, 0.5, size - 1, size - 1) );
+        painter.drawText( pixmap.rect(), Qt::AlignCenter, text );
+        painter.end();
+
+        clusterPixmaps.insert( text, pixmap );
+        return pixmap;
     };
 
     /**
@@ -393,14 +622,17 @@ public:
         return filteredStops;
     };
 
-    /** @brief Whether or not internal stops should be shown. */
-    inline bool showInternalStops() const { return mapWidget->zoom() > 2500; };
+    /**
+     * @brief Whether or not annotations should be shown for internal stops.
+     * Internal stops get drawn in clusters when zoomed out, but without annotations.
+     **/
+    inline bool annotateInternalStops() const { return mapWidget->zoom() > 2500; };
 
     /** @brief Whether or not an AnnotationData object should be prepared for @p stop. */
     inline bool doPrepareAnnotationForStop( const StopData &stopData ) const
     {
         return stopData.isActive() || stopData.isHovered() || stopData.isSelected() ||
-               (stopData.isInternal() && showInternalStops());
+               (stopData.isInternal() && annotateInternalStops());
     };
 
     /**
@@ -424,34 +656,41 @@ public:
 
         // Draw inactive and internal stop icons transparently (not active nor hovered)
         // Draw more transparently if zoomed farther away
-        painter->setOpacity( qBound(0.0, 0.9 * (mapWidget->zoom() - 1500) / 1500 - 0.3, 0.7) );
-        QList< GeoDataCoordinates > stopCoords;
+        painter->setOpacity( qBound(0.4, 0.9 * (mapWidget->zoom() - 1500) / 1500 - 0.3, 0.7) );
+
+        // Put the stops into a grid of cells with CLUSTER_CELL_SIZE pixels, one marker gets drawn
+        // for each cell. With more stops in the visible region more stops share a cell.
+        QHash< QPair<int, int>, QPair<GeoDataCoordinates, int> > clusters;
         for ( QMap<Stop, StopData>::ConstIterator it = stops.constBegin();
               it != stops.constEnd(); ++it )
         {
             // Only draw inactive, not hovered/selected or internal stops with less transparency.
-            // Do not draw internal stops when zooming far out.
-            if ( it->isActive() || it->isHovered() || it->isSelected() ||
-                 (it->isInternal() && !showInternalStops()) )
-            {
+            // When zooming far out, internal stops of bigger tiles get drawn in clusters.
+            if ( it->isActive() || it->isHovered() || it->isSelected() ) {
                 continue;
             }
 
-            // Check if the stop is on the same pixel as an already drawn stop
-            bool draw = true;
-            foreach ( const GeoDataCoordinates &coords, stopCoords ) {
-                if ( viewport->resolves(coords, it->coords) ) {
-                    draw = false;
-                    break;
-                }
-            }
-            if ( !draw ) {
+            qreal x, y;
+            if ( !viewport->screenCoordinates(it->coords, x, y) ) {
+                // Not visible
                 continue;
             }
 
-            // Draw the stop
-            drawStop( painter, it->coords, stopPixmap );
-            stopCoords << it->coords;
+            // Use the coordinates of the first stop in a cell for the marker
+            const QPair<int, int> cell( qFloor(x / CLUSTER_CELL_SIZE), qFloor(y / CLUSTER_CELL_SIZE) );
+            QPair<GeoDataCoordinates, int> &cluster = clusters[ cell ];
+            if ( cluster.second == 0 ) {
+                cluster.first = it->coords;
+            }
+            ++cluster.second;
+        }
+
+        // Draw a stop icon for cells with one stop and an aggregated marker for other cells
+        for ( QHash< QPair<int, int>, QPair<GeoDataCoordinates, int> >::ConstIterator it =
+              clusters.constBegin(); it != clusters.constEnd(); ++it )
+        {
+            drawStop( painter, it->first, it->second == 1 ? stopPixmap
+                                                          : clusterPixmap(it->second, metrics) );
         }
 
         // Draw stop icons for hovered stops
@@ -532,7 +771,11 @@ public:
     QList< AnnotationData > annotations; /**< Prepared data for drawing annotations. */
     QTimer *loadTimer; /**< A timer to not start too many requests while scrolling. */
     GeoDataLatLonAltBox viewBox; /**< Stores the currently visible map region. */
-    QString dataSource; /**< The name of the currently connected data source from the engine. */
+    int tileLevel; /**< The level of the tiles to load for viewBox or -1 to not load stops. */
+    QSet< StopTile > loadedTiles; /**< Tiles for which stops were loaded. */
+    QHash< QString, StopTile > tileRequests; /**< Requested tiles by connected source name. */
+    QList< StopTile > pendingTiles; /**< Tiles to request, when other requests are finished. */
+    QHash< QString, QPixmap > clusterPixmaps; /**< Markers for clusters by the shown text. */
 };
 
 PublicTransportLayer::PublicTransportLayer( MarbleWidget *mapWidget, const QString &serviceProvider,
@@ -556,6 +799,7 @@ PublicTransportLayer::~PublicTransportLayer()
 {
     Q_D( PublicTransportLayer );
     if ( d->flags.testFlag(AutoLoadStopsForMapRegion) ) {
+        d->clearTiles();
         Plasma::DataEngineManager::self()->unloadEngine( "publictransport" );
     }
     delete d_ptr;
@@ -602,6 +846,7 @@ void PublicTransportLayer::setServiceProvider( const QString &serviceProvider )
 
     if ( d->flags.testFlag(AutoLoadStopsForMapRegion) ) {
         // Update stops for the current map region, when the auto load feature is enbaled
+        d->clearTiles();
         startStopsByGeoPositionRequest();
     }
 }
@@ -745,59 +990,48 @@ void PublicTransportLayer::dataUpdated( const QString &sourceName,
         return;
     }
 
-    // Check for errors
-    if ( data.value("error").toBool() || !data.contains("stops") ) {
+    // Disconnect source again, ignore aborted requests
+    Plasma::DataEngine *engine = Plasma::DataEngineManager::self()->engine( "publictransport" );
+    engine->disconnectSource( sourceName, this );
+    if ( !d->tileRequests.contains(sourceName) ) {
+        kDebug() << "Aborted source" << sourceName;
         return;
     }
+    const StopTile tile = d->tileRequests.take( sourceName );
 
-    // Delete old stops that are out of an extended map viewport rectangle
-    ViewportParams *viewport = d->mapWidget->viewport();
-    qreal centerX, centerY;
-    viewport->screenCoordinates( viewport->centerLongitude(), viewport->centerLatitude(),
-                                 centerX, centerY );
-    QRect viewportRect( centerX - viewport->width() / 2, centerY - viewport->width() / 2,
-                        viewport->width(), viewport->height() );
-    viewportRect.adjust( -viewport->width(), -viewport->height(),
-                         viewport->width(), viewport->height() );
-
-    QMap<Stop, StopData>::Iterator it = d->stops.begin();
-    while ( it != d->stops.end() ) {
-        if ( !it->isInternal() ) {
-            ++it;
-        } else {
-            qreal stopX, stopY;
-            viewport->screenCoordinates( it->coords, stopX, stopY );
-            if ( viewportRect.contains(stopX, stopY) ) {
-                ++it;
-            } else {
-                // The stop is internal (loaded for the current map region)
-                // and out of an extended map viewport rectangle
-                it = d->stops.erase( it );
-            }
-        }
+    // Request the next pending tile
+    d->requestPendingTiles();
+
+    // Check for errors
+    if ( data.value("error").toBool() || !data.contains("stops") ) {
+        d->evictTiles();
+        d->mapWidget->update();
+        return;
     }
 
-    // Convert stop data from the engine to PublicTransport::Stop objects
-    // and insert them as internal stops (where requested for the currently visible map region)
+    // Convert stop data from the engine to PublicTransport::Stop objects and insert them as
+    // internal stops. Stops outside of the requested tile get loaded with other tiles.
+    d->loadedTiles.insert( tile );
     QVariantList stops = data["stops"].toList();
     foreach ( const QVariant &stopData, stops ) {
         const QVariantHash stop = stopData.toHash();
+        if ( !stop.contains("StopLongitude") || !stop.contains("StopLatitude") ) {
+            continue;
+        }
+
         const QString stopName = stop["StopName"].toString();
         const QString stopID = stop["StopID"].toString();
-        const bool coordsAvailable = stop.contains("StopLongitude") && stop.contains("StopLatitude");
-        const qreal longitude = coordsAvailable ? stop["StopLongitude"].toReal() : 0;
-        const qreal latitude = coordsAvailable? stop["StopLatitude"].toReal() : 0;
-
-        const Stop stopItem( stopName, stopID, coordsAvailable, longitude, latitude );
-        d->addStop( stopItem, InternalStop );
+        const qreal longitude = stop["StopLongitude"].toReal();
+        const qreal latitude = stop["StopLatitude"].toReal();
+        if ( PublicTransportLayerPrivate::tileForCoordinates(tile.level, longitude, latitude)
+             == tile )
+        {
+            d->addStop( Stop(stopName, stopID, true, longitude, latitude), InternalStop );
+        }
     }
 
-    // Disconnect source again
-    if ( d->dataSource == sourceName ) {
-        Plasma::DataEngine *engine = Plasma::DataEngineManager::self()->engine( "publictransport" );
-        engine->disconnectSource( sourceName, this );
-        d->dataSource.clear();
-    }
+    // Remove tiles of the previous level, if all tiles of the current level are loaded now
+    d->evictTiles();
 
     // Notify about the new stops
     emit stopsForVisibleMapRegionLoaded();
@@ -838,13 +1072,9 @@ Stop PublicTransportLayer::hoveredStop() const
 
 bool PublicTransportLayer::isStopVisible( const Stop &stop ) const
 {
+    // Internal stops get drawn at all zoom levels, maybe in a cluster
     Q_D( const PublicTransportLayer );
-    if ( !d->stops.contains(stop) ) {
-        return false;
-    } else {
-        const StopData &data = d->stops[ stop ];
-        return !data.isInternal() || d->showInternalStops();
-    }
+    return d->stops.contains( stop );
 }
 
 }; // namespace PublicTransport
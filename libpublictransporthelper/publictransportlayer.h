@@ -58,7 +58,8 @@ class PublicTransportLayerPrivate;
  *
  * If the AutoLoadStopsForMapRegion flag is set in the constructor, the ID of the provider to be
  * used for stop suggestion requests needs to be given. The provider needs to support the features
- * ProvidesStopPosition and ProvidesStopsByGeoPosition.
+ * ProvidesStopPosition and ProvidesStopsByGeoPosition. Stops get loaded in tiles, when zoomed out
+ * bigger tiles with less stops get loaded and nearby stops get drawn in clusters.
  **/
 class PUBLICTRANSPORTHELPER_EXPORT PublicTransportLayer : public QObject, public LayerInterface
 {
@@ -18,6 +18,7 @@
  */
 
 #include "stopfinder.h"
+#include "stopsuggestioncache.h"
 #include <Plasma/DataEngineManager>
 
 /** @brief Namespace for the publictransport helper library. */
@@ -26,11 +27,18 @@ namespace PublicTransport {
 class StopSuggesterPrivate
 {
 public:
+    /** @brief A running request for stop suggestions. */
+    struct Request {
+        QString serviceProviderId;
+        QString city;
+        QString stopPart;
+    };
+
     StopSuggesterPrivate( Plasma::DataEngine* _publicTransportEngine )
             : publicTransportEngine(_publicTransportEngine) {};
 
     Plasma::DataEngine *publicTransportEngine;
-    QStringList sourceNames;
+    QHash< QString, Request > requests; // Running requests by source name
 };
 
 StopSuggester::StopSuggester( Plasma::DataEngine* publicTransportEngine,
@@ -50,20 +58,34 @@ void StopSuggester::requestSuggestions( const QString &serviceProviderID,
 {
     Q_D( StopSuggester );
     if ( runningRequestOptions == AbortRunningRequests ) {
-        foreach( const QString &sourceName, d->sourceNames ) {
+        foreach( const QString &sourceName, d->requests.keys() ) {
             d->publicTransportEngine->disconnectSource( sourceName, this );
         }
-        d->sourceNames.clear();
+        d->requests.clear();
+    }
+
+    // Use cached suggestions if possible, also when the user types more characters
+    QVariantList stops;
+    if ( StopSuggestionCache::self()->suggestions(serviceProviderID, city, stopSubstring,
+                                                  &stops) )
+    {
+        emitStopSuggestions( stops );
+        return;
     }
 
+    QString sourceName;
     if ( !city.isEmpty() ) { // m_useSeparateCityValue ) {
-        d->sourceNames << QString( "Stops %1|stop=%2|city=%3" )
+        sourceName = QString( "Stops %1|stop=%2|city=%3" )
                 .arg( serviceProviderID, stopSubstring, city );
     } else {
-        d->sourceNames << QString( "Stops %1|stop=%2" )
-                .arg( serviceProviderID, stopSubstring );
+        sourceName = QString( "Stops %1|stop=%2" ).arg( serviceProviderID, stopSubstring );
     }
-    d->publicTransportEngine->connectSource( d->sourceNames.last(), this );
+    StopSuggesterPrivate::Request request;
+    request.serviceProviderId = serviceProviderID;
+    request.city = city;
+    request.stopPart = stopSubstring;
+    d->requests.insert( sourceName, request );
+    d->publicTransportEngine->connectSource( sourceName, this );
 }
 
 void StopSuggester::dataUpdated( const QString& sourceName, const Plasma::DataEngine::Data& data )
@@ -71,36 +93,45 @@ void StopSuggester::dataUpdated( const QString& sourceName, const Plasma::DataEn
     Q_D( StopSuggester );
     if ( sourceName.startsWith( QLatin1String( "Stops" ), Qt::CaseInsensitive ) ) {
         d->publicTransportEngine->disconnectSource( sourceName, this );
-        if ( !d->sourceNames.removeOne( sourceName ) ) {
+        if ( !d->requests.contains(sourceName) ) {
             kDebug() << "Source" << sourceName << "was aborted";
             return;
         }
 
-        QStringList stopNames;
-        QVariantHash stopToStopID;
-        QHash<QString, int> stopToStopWeight;
-        QVariantList stops = data["stops"].toList();
-        foreach ( const QVariant &stopData, stops ) {
-            QVariantHash stop = stopData.toHash();
-            QString stopName = stop["StopName"].toString();
-            QString stopID = stop["StopID"].toString();
-            int stopWeight = stop["StopWeight"].toInt();
-            stopNames.append( stopName );
-            stopToStopID.insert( stopName, stopID );
-            stopToStopWeight.insert( stopName, stopWeight );
+        const StopSuggesterPrivate::Request request = d->requests.take( sourceName );
+        if ( !data.value("error").toBool() && data.contains("stops") ) {
+            StopSuggestionCache::self()->insertSuggestions( request.serviceProviderId,
+                    request.city, request.stopPart, data["stops"].toList() );
         }
+        emitStopSuggestions( data["stops"].toList() );
+    }
+}
 
-        if ( !stopNames.isEmpty() ) {
-            emit stopSuggestionsReceived( stopNames, stopToStopID, stopToStopWeight );
-        } else {
-            kDebug() << "nothing found";
-        }
+void StopSuggester::emitStopSuggestions( const QVariantList &stops )
+{
+    QStringList stopNames;
+    QVariantHash stopToStopID;
+    QHash<QString, int> stopToStopWeight;
+    foreach ( const QVariant &stopData, stops ) {
+        QVariantHash stop = stopData.toHash();
+        QString stopName = stop["StopName"].toString();
+        QString stopID = stop["StopID"].toString();
+        int stopWeight = stop["StopWeight"].toInt();
+        stopNames.append( stopName );
+        stopToStopID.insert( stopName, stopID );
+        stopToStopWeight.insert( stopName, stopWeight );
+    }
+
+    if ( !stopNames.isEmpty() ) {
+        emit stopSuggestionsReceived( stopNames, stopToStopID, stopToStopWeight );
+    } else {
+        kDebug() << "nothing found";
     }
 }
 
 bool StopSuggester::isRunning() const {
     Q_D( const StopSuggester );
-    return !d->sourceNames.isEmpty();
+    return !d->requests.isEmpty();
 }
 
 class StopFinderPrivate
@@ -45,6 +45,12 @@ public:
     explicit StopSuggester( Plasma::DataEngine *publicTransportEngine, QObject* parent = 0 );
     virtual ~StopSuggester();
 
+    /**
+     * @brief Request stop suggestions for @p stopSubstring.
+     *
+     * Suggestions get taken from StopSuggestionCache if possible. stopSuggestionsReceived()
+     * then gets emitted before this function returns.
+     **/
     void requestSuggestions( const QString &serviceProviderID, const QString &stopSubstring,
                              const QString &city = QString(),
                              RunningRequestOptions runningRequestOptions = AbortRunningRequests );
@@ -63,6 +69,8 @@ protected:
     StopSuggesterPrivate* const d_ptr;
 
 private:
+    void emitStopSuggestions( const QVariantList &stops );
+
     Q_DECLARE_PRIVATE( StopSuggester )
     Q_DISABLE_COPY( StopSuggester )
 };
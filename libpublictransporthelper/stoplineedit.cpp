@@ -20,6 +20,7 @@
 // Own includes
 #include "stoplineedit.h"
 #include "stopsettings.h"
+#include "stopsuggestioncache.h"
 
 #ifdef MARBLE_FOUND
     #include "publictransportmapwidget.h"
@@ -241,9 +242,21 @@ public:
         Plasma::DataEngine *engine = Plasma::DataEngineManager::self()->engine("publictransport");
         if ( !sourceName.isEmpty() ) {
             engine->disconnectSource( sourceName, q );
+            sourceName.clear();
+        }
+
+        // Use cached suggestions if possible, also when the user types more characters
+        QVariantList cachedStops;
+        if ( StopSuggestionCache::self()->suggestions(serviceProvider, city, stopName,
+                                                      &cachedStops) )
+        {
+            state = StopLineEditPrivate::Ready;
+            q->setStopSuggestions( cachedStops );
+            return;
         }
 
         state = StopLineEditPrivate::WaitingForStopSuggestions;
+        stopPart = stopName;
         sourceName = QString("Stops %1|stop=%2").arg( serviceProvider, stopName );
         if ( !city.isEmpty() ) { // m_useSeparateCityValue ) {
             sourceName += QString("|city=%3").arg( city );
@@ -258,6 +271,7 @@ public:
     State state;
     int progress; // Progress of the data engine in processing a task (0 .. 100)
     QString sourceName; // Source name used to request stop suggestions at the data engine
+    QString stopPart; // The stop name part for which suggestions were requested last
     QString errorString;
     QString question;
     QString questionToolTip;
@@ -832,6 +846,16 @@ void StopLineEdit::dataUpdated( const QString& sourceName, const Plasma::DataEng
         return;
     }
 
+    const QVariantList stops = data["stops"].toList();
+    StopSuggestionCache::self()->insertSuggestions( d->serviceProvider, d->city, d->stopPart,
+                                                    stops );
+    setStopSuggestions( stops );
+}
+
+void StopLineEdit::setStopSuggestions( const QVariantList &stops )
+{
+    Q_D( StopLineEdit );
+
     // Delete old stops
     QList<Stop>::Iterator it = d->stops.begin();
     while ( it != d->stops.end() ) {
@@ -845,7 +869,6 @@ void StopLineEdit::dataUpdated( const QString& sourceName, const Plasma::DataEng
 
     QStringList weightedStops;
     QHash<Stop, QVariant> stopToStopWeight;
-    QVariantList stops = data["stops"].toList();
     foreach ( const QVariant &stopData, stops ) {
         QVariantHash stop = stopData.toHash();
         const QString stopName = stop["StopName"].toString();
@@ -172,6 +172,14 @@ protected:
     /** @brief Cancel a running GTFS feed import. */
     bool cancelImport();
 
+    /**
+     * @brief Use @p stops as suggestions for the current text.
+     *
+     * @param stops Received or cached suggestions in the format of the "stops" value of
+     *   "Stops" data sources of the publictransport engine.
+     **/
+    void setStopSuggestions( const QVariantList &stops );
+
 private:
     Q_DECLARE_PRIVATE( StopLineEdit )
     Q_DISABLE_COPY( StopLineEdit )
@@ -0,0 +1,190 @@
+/*
+ *   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "stopsuggestioncache.h"
+
+#include <KGlobal>
+#include <QCache>
+#include <QDateTime>
+
+/** @brief Namespace for the publictransport helper library. */
+namespace PublicTransport {
+
+/** @brief Orders stops by how good they match a stop name part, then by their weight. */
+class StopRanking
+{
+public:
+    explicit StopRanking( const QString &stopPart ) : m_stopPart(stopPart) {};
+
+    bool operator()( const QVariant &stop1, const QVariant &stop2 ) const {
+        const QVariantHash stopData1 = stop1.toHash();
+        const QVariantHash stopData2 = stop2.toHash();
+        const int rank1 = rank( stopData1["StopName"].toString() );
+        const int rank2 = rank( stopData2["StopName"].toString() );
+        if ( rank1 != rank2 ) {
+            return rank1 < rank2;
+        }
+        return stopData1["StopWeight"].toInt() > stopData2["StopWeight"].toInt();
+    };
+
+private:
+    // 0: Starts with the stop name part, 1: A word starts with it, 2: Contains it somewhere
+    int rank( const QString &stopName ) const {
+        const QString name = StopSuggestionCache::normalizedStopPart( stopName );
+        if ( name.startsWith(m_stopPart) ) {
+            return 0;
+        }
+        const int pos = name.indexOf( m_stopPart );
+        return pos > 0 && !name[pos - 1].isLetterOrNumber() ? 1 : 2;
+    };
+
+    QString m_stopPart;
+};
+
+class StopSuggestionCachePrivate
+{
+public:
+    /** @brief Cached suggestions for a stop name part. */
+    struct Suggestions {
+        QVariantList stops;
+        bool complete; // Whether or not the provider has suggested all matching stops
+        uint expires; // Time at which the suggestions expire in seconds since the epoch
+    };
+
+    StopSuggestionCachePrivate() : suggestions(StopSuggestionCache::MAXIMUM_CACHED_REQUESTS) {};
+
+    static QString key( const QString &serviceProviderId, const QString &city,
+                        const QString &normalizedStopPart ) {
+        return serviceProviderId + '|' + city.toLower() + '|' + normalizedStopPart;
+    };
+
+    /** @brief Get suggestions stored for @p key, expired suggestions get removed. */
+    const Suggestions *cachedSuggestions( const QString &key, uint now ) {
+        const Suggestions *cached = suggestions.object( key );
+        if ( cached && cached->expires < now ) {
+            suggestions.remove( key );
+            return 0;
+        }
+        return cached;
+    };
+
+    QCache< QString, Suggestions > suggestions; // Suggested stops by key()
+    QHash< QString, int > maximumCounts; // Longest received list by service provider ID
+};
+
+class StopSuggestionCacheSingleton
+{
+public:
+    StopSuggestionCache self;
+};
+K_GLOBAL_STATIC( StopSuggestionCacheSingleton, globalStopSuggestionCache )
+
+StopSuggestionCache *StopSuggestionCache::self()
+{
+    return &globalStopSuggestionCache->self;
+}
+
+StopSuggestionCache::StopSuggestionCache() : d_ptr(new StopSuggestionCachePrivate)
+{
+}
+
+StopSuggestionCache::~StopSuggestionCache()
+{
+    delete d_ptr;
+}
+
+QString StopSuggestionCache::normalizedStopPart( const QString &stopPart )
+{
+    return stopPart.simplified().toLower();
+}
+
+bool StopSuggestionCache::suggestions( const QString &serviceProviderId, const QString &city,
+                                       const QString &stopPart, QVariantList *stops )
+{
+    Q_D( StopSuggestionCache );
+    const QString normalized = normalizedStopPart( stopPart );
+    if ( normalized.isEmpty() ) {
+        return false;
+    }
+
+    // Use suggestions received for the same stop name part
+    const uint now = QDateTime::currentDateTime().toTime_t();
+    const StopSuggestionCachePrivate::Suggestions *cached = d->cachedSuggestions(
+            StopSuggestionCachePrivate::key(serviceProviderId, city, normalized), now );
+    if ( cached ) {
+        *stops = cached->stops;
+        return true;
+    }
+
+    // Search complete suggestions for the beginning of the stop name part, starting with the
+    // longest one, which has the fewest stops to filter
+    for ( int length = normalized.length() - 1; length > 0; --length ) {
+        cached = d->cachedSuggestions( StopSuggestionCachePrivate::key(
+                serviceProviderId, city, normalized.left(length)), now );
+        if ( !cached || !cached->complete ) {
+            continue;
+        }
+
+        // The provider has suggested all stops for the shorter stop name part,
+        // the suggestions for the longer part are the ones containing it
+        QVariantList matchingStops;
+        foreach ( const QVariant &stop, cached->stops ) {
+            if ( normalizedStopPart(stop.toHash()["StopName"].toString()).contains(normalized) ) {
+                matchingStops << stop;
+            }
+        }
+        qStableSort( matchingStops.begin(), matchingStops.end(), StopRanking(normalized) );
+        *stops = matchingStops;
+        return true;
+    }
+
+    return false;
+}
+
+void StopSuggestionCache::insertSuggestions( const QString &serviceProviderId,
+        const QString &city, const QString &stopPart, const QVariantList &stops,
+        int requestedCount )
+{
+    Q_D( StopSuggestionCache );
+    const QString normalized = normalizedStopPart( stopPart );
+    if ( normalized.isEmpty() || stops.isEmpty() ) {
+        return;
+    }
+
+    // Lists shorter than the longest list received from the provider were not truncated
+    int &maximumCount = d->maximumCounts[ serviceProviderId ];
+    maximumCount = qMax( maximumCount, stops.count() );
+
+    StopSuggestionCachePrivate::Suggestions *suggestions =
+            new StopSuggestionCachePrivate::Suggestions;
+    suggestions->stops = stops;
+    suggestions->complete = stops.count() < maximumCount && stops.count() < requestedCount;
+    suggestions->expires = QDateTime::currentDateTime().toTime_t() + MAXIMUM_SUGGESTION_AGE;
+    d->suggestions.insert( StopSuggestionCachePrivate::key(serviceProviderId, city, normalized),
+                           suggestions );
+}
+
+void StopSuggestionCache::clear()
+{
+    Q_D( StopSuggestionCache );
+    d->suggestions.clear();
+    d->maximumCounts.clear();
+}
+
+} // namespace PublicTransport
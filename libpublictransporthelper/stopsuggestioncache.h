@@ -0,0 +1,115 @@
+/*
+ *   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef STOPSUGGESTIONCACHE_HEADER
+#define STOPSUGGESTIONCACHE_HEADER
+
+/** @file
+ * @brief This file contains the StopSuggestionCache class.
+ * @author Friedrich Pülz <fpuelz@gmx.de> */
+
+#include "publictransporthelper_export.h"
+
+#include <QVariant>
+
+/** @brief Namespace for the publictransport helper library. */
+namespace PublicTransport {
+
+class StopSuggestionCachePrivate;
+
+/**
+ * @brief A process-wide cache of stop suggestions received from the publictransport engine.
+ *
+ * Use self() to get the instance, which gets shared by StopSuggester, StopLineEdit and the
+ * runner. Received suggestions get stored with insertSuggestions() for the service provider,
+ * the city and the normalized stop name part that was used in the request, see
+ * normalizedStopPart(). Cached suggestions expire after MAXIMUM_SUGGESTION_AGE seconds, empty
+ * lists do not get stored.
+ *
+ * suggestions() returns cached suggestions for the same request. If there are none, cached
+ * suggestions for the beginning of the stop name part get used, but only if they are
+ * complete. Providers return a limited number of suggestions, which is different for each
+ * provider and unknown to the cache. Therefore the longest list received from a provider is
+ * used as it's limit. Shorter lists are complete, if they also contain less stops than
+ * requested. Suggestions that contain the longer stop name part get filtered from a complete
+ * list and ranked locally, without a new request to the provider.
+ **/
+class PUBLICTRANSPORTHELPER_EXPORT StopSuggestionCache {
+    friend class StopSuggestionCacheSingleton;
+
+public:
+    /** @brief The number of stop suggestions requested by default, like in the engine. */
+    static const int DEFAULT_REQUESTED_COUNT = 20;
+
+    /** @brief The maximal number of cached stop suggestion lists. */
+    static const int MAXIMUM_CACHED_REQUESTS = 200;
+
+    /** @brief Seconds after which cached suggestions need to be requested again. */
+    static const int MAXIMUM_SUGGESTION_AGE = 30 * 60;
+
+    /** @brief Gets the instance of the cache used in this process. */
+    static StopSuggestionCache *self();
+
+    virtual ~StopSuggestionCache();
+
+    /**
+     * @brief Get cached suggestions for @p stopPart.
+     *
+     * @param serviceProviderId The ID of the service provider of the suggestions.
+     * @param city The city of the suggestions, if the provider uses a separate city value.
+     * @param stopPart The stop name part for which to get suggestions.
+     * @param stops Gets set to the suggested stops in the format of the "stops" value of
+     *   "Stops" data sources of the publictransport engine.
+     * @return True, if suggestions were found in the cache. Otherwise they need to be
+     *   requested from the data engine.
+     **/
+    bool suggestions( const QString &serviceProviderId, const QString &city,
+                      const QString &stopPart, QVariantList *stops );
+
+    /**
+     * @brief Store suggested @p stops received for @p stopPart.
+     *
+     * Only store suggestions of successful requests, results with an error must not be stored.
+     * Empty lists get ignored, they can be caused by temporary problems of the provider.
+     *
+     * @param stops The "stops" value of a "Stops" data source of the publictransport engine.
+     * @param requestedCount The maximal number of stops that were requested, ie. the "count"
+     *   parameter of the data source.
+     **/
+    void insertSuggestions( const QString &serviceProviderId, const QString &city,
+                            const QString &stopPart, const QVariantList &stops,
+                            int requestedCount = DEFAULT_REQUESTED_COUNT );
+
+    /** @brief Remove all cached suggestions. */
+    void clear();
+
+    /** @brief Gets @p stopPart in lower case and with simplified whitespace. */
+    static QString normalizedStopPart( const QString &stopPart );
+
+private:
+    StopSuggestionCache();
+
+    StopSuggestionCachePrivate* const d_ptr;
+    Q_DECLARE_PRIVATE( StopSuggestionCache )
+    Q_DISABLE_COPY( StopSuggestionCache )
+};
+
+} // namespace PublicTransport
+
+#endif // STOPSUGGESTIONCACHE_HEADER
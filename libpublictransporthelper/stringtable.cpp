@@ -0,0 +1,169 @@
+/*
+ *   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "stringtable.h"
+
+#include <KGlobal>
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+
+/** @brief Namespace for the publictransport helper library. */
+namespace PublicTransport {
+
+class StringTablePrivate
+{
+public:
+    StringTablePrivate() {
+        // Handle 0 is used for null and empty strings
+        strings << QString();
+        foldedHandles << 0;
+    };
+
+    /** @brief Get the handle of @p string, add it if needed. The mutex needs to be locked. */
+    int handle( const QString &string ) {
+        if ( string.isEmpty() ) {
+            return 0;
+        }
+
+        QHash< QString, int >::ConstIterator it = handles.constFind( string );
+        if ( it != handles.constEnd() ) {
+            return *it;
+        }
+
+        // Add the string and it's case folded version, if it is different
+        const int newHandle = strings.count();
+        strings << string;
+        foldedHandles << newHandle;
+        handles.insert( string, newHandle );
+
+        const QString folded = string.toCaseFolded();
+        if ( folded != string ) {
+            foldedHandles[ newHandle ] = handle( folded );
+        }
+        return newHandle;
+    };
+
+    mutable QMutex mutex;
+    QHash< QString, int > handles; // Handles by string
+    QVector< QString > strings; // Strings by handle
+    QVector< int > foldedHandles; // Handles of case folded strings by handle
+};
+
+class StringTableSingleton
+{
+public:
+    StringTable self;
+};
+K_GLOBAL_STATIC( StringTableSingleton, globalStringTable )
+
+StringTable *StringTable::self()
+{
+    return &globalStringTable->self;
+}
+
+StringTable::StringTable() : d_ptr(new StringTablePrivate)
+{
+}
+
+StringTable::~StringTable()
+{
+    delete d_ptr;
+}
+
+QString StringTable::intern( const QString &string )
+{
+    Q_D( StringTable );
+    QMutexLocker locker( &d->mutex );
+    return d->strings[ d->handle(string) ];
+}
+
+QStringList StringTable::intern( const QStringList &strings )
+{
+    Q_D( StringTable );
+    QMutexLocker locker( &d->mutex );
+    QStringList internedStrings;
+    internedStrings.reserve( strings.count() );
+    foreach ( const QString &string, strings ) {
+        internedStrings << d->strings[ d->handle(string) ];
+    }
+    return internedStrings;
+}
+
+int StringTable::handle( const QString &string )
+{
+    Q_D( StringTable );
+    QMutexLocker locker( &d->mutex );
+    return d->handle( string );
+}
+
+int StringTable::foldedHandle( const QString &string )
+{
+    Q_D( StringTable );
+    QMutexLocker locker( &d->mutex );
+    return d->foldedHandles[ d->handle(string) ];
+}
+
+QList<int> StringTable::foldedHandles( const QStringList &strings )
+{
+    Q_D( StringTable );
+    QMutexLocker locker( &d->mutex );
+    QList<int> handles;
+    handles.reserve( strings.count() );
+    foreach ( const QString &string, strings ) {
+        handles << d->foldedHandles[ d->handle(string) ];
+    }
+    return handles;
+}
+
+int StringTable::findFoldedHandle( const QString &string ) const
+{
+    Q_D( const StringTable );
+    if ( string.isEmpty() ) {
+        return 0;
+    }
+
+    QMutexLocker locker( &d->mutex );
+    QHash< QString, int >::ConstIterator it = d->handles.constFind( string );
+    if ( it == d->handles.constEnd() ) {
+        // Strings that only differ in case from an interned string are not in the table,
+        // but their case folded version is
+        it = d->handles.constFind( string.toCaseFolded() );
+        if ( it == d->handles.constEnd() ) {
+            return -1;
+        }
+    }
+    return d->foldedHandles[ *it ];
+}
+
+QString StringTable::string( int handle ) const
+{
+    Q_D( const StringTable );
+    QMutexLocker locker( &d->mutex );
+    return handle >= 0 && handle < d->strings.count() ? d->strings[handle] : QString();
+}
+
+int StringTable::count() const
+{
+    Q_D( const StringTable );
+    QMutexLocker locker( &d->mutex );
+    return d->strings.count() - 1;
+}
+
+} // namespace PublicTransport
@@ -0,0 +1,112 @@
+/*
+ *   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef STRINGTABLE_HEADER
+#define STRINGTABLE_HEADER
+
+/** @file
+ * @brief This file contains the StringTable class.
+ * @author Friedrich Pülz <fpuelz@gmx.de> */
+
+#include "publictransporthelper_export.h"
+
+#include <QStringList>
+
+/** @brief Namespace for the publictransport helper library. */
+namespace PublicTransport {
+
+class StringTablePrivate;
+
+/**
+ * @brief A process-wide table of interned strings, eg. stop names, transport lines and targets.
+ *
+ * Use self() to get the instance. The same stop names appear again and again in the route
+ * stops of departures. intern() returns a copy of a string that shares it's data with all other
+ * interned copies of the same string. This saves memory, and comparing two interned strings
+ * with the same contents only compares their data pointers.
+ *
+ * Each string gets an integer handle, see handle(). foldedHandle() returns the same handle for
+ * strings that only differ in case, so case insensitive comparisons can be done by comparing
+ * handles. Handles stay valid for the lifetime of the process. Strings do not get removed
+ * from the table, the number of different stop names and lines used in a process is limited.
+ * Strings that are only compared with interned strings should not be added to the table, use
+ * findFoldedHandle() for them.
+ *
+ * All functions are thread safe.
+ **/
+class PUBLICTRANSPORTHELPER_EXPORT StringTable {
+    friend class StringTableSingleton;
+
+public:
+    /** @brief Gets the instance of the string table used in this process. */
+    static StringTable *self();
+
+    virtual ~StringTable();
+
+    /** @brief Get the interned copy of @p string, it gets added to the table if needed. */
+    QString intern( const QString &string );
+
+    /** @brief Get interned copies of all strings in @p strings, see intern(). */
+    QStringList intern( const QStringList &strings );
+
+    /**
+     * @brief Get the handle of @p string, it gets added to the table if needed.
+     *
+     * Equal strings get the same handle. Null and empty strings have the handle 0.
+     **/
+    int handle( const QString &string );
+
+    /**
+     * @brief Get the handle of the case folded version of @p string.
+     *
+     * Strings that only differ in case get the same handle.
+     **/
+    int foldedHandle( const QString &string );
+
+    /** @brief Get the handles of the case folded versions of all @p strings, see foldedHandle(). */
+    QList<int> foldedHandles( const QStringList &strings );
+
+    /**
+     * @brief Get the handle of the case folded version of @p string, without adding it.
+     *
+     * Use this to compare strings with handles of interned strings, if @p string does not need
+     * to be interned, eg. stop names from user input.
+     *
+     * @return The same handle as foldedHandle() or -1, if neither @p string nor it's case folded
+     *   version is in the table. -1 is never equal to the handle of an interned string.
+     **/
+    int findFoldedHandle( const QString &string ) const;
+
+    /** @brief Get the string with @p handle or a null string if @p handle is invalid. */
+    QString string( int handle ) const;
+
+    /** @brief Get the number of strings in the table. */
+    int count() const;
+
+private:
+    StringTable();
+
+    StringTablePrivate* const d_ptr;
+    Q_DECLARE_PRIVATE( StringTable )
+    Q_DISABLE_COPY( StringTable )
+};
+
+} // namespace PublicTransport
+
+#endif // STRINGTABLE_HEADER
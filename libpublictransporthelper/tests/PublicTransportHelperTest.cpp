@@ -23,6 +23,11 @@
 #include "../stopwidget.h"
 #include "../locationmodel.h"
 #include "../checkcombobox.h"
+#include "../vehicleiconatlas.h"
+#include "../stopsuggestioncache.h"
+#include "../stringtable.h"
+#include "../departureinfo.h"
+#include "../filter.h"
 
 #include <Plasma/DataEngineManager>
 #include <KComboBox>
@@ -863,5 +868,176 @@ void PublicTransportHelperTest::locationModelTest()
     QCOMPARE( model.data(index, LocationCodeRole).toString(), QLatin1String("de") );
 }
 
+void PublicTransportHelperTest::vehicleIconAtlasTest()
+{
+    // Keys differ in each part
+    const QSize size( 32, 32 );
+    const quint64 key = VehicleIconAtlas::iconKey( 0, Bus, size, VehicleIconAtlas::ShadowedIcon );
+    QCOMPARE( VehicleIconAtlas::iconKey(0, Bus, size, VehicleIconAtlas::ShadowedIcon), key );
+    QVERIFY( VehicleIconAtlas::iconKey(1, Bus, size, VehicleIconAtlas::ShadowedIcon) != key );
+    QVERIFY( VehicleIconAtlas::iconKey(0, Tram, size, VehicleIconAtlas::ShadowedIcon) != key );
+    QVERIFY( VehicleIconAtlas::iconKey(0, Bus, QSize(32, 33),
+                                       VehicleIconAtlas::ShadowedIcon) != key );
+    QVERIFY( VehicleIconAtlas::iconKey(0, Bus, QSize(33, 32),
+                                       VehicleIconAtlas::ShadowedIcon) != key );
+    QVERIFY( VehicleIconAtlas::iconKey(0, Bus, size, VehicleIconAtlas::ColoredIcon) != key );
+    QVERIFY( VehicleIconAtlas::iconKey(0, Plane, size) !=
+             VehicleIconAtlas::iconKey(0, Ship, size) );
+
+    // SVG element IDs
+    QCOMPARE( VehicleIconAtlas::elementId(Bus), QString("bus") );
+    QCOMPARE( VehicleIconAtlas::elementId(Tram, VehicleIconAtlas::MonochromeIcon),
+              QString("tram_white") );
+    QCOMPARE( VehicleIconAtlas::elementId(Tram, VehicleIconAtlas::MonochromeIcon |
+                                                VehicleIconAtlas::EmptyIcon),
+              QString("tram_white_empty") );
+    QCOMPARE( VehicleIconAtlas::elementId(Tram, VehicleIconAtlas::ShadowedIcon),
+              QString("tram") );
+    QVERIFY( VehicleIconAtlas::elementId(UnknownVehicleType).isEmpty() );
+
+    // Icons of unregistered SVGs are null
+    QVERIFY( VehicleIconAtlas::self()->icon(100, Bus, size).isNull() );
+}
+
+void PublicTransportHelperTest::stopSuggestionCacheTest()
+{
+    StopSuggestionCache *cache = StopSuggestionCache::self();
+    cache->clear();
+    QCOMPARE( StopSuggestionCache::normalizedStopPart("  Bremen   Hbf "), QString("bremen hbf") );
+
+    QVariantList stops;
+    QVERIFY( !cache->suggestions("de_db", QString(), "Bre", &stops) );
+
+    // The first list received from a provider could be truncated, 12 stops are the limit
+    QVariantList truncatedStops;
+    for ( int i = 0; i < 12; ++i ) {
+        QVariantHash stop;
+        stop["StopName"] = QString( "Berlin %1" ).arg( i );
+        truncatedStops << stop;
+    }
+    cache->insertSuggestions( "de_db", QString(), "ber", truncatedStops );
+    QVERIFY( cache->suggestions("de_db", QString(), "ber", &stops) );
+    QCOMPARE( stops, truncatedStops );
+
+    // Truncated lists cannot be used for refinements
+    QVERIFY( !cache->suggestions("de_db", QString(), "berl", &stops) );
+
+    // A complete list of suggestions, shorter than the longest list of the provider
+    QVariantList completeStops;
+    const QStringList stopNames = QStringList() << "Bremen Hbf" << "Oberbremen"
+            << "Bremerhaven" << "Alt Bremen";
+    for ( int i = 0; i < stopNames.count(); ++i ) {
+        QVariantHash stop;
+        stop["StopName"] = stopNames[i];
+        stop["StopWeight"] = i;
+        completeStops << stop;
+    }
+    cache->insertSuggestions( "de_db", QString(), "bre", completeStops );
+    QVERIFY( cache->suggestions("de_db", QString(), "BRE", &stops) );
+    QCOMPARE( stops, completeStops );
+    QVERIFY( !cache->suggestions("de_vrn", QString(), "bre", &stops) );
+    QVERIFY( !cache->suggestions("de_db", "Bremen", "bre", &stops) );
+
+    // Refinements get filtered from the complete list, ranked by where they contain the text
+    QVERIFY( cache->suggestions("de_db", QString(), "Brem", &stops) );
+    QCOMPARE( stops.count(), 4 );
+    QCOMPARE( stops[0].toHash()["StopName"].toString(), QString("Bremerhaven") );
+    QCOMPARE( stops[1].toHash()["StopName"].toString(), QString("Bremen Hbf") );
+    QCOMPARE( stops[2].toHash()["StopName"].toString(), QString("Alt Bremen") );
+    QCOMPARE( stops[3].toHash()["StopName"].toString(), QString("Oberbremen") );
+    QVERIFY( cache->suggestions("de_db", QString(), "bremen", &stops) );
+    QCOMPARE( stops.count(), 3 );
+    QVERIFY( cache->suggestions("de_db", QString(), "bremen hbf", &stops) );
+    QCOMPARE( stops.count(), 1 );
+
+    // Lists truncated to the requested number of stops are not complete
+    cache->insertSuggestions( "de_db", QString(), "ham", completeStops, completeStops.count() );
+    QVERIFY( cache->suggestions("de_db", QString(), "ham", &stops) );
+    QVERIFY( !cache->suggestions("de_db", QString(), "hamb", &stops) );
+
+    // Empty lists do not get stored, they do not hide suggestions for longer stop name parts
+    cache->insertSuggestions( "de_db", QString(), "x", QVariantList() );
+    QVERIFY( !cache->suggestions("de_db", QString(), "x", &stops) );
+    QVERIFY( !cache->suggestions("de_db", QString(), "xy", &stops) );
+    cache->clear();
+}
+
+void PublicTransportHelperTest::stringTableTest()
+{
+    StringTable *table = StringTable::self();
+    QCOMPARE( table->handle(QString()), 0 );
+    QCOMPARE( table->handle(""), 0 );
+    QCOMPARE( table->string(0), QString() );
+    QCOMPARE( table->string(-1), QString() );
+
+    // Equal strings get the same handle, the interned copies share their data
+    const int handle = table->handle( "Bremen Hbf" );
+    QVERIFY( handle > 0 );
+    QCOMPARE( table->handle(QString("Bremen") + " Hbf"), handle );
+    QCOMPARE( table->string(handle), QString("Bremen Hbf") );
+    QCOMPARE( table->intern(QString("Bremen") + " Hbf").constData(),
+              table->string(handle).constData() );
+    const QStringList interned = table->intern( QStringList() << "Bremen Hbf" << "Oberbremen" );
+    QCOMPARE( interned, QStringList() << "Bremen Hbf" << "Oberbremen" );
+    QCOMPARE( interned[0].constData(), table->string(handle).constData() );
+
+    // Folded handles are equal for strings differing only in case
+    QVERIFY( table->handle("BREMEN HBF") != handle );
+    QCOMPARE( table->foldedHandle("BREMEN HBF"), table->foldedHandle("bremen hbf") );
+    QCOMPARE( table->foldedHandle("Bremen Hbf"), table->foldedHandle("bremen hbf") );
+    QVERIFY( table->foldedHandle("Bremen Hbf") != table->foldedHandle("Bremerhaven") );
+    QCOMPARE( table->foldedHandles(QStringList() << "Bremen Hbf" << "BREMERHAVEN"),
+              QList<int>() << table->foldedHandle("bremen hbf")
+                           << table->foldedHandle("bremerhaven") );
+
+    // Finding folded handles does not add strings to the table
+    const int count = table->count();
+    QCOMPARE( table->findFoldedHandle("BREMEN HBF"), table->foldedHandle("bremen hbf") );
+    QCOMPARE( table->findFoldedHandle("bReMeN hBf"), table->foldedHandle("bremen hbf") );
+    QCOMPARE( table->findFoldedHandle(QString()), 0 );
+    QCOMPARE( table->findFoldedHandle("12:00: Not interned stop"), -1 );
+    QCOMPARE( table->count(), count );
+
+    // Filters compare stop names using folded handles
+    const DepartureInfo departure( "test", 0, DepartureInfo::NoDepartureFlags, QString(), "S1",
+            "Bremerhaven", QString(), QDateTime::currentDateTime(), InterurbanTrain,
+            false, false, QString(), -1, QString(), QString(),
+            QStringList() << "Bremen Hbf" << "Oberbremen" << "Bremerhaven" );
+    QCOMPARE( departure.targetHandle(), table->foldedHandle("bremerhaven") );
+    QCOMPARE( departure.routeStopHandles().count(), 3 );
+    Filter filter;
+    filter << Constraint( FilterByVia, FilterEquals, "OBERBREMEN" );
+    QVERIFY( filter.match(departure) );
+    filter[0].value = "Oberbremen Nord";
+    QVERIFY( !filter.match(departure) );
+    filter[0] = Constraint( FilterByTarget, FilterDoesntEqual, "bremerhaven" );
+    QVERIFY( !filter.match(departure) );
+    filter[0] = Constraint( FilterByNextStop, FilterEquals, "oberbremen" );
+    QVERIFY( filter.match(departure) );
+
+    // Filter values do not get added to the table, but are found when added later
+    const int countBeforeFilter = table->count();
+    filter[0] = Constraint( FilterByTarget, FilterEquals, "Unknown Stop" );
+    QVERIFY( !filter.match(departure) );
+    filter[0].variant = FilterDoesntEqual;
+    QVERIFY( filter.match(departure) );
+    QCOMPARE( table->count(), countBeforeFilter );
+    const DepartureInfo unknownTargetDeparture( "test", 1, DepartureInfo::NoDepartureFlags,
+            QString(), "S2", "UNKNOWN STOP", QString(), QDateTime::currentDateTime(),
+            InterurbanTrain );
+    QVERIFY( !filter.match(unknownTargetDeparture) );
+    filter[0].variant = FilterEquals;
+    QVERIFY( filter.match(unknownTargetDeparture) );
+
+    // Targets get trimmed for the handle and the hash
+    const QDateTime dateTime = QDateTime::currentDateTime();
+    const DepartureInfo trimmedDeparture( "test", 2, DepartureInfo::NoDepartureFlags, QString(),
+            "S1", "Bremerhaven", QString(), dateTime, InterurbanTrain );
+    const DepartureInfo untrimmedDeparture( "test", 3, DepartureInfo::NoDepartureFlags,
+            QString(), "S1", " bremerhaven ", QString(), dateTime, InterurbanTrain );
+    QCOMPARE( untrimmedDeparture.targetHandle(), trimmedDeparture.targetHandle() );
+    QCOMPARE( untrimmedDeparture.hash(), trimmedDeparture.hash() );
+}
+
 QTEST_MAIN(PublicTransportHelperTest)
 #include "PublicTransportHelperTest.moc"
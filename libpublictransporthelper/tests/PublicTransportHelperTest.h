@@ -70,6 +70,15 @@ private slots:
 
     void locationModelTest();
 
+    // Tests keys and SVG element IDs of VehicleIconAtlas
+    void vehicleIconAtlasTest();
+
+    // Tests reuse of suggestions for shorter stop name parts in StopSuggestionCache
+    void stopSuggestionCacheTest();
+
+    // Tests handles of StringTable and filters matching stop names using them
+    void stringTableTest();
+
 private:
     StopSettings m_stopSettings;
     FilterSettingsList m_filterConfigurations;
@@ -0,0 +1,285 @@
+/*
+ *   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "vehicleiconatlas.h"
+
+#include <Plasma/PaintUtils>
+#include <KGlobal>
+#include <KDebug>
+#include <QCache>
+#include <QFutureWatcher>
+#include <QImage>
+#include <QPainter>
+#include <QSet>
+#include <QStringList>
+#include <QSvgRenderer>
+#include <QtConcurrentRun>
+
+/** @brief Namespace for the publictransport helper library. */
+namespace PublicTransport {
+
+/** @brief An icon to be rendered in a worker thread. */
+struct IconRequest {
+    quint64 key;
+    QString elementId;
+    QSize size;
+    VehicleIconAtlas::IconFlags flags;
+};
+
+/** @brief An icon rendered in a worker thread. */
+struct RenderedIcon {
+    quint64 key;
+    QImage image;
+};
+
+typedef QFutureWatcher< QList<RenderedIcon> > RenderWatcher;
+
+// Vehicle types with an element in the SVG, icons for all of them get pre-rendered
+static const VehicleType VEHICLE_TYPES[] = { Tram, Bus, TrolleyBus, Subway, Metro,
+        InterurbanTrain, RegionalTrain, RegionalExpressTrain, InterregionalTrain, IntercityTrain,
+        HighSpeedTrain, Feet, Ship, Plane };
+static const int VEHICLE_TYPE_COUNT = sizeof(VEHICLE_TYPES) / sizeof(VEHICLE_TYPES[0]);
+
+class VehicleIconAtlasPrivate
+{
+public:
+    VehicleIconAtlasPrivate() : icons(VehicleIconAtlas::MAXIMUM_CACHE_COST) {};
+
+    ~VehicleIconAtlasPrivate() {
+        qDeleteAll( renderers );
+    };
+
+    /**
+     * @brief Render @p elementId of the SVG in @p renderer into an image of @p size.
+     *
+     * This only uses QImage and can therefore be used in worker threads.
+     **/
+    static QImage renderIcon( QSvgRenderer *renderer, const QString &elementId,
+                              const QSize &size, VehicleIconAtlas::IconFlags flags )
+    {
+        const int shadowWidth = flags.testFlag(VehicleIconAtlas::ShadowedIcon)
+                ? VehicleIconAtlas::SHADOW_WIDTH : 0;
+        QImage icon( size, QImage::Format_ARGB32_Premultiplied );
+        icon.fill( 0 );
+        QPainter p( &icon );
+        p.setRenderHint( QPainter::Antialiasing );
+        renderer->render( &p, elementId, QRectF(shadowWidth, shadowWidth,
+                size.width() - 2 * shadowWidth, size.height() - 2 * shadowWidth) );
+        p.end();
+
+        if ( !flags.testFlag(VehicleIconAtlas::ShadowedIcon) &&
+             !flags.testFlag(VehicleIconAtlas::FadedIcon) )
+        {
+            return icon;
+        }
+
+        QImage image( size, QImage::Format_ARGB32_Premultiplied );
+        image.fill( 0 );
+        QPainter p2( &image );
+        if ( flags.testFlag(VehicleIconAtlas::ShadowedIcon) ) {
+            // Draw a shadow of the icon below it
+            QImage shadow = icon;
+            Plasma::PaintUtils::shadowBlur( shadow, shadowWidth - 1, Qt::black );
+            p2.drawImage( QPoint(1, 2), shadow );
+        }
+        p2.drawImage( QPoint(0, 0), icon );
+
+        if ( flags.testFlag(VehicleIconAtlas::FadedIcon) ) {
+            // Make the right part transparent
+            p2.setCompositionMode( QPainter::CompositionMode_DestinationIn );
+            QLinearGradient gradient( size.width() / 4, 0, size.width(), 0 );
+            gradient.setColorAt( 0.0, Qt::black );
+            gradient.setColorAt( 1.0, Qt::transparent );
+            p2.fillRect( image.rect(), QBrush(gradient) );
+        }
+        p2.end();
+        return image;
+    };
+
+    /** @brief Render all @p requests using the SVG in @p svgFileName, run in a worker thread. */
+    static QList<RenderedIcon> renderIcons( const QString &svgFileName,
+                                            const QList<IconRequest> &requests )
+    {
+        // Use an own renderer for this thread
+        QSvgRenderer renderer( svgFileName );
+        QList<RenderedIcon> icons;
+        foreach ( const IconRequest &request, requests ) {
+            RenderedIcon icon;
+            icon.key = request.key;
+            icon.image = renderIcon( &renderer, request.elementId, request.size, request.flags );
+            icons << icon;
+        }
+        return icons;
+    };
+
+    void insertIcon( quint64 key, const QPixmap &pixmap ) {
+        icons.insert( key, new QPixmap(pixmap),
+                      qMax(1, pixmap.width() * pixmap.height() * pixmap.depth() / 8) );
+    };
+
+    QStringList svgFileNames; // Registered SVG files, the index is the SVG ID
+    QList<QSvgRenderer*> renderers; // Renderers for svgFileNames, only used in the GUI thread
+    QCache<quint64, QPixmap> icons;
+
+    // Keys of icons with UnknownVehicleType, for size/flags combinations that got pre-rendered
+    QSet<quint64> prerenderedGroups;
+};
+
+class VehicleIconAtlasSingleton
+{
+public:
+    VehicleIconAtlas self;
+};
+K_GLOBAL_STATIC( VehicleIconAtlasSingleton, globalVehicleIconAtlas )
+
+VehicleIconAtlas *VehicleIconAtlas::self()
+{
+    return &globalVehicleIconAtlas->self;
+}
+
+VehicleIconAtlas::VehicleIconAtlas() : QObject(), d_ptr(new VehicleIconAtlasPrivate)
+{
+}
+
+VehicleIconAtlas::~VehicleIconAtlas()
+{
+    delete d_ptr;
+}
+
+int VehicleIconAtlas::registerSvg( const QString &svgFileName )
+{
+    Q_D( VehicleIconAtlas );
+    int svgId = d->svgFileNames.indexOf( svgFileName );
+    if ( svgId == -1 ) {
+        svgId = d->svgFileNames.count();
+        d->svgFileNames << svgFileName;
+        d->renderers << new QSvgRenderer( svgFileName );
+    }
+    return svgId;
+}
+
+quint64 VehicleIconAtlas::iconKey( int svgId, VehicleType vehicleType, const QSize &size,
+                                   IconFlags flags )
+{
+    // 8 bits for the SVG ID, the vehicle type and the flags, 16 bits for the width and height
+    return (quint64(svgId & 0xff) << 48) | (quint64(vehicleType & 0xff) << 40)
+            | (quint64(flags & 0xff) << 32) | (quint64(size.width() & 0xffff) << 16)
+            | quint64(size.height() & 0xffff);
+}
+
+QString VehicleIconAtlas::elementId( VehicleType vehicleType, IconFlags flags )
+{
+    QString vehicleKey;
+    switch ( vehicleType ) {
+        case Tram: vehicleKey = "tram"; break;
+        case Bus: vehicleKey = "bus"; break;
+        case TrolleyBus: vehicleKey = "trolleybus"; break;
+        case Subway: vehicleKey = "subway"; break;
+        case Metro: vehicleKey = "metro"; break;
+        case InterurbanTrain: vehicleKey = "interurbantrain"; break;
+        case RegionalTrain: vehicleKey = "regionaltrain"; break;
+        case RegionalExpressTrain: vehicleKey = "regionalexpresstrain"; break;
+        case InterregionalTrain: vehicleKey = "interregionaltrain"; break;
+        case IntercityTrain: vehicleKey = "intercitytrain"; break;
+        case HighSpeedTrain: vehicleKey = "highspeedtrain"; break;
+        case Feet: vehicleKey = "feet"; break;
+        case Ship: vehicleKey = "ship"; break;
+        case Plane: vehicleKey = "plane"; break;
+        default:
+            return QString();
+    }
+
+    // Use monochrome (mostly white) icons
+    if ( flags.testFlag(MonochromeIcon) ) {
+        vehicleKey.append( "_white" );
+    }
+    if ( flags.testFlag(EmptyIcon) ) {
+        vehicleKey.append( "_empty" );
+    }
+
+    return vehicleKey;
+}
+
+QPixmap VehicleIconAtlas::icon( int svgId, VehicleType vehicleType, const QSize &size,
+                                IconFlags flags )
+{
+    Q_D( VehicleIconAtlas );
+    const quint64 key = iconKey( svgId, vehicleType, size, flags );
+    const QPixmap *cachedIcon = d->icons.object( key );
+    if ( cachedIcon ) {
+        return *cachedIcon;
+    }
+    if ( svgId < 0 || svgId >= d->renderers.count() || size.isEmpty() ) {
+        return QPixmap();
+    }
+
+    // Render the requested icon now, store a null pixmap if there is no element for it
+    QSvgRenderer *renderer = d->renderers[ svgId ];
+    const QString element = elementId( vehicleType, flags );
+    QPixmap pixmap;
+    if ( !element.isEmpty() && renderer->elementExists(element) ) {
+        pixmap = QPixmap::fromImage(
+                VehicleIconAtlasPrivate::renderIcon(renderer, element, size, flags) );
+    } else if ( !element.isEmpty() ) {
+        kDebug() << "SVG element" << element << "not found in" << d->svgFileNames[svgId];
+    }
+    d->insertIcon( key, pixmap );
+
+    // Render icons for the other vehicle types with the same size and flags in a worker thread
+    const quint64 groupKey = iconKey( svgId, UnknownVehicleType, size, flags );
+    if ( !d->prerenderedGroups.contains(groupKey) ) {
+        d->prerenderedGroups.insert( groupKey );
+
+        QList<IconRequest> requests;
+        for ( int i = 0; i < VEHICLE_TYPE_COUNT; ++i ) {
+            IconRequest request;
+            request.key = iconKey( svgId, VEHICLE_TYPES[i], size, flags );
+            request.elementId = elementId( VEHICLE_TYPES[i], flags );
+            request.size = size;
+            request.flags = flags;
+            if ( request.key != key && renderer->elementExists(request.elementId) ) {
+                requests << request;
+            }
+        }
+
+        if ( !requests.isEmpty() ) {
+            RenderWatcher *watcher = new RenderWatcher( this );
+            connect( watcher, SIGNAL(finished()), this, SLOT(iconsRendered()) );
+            watcher->setFuture( QtConcurrent::run(&VehicleIconAtlasPrivate::renderIcons,
+                                                  d->svgFileNames[svgId], requests) );
+        }
+    }
+
+    return pixmap;
+}
+
+void VehicleIconAtlas::iconsRendered()
+{
+    Q_D( VehicleIconAtlas );
+    RenderWatcher *watcher = static_cast<RenderWatcher*>( sender() );
+    foreach ( const RenderedIcon &icon, watcher->result() ) {
+        // QPixmaps can only be created in the GUI thread
+        if ( !d->icons.contains(icon.key) ) {
+            d->insertIcon( icon.key, QPixmap::fromImage(icon.image) );
+        }
+    }
+    watcher->deleteLater();
+}
+
+} // namespace PublicTransport
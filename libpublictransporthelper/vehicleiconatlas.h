@@ -0,0 +1,122 @@
+/*
+ *   Copyright 2012 Friedrich Pülz <fpuelz@gmx.de>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Library General Public License as
+ *   published by the Free Software Foundation; either version 2 or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU Library General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef VEHICLEICONATLAS_HEADER
+#define VEHICLEICONATLAS_HEADER
+
+/** @file
+ * @brief This file contains the VehicleIconAtlas class.
+ * @author Friedrich Pülz <fpuelz@gmx.de> */
+
+#include "publictransporthelper_export.h"
+#include "enums.h"
+
+#include <QObject>
+#include <QPixmap>
+
+/** @brief Namespace for the publictransport helper library. */
+namespace PublicTransport {
+
+class VehicleIconAtlasPrivate;
+
+/**
+ * @brief A process-wide cache of rendered vehicle type icons.
+ *
+ * All applets running in the same process share the icons rendered by this atlas, use
+ * self() to get the instance. Icons get identified by integer keys, see iconKey(), which are
+ * cheap to compute for each paint.
+ *
+ * Register the SVG containing the vehicle type elements using registerSvg() once and use the
+ * returned ID with icon(). The first request for an icon in a size/flags combination renders it
+ * directly. The icons of all other vehicle types in the same size and with the same flags then
+ * get rendered in a worker thread, so that following paints only need to draw cached pixmaps.
+ **/
+class PUBLICTRANSPORTHELPER_EXPORT VehicleIconAtlas : public QObject {
+    Q_OBJECT
+    friend class VehicleIconAtlasSingleton;
+
+public:
+    /** @brief Flags for rendered vehicle type icons. */
+    enum IconFlag {
+        ColoredIcon     = 0x00, /**< The default colored vehicle type icon. */
+        EmptyIcon       = 0x01, /**< Vehicle type icon without content, eg. to draw the
+                * transport line string into it. */
+        MonochromeIcon  = 0x02, /**< Use a monochrome version of the icon. */
+        ShadowedIcon    = 0x04, /**< Draw a shadow below the icon. The icon gets drawn
+                * SHADOW_WIDTH pixels smaller, to have space for the shadow. */
+        FadedIcon       = 0x08  /**< Fade the icon out to the right. */
+    };
+    Q_DECLARE_FLAGS( IconFlags, IconFlag )
+
+    /** @brief The width of shadows of icons with the ShadowedIcon flag. */
+    static const int SHADOW_WIDTH = 4;
+
+    /** @brief The maximal number of bytes used by cached pixmaps. */
+    static const int MAXIMUM_CACHE_COST = 8 * 1024 * 1024;
+
+    /** @brief Gets the instance of the atlas used in this process. */
+    static VehicleIconAtlas *self();
+
+    virtual ~VehicleIconAtlas();
+
+    /**
+     * @brief Register the SVG file @p svgFileName containing vehicle type elements.
+     *
+     * @return An ID for the SVG to be used with icon(). Registering the same file again
+     *   returns the same ID.
+     **/
+    int registerSvg( const QString &svgFileName );
+
+    /**
+     * @brief Gets the rendered icon for @p vehicleType.
+     *
+     * @param svgId The ID of the SVG containing the icon, see registerSvg().
+     * @param vehicleType The vehicle type for which to get the icon.
+     * @param size The size of the returned pixmap, including space for shadows.
+     * @param flags Flags for the icon.
+     * @return The rendered icon or a null pixmap, if the SVG contains no element for
+     *   @p vehicleType.
+     **/
+    QPixmap icon( int svgId, VehicleType vehicleType, const QSize &size,
+                  IconFlags flags = ColoredIcon );
+
+    /** @brief Gets the key used to cache an icon, see icon(). */
+    static quint64 iconKey( int svgId, VehicleType vehicleType, const QSize &size,
+                            IconFlags flags = ColoredIcon );
+
+    /** @brief Gets the ID of the SVG element for @p vehicleType with @p flags. */
+    static QString elementId( VehicleType vehicleType, IconFlags flags = ColoredIcon );
+
+protected Q_SLOTS:
+    /** @brief Icons were rendered in a worker thread. */
+    void iconsRendered();
+
+private:
+    VehicleIconAtlas();
+
+    VehicleIconAtlasPrivate* const d_ptr;
+    Q_DECLARE_PRIVATE( VehicleIconAtlas )
+    Q_DISABLE_COPY( VehicleIconAtlas )
+};
+
+} // namespace PublicTransport
+
+Q_DECLARE_OPERATORS_FOR_FLAGS( PublicTransport::VehicleIconAtlas::IconFlags )
+
+#endif // VEHICLEICONATLAS_HEADER
@@ -22,6 +22,7 @@
 
 // libpublictransporthelper includes
 #include "marbleprocess.h"
+#include "stopsuggestioncache.h"
 
 // KDE includes
 #include <KToolInvocation>
@@ -34,12 +35,13 @@
 #include <QWaitCondition>
 #include <QTimer>
 #include <QSemaphore>
+#include <QDateTime>
 
 using namespace PublicTransport;
 
 PublicTransportRunner::PublicTransportRunner( QObject *parent, const QVariantList& args )
         : Plasma::AbstractRunner(parent, args),
-          m_helper(new PublicTransportRunnerHelper(this)),
+          m_queryCount(0), m_activeUpdater(0), m_helper(new PublicTransportRunnerHelper(this)),
           m_semaphore(new QSemaphore(1)), m_marble(0)
 {
     Q_UNUSED( args );
@@ -119,9 +121,43 @@ void PublicTransportRunner::reloadConfiguration()
 
 void PublicTransportRunner::match( Plasma::RunnerContext &context )
 {
+    // Wait a little bit, we don't want to query on every keypress.
+    // Newer queries wake up waiting older ones, which then return without a query.
+    // A running request of an older query gets aborted
+    const int queryDelay = context.query().startsWith( m_settings.keywordStop + ' ',
+            Qt::CaseInsensitive ) ? STOP_SUGGESTIONS_QUERY_DELAY : QUERY_DELAY;
+    m_mutex.lock();
+    const int queryNumber = ++m_queryCount;
+    m_query = context.query();
+    if ( m_activeUpdater ) {
+        QMetaObject::invokeMethod( m_activeUpdater, "abort", Qt::QueuedConnection );
+        m_activeUpdater = 0;
+    }
+    m_queryChanged.wakeAll();
+
+    QTime time;
+    time.start();
+    while ( queryNumber == m_queryCount && time.elapsed() < queryDelay ) {
+        m_queryChanged.wait( &m_mutex, queryDelay - time.elapsed() );
+    }
+    bool superseded = queryNumber != m_queryCount;
+    m_mutex.unlock();
+    if ( superseded || !context.isValid() ) {
+        return;
+    }
+
     // Limit matches running in parallel
     m_semaphore->acquire();
 
+    // Check again, a newer query may have arrived while waiting for the semaphore
+    m_mutex.lock();
+    superseded = queryNumber != m_queryCount;
+    m_mutex.unlock();
+    if ( superseded ) {
+        m_semaphore->release();
+        return;
+    }
+
     // Used aseigo's change in the places runner to make it work with KIO's non-thread-safety
     Plasma::DataEngine *engine = dataEngine( "publictransport" );
     if ( QThread::currentThread() == QCoreApplication::instance()->thread() ) {
@@ -140,6 +176,26 @@ void PublicTransportRunner::match( Plasma::RunnerContext &context )
     m_semaphore->release();
 }
 
+bool PublicTransportRunner::setActiveUpdater( AsyncDataEngineUpdater *updater,
+                                              const QString &query )
+{
+    QMutexLocker locker( &m_mutex );
+    if ( query != m_query ) {
+        return false;
+    }
+
+    m_activeUpdater = updater;
+    return true;
+}
+
+void PublicTransportRunner::resetActiveUpdater( AsyncDataEngineUpdater *updater )
+{
+    QMutexLocker locker( &m_mutex );
+    if ( m_activeUpdater == updater ) {
+        m_activeUpdater = 0;
+    }
+}
+
 void PublicTransportRunnerHelper::match( PublicTransportRunner *runner,
         Plasma::DataEngine *engine, Plasma::RunnerContext* c )
 {
@@ -259,35 +315,54 @@ void PublicTransportRunnerHelper::match( PublicTransportRunner *runner,
         stop2 = rx.cap(2);
     }
 
-    // Wait a little bit, we don't want to query on every keypress
-    QMutex mutex;
-    QWaitCondition waiter;
-    mutex.lock();
-    if ( keywords.testFlag( PublicTransportRunner::StopSuggestions ) ) {
-        // Stop suggestion documents are usually smaller, no need to wait so much
-        waiter.wait( &mutex, 50 );
-    } else {
-        waiter.wait( &mutex, 500 );
-    }
-    mutex.unlock();
-
-    // Check if the context is still valid
-    if ( !context || !context->isValid() ) {
-        emit matchFinished( Aborted );
-        return;
-    }
-
-    // TODO: put the asyncUpdater-code into the helper class as methods?
-    AsyncDataEngineUpdater asyncUpdater( engine, context.data(), runner );
+    // Use results of the same query, if they are not too old. Stop suggestions get taken from
+    // the StopSuggestionCache, which also filters complete suggestions for the beginning of the
+    // stop name. The keystroke delay is done in PublicTransportRunner::match(), outside of the
+    // thread of the data engine
+    const int resultCount = context->singleRunnerQueryMode() ? 10 : settings.resultCount;
+    const QString queryKey = QString( "%1|%2|%3|%4|%5|" ).arg( int(keywords) )
+            .arg( data.minutesUntilFirstResult ).arg( resultCount )
+            .arg( settings.serviceProviderID ).arg( settings.city );
+    const bool stopSuggestions = keywords.testFlag( PublicTransportRunner::StopSuggestions );
+    QList<Result> results;
+    QVariantList cachedStops;
+    if ( stopSuggestions && StopSuggestionCache::self()->suggestions(
+            settings.serviceProviderID, settings.city, stop, &cachedStops) )
+    {
+        results = AsyncDataEngineUpdater::stopSuggestionResults( cachedStops,
+                m_stopSuggestionUrls.value(settings.serviceProviderID) );
+    } else if ( stopSuggestions || !cachedResults(queryKey, stop, stop2, &results) ) {
+        // TODO: put the asyncUpdater-code into the helper class as methods?
+        AsyncDataEngineUpdater asyncUpdater( engine, context.data(), runner );
+        if ( !runner->setActiveUpdater(&asyncUpdater, context->query()) ) {
+            // A newer query has arrived meanwhile
+            emit matchFinished( Aborted );
+            return;
+        }
 
-    QEventLoop loop;
-    connect( &asyncUpdater, SIGNAL(finished(bool)), &loop, SLOT(quit()) );
+        QEventLoop loop;
+        connect( &asyncUpdater, SIGNAL(finished(bool)), &loop, SLOT(quit()) );
 
-    // Query results from the data engine
-    asyncUpdater.query( engine, data, stop, stop2 );
+        // Query results from the data engine
+        asyncUpdater.query( engine, data, stop, stop2 );
 
-    // Wait for the updater to finish
-    loop.exec();
+        // Wait for the updater to finish or to get aborted by a newer query
+        loop.exec();
+        runner->resetActiveUpdater( &asyncUpdater );
+
+        results = asyncUpdater.results();
+        if ( asyncUpdater.hasStopSuggestions() ) {
+            // Only successfully received suggestions get stored
+            StopSuggestionCache::self()->insertSuggestions( settings.serviceProviderID,
+                    settings.city, stop, asyncUpdater.stopSuggestions(), resultCount );
+            m_stopSuggestionUrls.insert( settings.serviceProviderID, asyncUpdater.requestUrl() );
+        } else if ( !stopSuggestions && !results.isEmpty() ) {
+            CachedResults cached;
+            cached.results = results;
+            cached.expires = QDateTime::currentDateTime().addSecs( RESULT_CACHE_TIMEOUT );
+            m_cachedResults.insert( queryKey + stop.toLower() + '|' + stop2.toLower(), cached );
+        }
+    }
 
     // Check if the context is still valid
     if ( !context || !context->isValid() ) {
@@ -296,7 +371,6 @@ void PublicTransportRunnerHelper::match( PublicTransportRunner *runner,
     }
 
     // Create a match for each result
-    const QList<Result> results = asyncUpdater.results();
     QList<Plasma::QueryMatch> matches;
     foreach( const Result &result, results ) {
         Plasma::QueryMatch m( runner );
@@ -313,6 +387,29 @@ void PublicTransportRunnerHelper::match( PublicTransportRunner *runner,
     emit matchFinished( FinishedSuccessfully );
 }
 
+bool PublicTransportRunnerHelper::cachedResults( const QString &queryKey, const QString &stop,
+        const QString &stop2, QList<Result> *results )
+{
+    // Remove expired results
+    const QDateTime now = QDateTime::currentDateTime();
+    QHash< QString, CachedResults >::Iterator it = m_cachedResults.begin();
+    while ( it != m_cachedResults.end() ) {
+        if ( it->expires < now ) {
+            it = m_cachedResults.erase( it );
+        } else {
+            ++it;
+        }
+    }
+
+    it = m_cachedResults.find( queryKey + stop.toLower() + '|' + stop2.toLower() );
+    if ( it == m_cachedResults.end() ) {
+        return false;
+    }
+
+    *results = it->results;
+    return true;
+}
+
 void PublicTransportRunner::run( const Plasma::RunnerContext &context,
                                  const Plasma::QueryMatch &match )
 {
@@ -346,7 +443,8 @@ void PublicTransportRunner::marbleFinished()
 
 AsyncDataEngineUpdater::AsyncDataEngineUpdater( Plasma::DataEngine *engine,
         Plasma::RunnerContext* context, PublicTransportRunner *runner )
-        : QObject(0), m_engine(engine), m_context(context), m_runner(runner)
+        : QObject(0), m_hasStopSuggestions(false), m_engine(engine), m_context(context),
+          m_runner(runner)
 {
     m_settings = m_runner->settings();
 }
@@ -356,6 +454,21 @@ QList< Result > AsyncDataEngineUpdater::results() const
     return m_results;
 }
 
+bool AsyncDataEngineUpdater::hasStopSuggestions() const
+{
+    return m_hasStopSuggestions;
+}
+
+QVariantList AsyncDataEngineUpdater::stopSuggestions() const
+{
+    return m_stopSuggestions;
+}
+
+QUrl AsyncDataEngineUpdater::requestUrl() const
+{
+    return m_requestUrl;
+}
+
 Plasma::DataEngine* AsyncDataEngineUpdater::engine() const
 {
     return m_engine;
@@ -632,7 +745,7 @@ void AsyncDataEngineUpdater::processDepartures( const QString &sourceName,
         res.relevance = 0.8;
         m_results << res;
     } else {
-        normalizeRelevance( min, max );
+        normalizeRelevance( &m_results, min, max );
     }
 }
 
@@ -822,7 +935,7 @@ void AsyncDataEngineUpdater::processJourneys( const QString& sourceName, const P
         res.relevance = 0.8;
         m_results << res;
     } else {
-        normalizeRelevance( min, max );
+        normalizeRelevance( &m_results, min, max );
     }
 }
 
@@ -831,13 +944,22 @@ void AsyncDataEngineUpdater::processStopSuggestions( const QString& sourceName,
 {
     Q_UNUSED( sourceName )
 
+    // Keep the received stops to be stored in the StopSuggestionCache
+    m_hasStopSuggestions = true;
+    m_stopSuggestions = data["stops"].toList();
+    m_requestUrl = data["requestUrl"].toUrl();
+    m_results = stopSuggestionResults( m_stopSuggestions, m_requestUrl );
+}
+
+QList< Result > AsyncDataEngineUpdater::stopSuggestionResults( const QVariantList &stops,
+                                                              const QUrl &url )
+{
     // Cache stop icon for all stop suggestions
     KIcon icon( "public-transport-stop" );
 
     // Get all stop names, IDs, weights
-    QUrl url = data["requestUrl"].toUrl();
+    QList< Result > results;
     qreal min = INT_MAX, max = 0;
-    QVariantList stops = data["stops"].toList();
     foreach ( const QVariant &stopData, stops ) {
         QVariantHash stop = stopData.toHash();
         QString stopName = stop["StopName"].toString();
@@ -858,45 +980,46 @@ void AsyncDataEngineUpdater::processStopSuggestions( const QString& sourceName,
         res.data["StopID"] = stopID;
         res.data["StopLongitude"] = longitude;
         res.data["StopLatitude"] = latitude;
-        m_results << res;
+        results << res;
 
         min = qMin( min, res.relevance );
         max = qMax( max, res.relevance );
     }
 
-    if ( m_results.isEmpty() ) {
+    if ( results.isEmpty() ) {
         // No stop suggestions found
         Result res;
         res.icon = icon;
         res.url = url;
         res.text = i18n( "No stop suggestions found, try another one" );
         res.relevance = 0.8;
-        m_results << res;
+        results << res;
     } else {
-        normalizeRelevance( min, max );
+        normalizeRelevance( &results, min, max );
 
-        for ( int i = 0; i < m_results.length(); ++i ) {
-            Result &res = m_results[i];
+        for ( int i = 0; i < results.length(); ++i ) {
+            Result &res = results[i];
             res.subtext = i18n( "Relevance: %1%, Service Provider's Stop ID: %2",
                                 qRound( res.relevance * 100 ), res.data["StopID"].toString() );
         }
     }
+    return results;
 }
 
-void AsyncDataEngineUpdater::normalizeRelevance( qreal min, qreal max )
+void AsyncDataEngineUpdater::normalizeRelevance( QList< Result > *results, qreal min, qreal max )
 {
     const qreal span = max - min;
     if ( qFuzzyIsNull( span ) ) {
         // Maximum and minimum relevance are (almost) equal
-        for ( int i = 0; i < m_results.length(); ++i ) {
-            m_results[i].relevance = 0.8;
+        for ( int i = 0; i < results->length(); ++i ) {
+            (*results)[i].relevance = 0.8;
         }
     } else {
         const qreal targetMin = 0.6;
         const qreal targetMax = 1.0;
-        for ( int i = 0; i < m_results.length(); ++i ) {
-            m_results[i].relevance = targetMin + ( targetMax - targetMin ) *
-                                     ( m_results[i].relevance - min ) / span;
+        for ( int i = 0; i < results->length(); ++i ) {
+            (*results)[i].relevance = targetMin + ( targetMax - targetMin ) *
+                                      ( (*results)[i].relevance - min ) / span;
         }
     }
 }
@@ -23,11 +23,13 @@
 #include <plasma/abstractrunner.h>
 #include <KIcon>
 #include <Plasma/DataEngine>
+#include <QWaitCondition>
 #include "config/publictransportrunner_config.h"
 
 class QSemaphore;
 class MarbleProcess;
 class PublicTransportRunnerHelper;
+class AsyncDataEngineUpdater;
 
 // Define our plasma Runner
 class PublicTransportRunner : public Plasma::AbstractRunner {
@@ -70,6 +72,12 @@ public:
         int resultCount;
     };
 
+    /** @brief Milliseconds to wait for further keystrokes before starting a query. */
+    static const int QUERY_DELAY = 500;
+
+    /** @brief Like QUERY_DELAY for stop suggestion queries, their documents are smaller. */
+    static const int STOP_SUGGESTIONS_QUERY_DELAY = 50;
+
     // Basic Create/Destroy
     PublicTransportRunner( QObject *parent, const QVariantList& args );
     ~PublicTransportRunner();
@@ -82,6 +90,19 @@ public:
 
     QMutex &mutex() { return m_mutex; };
 
+    /**
+     * @brief Set the updater that runs the data engine request for @p query.
+     *
+     * The updater gets aborted, when a newer query arrives in match().
+     *
+     * @return False, if a newer query has arrived meanwhile. The updater then does not get set
+     *   and should not be started.
+     **/
+    bool setActiveUpdater( AsyncDataEngineUpdater *updater, const QString &query );
+
+    /** @brief Unset @p updater, if it is the active updater, ie. before it gets deleted. */
+    void resetActiveUpdater( AsyncDataEngineUpdater *updater );
+
 signals:
     void doMatch(PublicTransportRunner *runner, Plasma::DataEngine *engine, Plasma::RunnerContext *context);
 
@@ -91,6 +112,10 @@ protected slots:
 
 private:
     QMutex m_mutex;
+    QWaitCondition m_queryChanged; // Woken up when a new query arrives in match()
+    int m_queryCount; // Counts queries to find out if a query was superseded by a newer one
+    QString m_query; // The newest query
+    AsyncDataEngineUpdater *m_activeUpdater; // Running request for m_query or 0
     PublicTransportRunnerHelper *m_helper;
     Settings m_settings;
     QSemaphore *m_semaphore;
@@ -101,26 +126,6 @@ K_EXPORT_PLASMA_RUNNER(publictransport, PublicTransportRunner)
 Q_DECLARE_OPERATORS_FOR_FLAGS( PublicTransportRunner::Keywords )
 
 
-class PublicTransportRunnerHelper : public QObject {
-    Q_OBJECT
-
-public:
-    enum FinishType {
-        FinishedSuccessfully = 0,
-        FinishedWithErrors,
-        Aborted
-    };
-
-    explicit PublicTransportRunnerHelper( PublicTransportRunner *runner );
-
-signals:
-    void matchFinished( FinishType finishType = FinishedSuccessfully );
-
-public slots:
-    void match( PublicTransportRunner *runner, Plasma::DataEngine *engine,
-                Plasma::RunnerContext *context );
-};
-
 /**
 * @brief Contains information about a single match from the search.
 */
@@ -183,6 +188,18 @@ public:
     QList<Result> results() const;
     Plasma::DataEngine *engine() const;
 
+    /** @brief Whether or not stop suggestions were received successfully. */
+    bool hasStopSuggestions() const;
+
+    /** @brief The received "stops" value, if hasStopSuggestions() returns true. */
+    QVariantList stopSuggestions() const;
+
+    /** @brief The URL of the provider's page, from which the results were received. */
+    QUrl requestUrl() const;
+
+    /** @brief Create results for suggested @p stops in the format of the engine. */
+    static QList<Result> stopSuggestionResults( const QVariantList &stops, const QUrl &url );
+
 signals:
     /**
      * @brief Emitted when a search has been completed.
@@ -212,9 +229,12 @@ private:
 
     static bool isTimeShown( const QDateTime& dateTime, int timeOffsetOfFirstDeparture );
 
-    void normalizeRelevance( qreal min, qreal max );
+    static void normalizeRelevance( QList<Result> *results, qreal min, qreal max );
 
     QList<Result> m_results;
+    bool m_hasStopSuggestions;
+    QVariantList m_stopSuggestions;
+    QUrl m_requestUrl;
     Plasma::DataEngine *m_engine;
     QPointer< Plasma::RunnerContext > m_context;
     PublicTransportRunner::QueryData m_data;
@@ -223,4 +243,48 @@ private:
     PublicTransportRunner *m_runner;
 };
 
+class PublicTransportRunnerHelper : public QObject {
+    Q_OBJECT
+
+public:
+    enum FinishType {
+        FinishedSuccessfully = 0,
+        FinishedWithErrors,
+        Aborted
+    };
+
+    /** @brief Seconds for which results of a query get reused for the same query. */
+    static const int RESULT_CACHE_TIMEOUT = 60;
+
+    explicit PublicTransportRunnerHelper( PublicTransportRunner *runner );
+
+signals:
+    void matchFinished( FinishType finishType = FinishedSuccessfully );
+
+public slots:
+    void match( PublicTransportRunner *runner, Plasma::DataEngine *engine,
+                Plasma::RunnerContext *context );
+
+private:
+    /** @brief Results of a query, stored for RESULT_CACHE_TIMEOUT seconds. */
+    struct CachedResults {
+        QList<Result> results;
+        QDateTime expires;
+    };
+
+    /**
+     * @brief Get cached results of the same departure, arrival or journey query.
+     *
+     * Stop suggestions get cached in the StopSuggestionCache instead, which can also reuse
+     * complete suggestions for the beginning of a stop name.
+     *
+     * @return True, if cached results were found and written to @p results.
+     **/
+    bool cachedResults( const QString &queryKey, const QString &stop, const QString &stop2,
+                        QList<Result> *results );
+
+    QHash< QString, CachedResults > m_cachedResults; // Keys are query keys with stop names
+    QHash< QString, QUrl > m_stopSuggestionUrls; // Last request URL by service provider ID
+};
+
 #endif